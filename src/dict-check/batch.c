@@ -0,0 +1,606 @@
+/** @file
+    Implementacja równoległego sprawdzania wielu plików.
+
+    @ingroup dict-check
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-25
+    @copyright Uniwersytet Warszawski
+  */
+
+#include "batch.h"
+#include "reader.h"
+#include "writer.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Numer fragmentu oznaczający zadanie otwarcia pliku.
+#define BATCH_OPEN SIZE_MAX
+
+/// Początkowy rozmiar bufora wyjścia diagnostycznego fragmentu.
+#define BATCH_ERR_BUFFER 256
+
+/**
+  Wynik sprawdzenia fragmentu pliku.
+  */
+struct chunk_result
+{
+    struct writer out;          ///< Wyjście (w pamięci).
+    struct writer err;          ///< Wyjście diagnostyczne (w pamięci).
+    int status;                 ///< Wynik checker_run().
+};
+
+/**
+  Sprawdzany plik.
+  */
+struct job
+{
+    const char *path;               ///< Ścieżka.
+    int fd;                         ///< Deskryptor lub -1.
+    char *map;                      ///< Zmapowany plik lub NULL.
+    size_t size;                    ///< Rozmiar pliku.
+    size_t chunks;                  ///< Liczba fragmentów (0 przed otwarciem).
+    size_t *starts;                 ///< Początki fragmentów (`chunks + 1` pozycji).
+    int *rows;                      ///< Wiersze, w których zaczynają się fragmenty.
+    struct chunk_result *results;   ///< Wyniki fragmentów.
+    size_t remaining;               ///< Liczba niesprawdzonych fragmentów (atomowo).
+    bool failed;                    ///< Czy nie udało się otworzyć pliku.
+    bool done;                      ///< Czy wyniki są gotowe (chronione blokadą wyjścia).
+};
+
+/**
+  Zadanie: otwarcie pliku albo sprawdzenie jego fragmentu.
+  */
+struct task
+{
+    struct job *job;            ///< Plik.
+    size_t chunk;               ///< Numer fragmentu lub BATCH_OPEN.
+};
+
+/**
+  Kolejka zadań wątku (cykliczna, z dostępem z obu końców).
+  */
+struct deque
+{
+    pthread_mutex_t lock;       ///< Blokada.
+    struct task *tasks;         ///< Zadania.
+    size_t head;                ///< Początek kolejki.
+    size_t len;                 ///< Liczba zadań.
+    size_t cap;                 ///< Pojemność.
+};
+
+struct batch;
+
+/**
+  Wątek sprawdzający.
+  */
+struct batch_worker
+{
+    pthread_t thread;           ///< Wątek.
+    struct batch *b;            ///< Wspólny stan.
+    size_t index;               ///< Numer wątku.
+    struct deque queue;         ///< Własna kolejka zadań.
+    struct checker checker;     ///< Stan sprawdzania.
+};
+
+/**
+  Wspólny stan sprawdzania wielu plików.
+  */
+struct batch
+{
+    const struct check_options *opts;   ///< Opcje sprawdzania.
+    const struct batch_options *bo;     ///< Opcje sprawdzania wielu plików.
+    struct job *jobs;                   ///< Pliki.
+    size_t jobs_no;                     ///< Liczba plików.
+    struct batch_worker *workers;       ///< Wątki.
+    size_t workers_no;                  ///< Liczba wątków.
+    size_t pending;                     ///< Liczba niezakończonych zadań (atomowo).
+    pthread_mutex_t idle_lock;          ///< Blokada czekania na zadania.
+    pthread_cond_t idle_cond;           ///< Nowe zadania lub koniec wszystkich zadań.
+    size_t pushes;                      ///< Licznik udostępnień fragmentów (atomowo, zmieniany pod blokadą czekania).
+    pthread_mutex_t out_lock;           ///< Blokada wyjścia.
+    size_t next;                        ///< Pierwszy niewypisany plik.
+    int status;                         ///< Wynik całego sprawdzania.
+};
+
+/** @name Funkcje pomocnicze
+ * @{
+ */
+
+/**
+  Dodaje zadanie na koniec kolejki.
+  @param[in,out] q Kolejka.
+  @param[in] t Zadanie.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+static int deque_push(struct deque *q, struct task t)
+{
+    pthread_mutex_lock(&q->lock);
+    if(q->len == q->cap)
+    {
+        size_t cap = q->cap == 0 ? 16 : 2 * q->cap;
+        struct task *nt = malloc(cap * sizeof(struct task));
+        if(nt == NULL)
+        {
+            pthread_mutex_unlock(&q->lock);
+            return -1;
+        }
+        for(size_t i = 0; i < q->len; i++)
+            nt[i] = q->tasks[(q->head + i) % q->cap];
+        free(q->tasks);
+        q->tasks = nt;
+        q->head = 0;
+        q->cap = cap;
+    }
+    q->tasks[(q->head + q->len) % q->cap] = t;
+    q->len++;
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+}
+
+/**
+  Wyjmuje zadanie z kolejki.
+  Właściciel bierze zadania z początku, a podkradający z końca.
+  @param[in,out] q Kolejka.
+  @param[in] steal Czy brać z końca kolejki.
+  @param[out] t Zadanie.
+  @return Czy wyjęto zadanie.
+  */
+static bool deque_pop(struct deque *q, bool steal, struct task *t)
+{
+    pthread_mutex_lock(&q->lock);
+    bool ok = q->len > 0;
+    if(ok)
+    {
+        if(steal) *t = q->tasks[(q->head + q->len - 1) % q->cap];
+        else
+        {
+            *t = q->tasks[q->head];
+            q->head = (q->head + 1) % q->cap;
+        }
+        q->len--;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+/**
+  Znajduje zadanie dla wątku: najpierw we własnej kolejce, potem w cudzych.
+  @param[in,out] w Wątek.
+  @param[out] t Zadanie.
+  @return Czy znaleziono zadanie.
+  */
+static bool next_task(struct batch_worker *w, struct task *t)
+{
+    if(deque_pop(&w->queue, false, t)) return true;
+    struct batch *b = w->b;
+    for(size_t k = 1; k < b->workers_no; k++)
+        if(deque_pop(&b->workers[(w->index + k) % b->workers_no].queue, true, t))
+            return true;
+    return false;
+}
+
+/**
+  Dzieli zmapowany plik na fragmenty zaczynające się na początku wiersza.
+  @param[in,out] job Plik.
+  @param[in] chunk Docelowy rozmiar fragmentu.
+  @return 0 jeśli się udało, -1 jeśli brakło pamięci.
+  */
+static int split_job(struct job *job, size_t chunk)
+{
+    size_t n = 1 + job->size / chunk;
+    job->starts = malloc((n + 1) * sizeof(size_t));
+    job->rows = malloc(n * sizeof(int));
+    if(job->starts == NULL || job->rows == NULL) return -1;
+    size_t k = 0;
+    job->starts[0] = 0;
+    job->rows[0] = 1;
+    size_t pos = chunk;
+    while(pos < job->size && k + 1 < n)
+    {
+        const char *nl = memchr(job->map + pos, '\n', job->size - pos);
+        if(nl == NULL) break;
+        size_t start = nl - job->map + 1;
+        if(start >= job->size) break;
+        // Wiersz nowego fragmentu to liczba znaków nowej linii przed nim
+        int rows = job->rows[k];
+        for(const char *p = job->map + job->starts[k];
+            (p = memchr(p, '\n', job->map + start - p)) != NULL; p++)
+            rows++;
+        k++;
+        job->starts[k] = start;
+        job->rows[k] = rows;
+        pos = start + chunk;
+    }
+    job->chunks = k + 1;
+    job->starts[job->chunks] = job->size;
+    return 0;
+}
+
+/**
+  Sprawdza fragment pliku albo cały plik czytany strumieniowo.
+  @param[in,out] w Wątek.
+  @param[in,out] job Plik.
+  @param[in] k Numer fragmentu.
+  */
+static void run_chunk(struct batch_worker *w, struct job *job, size_t k)
+{
+    struct chunk_result *r = &job->results[k];
+    const struct check_options *opts = w->b->opts;
+    struct reader in;
+    struct check_source src = { job->path, 0, 1 };
+    size_t len = job->size;
+    if(job->map != NULL)
+    {
+        src.offset = job->starts[k];
+        src.row = job->rows[k];
+        len = job->starts[k + 1] - job->starts[k];
+        reader_open_memory(&in, job->map + src.offset, len);
+    }
+    else if(job->fd < 0 || reader_open(&in, job->fd) < 0)
+        reader_open_memory(&in, "", 0);
+    r->status = -1;
+    r->err.buffer = NULL;
+    if(writer_init(&r->out, NULL, opts->echo ? len + len / 8 + 64 : BATCH_ERR_BUFFER) == 0
+       && writer_init(&r->err, NULL, BATCH_ERR_BUFFER) == 0)
+        r->status = checker_run(&w->checker, opts, &src, &in, &r->out, &r->err);
+    if(r->out.failed || r->err.failed) r->status = -1;
+    reader_done(&in);
+}
+
+/**
+  Zapisuje dane do pliku.
+  @param[in] path Ścieżka.
+  @param[in] data Dane.
+  @param[in] len Długość danych.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+static int write_file(const char *path, const char *data, size_t len)
+{
+    FILE *f = fopen(path, "wb");
+    if(f == NULL) return -1;
+    size_t n = fwrite(data, 1, len, f);
+    return fclose(f) == 0 && n == len ? 0 : -1;
+}
+
+/**
+  Wypisuje wyniki pliku na standardowe wyjścia albo do plików wynikowych
+  i zwalnia je. Fragmenty po pierwszym niepoprawnym UTF-8 są pomijane,
+  tak jak przy sprawdzaniu całego pliku naraz.
+  @param[in,out] b Wspólny stan.
+  @param[in,out] job Plik.
+  */
+static void emit_job(struct batch *b, struct job *job)
+{
+    if(job->failed)
+    {
+        fprintf(stderr, "Could not open file: %s\n", job->path);
+        b->status = 1;
+        return;
+    }
+    size_t used = 0;
+    size_t out_len = 0, err_len = 0;
+    while(used < job->chunks)
+    {
+        struct chunk_result *r = &job->results[used++];
+        out_len += r->out.len;
+        err_len += r->err.len;
+        if(r->status < 0)
+        {
+            fprintf(stderr, "Out of memory while checking: %s\n", job->path);
+            b->status = 1;
+        }
+        if(r->status != 0) break;
+    }
+    if(b->bo->suffix == NULL)
+    {
+        for(size_t k = 0; k < used; k++)
+            fwrite(job->results[k].out.buffer, 1, job->results[k].out.len, stdout);
+        for(size_t k = 0; k < used; k++)
+            fwrite(job->results[k].err.buffer, 1, job->results[k].err.len, stderr);
+    }
+    else
+    {
+        // Sklejamy wyniki fragmentów w pierwszym z nich
+        struct writer *out = &job->results[0].out, *err = &job->results[0].err;
+        for(size_t k = 1; k < used; k++)
+        {
+            writer_write(out, job->results[k].out.buffer, job->results[k].out.len);
+            writer_write(err, job->results[k].err.buffer, job->results[k].err.len);
+        }
+        size_t pl = strlen(job->path), sl = strlen(b->bo->suffix);
+        char *name = malloc(pl + sl + 5);
+        bool ok = name != NULL && !out->failed && !err->failed;
+        if(ok)
+        {
+            memcpy(name, job->path, pl);
+            strcpy(name + pl, b->bo->suffix);
+            ok = write_file(name, out->buffer, out_len) == 0;
+            strcat(name, ".err");
+            if(err_len > 0) ok = ok && write_file(name, err->buffer, err_len) == 0;
+            else unlink(name);
+        }
+        if(!ok)
+        {
+            fprintf(stderr, "Could not write results for: %s\n", job->path);
+            b->status = 1;
+        }
+        free(name);
+    }
+}
+
+/**
+  Zwalnia wyniki pliku.
+  @param[in,out] job Plik.
+  */
+static void free_job(struct job *job)
+{
+    for(size_t k = 0; k < job->chunks && job->results != NULL; k++)
+    {
+        if(job->results[k].out.buffer != NULL) writer_done(&job->results[k].out);
+        if(job->results[k].err.buffer != NULL) writer_done(&job->results[k].err);
+    }
+    free(job->results);
+    free(job->starts);
+    free(job->rows);
+    job->results = NULL;
+    job->starts = NULL;
+    job->rows = NULL;
+}
+
+/**
+  Kończy plik, którego wszystkie fragmenty zostały sprawdzone.
+  @param[in,out] b Wspólny stan.
+  @param[in,out] job Plik.
+  */
+static void finish_job(struct batch *b, struct job *job)
+{
+    if(job->map != NULL) munmap(job->map, job->size);
+    if(job->fd >= 0) close(job->fd);
+    job->map = NULL;
+    job->fd = -1;
+    pthread_mutex_lock(&b->out_lock);
+    if(b->bo->suffix != NULL)
+    {
+        emit_job(b, job);
+        free_job(job);
+    }
+    else
+    {
+        // Wypisujemy wszystkie gotowe pliki, które są następne w kolejności
+        job->done = true;
+        while(b->next < b->jobs_no && b->jobs[b->next].done)
+        {
+            emit_job(b, &b->jobs[b->next]);
+            free_job(&b->jobs[b->next]);
+            b->next++;
+        }
+    }
+    pthread_mutex_unlock(&b->out_lock);
+}
+
+/**
+  Budzi wątki czekające na zadania, bo udostępniono nowe fragmenty.
+  @param[in,out] b Wspólny stan.
+  */
+static void wake_idle(struct batch *b)
+{
+    pthread_mutex_lock(&b->idle_lock);
+    __atomic_add_fetch(&b->pushes, 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&b->idle_cond);
+    pthread_mutex_unlock(&b->idle_lock);
+}
+
+/**
+  Kończy zadanie; po ostatnim budzi czekające wątki, żeby się zakończyły.
+  @param[in,out] b Wspólny stan.
+  */
+static void task_done(struct batch *b)
+{
+    if(__atomic_sub_fetch(&b->pending, 1, __ATOMIC_ACQ_REL) > 0) return;
+    pthread_mutex_lock(&b->idle_lock);
+    pthread_cond_broadcast(&b->idle_cond);
+    pthread_mutex_unlock(&b->idle_lock);
+}
+
+/**
+  Oznacza fragment jako sprawdzony i kończy plik po ostatnim fragmencie.
+  @param[in,out] b Wspólny stan.
+  @param[in,out] job Plik.
+  */
+static void finish_chunk(struct batch *b, struct job *job)
+{
+    if(__atomic_sub_fetch(&job->remaining, 1, __ATOMIC_ACQ_REL) == 0)
+        finish_job(b, job);
+}
+
+/**
+  Otwiera plik, dzieli go na fragmenty, udostępnia fragmenty innym
+  wątkom i sprawdza pierwszy z nich.
+  @param[in,out] w Wątek.
+  @param[in,out] job Plik.
+  */
+static void open_job(struct batch_worker *w, struct job *job)
+{
+    struct batch *b = w->b;
+    struct stat st;
+    job->fd = open(job->path, O_RDONLY);
+    if(job->fd < 0 || fstat(job->fd, &st) < 0)
+    {
+        job->failed = true;
+        finish_job(b, job);
+        return;
+    }
+    job->chunks = 1;
+    if(S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, job->fd, 0);
+        if(m != MAP_FAILED)
+        {
+            madvise(m, st.st_size, MADV_SEQUENTIAL);
+            job->map = m;
+            job->size = st.st_size;
+            if(split_job(job, b->bo->chunk) < 0)
+            {
+                // Bez podziału sprawdzamy plik w całości
+                free(job->starts);
+                free(job->rows);
+                job->starts = NULL;
+                job->rows = NULL;
+                munmap(job->map, job->size);
+                job->map = NULL;
+                job->chunks = 1;
+            }
+        }
+    }
+    job->results = calloc(job->chunks, sizeof(struct chunk_result));
+    if(job->results == NULL)
+    {
+        job->failed = true;
+        job->chunks = 0;
+        finish_job(b, job);
+        return;
+    }
+    job->remaining = job->chunks;
+    if(job->chunks > 1)
+    {
+        __atomic_add_fetch(&b->pending, job->chunks - 1, __ATOMIC_ACQ_REL);
+        for(size_t k = 1; k < job->chunks; k++)
+        {
+            struct task t = { job, k };
+            if(deque_push(&w->queue, t) < 0)
+            {
+                // Nie da się udostępnić fragmentu: sprawdzamy go sami
+                run_chunk(w, job, k);
+                finish_chunk(b, job);
+                task_done(b);
+            }
+        }
+        wake_idle(b);
+    }
+    run_chunk(w, job, 0);
+    finish_chunk(b, job);
+}
+
+/**
+  Pętla wątku sprawdzającego.
+  @param[in] arg Wątek (struct batch_worker).
+  @return NULL.
+  */
+static void * worker_main(void *arg)
+{
+    struct batch_worker *w = arg;
+    struct batch *b = w->b;
+    while(1)
+    {
+        size_t pushes = __atomic_load_n(&b->pushes, __ATOMIC_ACQUIRE);
+        struct task t;
+        if(next_task(w, &t))
+        {
+            if(t.chunk == BATCH_OPEN) open_job(w, t.job);
+            else
+            {
+                run_chunk(w, t.job, t.chunk);
+                finish_chunk(b, t.job);
+            }
+            task_done(b);
+            continue;
+        }
+        // Brak zadań: kończymy, chyba że inne wątki mogą jeszcze udostępnić
+        // fragmenty; wtedy czekamy, aż to zrobią albo skończą wszystkie zadania
+        pthread_mutex_lock(&b->idle_lock);
+        while(__atomic_load_n(&b->pending, __ATOMIC_ACQUIRE) > 0
+              && __atomic_load_n(&b->pushes, __ATOMIC_ACQUIRE) == pushes)
+            pthread_cond_wait(&b->idle_cond, &b->idle_lock);
+        bool finished = __atomic_load_n(&b->pending, __ATOMIC_ACQUIRE) == 0;
+        pthread_mutex_unlock(&b->idle_lock);
+        if(finished) break;
+    }
+    return NULL;
+}
+
+/**
+ * @}
+ */
+
+/** @name Elementy interfejsu
+ * @{
+ */
+
+int batch_run(const struct dictionary *dict, const struct check_options *opts,
+        const struct batch_options *bo, char **paths, size_t paths_no)
+{
+    struct batch b;
+    b.opts = opts;
+    b.bo = bo;
+    b.jobs_no = paths_no;
+    b.workers_no = bo->threads;
+    b.pending = paths_no;
+    b.pushes = 0;
+    b.next = 0;
+    b.status = 0;
+    b.jobs = calloc(paths_no, sizeof(struct job));
+    b.workers = calloc(b.workers_no, sizeof(struct batch_worker));
+    if(b.jobs == NULL || b.workers == NULL)
+    {
+        free(b.jobs);
+        free(b.workers);
+        return 1;
+    }
+    pthread_mutex_init(&b.out_lock, NULL);
+    pthread_mutex_init(&b.idle_lock, NULL);
+    pthread_cond_init(&b.idle_cond, NULL);
+    for(size_t i = 0; i < b.workers_no; i++)
+    {
+        struct batch_worker *w = &b.workers[i];
+        w->b = &b;
+        w->index = i;
+        pthread_mutex_init(&w->queue.lock, NULL);
+        if(checker_init(&w->checker, dict, bo->memo_limit / b.workers_no) < 0)
+        {
+            fprintf(stderr, "Out of memory.\n");
+            exit(1);
+        }
+    }
+    // Pliki rozdzielamy po kolei, żeby wcześniejsze pliki kończyły się wcześniej
+    for(size_t i = 0; i < paths_no; i++)
+    {
+        b.jobs[i].path = paths[i];
+        b.jobs[i].fd = -1;
+        struct task t = { &b.jobs[i], BATCH_OPEN };
+        if(deque_push(&b.workers[i % b.workers_no].queue, t) < 0)
+        {
+            fprintf(stderr, "Out of memory.\n");
+            exit(1);
+        }
+    }
+    for(size_t i = 0; i < b.workers_no; i++)
+        pthread_create(&b.workers[i].thread, NULL, worker_main, &b.workers[i]);
+    for(size_t i = 0; i < b.workers_no; i++)
+    {
+        pthread_join(b.workers[i].thread, NULL);
+        checker_done(&b.workers[i].checker);
+        free(b.workers[i].queue.tasks);
+        pthread_mutex_destroy(&b.workers[i].queue.lock);
+    }
+    pthread_mutex_destroy(&b.out_lock);
+    pthread_mutex_destroy(&b.idle_lock);
+    pthread_cond_destroy(&b.idle_cond);
+    fflush(stdout);
+    fflush(stderr);
+    free(b.workers);
+    free(b.jobs);
+    return b.status;
+}
+
+/**
+ * @}
+ */
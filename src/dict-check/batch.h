@@ -0,0 +1,54 @@
+/** @file
+    Interfejs równoległego sprawdzania wielu plików.
+
+    Pliki są rozdzielane między wątki, z których każdy ma własną
+    kolejkę zadań i własny stan sprawdzania (struct checker).
+    Wątek bez zadań podkrada je z końca kolejki innego wątku.
+    Duży plik jest dzielony na fragmenty zaczynające się na początku
+    wiersza; fragmenty trafiają do kolejki wątku, który otworzył plik,
+    więc bezczynne wątki mogą je przejąć.
+
+    Wyniki pliku trafiają albo do osobnych plików
+    (`ścieżka` + przyrostek dla wyjścia, `.err` dodatkowo dla wyjścia
+    diagnostycznego), albo na standardowe wyjścia w kolejności plików.
+
+    @ingroup dict-check
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-25
+    @copyright Uniwersytet Warszawski
+  */
+
+#ifndef DICT_CHECK_BATCH_H
+#define DICT_CHECK_BATCH_H
+
+#include "checker.h"
+#include <stddef.h>
+
+/// Domyślny rozmiar fragmentu pliku.
+#define BATCH_DEFAULT_CHUNK (4 * 1024 * 1024)
+
+/**
+  Opcje sprawdzania wielu plików.
+  */
+struct batch_options
+{
+    size_t threads;             ///< Liczba wątków.
+    size_t memo_limit;          ///< Łączny limit pamięci wyników w bajtach.
+    size_t chunk;               ///< Rozmiar fragmentu, na które dzielić duże pliki.
+    const char *suffix;         ///< Przyrostek plików wynikowych lub NULL dla wspólnego wyjścia.
+};
+
+/**
+  Sprawdza pliki.
+  Przed pierwszym użyciem trzeba wywołać letters_init().
+  @param[in] dict Słownik.
+  @param[in] opts Opcje sprawdzania.
+  @param[in] bo Opcje sprawdzania wielu plików.
+  @param[in] paths Ścieżki plików.
+  @param[in] paths_no Liczba plików.
+  @return 0 jeśli sprawdzono wszystkie pliki, 1 jeśli wystąpiły błędy.
+  */
+int batch_run(const struct dictionary *dict, const struct check_options *opts,
+        const struct batch_options *bo, char **paths, size_t paths_no);
+
+#endif /* DICT_CHECK_BATCH_H */
@@ -0,0 +1,270 @@
+/** @file
+  Test równoległego sprawdzania wielu plików.
+
+  Wyniki sprawdzania w wielu wątkach, z plikami podzielonymi
+  na małe fragmenty, są porównywane z wynikami sprawdzania
+  w jednym wątku bez dzielenia plików.
+
+  @ingroup dict-check
+  @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+  @copyright Uniwersytet Warszawski
+  @date 2015-06-25
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <cmocka.h>
+#include "batch.h"
+#include "letters.h"
+
+/// Liczba plików testowych.
+#define FILES 5
+
+/// Słownik testowy.
+static struct dictionary *dict;
+
+/// Katalog tymczasowy z plikami testowymi.
+static char dir[] = "/tmp/batch-test.XXXXXX";
+
+/// Ścieżki plików testowych (ostatni nie istnieje).
+static char *paths[FILES + 1];
+
+/**
+  Zwraca ścieżkę w katalogu tymczasowym.
+  @param[in] name Nazwa pliku.
+  @param[in] suffix Przyrostek nazwy.
+  @return Ścieżka (do zwolnienia przez free()).
+  */
+static char * path_in_dir(const char *name, const char *suffix)
+{
+    char *p = malloc(strlen(dir) + strlen(name) + strlen(suffix) + 2);
+    sprintf(p, "%s/%s%s", dir, name, suffix);
+    return p;
+}
+
+/**
+  Wczytuje cały plik.
+  @param[in] path Ścieżka.
+  @param[out] len Długość pliku.
+  @return Zawartość pliku (do zwolnienia przez free()) lub NULL, jeśli plik nie istnieje.
+  */
+static char * read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if(f == NULL) return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    rewind(f);
+    char *data = malloc(*len + 1);
+    assert_int_equal(fread(data, 1, *len, f), *len);
+    fclose(f);
+    return data;
+}
+
+/**
+  Porównuje pliki.
+  @param[in] a Ścieżka pierwszego pliku.
+  @param[in] b Ścieżka drugiego pliku.
+  */
+static void assert_same_file(const char *a, const char *b)
+{
+    size_t la, lb;
+    char *da = read_file(a, &la);
+    char *db = read_file(b, &lb);
+    assert_int_equal(da == NULL, db == NULL);
+    if(da != NULL)
+    {
+        assert_int_equal(la, lb);
+        assert_memory_equal(da, db, la);
+    }
+    free(da);
+    free(db);
+}
+
+/**
+  Tworzy słownik i pliki testowe.
+  @param[in] state Nieużywany.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+static int setup(void **state)
+{
+    static const wchar_t *words[] = { L"ala", L"ma", L"kota", L"kot", L"psa", L"dom", L"las" };
+    static const char *text[] = { "ala", "ma", "kota", "kot", "psa", "dom", "las", "alx", "mb", "kto", "ps" };
+    setlocale(LC_ALL, "pl_PL.UTF-8");
+    letters_init();
+    dict = dictionary_new();
+    for(size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++)
+        dictionary_insert(dict, words[i]);
+    dictionary_rule_add(dict, L"0", L"1", false, 1, RULE_NORMAL);
+    dictionary_rule_add(dict, L"0", L"", false, 1, RULE_NORMAL);
+    dictionary_rule_add(dict, L"", L"0", false, 1, RULE_NORMAL);
+    dictionary_hints_max_cost(dict, 2);
+    if(mkdtemp(dir) == NULL) return -1;
+
+    static const char *names[] = { "long", "short", "empty", "invalid", "nonl", "missing" };
+    for(int i = 0; i <= FILES; i++)
+        paths[i] = path_in_dir(names[i], "");
+    unsigned seed = 1;
+    FILE *f = fopen(paths[0], "w");
+    for(int line = 0; line < 2000; line++)
+    {
+        int n = rand_r(&seed) % 12;
+        for(int k = 0; k < n; k++)
+            fprintf(f, "%s%s", k > 0 ? " " : "", text[rand_r(&seed) % 11]);
+        fputs(line % 7 == 0 ? ".\n" : "\n", f);
+    }
+    fclose(f);
+    f = fopen(paths[1], "w");
+    fputs("ala ma kto\n", f);
+    fclose(f);
+    f = fopen(paths[2], "w");
+    fclose(f);
+    // Po niepoprawnym UTF-8 sprawdzanie pliku się kończy
+    f = fopen(paths[3], "w");
+    for(int line = 0; line < 200; line++)
+        fprintf(f, line == 150 ? "kto \xc5 ala\n" : "ala ma kto %d\n", line);
+    fclose(f);
+    f = fopen(paths[4], "w");
+    for(int line = 0; line < 100; line++)
+        fprintf(f, "%sdom las ps", line > 0 ? "\n" : "");
+    fclose(f);
+    return 0;
+}
+
+/**
+  Usuwa słownik i pliki testowe.
+  @param[in] state Nieużywany.
+  @return 0.
+  */
+static int teardown(void **state)
+{
+    char command[sizeof(dir) + 16];
+    sprintf(command, "rm -rf %s", dir);
+    if(system(command) != 0) return -1;
+    for(int i = 0; i <= FILES; i++)
+        free(paths[i]);
+    dictionary_done(dict);
+    return 0;
+}
+
+/**
+  Sprawdza pliki w jednym wątku bez dzielenia i w wielu wątkach
+  z podziałem na fragmenty, a następnie porównuje wyniki.
+  @param[in] opts Opcje sprawdzania.
+  */
+static void check_same_results(const struct check_options *opts)
+{
+    struct batch_options serial = { 1, 1024 * 1024, (size_t)1 << 30, ".ref" };
+    struct batch_options parallel = { 4, 1024 * 1024, 256, ".out" };
+    // Brakujący plik jest błędem, ale pozostałe pliki są sprawdzane
+    assert_int_equal(batch_run(dict, opts, &serial, paths, FILES + 1), 1);
+    assert_int_equal(batch_run(dict, opts, &parallel, paths, FILES + 1), 1);
+    for(int i = 0; i < FILES; i++)
+    {
+        char *ref = malloc(strlen(paths[i]) + 16);
+        char *out = malloc(strlen(paths[i]) + 16);
+        sprintf(ref, "%s.ref", paths[i]);
+        sprintf(out, "%s.out", paths[i]);
+        assert_same_file(ref, out);
+        assert_int_equal(access(ref, F_OK), 0);
+        strcat(ref, ".err");
+        strcat(out, ".err");
+        assert_same_file(ref, out);
+        free(ref);
+        free(out);
+    }
+}
+
+/// Testuje sprawdzanie w zwykłym formacie.
+static void batch_plain_test(void **state)
+{
+    struct check_options opts = { false, true, CHECK_PLAIN };
+    check_same_results(&opts);
+    char *ref = path_in_dir("short", ".ref");
+    size_t len;
+    char *data = read_file(ref, &len);
+    assert_true(data != NULL);
+    assert_int_equal(len, 12);
+    assert_memory_equal(data, "ala ma #kto\n", 12);
+    free(data);
+    free(ref);
+}
+
+/// Testuje sprawdzanie z podpowiedziami, które zawierają numery wierszy.
+static void batch_verbose_test(void **state)
+{
+    struct check_options opts = { true, true, CHECK_PLAIN };
+    check_same_results(&opts);
+    char *ref = path_in_dir("long", ".ref.err");
+    size_t len;
+    char *data = read_file(ref, &len);
+    assert_true(data != NULL && len > 0);
+    free(data);
+    free(ref);
+}
+
+/// Testuje sprawdzanie w formacie JSON Lines.
+static void batch_jsonl_test(void **state)
+{
+    struct check_options opts = { false, false, CHECK_JSONL };
+    check_same_results(&opts);
+}
+
+/// Testuje wypisywanie wyników wszystkich plików na standardowe wyjście.
+static void batch_stdout_test(void **state)
+{
+    struct check_options opts = { false, true, CHECK_PLAIN };
+    struct batch_options serial = { 1, 1024 * 1024, (size_t)1 << 30, ".ref" };
+    struct batch_options parallel = { 4, 1024 * 1024, 256, NULL };
+    assert_int_equal(batch_run(dict, &opts, &serial, paths, FILES), 0);
+    char *all = path_in_dir("all", "");
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    FILE *f = fopen(all, "w");
+    assert_true(f != NULL);
+    dup2(fileno(f), STDOUT_FILENO);
+    fclose(f);
+    int r = batch_run(dict, &opts, &parallel, paths, FILES);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    assert_int_equal(r, 0);
+
+    size_t len;
+    char *data = read_file(all, &len);
+    size_t pos = 0;
+    for(int i = 0; i < FILES; i++)
+    {
+        char *ref = malloc(strlen(paths[i]) + 16);
+        sprintf(ref, "%s.ref", paths[i]);
+        size_t rl;
+        char *rd = read_file(ref, &rl);
+        assert_true(rd != NULL);
+        assert_true(pos + rl <= len);
+        assert_memory_equal(data + pos, rd, rl);
+        pos += rl;
+        free(rd);
+        free(ref);
+    }
+    assert_int_equal(pos, len);
+    free(data);
+    free(all);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(batch_plain_test),
+        cmocka_unit_test(batch_verbose_test),
+        cmocka_unit_test(batch_jsonl_test),
+        cmocka_unit_test(batch_stdout_test),
+    };
+
+    return cmocka_run_group_tests(tests, setup, teardown);
+}
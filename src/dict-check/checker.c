@@ -0,0 +1,375 @@
+/** @file
+    Implementacja sprawdzania tekstu.
+
+    @ingroup dict-check
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-24
+    @copyright Uniwersytet Warszawski
+  */
+
+#include "checker.h"
+#include "letters.h"
+#include "utf8.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/** @name Funkcje pomocnicze
+ * @{
+ */
+
+/// Początkowy rozmiar bufora na sformatowane podpowiedzi.
+#define HINTS_BUFFER 256
+
+/// Początkowy rozmiar bufora na sprawdzane słowo.
+#define CHECKER_WORD_BUFFER 1024
+
+/**
+  Wypisuje łańcuch w cudzysłowach, ze znakami specjalnymi JSON-a
+  zamienionymi na sekwencje ucieczki.
+  @param[in,out] w Bufor wyjścia.
+  @param[in] s Łańcuch w UTF-8.
+  @param[in] len Długość łańcucha w bajtach.
+  */
+static void write_json_string(struct writer *w, const char *s, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    writer_byte(w, '"');
+    size_t from = 0;
+    for(size_t i = 0; i < len; i++)
+    {
+        unsigned char c = s[i];
+        if(c >= 0x20 && c != '"' && c != '\\') continue;
+        writer_write(w, s + from, i - from);
+        writer_byte(w, '\\');
+        if(c == '"' || c == '\\') writer_byte(w, c);
+        else
+        {
+            writer_string(w, "u00");
+            writer_byte(w, hex[c >> 4]);
+            writer_byte(w, hex[c & 15]);
+        }
+        from = i + 1;
+    }
+    writer_write(w, s + from, len - from);
+    writer_byte(w, '"');
+}
+
+/**
+  Formatuje podpowiedzi dla słowa tak, jak są wypisywane w danym formacie:
+  - CHECK_PLAIN: każda podpowiedź poprzedzona spacją, a brak podpowiedzi
+    to pojedyncza spacja,
+  - CHECK_JSONL: tablica obiektów z podpowiedzią i kosztem,
+  - CHECK_TSV: podpowiedzi, tabulator i koszty, jedne i drugie
+    oddzielone przecinkami.
+  @param[in] dict Słownik.
+  @param[in] word Słowo w UTF-8.
+  @param[in] len Długość słowa w bajtach.
+  @param[in] format Format.
+  @param[in,out] line Bufor bez strumienia, do którego zapisać podpowiedzi
+  (jego poprzednia zawartość jest porzucana).
+  @return 0 jeśli się udało, -1 jeśli brakło pamięci.
+  */
+static int format_hints(const struct dictionary *dict, const char *word, size_t len,
+        enum check_format format, struct writer *line)
+{
+    line->len = 0;
+    line->failed = false;
+    char *hints;
+    size_t hlen;
+    int costs[DICTIONARY_MAX_HINTS];
+    int cnt = dictionary_hints_costs_utf8(dict, word, len, &hints, &hlen, costs);
+    const char *h = hints;
+    switch(format)
+    {
+        case CHECK_PLAIN:
+            for(int i = 0; i < cnt; i++, h += strlen(h) + 1)
+            {
+                writer_byte(line, ' ');
+                writer_string(line, h);
+            }
+            if(cnt <= 0) writer_byte(line, ' ');
+            break;
+        case CHECK_JSONL:
+            writer_byte(line, '[');
+            for(int i = 0; i < cnt; i++, h += strlen(h) + 1)
+            {
+                if(i > 0) writer_byte(line, ',');
+                writer_string(line, "{\"hint\":");
+                write_json_string(line, h, strlen(h));
+                writer_string(line, ",\"cost\":");
+                writer_int(line, costs[i]);
+                writer_byte(line, '}');
+            }
+            writer_byte(line, ']');
+            break;
+        case CHECK_TSV:
+            for(int i = 0; i < cnt; i++, h += strlen(h) + 1)
+            {
+                if(i > 0) writer_byte(line, ',');
+                writer_string(line, h);
+            }
+            writer_byte(line, '\t');
+            for(int i = 0; i < cnt; i++)
+            {
+                if(i > 0) writer_byte(line, ',');
+                writer_int(line, costs[i]);
+            }
+            break;
+    }
+    free(hints);
+    return cnt < 0 || line->failed ? -1 : 0;
+}
+
+/**
+  Wypisuje informację o słowie spoza słownika.
+  @param[in,out] w Bufor wyjścia.
+  @param[in] format Format.
+  @param[in] name Nazwa pliku lub NULL.
+  @param[in] offset Pozycja słowa w bajtach od początku tekstu.
+  @param[in] row Wiersz.
+  @param[in] col Kolumna.
+  @param[in] word Słowo w postaci z tekstu.
+  @param[in] len Długość słowa w bajtach.
+  @param[in] hint Podpowiedzi sformatowane przez format_hints() albo NULL.
+  @param[in] hint_len Długość podpowiedzi w bajtach.
+  */
+static void write_record(struct writer *w, enum check_format format, const char *name,
+        size_t offset, int row, int col, const char *word, size_t len,
+        const char *hint, size_t hint_len)
+{
+    switch(format)
+    {
+        case CHECK_PLAIN:
+            if(name != NULL)
+            {
+                writer_string(w, name);
+                writer_byte(w, ':');
+            }
+            writer_int(w, row);
+            writer_byte(w, ',');
+            writer_int(w, col);
+            writer_byte(w, ' ');
+            writer_write(w, word, len);
+            writer_byte(w, ':');
+            if(hint != NULL) writer_write(w, hint, hint_len);
+            else writer_byte(w, ' ');
+            break;
+        case CHECK_JSONL:
+            writer_byte(w, '{');
+            if(name != NULL)
+            {
+                writer_string(w, "\"file\":");
+                write_json_string(w, name, strlen(name));
+                writer_byte(w, ',');
+            }
+            writer_string(w, "\"offset\":");
+            writer_int(w, offset);
+            writer_string(w, ",\"row\":");
+            writer_int(w, row);
+            writer_string(w, ",\"col\":");
+            writer_int(w, col);
+            writer_string(w, ",\"word\":");
+            write_json_string(w, word, len);
+            writer_string(w, ",\"hints\":");
+            if(hint != NULL) writer_write(w, hint, hint_len);
+            else writer_string(w, "[]");
+            writer_byte(w, '}');
+            break;
+        case CHECK_TSV:
+            if(name != NULL)
+            {
+                writer_string(w, name);
+                writer_byte(w, '\t');
+            }
+            writer_int(w, offset);
+            writer_byte(w, '\t');
+            writer_int(w, row);
+            writer_byte(w, '\t');
+            writer_int(w, col);
+            writer_byte(w, '\t');
+            writer_write(w, word, len);
+            writer_byte(w, '\t');
+            if(hint != NULL) writer_write(w, hint, hint_len);
+            else writer_byte(w, '\t');
+            break;
+    }
+    writer_byte(w, '\n');
+}
+
+/**
+ * @}
+ */
+
+/** @name Elementy interfejsu
+ * @{
+ */
+
+int checker_init(struct checker *c, const struct dictionary *dict, size_t memo_limit)
+{
+    c->dict = dict;
+    memo_init(&c->memo, memo_limit);
+    c->word_cap = CHECKER_WORD_BUFFER;
+    c->word = malloc(c->word_cap);
+    if(writer_init(&c->line, NULL, HINTS_BUFFER) < 0 || c->word == NULL)
+    {
+        free(c->word);
+        free(c->line.buffer);
+        return -1;
+    }
+    return 0;
+}
+
+void checker_done(struct checker *c)
+{
+    memo_done(&c->memo);
+    writer_done(&c->line);
+    free(c->word);
+    c->word = NULL;
+}
+
+int checker_run(struct checker *c, const struct check_options *opts,
+        const struct check_source *src, struct reader *in,
+        struct writer *out, struct writer *err)
+{
+    const struct dictionary *dict = c->dict;
+    struct memo *memo = &c->memo;
+    bool echo = opts->echo;
+    bool records = opts->verbose || opts->format != CHECK_PLAIN;
+    struct writer *rec = echo ? err : out;
+    const char *name = src != NULL ? src->name : NULL;
+    size_t llen = 0;
+    size_t base = src != NULL ? src->offset : 0;    // Pozycja początku bufora w tekście
+    size_t pos = 0;         // Pozycja w buforze wejścia
+    size_t flushed = 0;     // Początek niewypisanej części bufora
+    size_t wstart = 0;      // Początek bieżącego słowa
+    bool inword = false;
+    bool refill = false;
+    int row = src != NULL ? src->row : 1;
+    int col = 1;
+    int ccl = 1;
+    while(1)
+    {
+        if(pos >= in->len || refill)
+        {
+            // Wypisujemy wszystko poza niedokończonym słowem
+            size_t keep = inword ? wstart : pos;
+            if(echo) writer_write(out, in->buffer + flushed, keep - flushed);
+            flushed = keep;
+            if(reader_fill(in, keep) < 0) break;
+            base += keep;
+            pos -= keep;
+            if(inword) wstart -= keep;
+            flushed = 0;
+            refill = false;
+            continue;
+        }
+        unsigned char ch = in->buffer[pos];
+        wchar_t lower;
+        size_t n = 1;
+        if(ch < 0x80) lower = letters_table[ch];
+        else
+        {
+            wchar_t wc;
+            n = utf8_decode(in->buffer + pos, in->len - pos, &wc);
+            if(n == 0)
+            {
+                // Znak może być ucięty na końcu bloku
+                if(!in->eof && in->len - pos < UTF8_MAX_LENGTH)
+                {
+                    refill = true;
+                    continue;
+                }
+                // Niepoprawny UTF-8 kończy przetwarzanie
+                size_t keep = inword ? wstart : pos;
+                if(echo) writer_write(out, in->buffer + flushed, keep - flushed);
+                return 1;
+            }
+            lower = letters_lower(wc);
+        }
+        if(lower != 0)
+        {
+            // Dodaj kolejną literę słowa do bufora
+            if(!inword)
+            {
+                inword = true;
+                wstart = pos;
+                ccl = col;
+                llen = 0;
+            }
+            if(llen + UTF8_MAX_LENGTH > c->word_cap)
+            {
+                char *nw = realloc(c->word, c->word_cap * 2);
+                if(nw == NULL) return -1;
+                c->word = nw;
+                c->word_cap *= 2;
+            }
+            if(lower < 0x80) c->word[llen++] = lower;
+            else llen += utf8_encode(lower, c->word + llen);
+            col++;
+        }
+        else
+        {
+            if(inword)
+            {
+                // Sprawdź słowo z bufora, najpierw w pamięci wyników
+                uint32_t hash = memo_hash(c->word, llen);
+                const struct memo_entry *e = memo_find(memo, c->word, llen, hash);
+                bool found;
+                const char *hint = NULL;
+                size_t hint_len = 0;
+                if(e != NULL)
+                {
+                    found = e->found;
+                    hint = memo_hint(memo, e);
+                    hint_len = e->hint_len;
+                }
+                else
+                {
+                    found = dictionary_find_utf8(dict, c->word, llen);
+                    int r = 0;
+                    if(!found && records)
+                    {
+                        r = format_hints(dict, c->word, llen, opts->format, &c->line);
+                        if(r == 0)
+                        {
+                            hint = c->line.buffer;
+                            hint_len = c->line.len;
+                        }
+                    }
+                    // Błędów braku pamięci nie zapamiętujemy
+                    if(r == 0) memo_add(memo, c->word, llen, hash, found, hint, hint_len);
+                }
+                if(!found)
+                {
+                    if(echo)
+                    {
+                        writer_write(out, in->buffer + flushed, wstart - flushed);
+                        writer_byte(out, '#');
+                    }
+                    flushed = wstart;
+                    if(records)
+                        write_record(rec, opts->format, name, base + wstart, row, ccl,
+                                     in->buffer + wstart, pos - wstart, hint, hint_len);
+                }
+                inword = false;
+            }
+            // Ogarnianie wiersza i kolumny
+            if(ch == '\n')
+            {
+                row++;
+                col = 1;
+            }
+            else
+            {
+                col++;
+            }
+        }
+        pos += n;
+    }
+    return 0;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,128 @@
+/** @file
+    Interfejs sprawdzania tekstu.
+
+    Tekst jest przepisywany na wyjście, a słowa spoza słownika
+    są poprzedzane znakiem '#'. W trybie verbose na wyjście
+    diagnostyczne trafia pozycja każdego takiego słowa wraz z podpowiedziami.
+
+    Zamiast wierszy `wiersz,kolumna słowo: podpowiedzi` można wypisywać
+    rekordy do przetwarzania przez programy:
+    - JSON Lines: `{"offset":O,"row":R,"col":C,"word":"...",
+      "hints":[{"hint":"...","cost":K},...]}`,
+    - TSV: `O\tR\tC\tsłowo\tpodpowiedź,podpowiedź\tkoszt,koszt`,
+
+    gdzie O to pozycja słowa w bajtach od początku tekstu.
+    Rekordy zawsze zawierają podpowiedzi. Jeśli tekst nie jest przepisywany,
+    wiersze lub rekordy trafiają na wyjście zamiast na wyjście diagnostyczne.
+    Jeśli tekst pochodzi z nazwanego pliku, wiersze i rekordy zaczynają się
+    od nazwy pliku (pole "file" w JSON-ie).
+
+    Stan sprawdzania (pamięć wyników i bufory robocze) jest trzymany
+    w struct checker, więc wątek może go używać dla wielu tekstów.
+
+    @ingroup dict-check
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-24
+    @copyright Uniwersytet Warszawski
+  */
+
+#ifndef DICT_CHECK_CHECKER_H
+#define DICT_CHECK_CHECKER_H
+
+#include "dictionary.h"
+#include "memo.h"
+#include "reader.h"
+#include "writer.h"
+#include <stdbool.h>
+
+/**
+  Format informacji o słowach spoza słownika.
+  */
+enum check_format
+{
+    CHECK_PLAIN,            ///< Wiersze `wiersz,kolumna słowo: podpowiedzi`.
+    CHECK_JSONL,            ///< Rekordy JSON, jeden w wierszu.
+    CHECK_TSV               ///< Rekordy oddzielone tabulatorami.
+};
+
+/// Liczba trybów sprawdzania, które wymagają osobnej pamięci wyników.
+#define CHECK_MODES 4
+
+/**
+  Opcje sprawdzania.
+  */
+struct check_options
+{
+    bool verbose;               ///< Czy wypisywać podpowiedzi (w formacie CHECK_PLAIN).
+    bool echo;                  ///< Czy przepisywać tekst na wyjście.
+    enum check_format format;   ///< Format informacji o słowach.
+};
+
+/**
+  Zwraca numer trybu sprawdzania (od 0 do CHECK_MODES - 1).
+  Pamięć wyników przechowuje sformatowane podpowiedzi,
+  więc można jej używać tylko w jednym trybie.
+  @param[in] o Opcje.
+  @return Numer trybu.
+  */
+static inline int check_mode(const struct check_options *o)
+{
+    return o->format == CHECK_PLAIN ? o->verbose : 1 + o->format;
+}
+
+/**
+  Położenie sprawdzanego fragmentu w tekście.
+  */
+struct check_source
+{
+    const char *name;           ///< Nazwa pliku lub NULL.
+    size_t offset;              ///< Pozycja początku fragmentu w bajtach.
+    int row;                    ///< Wiersz, w którym zaczyna się fragment (fragment zaczyna się na początku wiersza).
+};
+
+/**
+  Stan sprawdzania wielokrotnego użytku.
+  */
+struct checker
+{
+    const struct dictionary *dict;  ///< Słownik.
+    struct memo memo;               ///< Pamięć wyników sprawdzania słów.
+    char *word;                     ///< Bufor na sprawdzane słowo.
+    size_t word_cap;                ///< Pojemność bufora na słowo.
+    struct writer line;             ///< Bufor na sformatowane podpowiedzi.
+};
+
+/**
+  Tworzy stan sprawdzania.
+  Przed pierwszym użyciem trzeba wywołać letters_init().
+  @param[out] c Stan sprawdzania.
+  @param[in] dict Słownik.
+  @param[in] memo_limit Limit pamięci wyników w bajtach.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+int checker_init(struct checker *c, const struct dictionary *dict, size_t memo_limit);
+
+/**
+  Zwalnia stan sprawdzania.
+  @param[in,out] c Stan sprawdzania.
+  */
+void checker_done(struct checker *c);
+
+/**
+  Sprawdza tekst.
+  Pamięć wyników przechowuje sformatowane podpowiedzi, więc jeden
+  stan sprawdzania można używać tylko z opcjami o tym samym check_mode().
+  @param[in,out] c Stan sprawdzania.
+  @param[in] opts Opcje.
+  @param[in] src Położenie fragmentu lub NULL dla całego nienazwanego tekstu.
+  @param[in,out] in Wejście.
+  @param[in,out] out Wyjście.
+  @param[in,out] err Wyjście diagnostyczne.
+  @return 0 jeśli się udało, 1 jeśli przerwano na niepoprawnym UTF-8,
+  -1 jeśli brakło pamięci.
+  */
+int checker_run(struct checker *c, const struct check_options *opts,
+        const struct check_source *src, struct reader *in,
+        struct writer *out, struct writer *err);
+
+#endif /* DICT_CHECK_CHECKER_H */
@@ -9,12 +9,21 @@
     @copyright Uniwersytet Warszawski
   */
 
+#include "batch.h"
+#include "checker.h"
 #include "dictionary.h"
+#include "letters.h"
+#include "memo.h"
+#include "protocol.h"
+#include "reader.h"
+#include "writer.h"
+#include <limits.h>
 #include <locale.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <wctype.h>
+#include <unistd.h>
 
 
 /**
@@ -22,9 +31,178 @@
  */
 enum ProgramOptionsParsingState
 {
-    PositionalParameters
+    PositionalParameters,
+    MemoLimitParameter,
+    SocketParameter,
+    DictionaryIndexParameter,
+    ListParameter,
+    ThreadsParameter,
+    SuffixParameter
 };
 
+/**
+  Wypisuje sposób użycia programu.
+  @param[in] name Nazwa programu.
+  */
+static void usage(const char *name)
+{
+    printf(" %s [-v] [-P] [--format=plain|jsonl|tsv] [--no-echo] [-m <memo limit in MB>] <dictionary file>\n", name);
+    printf(" %s [-v] [-P] [--format=plain|jsonl|tsv] [--no-echo] [-m <memo limit in MB>] [-j <threads>] [-o <output suffix>]"
+           " <dictionary file> [-l <file list>] <file>...\n", name);
+    printf(" %s [-v] [--format=plain|jsonl|tsv] [--no-echo] -s <server socket> [-d <dictionary index>]\n", name);
+}
+
+/**
+  Sprawdza tekst ze standardowego wejścia za pomocą serwera słownikowego.
+  @param[in] path Ścieżka gniazda serwera.
+  @param[in] dict Numer słownika na serwerze.
+  @param[in] opts Opcje sprawdzania.
+  @return 0 jeśli się udało, 1 w p.p.
+  */
+static int run_client(const char *path, unsigned char dict, const struct check_options *opts)
+{
+    struct reader in;
+    if(reader_open(&in, STDIN_FILENO) < 0)
+    {
+        printf("Out of memory.\n");
+        return 1;
+    }
+    // Serwer sprawdza cały tekst naraz, żeby numery wierszy były poprawne
+    while(reader_fill(&in, 0) == 0);
+    int fd = protocol_connect(path);
+    if(fd < 0)
+    {
+        reader_done(&in);
+        printf("Could not connect to server: %s\n", path);
+        return 1;
+    }
+    struct protocol_conn conn;
+    struct protocol_frame f;
+    int r = 1;
+    if(protocol_init(&conn, fd) < 0)
+    {
+        printf("Out of memory.\n");
+        goto done;
+    }
+    unsigned char flags = (opts->verbose ? PROTOCOL_VERBOSE : 0)
+                        | (opts->echo ? 0 : PROTOCOL_NO_ECHO)
+                        | (opts->format == CHECK_JSONL ? PROTOCOL_JSONL : 0)
+                        | (opts->format == CHECK_TSV ? PROTOCOL_TSV : 0);
+    if(protocol_send(&conn, PROTOCOL_CHECK, dict, flags,
+                     in.buffer, in.len) < 0 || protocol_next(&conn, &f) <= 0)
+    {
+        printf("Communication with server failed.\n");
+        goto done;
+    }
+    if(f.type == PROTOCOL_CHECK && f.len >= 4 && protocol_get_u32(f.payload) <= f.len - 4)
+    {
+        uint32_t olen = protocol_get_u32(f.payload);
+        fwrite(f.payload + 4, 1, olen, stdout);
+        fwrite(f.payload + 4 + olen, 1, f.len - 4 - olen, stderr);
+        r = 0;
+    }
+    else if(f.type == PROTOCOL_ERROR)
+        printf("Server error: %.*s\n", (int)f.len, f.payload);
+    else
+        printf("Invalid server response.\n");
+done:
+    protocol_done(&conn);
+    close(fd);
+    reader_done(&in);
+    return r;
+}
+
+/**
+  Wypisuje na standardowe wyjście błędów statystyki generowania podpowiedzi.
+  @param[in] dict Słownik.
+  */
+static void print_stats(const struct dictionary *dict)
+{
+    struct dictionary_stats st;
+    if(dictionary_stats(dict, &st) < 0)
+    {
+        fprintf(stderr, "Hint statistics are not available (build with -DDICTIONARY_HINT_STATS=ON).\n");
+        return;
+    }
+    fprintf(stderr, "Hint statistics:\n");
+    fprintf(stderr, "  words: %llu (edit distance only: %llu)\n", st.queries, st.edit_queries);
+    fprintf(stderr, "  states per cost:");
+    for(int i = 0; i < DICTIONARY_STATS_LAYERS; i++)
+        if(st.states[i] > 0)
+            fprintf(stderr, " %d%s: %llu", i, i == DICTIONARY_STATS_LAYERS - 1 ? "+" : "", st.states[i]);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  duplicate states: %llu\n", st.duplicates);
+    fprintf(stderr, "  trie nodes visited: %llu\n", st.nodes);
+    fprintf(stderr, "  rule applications: %llu, with new states: %llu\n", st.rule_tries, st.rule_successes);
+    fprintf(stderr, "  time [ms]: preprocess %.3f, expansion %.3f, dedup %.3f, text %.3f\n",
+            st.preprocess_ns / 1e6, st.expand_ns / 1e6, st.unify_ns / 1e6, st.text_ns / 1e6);
+    struct word_list rules;
+    struct dictionary_rule_stats *rs;
+    word_list_init(&rules);
+    int n = dictionary_rule_stats(dict, &rules, &rs);
+    if(n > 0 && word_list_size(&rules) == (size_t)n)
+    {
+        fprintf(stderr, "Rules (applications, with new states):\n");
+        for(int i = 0; i < n; i++)
+            fprintf(stderr, "  %ls\t%llu\t%llu\n", word_list_get(&rules)[i], rs[i].tries, rs[i].successes);
+    }
+    free(rs);
+    word_list_done(&rules);
+}
+
+/**
+  Dodaje ścieżkę do listy plików.
+  @param[in,out] paths Lista ścieżek.
+  @param[in,out] len Liczba ścieżek.
+  @param[in,out] cap Pojemność listy.
+  @param[in] path Ścieżka.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+static int add_path(char ***paths, size_t *len, size_t *cap, char *path)
+{
+    if(*len == *cap)
+    {
+        size_t nc = *cap == 0 ? 16 : 2 * *cap;
+        char **np = realloc(*paths, nc * sizeof(char *));
+        if(np == NULL) return -1;
+        *paths = np;
+        *cap = nc;
+    }
+    (*paths)[(*len)++] = path;
+    return 0;
+}
+
+/**
+  Wczytuje listę plików (jedna ścieżka w wierszu, puste wiersze są pomijane).
+  @param[in] list Ścieżka pliku z listą lub "-" dla standardowego wejścia.
+  @param[in,out] paths Lista ścieżek.
+  @param[in,out] len Liczba ścieżek.
+  @param[in,out] cap Pojemność listy.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+static int read_list(const char *list, char ***paths, size_t *len, size_t *cap)
+{
+    FILE *f = strcmp(list, "-") == 0 ? stdin : fopen(list, "r");
+    if(f == NULL) return -1;
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t n;
+    int r = 0;
+    while(r == 0 && (n = getline(&line, &line_cap, f)) >= 0)
+    {
+        if(n > 0 && line[n - 1] == '\n') line[--n] = 0;
+        if(n == 0) continue;
+        char *path = strdup(line);
+        if(path == NULL || add_path(paths, len, cap, path) < 0)
+        {
+            free(path);
+            r = -1;
+        }
+    }
+    free(line);
+    if(f != stdin) fclose(f);
+    return r;
+}
 
 /**
   Funkcja main.
@@ -37,8 +215,18 @@ int main(int argc, char *argv[])
     setlocale(LC_ALL, "pl_PL.UTF-8");
     
     // Opcje linii komend
-    int verbose = 0;
+    struct check_options opts = { false, true, CHECK_PLAIN };
+    size_t memo_limit = MEMO_DEFAULT_LIMIT;
     char *dictfile = NULL;
+    char *server = NULL;
+    unsigned long dict_index = 0;
+    struct batch_options bo = { 0, 0, BATCH_DEFAULT_CHUNK, NULL };
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    bo.threads = cpus > 0 ? cpus : 1;
+    char **paths = NULL;
+    size_t paths_no = 0, paths_cap = 0, owned_no = 0;
+    const char *list = NULL;
+    bool profile = false;
     enum ProgramOptionsParsingState pars = PositionalParameters;
     for(int i = 1; i < argc; i++)
     {
@@ -46,24 +234,135 @@ int main(int argc, char *argv[])
         {
             case PositionalParameters:
             {
-                if(strcmp("-v", argv[i]) == 0) verbose = 1;
-                else if(dictfile == NULL) dictfile = argv[i];
-                else
+                if(strcmp("-v", argv[i]) == 0) opts.verbose = true;
+                else if(strcmp("-P", argv[i]) == 0) profile = true;
+                else if(strcmp("--no-echo", argv[i]) == 0) opts.echo = false;
+                else if(strcmp("--format=plain", argv[i]) == 0) opts.format = CHECK_PLAIN;
+                else if(strcmp("--format=jsonl", argv[i]) == 0) opts.format = CHECK_JSONL;
+                else if(strcmp("--format=tsv", argv[i]) == 0) opts.format = CHECK_TSV;
+                else if(strcmp("-m", argv[i]) == 0) pars = MemoLimitParameter;
+                else if(strcmp("-s", argv[i]) == 0) pars = SocketParameter;
+                else if(strcmp("-d", argv[i]) == 0) pars = DictionaryIndexParameter;
+                else if(strcmp("-l", argv[i]) == 0) pars = ListParameter;
+                else if(strcmp("-j", argv[i]) == 0) pars = ThreadsParameter;
+                else if(strcmp("-o", argv[i]) == 0) pars = SuffixParameter;
+                else if(argv[i][0] == '-' && argv[i][1] != 0)
                 {
                     printf("Unknown command line option.\n");
-                    printf(" %s [-v] <dictionary file>\n", argv[0]);
+                    usage(argv[0]);
+                    return 1;
+                }
+                else if(dictfile == NULL) dictfile = argv[i];
+                else if(add_path(&paths, &paths_no, &paths_cap, argv[i]) < 0)
+                {
+                    printf("Out of memory.\n");
                     return 1;
                 }
                 break;
             }
+            case MemoLimitParameter:
+            {
+                char *end;
+                memo_limit = strtoul(argv[i], &end, 10);
+                if(*argv[i] == 0 || *end != 0)
+                {
+                    printf("Invalid memo limit: %s\n", argv[i]);
+                    usage(argv[0]);
+                    return 1;
+                }
+                pars = PositionalParameters;
+                break;
+            }
+            case SocketParameter:
+            {
+                server = argv[i];
+                pars = PositionalParameters;
+                break;
+            }
+            case DictionaryIndexParameter:
+            {
+                char *end;
+                dict_index = strtoul(argv[i], &end, 10);
+                if(*argv[i] == 0 || *end != 0 || dict_index > UCHAR_MAX)
+                {
+                    printf("Invalid dictionary index: %s\n", argv[i]);
+                    usage(argv[0]);
+                    return 1;
+                }
+                pars = PositionalParameters;
+                break;
+            }
+            case ListParameter:
+            {
+                list = argv[i];
+                pars = PositionalParameters;
+                break;
+            }
+            case ThreadsParameter:
+            {
+                char *end;
+                bo.threads = strtoul(argv[i], &end, 10);
+                if(*argv[i] == 0 || *end != 0 || bo.threads == 0)
+                {
+                    printf("Invalid number of threads: %s\n", argv[i]);
+                    usage(argv[0]);
+                    return 1;
+                }
+                pars = PositionalParameters;
+                break;
+            }
+            case SuffixParameter:
+            {
+                bo.suffix = argv[i];
+                pars = PositionalParameters;
+                break;
+            }
+        }
+    }
+    if(pars != PositionalParameters)
+    {
+        printf("Missing option value.\n");
+        usage(argv[0]);
+        return 1;
+    }
+    
+    // Pliki z listy trafiają za pliki z linii komend
+    owned_no = paths_no;
+    if(list != NULL && read_list(list, &paths, &paths_no, &paths_cap) < 0)
+    {
+        printf("Could not read file list: %s\n", list);
+        return 1;
+    }
+    
+    // Tryb klienta: słowniki trzyma serwer
+    if(server != NULL)
+    {
+        if(paths_no > 0 || list != NULL)
+        {
+            printf("Files cannot be checked with a server.\n");
+            usage(argv[0]);
+            return 1;
+        }
+        if(dictfile != NULL)
+        {
+            printf("Dictionary file cannot be used with a server.\n");
+            usage(argv[0]);
+            return 1;
+        }
+        if(profile)
+        {
+            printf("Hint statistics cannot be collected with a server.\n");
+            usage(argv[0]);
+            return 1;
         }
+        return run_client(server, dict_index, &opts);
     }
     
     // Otwieranie konkretnego słownika
     if(dictfile == NULL)
     {
         printf("Dictionary file not specified.\n");
-        printf(" %s [-v] <dictionary file>\n", argv[0]);
+        usage(argv[0]);
         return 1;
     }
     FILE *fdict = fopen(dictfile, "rb");
@@ -79,91 +378,48 @@ int main(int argc, char *argv[])
         return 1;
     }
     fclose(fdict);
+    // Indeks podpowiedzi obok słownika jest opcjonalny
+    char *findex = malloc(strlen(dictfile) + sizeof(DICTIONARY_INDEX_SUFFIX));
+    if(findex != NULL)
+    {
+        strcat(strcpy(findex, dictfile), DICTIONARY_INDEX_SUFFIX);
+        dictionary_index_load(dict, findex);
+        free(findex);
+    }
     
     
     // Przetwarzanie tekstu do sprawdzenia.
-    FILE *data = stdin;
-    wint_t ch;
-    int cap = 1024;
-    int len = 0;
-    wchar_t *word = malloc(sizeof(wchar_t)*cap);
-    wchar_t *lowr = malloc(sizeof(wchar_t)*cap);
-    int row = 1;
-    int col = 1;
-    int ccl = 1;
-    struct word_list words;
-    while((ch = fgetwc(data)) != EOF)
-    {
-        if(iswalpha(ch))
-        {
-            // Dodaj kolejną literę słowa do bufora
-            if(len == 0) ccl = col;
-            word[len] = ch;
-            lowr[len] = towlower(ch);
-            col++;
-            len++;
-            if(len >= cap)
-            {
-                cap *= 2;
-                wchar_t *nw = malloc(sizeof(wchar_t)*cap);
-                wchar_t *nl = malloc(sizeof(wchar_t)*cap);
-                memcpy(nw, word, sizeof(wchar_t)*len);
-                memcpy(nl, lowr, sizeof(wchar_t)*len);
-                free(word); free(lowr);
-                word = nw; lowr = nl;
-            }
-        }
-        else
-        {
-            if(len > 0)
-            {
-                // Sprawdź słowo z bufora
-                word[len] = 0;
-                lowr[len] = 0;
-                if(!dictionary_find(dict, lowr))
-                {
-                    printf("#%ls", word);
-                    if(verbose)
-                    {
-                        fprintf(stderr, "%d,%d %ls:", row, ccl, word);
-                        //word_list_init(&words); -- initialized in dictionary_hints
-                        dictionary_hints(dict, lowr, &words);
-                        const wchar_t * const * arr = word_list_get(&words);
-                        for(int i = 0; i < word_list_size(&words); i++)
-                        {
-                            fprintf(stderr, " %ls", arr[i]);
-                        }
-                        if(word_list_size(&words) == 0)
-                        {
-                            fprintf(stderr, " ");
-                        }
-                        word_list_done(&words);
-                        fprintf(stderr, "\n");
-                    }
-                }
-                else
-                {
-                    printf("%ls", word);
-                }
-                len = 0;
-            }
-            // Ogarnianie wiersza i kolumny
-            if(ch == L'\n')
-            {
-                row++;
-                col = 1;
-            }
-            else
-            {
-                col++;
-            }
-            // Wypisywanie znaków na wyjście
-            printf("%lc", ch);
-        }
+    letters_init();
+    if(paths_no > 0 || list != NULL)
+    {
+        bo.memo_limit = memo_limit * 1024 * 1024;
+        int r = batch_run(dict, &opts, &bo, paths, paths_no);
+        for(size_t i = owned_no; i < paths_no; i++)
+            free(paths[i]);
+        free(paths);
+        if(profile) print_stats(dict);
+        dictionary_done(dict);
+        return r;
+    }
+    struct checker checker;
+    struct reader in;
+    struct writer out, err;
+    if(checker_init(&checker, dict, memo_limit * 1024 * 1024) < 0
+       || reader_open(&in, STDIN_FILENO) < 0
+       || writer_init(&out, stdout, WRITER_BUFFER) < 0
+       || writer_init(&err, stderr, WRITER_BUFFER) < 0)
+    {
+        printf("Out of memory.\n");
+        return 1;
     }
+    if(checker_run(&checker, &opts, NULL, &in, &out, &err) < 0)
+        fprintf(stderr, "Out of memory.\n");
     // Usuwanie buforów i słownika
-    free(word);
-    free(lowr);
+    checker_done(&checker);
+    writer_done(&out);
+    writer_done(&err);
+    if(profile) print_stats(dict);
+    reader_done(&in);
     dictionary_done(dict);
     return 0;
 }
@@ -0,0 +1,18 @@
+/** @file
+    Implementacja klasyfikacji liter.
+
+    @ingroup dict-check
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-22
+    @copyright Uniwersytet Warszawski
+  */
+
+#include "letters.h"
+
+wchar_t letters_table[LETTERS_TABLE_SIZE];
+
+void letters_init(void)
+{
+    for(wchar_t c = 0; c < LETTERS_TABLE_SIZE; c++)
+        letters_table[c] = iswalpha(c) ? (wchar_t)towlower(c) : 0;
+}
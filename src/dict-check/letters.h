@@ -0,0 +1,45 @@
+/** @file
+    Interfejs klasyfikacji liter.
+
+    Dla znaków o małych kodach (w tym ASCII i wszystkich polskich liter)
+    wynik iswalpha() i towlower() jest raz wyliczany do tablicy,
+    więc rozpoznanie litery to jedno odwołanie do pamięci.
+    Pozostałe znaki są klasyfikowane funkcjami z biblioteki standardowej.
+
+    @ingroup dict-check
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-22
+    @copyright Uniwersytet Warszawski
+  */
+
+#ifndef DICT_CHECK_LETTERS_H
+#define DICT_CHECK_LETTERS_H
+
+#include <wchar.h>
+#include <wctype.h>
+
+/// Liczba znaków klasyfikowanych przez tablicę (wszystkie 1- i 2-bajtowe w UTF-8).
+#define LETTERS_TABLE_SIZE 0x800
+
+/**
+  Małe litery odpowiadające znakom; 0 dla znaków niebędących literami.
+  */
+extern wchar_t letters_table[LETTERS_TABLE_SIZE];
+
+/**
+  Wypełnia tablicę zgodnie z bieżącym locale.
+  */
+void letters_init(void);
+
+/**
+  Zwraca małą literę odpowiadającą znakowi.
+  @param[in] c Znak.
+  @return Mała litera lub 0, jeśli znak nie jest literą.
+  */
+static inline wchar_t letters_lower(wchar_t c)
+{
+    if(c >= 0 && c < LETTERS_TABLE_SIZE) return letters_table[c];
+    return iswalpha(c) ? (wchar_t)towlower(c) : 0;
+}
+
+#endif /* DICT_CHECK_LETTERS_H */
@@ -0,0 +1,155 @@
+/** @file
+    Implementacja pamięci wyników sprawdzania słów.
+
+    @ingroup dict-check
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-23
+    @copyright Uniwersytet Warszawski
+  */
+
+#include "memo.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/// Początkowy rozmiar tablicy.
+#define MEMO_INITIAL_SIZE 1024
+
+/// Początkowa pojemność bufora danych.
+#define MEMO_INITIAL_DATA (16 * 1024)
+
+/** @name Funkcje pomocnicze
+ * @{
+ */
+
+/**
+  Zwraca zajmowaną pamięć po zmianie rozmiarów tablicy i bufora.
+  @param[in] size Rozmiar tablicy.
+  @param[in] data_cap Pojemność bufora.
+  @return Liczba bajtów.
+  */
+static size_t memo_usage(size_t size, size_t data_cap)
+{
+    return size * sizeof(struct memo_entry) + data_cap;
+}
+
+/**
+  Zwraca miejsce w tablicy, od którego szukać słowa o danym haszu.
+  @param[in] table Tablica.
+  @param[in] size Rozmiar tablicy.
+  @param[in] hash Hasz.
+  @return Pierwsze wolne miejsce z ciągu rozpoczętego od pozycji haszu.
+  */
+static struct memo_entry * memo_slot(struct memo_entry *table, size_t size, uint32_t hash)
+{
+    size_t i = hash & (size - 1);
+    while(table[i].key_len != 0) i = (i + 1) & (size - 1);
+    return &table[i];
+}
+
+/**
+  Podwaja tablicę.
+  @param[in,out] m Pamięć.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+static int memo_grow_table(struct memo *m)
+{
+    size_t size = m->size == 0 ? MEMO_INITIAL_SIZE : m->size * 2;
+    if(memo_usage(size, m->data_cap) > m->limit) return -1;
+    struct memo_entry *table = calloc(size, sizeof(struct memo_entry));
+    if(table == NULL) return -1;
+    for(size_t i = 0; i < m->size; i++)
+        if(m->table[i].key_len != 0)
+            *memo_slot(table, size, m->table[i].hash) = m->table[i];
+    free(m->table);
+    m->table = table;
+    m->size = size;
+    return 0;
+}
+
+/**
+  Zapewnia miejsce w buforze danych.
+  @param[in,out] m Pamięć.
+  @param[in] len Liczba potrzebnych wolnych bajtów.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+static int memo_reserve_data(struct memo *m, size_t len)
+{
+    if(m->data_cap - m->data_len >= len) return 0;
+    size_t cap = m->data_cap == 0 ? MEMO_INITIAL_DATA : m->data_cap;
+    while(cap - m->data_len < len) cap *= 2;
+    if(memo_usage(m->size, cap) > m->limit) return -1;
+    char *data = realloc(m->data, cap);
+    if(data == NULL) return -1;
+    m->data = data;
+    m->data_cap = cap;
+    return 0;
+}
+
+/**
+ * @}
+ */
+
+/** @name Elementy interfejsu
+ * @{
+ */
+
+void memo_init(struct memo *m, size_t limit)
+{
+    m->table = NULL;
+    m->size = 0;
+    m->count = 0;
+    m->data = NULL;
+    m->data_len = 0;
+    m->data_cap = 0;
+    m->limit = limit;
+}
+
+void memo_done(struct memo *m)
+{
+    free(m->table);
+    free(m->data);
+    memo_init(m, m->limit);
+}
+
+const struct memo_entry * memo_find(const struct memo *m, const char *key,
+        size_t len, uint32_t hash)
+{
+    if(m->size == 0) return NULL;
+    size_t i = hash & (m->size - 1);
+    while(m->table[i].key_len != 0)
+    {
+        const struct memo_entry *e = &m->table[i];
+        if(e->hash == hash && e->key_len == len
+           && memcmp(m->data + e->key, key, len) == 0)
+            return e;
+        i = (i + 1) & (m->size - 1);
+    }
+    return NULL;
+}
+
+int memo_add(struct memo *m, const char *key, size_t len, uint32_t hash,
+        bool found, const char *hint, size_t hint_len)
+{
+    if(len == 0 || len > UINT32_MAX || hint_len > UINT32_MAX) return -1;
+    // Współczynnik zapełnienia utrzymujemy poniżej 1/2
+    if(2 * (m->count + 1) > m->size && memo_grow_table(m) < 0) return -1;
+    if(memo_reserve_data(m, len + hint_len) < 0) return -1;
+    struct memo_entry *e = memo_slot(m->table, m->size, hash);
+    e->key = m->data_len;
+    memcpy(m->data + m->data_len, key, len);
+    m->data_len += len;
+    e->hint = m->data_len;
+    if(hint_len > 0) memcpy(m->data + m->data_len, hint, hint_len);
+    m->data_len += hint_len;
+    e->hash = hash;
+    e->key_len = len;
+    e->hint_len = hint_len;
+    e->found = found;
+    m->count++;
+    return 0;
+}
+
+/**
+ * @}
+ */
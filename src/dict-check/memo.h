@@ -0,0 +1,122 @@
+/** @file
+    Interfejs pamięci wyników sprawdzania słów.
+
+    Słowa w tekście naturalnym często się powtarzają, więc wynik
+    sprawdzenia słowa (i sformatowane podpowiedzi) zapamiętujemy
+    w tablicy haszującej z adresowaniem otwartym.
+    Klucze i podpowiedzi trzymamy w jednym ciągłym buforze,
+    a wpisy odwołują się do nich przez przesunięcia.
+    Rozmiar pamięci jest ograniczony; po przekroczeniu limitu
+    nowe słowa po prostu nie są zapamiętywane.
+
+    @ingroup dict-check
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-23
+    @copyright Uniwersytet Warszawski
+  */
+
+#ifndef DICT_CHECK_MEMO_H
+#define DICT_CHECK_MEMO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Domyślny limit pamięci w megabajtach.
+#define MEMO_DEFAULT_LIMIT 64
+
+/**
+  Wpis w tablicy.
+  */
+struct memo_entry
+{
+    size_t key;             ///< Przesunięcie klucza w buforze danych.
+    size_t hint;            ///< Przesunięcie podpowiedzi w buforze danych.
+    uint32_t hash;          ///< Hasz klucza.
+    uint32_t key_len;       ///< Długość klucza; 0 oznacza wolne miejsce.
+    uint32_t hint_len;      ///< Długość podpowiedzi.
+    bool found;             ///< Czy słowo jest w słowniku.
+};
+
+/**
+  Pamięć wyników sprawdzania słów.
+  */
+struct memo
+{
+    struct memo_entry *table;   ///< Tablica wpisów.
+    size_t size;                ///< Rozmiar tablicy (potęga dwójki).
+    size_t count;               ///< Liczba zajętych wpisów.
+    char *data;                 ///< Bufor na klucze i podpowiedzi.
+    size_t data_len;            ///< Liczba zajętych bajtów bufora.
+    size_t data_cap;            ///< Pojemność bufora.
+    size_t limit;               ///< Maksymalna zajmowana pamięć w bajtach.
+};
+
+/**
+  Tworzy pustą pamięć.
+  @param[out] m Pamięć.
+  @param[in] limit Maksymalna zajmowana pamięć w bajtach.
+  */
+void memo_init(struct memo *m, size_t limit);
+
+/**
+  Zwalnia pamięć.
+  @param[in,out] m Pamięć.
+  */
+void memo_done(struct memo *m);
+
+/**
+  Wyszukuje słowo.
+  @param[in] m Pamięć.
+  @param[in] key Słowo w UTF-8.
+  @param[in] len Długość słowa w bajtach.
+  @param[in] hash Hasz słowa (z memo_hash()).
+  @return Wpis lub NULL, jeśli słowa nie zapamiętano.
+  */
+const struct memo_entry * memo_find(const struct memo *m, const char *key,
+        size_t len, uint32_t hash);
+
+/**
+  Zapamiętuje słowo.
+  Słowa nie może jeszcze być w pamięci.
+  @param[in,out] m Pamięć.
+  @param[in] key Słowo w UTF-8.
+  @param[in] len Długość słowa w bajtach (niezerowa).
+  @param[in] hash Hasz słowa (z memo_hash()).
+  @param[in] found Czy słowo jest w słowniku.
+  @param[in] hint Sformatowane podpowiedzi.
+  @param[in] hint_len Długość podpowiedzi w bajtach.
+  @return 0 jeśli zapamiętano, -1 jeśli przekroczono limit lub brakło pamięci.
+  */
+int memo_add(struct memo *m, const char *key, size_t len, uint32_t hash,
+        bool found, const char *hint, size_t hint_len);
+
+/**
+  Zwraca podpowiedzi zapisane we wpisie.
+  @param[in] m Pamięć.
+  @param[in] e Wpis.
+  @return Wskaźnik na podpowiedzi (ważny do następnego memo_add()).
+  */
+static inline const char * memo_hint(const struct memo *m, const struct memo_entry *e)
+{
+    return m->data + e->hint;
+}
+
+/**
+  Oblicza hasz słowa (FNV-1a).
+  @param[in] key Słowo.
+  @param[in] len Długość słowa w bajtach.
+  @return Hasz.
+  */
+static inline uint32_t memo_hash(const char *key, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)key[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+#endif /* DICT_CHECK_MEMO_H */
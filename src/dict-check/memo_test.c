@@ -0,0 +1,146 @@
+/** @file
+  Test pamięci wyników sprawdzania słów.
+
+  @ingroup dict-check
+  @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+  @copyright Uniwersytet Warszawski
+  @date 2015-06-23
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmocka.h>
+#include "memo.h"
+
+/**
+  Zapamiętuje słowo z podpowiedzią postaci "<słowo>!".
+  @param[in,out] m Pamięć.
+  @param[in] key Słowo.
+  @param[in] found Czy słowo jest w słowniku.
+  @return Wynik memo_add().
+  */
+static int add_word(struct memo *m, const char *key, bool found)
+{
+    char hint[64];
+    int n = snprintf(hint, sizeof(hint), "%s!", key);
+    return memo_add(m, key, strlen(key), memo_hash(key, strlen(key)), found, hint, n);
+}
+
+/**
+  Sprawdza, czy słowo zapamiętane przez add_word() jest w pamięci.
+  @param[in] m Pamięć.
+  @param[in] key Słowo.
+  @param[in] found Oczekiwany wynik sprawdzenia słowa.
+  */
+static void check_word(const struct memo *m, const char *key, bool found)
+{
+    const struct memo_entry *e = memo_find(m, key, strlen(key), memo_hash(key, strlen(key)));
+    assert_true(e != NULL);
+    assert_int_equal(e->found, found);
+    assert_int_equal(e->hint_len, strlen(key) + 1);
+    assert_memory_equal(memo_hint(m, e), key, strlen(key));
+    assert_int_equal(memo_hint(m, e)[strlen(key)], '!');
+}
+
+/// Testuje zapamiętywanie i wyszukiwanie słów.
+static void memo_add_find_test(void **state)
+{
+    struct memo m;
+    memo_init(&m, MEMO_DEFAULT_LIMIT * 1024 * 1024);
+    assert_true(memo_find(&m, "ala", 3, memo_hash("ala", 3)) == NULL);
+    assert_int_equal(add_word(&m, "ala", true), 0);
+    assert_int_equal(add_word(&m, "kot", false), 0);
+    assert_int_equal(memo_add(&m, "pies", 4, memo_hash("pies", 4), true, NULL, 0), 0);
+    check_word(&m, "ala", true);
+    check_word(&m, "kot", false);
+    const struct memo_entry *e = memo_find(&m, "pies", 4, memo_hash("pies", 4));
+    assert_true(e != NULL);
+    assert_int_equal(e->hint_len, 0);
+    assert_true(memo_find(&m, "al", 2, memo_hash("al", 2)) == NULL);
+    assert_true(memo_find(&m, "alan", 4, memo_hash("alan", 4)) == NULL);
+    assert_int_equal(memo_add(&m, "", 0, memo_hash("", 0), true, NULL, 0), -1);
+    assert_int_equal(m.count, 3);
+    memo_done(&m);
+}
+
+/// Testuje słowa o tym samym haszu.
+static void memo_collision_test(void **state)
+{
+    struct memo m;
+    memo_init(&m, MEMO_DEFAULT_LIMIT * 1024 * 1024);
+    assert_int_equal(memo_add(&m, "ala", 3, 7, true, "a", 1), 0);
+    assert_int_equal(memo_add(&m, "ola", 3, 7, false, "o", 1), 0);
+    const struct memo_entry *a = memo_find(&m, "ala", 3, 7);
+    const struct memo_entry *o = memo_find(&m, "ola", 3, 7);
+    assert_true(a != NULL && o != NULL && a != o);
+    assert_true(a->found);
+    assert_false(o->found);
+    assert_int_equal(*memo_hint(&m, o), 'o');
+    assert_true(memo_find(&m, "ela", 3, 7) == NULL);
+    memo_done(&m);
+}
+
+/// Testuje powiększanie tablicy i bufora danych.
+static void memo_grow_test(void **state)
+{
+    struct memo m;
+    memo_init(&m, MEMO_DEFAULT_LIMIT * 1024 * 1024);
+    char key[16];
+    for(int i = 0; i < 5000; i++)
+    {
+        sprintf(key, "w%d", i);
+        assert_int_equal(add_word(&m, key, i % 2 == 0), 0);
+    }
+    assert_true(m.size >= 2 * 5000);
+    for(int i = 0; i < 5000; i++)
+    {
+        sprintf(key, "w%d", i);
+        check_word(&m, key, i % 2 == 0);
+    }
+    memo_done(&m);
+}
+
+/// Testuje ograniczenie zajmowanej pamięci.
+static void memo_limit_test(void **state)
+{
+    struct memo m;
+    memo_init(&m, 1024);
+    assert_int_equal(add_word(&m, "ala", true), -1);
+    assert_true(memo_find(&m, "ala", 3, memo_hash("ala", 3)) == NULL);
+    memo_done(&m);
+
+    memo_init(&m, 1024 * sizeof(struct memo_entry) + 16 * 1024);
+    char key[16];
+    int added = 0;
+    while(1)
+    {
+        sprintf(key, "w%d", added);
+        if(add_word(&m, key, true) < 0) break;
+        added++;
+    }
+    assert_true(added > 0 && added <= 512);
+    assert_int_equal(m.count, added);
+    assert_true(m.size * sizeof(struct memo_entry) + m.data_cap <= m.limit);
+    for(int i = 0; i < added; i++)
+    {
+        sprintf(key, "w%d", i);
+        check_word(&m, key, true);
+    }
+    memo_done(&m);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(memo_add_find_test),
+        cmocka_unit_test(memo_collision_test),
+        cmocka_unit_test(memo_grow_test),
+        cmocka_unit_test(memo_limit_test),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,242 @@
+/** @file
+    Implementacja protokołu serwera słownikowego.
+
+    @ingroup dict-check
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-24
+    @copyright Uniwersytet Warszawski
+  */
+
+#include "protocol.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/// Początkowa pojemność buforów połączenia.
+#define PROTOCOL_BUFFER (64 * 1024)
+
+/** @name Funkcje pomocnicze
+ * @{
+ */
+
+/**
+  Zapisuje liczbę 32-bitową w porządku big-endian.
+  @param[out] p Miejsce na liczbę.
+  @param[in] value Liczba.
+  */
+static void put_u32(char *p, uint32_t value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+/**
+  Zapewnia miejsce w buforze.
+  @param[in,out] buffer Bufor.
+  @param[in,out] cap Pojemność bufora.
+  @param[in] need Wymagana pojemność.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+static int reserve(char **buffer, size_t *cap, size_t need)
+{
+    if(need <= *cap) return 0;
+    size_t nc = *cap;
+    while(nc < need) nc *= 2;
+    char *nb = realloc(*buffer, nc);
+    if(nb == NULL) return -1;
+    *buffer = nb;
+    *cap = nc;
+    return 0;
+}
+
+/**
+  Wypełnia adres gniazda.
+  @param[out] addr Adres.
+  @param[in] path Ścieżka gniazda.
+  @return 0 jeśli się udało, -1 jeśli ścieżka jest za długa.
+  */
+static int socket_address(struct sockaddr_un *addr, const char *path)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(addr->sun_path)) return -1;
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+/**
+ * @}
+ */
+
+/** @name Elementy interfejsu
+ * @{
+ */
+
+int protocol_init(struct protocol_conn *c, int fd)
+{
+    c->fd = fd;
+    c->in_pos = c->in_len = 0;
+    c->out_len = 0;
+    c->frame = 0;
+    c->in_cap = c->out_cap = PROTOCOL_BUFFER;
+    c->in = malloc(c->in_cap);
+    c->out = malloc(c->out_cap);
+    if(c->in == NULL || c->out == NULL)
+    {
+        protocol_done(c);
+        return -1;
+    }
+    return 0;
+}
+
+void protocol_done(struct protocol_conn *c)
+{
+    free(c->in);
+    free(c->out);
+    c->in = c->out = NULL;
+    c->in_cap = c->out_cap = 0;
+}
+
+int protocol_next(struct protocol_conn *c, struct protocol_frame *f)
+{
+    while(1)
+    {
+        size_t avail = c->in_len - c->in_pos;
+        if(avail >= PROTOCOL_HEADER)
+        {
+            const char *h = c->in + c->in_pos;
+            uint32_t len = protocol_get_u32(h + 4);
+            if(len > PROTOCOL_MAX_FRAME) return -1;
+            if(avail >= PROTOCOL_HEADER + len)
+            {
+                f->type = h[0];
+                f->dict = h[1];
+                f->flags = h[2];
+                f->len = len;
+                f->payload = h + PROTOCOL_HEADER;
+                c->in_pos += PROTOCOL_HEADER + len;
+                return 1;
+            }
+            if(reserve(&c->in, &c->in_cap, PROTOCOL_HEADER + len) < 0) return -1;
+        }
+        // Brak całej ramki: wysyłamy odpowiedzi i czekamy na dane
+        if(protocol_flush(c) < 0) return -1;
+        memmove(c->in, c->in + c->in_pos, avail);
+        c->in_pos = 0;
+        c->in_len = avail;
+        if(c->in_len == c->in_cap
+           && reserve(&c->in, &c->in_cap, c->in_cap * 2) < 0) return -1;
+        ssize_t n = read(c->fd, c->in + c->in_len, c->in_cap - c->in_len);
+        if(n < 0 && errno == EINTR) continue;
+        if(n < 0) return -1;
+        if(n == 0) return avail == 0 ? 0 : -1;
+        c->in_len += n;
+    }
+}
+
+int protocol_begin(struct protocol_conn *c, unsigned char type,
+        unsigned char dict, unsigned char flags)
+{
+    if(reserve(&c->out, &c->out_cap, c->out_len + PROTOCOL_HEADER) < 0) return -1;
+    c->frame = c->out_len;
+    char *h = c->out + c->out_len;
+    h[0] = type;
+    h[1] = dict;
+    h[2] = flags;
+    h[3] = 0;
+    c->out_len += PROTOCOL_HEADER;
+    return 0;
+}
+
+int protocol_append(struct protocol_conn *c, const void *data, size_t len)
+{
+    if(reserve(&c->out, &c->out_cap, c->out_len + len) < 0) return -1;
+    if(len > 0) memcpy(c->out + c->out_len, data, len);
+    c->out_len += len;
+    return 0;
+}
+
+int protocol_append_u32(struct protocol_conn *c, uint32_t value)
+{
+    char buf[4];
+    put_u32(buf, value);
+    return protocol_append(c, buf, 4);
+}
+
+int protocol_end(struct protocol_conn *c)
+{
+    size_t len = c->out_len - c->frame - PROTOCOL_HEADER;
+    if(len > PROTOCOL_MAX_FRAME)
+    {
+        c->out_len = c->frame;
+        return -1;
+    }
+    put_u32(c->out + c->frame + 4, len);
+    return 0;
+}
+
+int protocol_send(struct protocol_conn *c, unsigned char type, unsigned char dict,
+        unsigned char flags, const void *data, size_t len)
+{
+    if(protocol_begin(c, type, dict, flags) < 0) return -1;
+    if(protocol_append(c, data, len) < 0)
+    {
+        c->out_len = c->frame;
+        return -1;
+    }
+    return protocol_end(c);
+}
+
+int protocol_flush(struct protocol_conn *c)
+{
+    size_t done = 0;
+    while(done < c->out_len)
+    {
+        ssize_t n = write(c->fd, c->out + done, c->out_len - done);
+        if(n < 0 && errno == EINTR) continue;
+        if(n < 0) return -1;
+        done += n;
+    }
+    c->out_len = 0;
+    c->frame = 0;
+    return 0;
+}
+
+int protocol_connect(const char *path)
+{
+    struct sockaddr_un addr;
+    if(socket_address(&addr, path) < 0) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) return -1;
+    if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int protocol_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    if(socket_address(&addr, path) < 0) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) return -1;
+    unlink(path);
+    if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,198 @@
+/** @file
+    Interfejs protokołu serwera słownikowego.
+
+    Klient i serwer wymieniają ramki. Każda ramka zaczyna się
+    8-bajtowym nagłówkiem: typ, numer słownika, flagi, bajt zerowy
+    oraz długość danych (32 bity, big-endian), po którym następują dane.
+
+    Zapytania:
+    - PROTOCOL_FIND: dane to słowo w UTF-8,
+      odpowiedź zawiera jeden bajt: 1 jeśli słowo jest w słowniku, 0 w p.p.
+    - PROTOCOL_HINTS: dane to słowo w UTF-8,
+      odpowiedź to lista podpowiedzi zakończonych znakami '\0'.
+    - PROTOCOL_CHECK: dane to tekst do sprawdzenia (flagi odpowiadają
+      opcjom dict-check), odpowiedź to długość wyjścia (32 bity, big-endian),
+      wyjście i wyjście diagnostyczne, tak jak wypisałby je dict-check.
+
+    Na błędne zapytanie (np. słowo, które nie jest poprawnym UTF-8)
+    serwer odpowiada ramką PROTOCOL_ERROR z opisem błędu.
+    Odpowiedzi przychodzą w kolejności zapytań, więc klient może wysłać
+    wiele zapytań bez czekania na odpowiedzi. Serwer wysyła odpowiedzi,
+    gdy zabraknie mu pełnych zapytań, więc klient wysyłający dużo
+    zapytań naraz powinien równocześnie odbierać odpowiedzi.
+
+    @ingroup dict-check
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-24
+    @copyright Uniwersytet Warszawski
+  */
+
+#ifndef DICT_CHECK_PROTOCOL_H
+#define DICT_CHECK_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Długość nagłówka ramki.
+#define PROTOCOL_HEADER 8
+
+/// Maksymalna długość danych w ramce.
+#define PROTOCOL_MAX_FRAME (256u * 1024 * 1024)
+
+/// Flaga zapytania PROTOCOL_CHECK: wypisywać podpowiedzi.
+#define PROTOCOL_VERBOSE 1
+
+/// Flaga zapytania PROTOCOL_CHECK: nie przepisywać tekstu.
+#define PROTOCOL_NO_ECHO 2
+
+/// Flaga zapytania PROTOCOL_CHECK: rekordy w formacie JSON Lines.
+#define PROTOCOL_JSONL 4
+
+/// Flaga zapytania PROTOCOL_CHECK: rekordy w formacie TSV.
+#define PROTOCOL_TSV 8
+
+/**
+  Typy ramek.
+  */
+enum protocol_type
+{
+    PROTOCOL_FIND = 'F',        ///< Sprawdzenie słowa.
+    PROTOCOL_HINTS = 'H',       ///< Podpowiedzi dla słowa.
+    PROTOCOL_CHECK = 'C',       ///< Sprawdzenie tekstu.
+    PROTOCOL_ERROR = 'E'        ///< Odpowiedź: błąd.
+};
+
+/**
+  Odebrana ramka.
+  */
+struct protocol_frame
+{
+    unsigned char type;         ///< Typ ramki.
+    unsigned char dict;         ///< Numer słownika.
+    unsigned char flags;        ///< Flagi.
+    uint32_t len;               ///< Długość danych.
+    const char *payload;        ///< Dane (ważne do następnego protocol_next()).
+};
+
+/**
+  Połączenie z buforami wejścia i wyjścia.
+  */
+struct protocol_conn
+{
+    int fd;                     ///< Gniazdo.
+    char *in;                   ///< Bufor wejścia.
+    size_t in_pos;              ///< Początek nieprzetworzonych danych.
+    size_t in_len;              ///< Koniec danych w buforze wejścia.
+    size_t in_cap;              ///< Pojemność bufora wejścia.
+    char *out;                  ///< Bufor wyjścia.
+    size_t out_len;             ///< Liczba bajtów w buforze wyjścia.
+    size_t out_cap;             ///< Pojemność bufora wyjścia.
+    size_t frame;               ///< Początek budowanej ramki w buforze wyjścia.
+};
+
+/**
+  Tworzy połączenie na gnieździe.
+  @param[out] c Połączenie.
+  @param[in] fd Gniazdo.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+int protocol_init(struct protocol_conn *c, int fd);
+
+/**
+  Zwalnia bufory połączenia (nie zamyka gniazda).
+  @param[in,out] c Połączenie.
+  */
+void protocol_done(struct protocol_conn *c);
+
+/**
+  Odbiera kolejną ramkę.
+  Zanim zacznie czekać na dane, wysyła zbuforowane ramki.
+  @param[in,out] c Połączenie.
+  @param[out] f Ramka.
+  @return 1 jeśli odebrano ramkę, 0 jeśli druga strona zamknęła połączenie,
+  -1 jeśli wystąpił błąd.
+  */
+int protocol_next(struct protocol_conn *c, struct protocol_frame *f);
+
+/**
+  Zaczyna budowanie ramki w buforze wyjścia.
+  @param[in,out] c Połączenie.
+  @param[in] type Typ ramki.
+  @param[in] dict Numer słownika.
+  @param[in] flags Flagi.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+int protocol_begin(struct protocol_conn *c, unsigned char type,
+        unsigned char dict, unsigned char flags);
+
+/**
+  Dopisuje dane do budowanej ramki.
+  @param[in,out] c Połączenie.
+  @param[in] data Dane.
+  @param[in] len Długość danych.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+int protocol_append(struct protocol_conn *c, const void *data, size_t len);
+
+/**
+  Dopisuje liczbę 32-bitową (big-endian) do budowanej ramki.
+  @param[in,out] c Połączenie.
+  @param[in] value Liczba.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+int protocol_append_u32(struct protocol_conn *c, uint32_t value);
+
+/**
+  Kończy budowanie ramki.
+  @param[in,out] c Połączenie.
+  @return 0 jeśli się udało, -1 jeśli ramka jest za długa.
+  */
+int protocol_end(struct protocol_conn *c);
+
+/**
+  Buduje całą ramkę.
+  @param[in,out] c Połączenie.
+  @param[in] type Typ ramki.
+  @param[in] dict Numer słownika.
+  @param[in] flags Flagi.
+  @param[in] data Dane.
+  @param[in] len Długość danych.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+int protocol_send(struct protocol_conn *c, unsigned char type, unsigned char dict,
+        unsigned char flags, const void *data, size_t len);
+
+/**
+  Wysyła zbuforowane ramki.
+  @param[in,out] c Połączenie.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+int protocol_flush(struct protocol_conn *c);
+
+/**
+  Odczytuje liczbę 32-bitową zapisaną w porządku big-endian.
+  @param[in] p Dane.
+  @return Liczba.
+  */
+static inline uint32_t protocol_get_u32(const char *p)
+{
+    const unsigned char *u = (const unsigned char *)p;
+    return (uint32_t)u[0] << 24 | (uint32_t)u[1] << 16 | (uint32_t)u[2] << 8 | u[3];
+}
+
+/**
+  Łączy się z serwerem.
+  @param[in] path Ścieżka gniazda.
+  @return Gniazdo lub -1, jeśli się nie udało.
+  */
+int protocol_connect(const char *path);
+
+/**
+  Tworzy gniazdo nasłuchujące.
+  Istniejący plik gniazda jest usuwany.
+  @param[in] path Ścieżka gniazda.
+  @return Gniazdo lub -1, jeśli się nie udało.
+  */
+int protocol_listen(const char *path);
+
+#endif /* DICT_CHECK_PROTOCOL_H */
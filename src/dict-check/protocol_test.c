@@ -0,0 +1,260 @@
+/** @file
+  Test ramek protokołu serwera słownikowego.
+
+  Ramki są czytane z potoku, więc do testów nie jest potrzebne gniazdo.
+
+  @ingroup dict-check
+  @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+  @copyright Uniwersytet Warszawski
+  @date 2015-06-24
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <cmocka.h>
+#include "protocol.h"
+
+/**
+  Fragmenty danych wysyłane do potoku przez osobny wątek.
+  */
+struct dribble
+{
+    int fd;                 ///< Koniec potoku do pisania.
+    const char *data;       ///< Dane.
+    size_t len;             ///< Długość danych.
+    size_t piece;           ///< Długość jednego fragmentu.
+};
+
+/**
+  Zapisuje nagłówek ramki.
+  @param[out] h Miejsce na nagłówek.
+  @param[in] type Typ ramki.
+  @param[in] dict Numer słownika.
+  @param[in] flags Flagi.
+  @param[in] len Długość danych.
+  */
+static void header(char *h, unsigned char type, unsigned char dict,
+        unsigned char flags, uint32_t len)
+{
+    h[0] = type;
+    h[1] = dict;
+    h[2] = flags;
+    h[3] = 0;
+    h[4] = len >> 24;
+    h[5] = len >> 16;
+    h[6] = len >> 8;
+    h[7] = len;
+}
+
+/**
+  Wątek zapisujący dane fragmentami, z przerwami między nimi,
+  a na końcu zamykający potok.
+  @param[in] arg Dane (struct dribble).
+  @return NULL.
+  */
+static void * dribble_main(void *arg)
+{
+    struct dribble *d = arg;
+    for(size_t done = 0; done < d->len; )
+    {
+        size_t n = d->len - done < d->piece ? d->len - done : d->piece;
+        ssize_t w = write(d->fd, d->data + done, n);
+        if(w <= 0) break;
+        done += w;
+        usleep(1000);
+    }
+    close(d->fd);
+    return NULL;
+}
+
+/// Testuje budowanie i wysyłanie ramek.
+static void protocol_send_test(void **state)
+{
+    int p[2];
+    assert_int_equal(pipe(p), 0);
+    struct protocol_conn c;
+    assert_int_equal(protocol_init(&c, p[1]), 0);
+    assert_int_equal(protocol_send(&c, PROTOCOL_FIND, 3, 0, "ala", 3), 0);
+    assert_int_equal(protocol_begin(&c, PROTOCOL_CHECK, 1, PROTOCOL_VERBOSE), 0);
+    assert_int_equal(protocol_append_u32(&c, 0x01020304), 0);
+    assert_int_equal(protocol_append(&c, "xy", 2), 0);
+    assert_int_equal(protocol_end(&c), 0);
+    assert_int_equal(protocol_send(&c, PROTOCOL_HINTS, 0, 0, NULL, 0), 0);
+    assert_int_equal(protocol_flush(&c), 0);
+    assert_int_equal(c.out_len, 0);
+
+    char expected[3 * PROTOCOL_HEADER + 9];
+    header(expected, PROTOCOL_FIND, 3, 0, 3);
+    memcpy(expected + PROTOCOL_HEADER, "ala", 3);
+    header(expected + PROTOCOL_HEADER + 3, PROTOCOL_CHECK, 1, PROTOCOL_VERBOSE, 6);
+    memcpy(expected + 2 * PROTOCOL_HEADER + 3, "\1\2\3\4xy", 6);
+    header(expected + 2 * PROTOCOL_HEADER + 9, PROTOCOL_HINTS, 0, 0, 0);
+    char buffer[sizeof(expected) + 1];
+    assert_int_equal(read(p[0], buffer, sizeof(buffer)), sizeof(expected));
+    assert_memory_equal(buffer, expected, sizeof(expected));
+    assert_int_equal(protocol_get_u32(expected + PROTOCOL_HEADER + 3 + 4), 6);
+    protocol_done(&c);
+    close(p[0]);
+    close(p[1]);
+}
+
+/// Testuje odbieranie wielu ramek wysłanych naraz.
+static void protocol_pipelined_test(void **state)
+{
+    int p[2];
+    assert_int_equal(pipe(p), 0);
+    char data[3 * PROTOCOL_HEADER + 7];
+    header(data, PROTOCOL_FIND, 0, 0, 3);
+    memcpy(data + PROTOCOL_HEADER, "kot", 3);
+    header(data + PROTOCOL_HEADER + 3, PROTOCOL_HINTS, 2, 0, 0);
+    header(data + 2 * PROTOCOL_HEADER + 3, PROTOCOL_CHECK, 1, PROTOCOL_VERBOSE, 4);
+    memcpy(data + 3 * PROTOCOL_HEADER + 3, "pies", 4);
+    assert_int_equal(write(p[1], data, sizeof(data)), sizeof(data));
+    close(p[1]);
+
+    struct protocol_conn c;
+    struct protocol_frame f;
+    assert_int_equal(protocol_init(&c, p[0]), 0);
+    assert_int_equal(protocol_next(&c, &f), 1);
+    assert_int_equal(f.type, PROTOCOL_FIND);
+    assert_int_equal(f.dict, 0);
+    assert_int_equal(f.len, 3);
+    assert_memory_equal(f.payload, "kot", 3);
+    assert_int_equal(protocol_next(&c, &f), 1);
+    assert_int_equal(f.type, PROTOCOL_HINTS);
+    assert_int_equal(f.dict, 2);
+    assert_int_equal(f.len, 0);
+    assert_int_equal(protocol_next(&c, &f), 1);
+    assert_int_equal(f.type, PROTOCOL_CHECK);
+    assert_int_equal(f.dict, 1);
+    assert_int_equal(f.flags, PROTOCOL_VERBOSE);
+    assert_int_equal(f.len, 4);
+    assert_memory_equal(f.payload, "pies", 4);
+    assert_int_equal(protocol_next(&c, &f), 0);
+    protocol_done(&c);
+    close(p[0]);
+}
+
+/**
+  Wysyła ramki fragmentami i sprawdza, czy zostaną poprawnie złożone.
+  @param[in] payload Długość danych drugiej ramki.
+  @param[in] piece Długość fragmentu.
+  */
+static void check_split(size_t payload, size_t piece)
+{
+    size_t len = 2 * PROTOCOL_HEADER + 3 + payload;
+    char *data = malloc(len);
+    header(data, PROTOCOL_FIND, 0, 0, 3);
+    memcpy(data + PROTOCOL_HEADER, "ala", 3);
+    header(data + PROTOCOL_HEADER + 3, PROTOCOL_CHECK, 0, 0, payload);
+    for(size_t i = 0; i < payload; i++)
+        data[2 * PROTOCOL_HEADER + 3 + i] = 'a' + i % 26;
+
+    int p[2];
+    assert_int_equal(pipe(p), 0);
+    struct dribble d = { p[1], data, len, piece };
+    pthread_t writer;
+    assert_int_equal(pthread_create(&writer, NULL, dribble_main, &d), 0);
+    struct protocol_conn c;
+    struct protocol_frame f;
+    assert_int_equal(protocol_init(&c, p[0]), 0);
+    assert_int_equal(protocol_next(&c, &f), 1);
+    assert_int_equal(f.type, PROTOCOL_FIND);
+    assert_int_equal(f.len, 3);
+    assert_memory_equal(f.payload, "ala", 3);
+    assert_int_equal(protocol_next(&c, &f), 1);
+    assert_int_equal(f.type, PROTOCOL_CHECK);
+    assert_int_equal(f.len, payload);
+    assert_memory_equal(f.payload, data + 2 * PROTOCOL_HEADER + 3, payload);
+    assert_int_equal(protocol_next(&c, &f), 0);
+    pthread_join(writer, NULL);
+    protocol_done(&c);
+    close(p[0]);
+    free(data);
+}
+
+/// Testuje składanie ramek podzielonych w środku nagłówka i danych.
+static void protocol_split_test(void **state)
+{
+    check_split(10, 1);
+    check_split(10, 5);
+    check_split(100, 7);
+}
+
+/// Testuje ramki dłuższe niż początkowy bufor wejścia i bufor potoku.
+static void protocol_large_test(void **state)
+{
+    check_split(300 * 1024, 50 * 1024);
+}
+
+/// Testuje nagłówek z długością większą niż PROTOCOL_MAX_FRAME.
+static void protocol_oversized_test(void **state)
+{
+    int p[2];
+    assert_int_equal(pipe(p), 0);
+    char data[2 * PROTOCOL_HEADER + 1];
+    header(data, PROTOCOL_FIND, 0, 0, 1);
+    data[PROTOCOL_HEADER] = 'a';
+    header(data + PROTOCOL_HEADER + 1, PROTOCOL_CHECK, 0, 0, PROTOCOL_MAX_FRAME + 1);
+    assert_int_equal(write(p[1], data, sizeof(data)), sizeof(data));
+    struct protocol_conn c;
+    struct protocol_frame f;
+    assert_int_equal(protocol_init(&c, p[0]), 0);
+    assert_int_equal(protocol_next(&c, &f), 1);
+    assert_int_equal(f.type, PROTOCOL_FIND);
+    assert_int_equal(protocol_next(&c, &f), -1);
+    protocol_done(&c);
+    close(p[0]);
+    close(p[1]);
+
+    // Największa długość, jaką da się zapisać w nagłówku
+    assert_int_equal(pipe(p), 0);
+    memset(data, 0xff, PROTOCOL_HEADER);
+    assert_int_equal(write(p[1], data, PROTOCOL_HEADER), PROTOCOL_HEADER);
+    assert_int_equal(protocol_init(&c, p[0]), 0);
+    assert_int_equal(protocol_next(&c, &f), -1);
+    protocol_done(&c);
+    close(p[0]);
+    close(p[1]);
+}
+
+/// Testuje połączenie zamknięte w środku ramki.
+static void protocol_truncated_test(void **state)
+{
+    static const size_t cut[] = { 3, PROTOCOL_HEADER, PROTOCOL_HEADER + 2 };
+    char data[PROTOCOL_HEADER + 4];
+    header(data, PROTOCOL_HINTS, 0, 0, 4);
+    memcpy(data + PROTOCOL_HEADER, "abcd", 4);
+    for(size_t i = 0; i < sizeof(cut) / sizeof(cut[0]); i++)
+    {
+        int p[2];
+        assert_int_equal(pipe(p), 0);
+        assert_int_equal(write(p[1], data, cut[i]), cut[i]);
+        close(p[1]);
+        struct protocol_conn c;
+        struct protocol_frame f;
+        assert_int_equal(protocol_init(&c, p[0]), 0);
+        assert_int_equal(protocol_next(&c, &f), -1);
+        protocol_done(&c);
+        close(p[0]);
+    }
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(protocol_send_test),
+        cmocka_unit_test(protocol_pipelined_test),
+        cmocka_unit_test(protocol_split_test),
+        cmocka_unit_test(protocol_large_test),
+        cmocka_unit_test(protocol_oversized_test),
+        cmocka_unit_test(protocol_truncated_test),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
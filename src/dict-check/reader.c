@@ -0,0 +1,92 @@
+/** @file
+    Implementacja blokowego czytania wejścia.
+
+    @ingroup dict-check
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-22
+    @copyright Uniwersytet Warszawski
+  */
+
+#include "reader.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int reader_open(struct reader *r, int fd)
+{
+    r->fd = fd;
+    r->buffer = NULL;
+    r->len = 0;
+    r->capacity = 0;
+    r->mapped = false;
+    r->borrowed = false;
+    r->eof = false;
+
+    struct stat st;
+    if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(m != MAP_FAILED)
+        {
+            madvise(m, st.st_size, MADV_SEQUENTIAL);
+            r->buffer = m;
+            r->len = r->capacity = st.st_size;
+            r->mapped = true;
+            r->eof = true;
+            return 0;
+        }
+    }
+    r->buffer = malloc(READER_BLOCK);
+    if(r->buffer == NULL) return -1;
+    r->capacity = READER_BLOCK;
+    return 0;
+}
+
+void reader_open_memory(struct reader *r, const char *data, size_t len)
+{
+    r->fd = -1;
+    r->buffer = (char *)data;
+    r->len = r->capacity = len;
+    r->mapped = false;
+    r->borrowed = true;
+    r->eof = true;
+}
+
+int reader_fill(struct reader *r, size_t keep)
+{
+    if(r->eof) return -1;
+    r->len -= keep;
+    memmove(r->buffer, r->buffer + keep, r->len);
+    // Zachowywane dane zajmują większość bufora (długie słowo) - powiększamy go
+    if(r->capacity - r->len < READER_BLOCK / 2)
+    {
+        char *nb = realloc(r->buffer, r->capacity * 2);
+        if(nb == NULL) return -1;
+        r->buffer = nb;
+        r->capacity *= 2;
+    }
+    while(1)
+    {
+        ssize_t n = read(r->fd, r->buffer + r->len, r->capacity - r->len);
+        if(n > 0)
+        {
+            r->len += n;
+            return 0;
+        }
+        if(n < 0 && errno == EINTR) continue;
+        r->eof = true;
+        return -1;
+    }
+}
+
+void reader_done(struct reader *r)
+{
+    if(r->mapped) munmap(r->buffer, r->capacity);
+    else if(!r->borrowed) free(r->buffer);
+    r->buffer = NULL;
+    r->len = r->capacity = 0;
+}
@@ -0,0 +1,71 @@
+/** @file
+    Interfejs blokowego czytania wejścia.
+
+    Zwykłe pliki są mapowane do pamięci w całości, pozostałe wejścia
+    (potoki, terminale) są czytane dużymi blokami do bufora, który
+    rośnie, gdy trzeba w nim zatrzymać długie słowo.
+    Można też czytać dane, które są już w pamięci (np. z gniazda).
+
+    @ingroup dict-check
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-22
+    @copyright Uniwersytet Warszawski
+  */
+
+#ifndef DICT_CHECK_READER_H
+#define DICT_CHECK_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/// Rozmiar bloku czytanego za jednym razem.
+#define READER_BLOCK (64 * 1024)
+
+/**
+  Stan czytania wejścia.
+  */
+struct reader
+{
+    int fd;             ///< Deskryptor wejścia.
+    char *buffer;       ///< Bufor lub zmapowany plik.
+    size_t len;         ///< Liczba bajtów w buforze.
+    size_t capacity;    ///< Pojemność bufora.
+    bool mapped;        ///< Czy bufor jest zmapowanym plikiem.
+    bool borrowed;      ///< Czy bufor należy do wywołującego.
+    bool eof;           ///< Czy w buforze jest już całe wejście.
+};
+
+/**
+  Zaczyna czytanie wejścia.
+  @param[out] r Stan czytania.
+  @param[in] fd Deskryptor wejścia.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+int reader_open(struct reader *r, int fd);
+
+/**
+  Zaczyna czytanie danych, które są już w pamięci.
+  Dane nie są kopiowane i muszą istnieć aż do reader_done().
+  @param[out] r Stan czytania.
+  @param[in] data Dane.
+  @param[in] len Długość danych w bajtach.
+  */
+void reader_open_memory(struct reader *r, const char *data, size_t len);
+
+/**
+  Dokłada do bufora kolejne dane z wejścia.
+  Bajty przed pozycją `keep` są porzucane, a pozostałe przesuwane
+  na początek bufora, więc wszystkie pozycje w buforze zmniejszają się o `keep`.
+  @param[in,out] r Stan czytania.
+  @param[in] keep Pozycja pierwszego bajtu, który trzeba zachować.
+  @return 0 jeśli dołożono dane, -1 jeśli wejście się skończyło lub wystąpił błąd.
+  */
+int reader_fill(struct reader *r, size_t keep);
+
+/**
+  Kończy czytanie i zwalnia bufor.
+  @param[in,out] r Stan czytania.
+  */
+void reader_done(struct reader *r);
+
+#endif /* DICT_CHECK_READER_H */
@@ -0,0 +1,117 @@
+/** @file
+  Test blokowego czytania wejścia.
+
+  @ingroup dict-check
+  @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+  @copyright Uniwersytet Warszawski
+  @date 2015-06-22
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <cmocka.h>
+#include "reader.h"
+
+/// Testuje czytanie zwykłego pliku, który jest mapowany w całości.
+static void reader_file_test(void **state)
+{
+    FILE *f = tmpfile();
+    assert_true(f != NULL);
+    fputs("ala ma kota", f);
+    fflush(f);
+    struct reader r;
+    assert_int_equal(reader_open(&r, fileno(f)), 0);
+    assert_true(r.mapped);
+    assert_true(r.eof);
+    assert_int_equal(r.len, 11);
+    assert_memory_equal(r.buffer, "ala ma kota", 11);
+    assert_int_equal(reader_fill(&r, 0), -1);
+    reader_done(&r);
+    fclose(f);
+}
+
+/// Testuje czytanie pustego pliku, którego nie da się zmapować.
+static void reader_empty_file_test(void **state)
+{
+    FILE *f = tmpfile();
+    assert_true(f != NULL);
+    struct reader r;
+    assert_int_equal(reader_open(&r, fileno(f)), 0);
+    assert_false(r.mapped);
+    assert_int_equal(r.len, 0);
+    assert_int_equal(reader_fill(&r, 0), -1);
+    assert_true(r.eof);
+    assert_int_equal(r.len, 0);
+    reader_done(&r);
+    fclose(f);
+}
+
+/// Testuje czytanie potoku i porzucanie przeczytanych bajtów.
+static void reader_pipe_test(void **state)
+{
+    int p[2];
+    assert_int_equal(pipe(p), 0);
+    struct reader r;
+    assert_int_equal(reader_open(&r, p[0]), 0);
+    assert_false(r.mapped);
+    assert_int_equal(r.len, 0);
+    assert_int_equal(write(p[1], "abcdef", 6), 6);
+    assert_int_equal(reader_fill(&r, 0), 0);
+    assert_int_equal(r.len, 6);
+    assert_memory_equal(r.buffer, "abcdef", 6);
+    assert_int_equal(write(p[1], "gh", 2), 2);
+    assert_int_equal(reader_fill(&r, 4), 0);
+    assert_int_equal(r.len, 4);
+    assert_memory_equal(r.buffer, "efgh", 4);
+    close(p[1]);
+    assert_int_equal(reader_fill(&r, 0), -1);
+    assert_true(r.eof);
+    assert_int_equal(r.len, 4);
+    assert_memory_equal(r.buffer, "efgh", 4);
+    reader_done(&r);
+    close(p[0]);
+}
+
+/// Testuje powiększanie bufora, gdy trzeba zachować długie słowo.
+static void reader_grow_test(void **state)
+{
+    int p[2];
+    assert_int_equal(pipe(p), 0);
+    struct reader r;
+    assert_int_equal(reader_open(&r, p[0]), 0);
+    size_t len = READER_BLOCK * 5 / 8;
+    char *data = malloc(len);
+    for(size_t i = 0; i < len; i++)
+        data[i] = 'a' + i % 26;
+    assert_int_equal(write(p[1], data, len), len);
+    while(r.len < len)
+        assert_int_equal(reader_fill(&r, 0), 0);
+    assert_int_equal(r.capacity, READER_BLOCK);
+    assert_int_equal(write(p[1], "!", 1), 1);
+    assert_int_equal(reader_fill(&r, 0), 0);
+    assert_int_equal(r.capacity, 2 * READER_BLOCK);
+    assert_int_equal(r.len, len + 1);
+    assert_memory_equal(r.buffer, data, len);
+    assert_int_equal(r.buffer[len], '!');
+    free(data);
+    reader_done(&r);
+    close(p[1]);
+    close(p[0]);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(reader_file_test),
+        cmocka_unit_test(reader_empty_file_test),
+        cmocka_unit_test(reader_pipe_test),
+        cmocka_unit_test(reader_grow_test),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
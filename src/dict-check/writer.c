@@ -0,0 +1,99 @@
+/** @file
+    Implementacja buforowanego wypisywania wyjścia.
+
+    @ingroup dict-check
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-22
+    @copyright Uniwersytet Warszawski
+  */
+
+#include "writer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int writer_init(struct writer *w, FILE *file, size_t capacity)
+{
+    w->file = file;
+    w->len = 0;
+    w->capacity = capacity;
+    w->failed = false;
+    w->buffer = malloc(capacity);
+    return w->buffer == NULL ? -1 : 0;
+}
+
+void writer_write(struct writer *w, const char *data, size_t len)
+{
+    if(len <= w->capacity - w->len)
+    {
+        memcpy(w->buffer + w->len, data, len);
+        w->len += len;
+        return;
+    }
+    if(w->file != NULL && len >= w->capacity)
+    {
+        writer_flush(w);
+        fwrite(data, 1, len, w->file);
+        return;
+    }
+    writer_overflow(w, len);
+    if(len > w->capacity - w->len) return;
+    memcpy(w->buffer + w->len, data, len);
+    w->len += len;
+}
+
+void writer_overflow(struct writer *w, size_t need)
+{
+    if(w->file != NULL)
+    {
+        writer_flush(w);
+        return;
+    }
+    size_t cap = w->capacity;
+    while(cap - w->len < need) cap *= 2;
+    char *nb = realloc(w->buffer, cap);
+    if(nb == NULL)
+    {
+        w->failed = true;
+        return;
+    }
+    w->buffer = nb;
+    w->capacity = cap;
+}
+
+void writer_string(struct writer *w, const char *s)
+{
+    writer_write(w, s, strlen(s));
+}
+
+void writer_int(struct writer *w, long value)
+{
+    char buf[24];
+    char *end = buf + sizeof(buf);
+    char *p = end;
+    unsigned long v = value < 0 ? -(unsigned long)value : (unsigned long)value;
+    do
+    {
+        *--p = '0' + v % 10;
+        v /= 10;
+    }
+    while(v > 0);
+    if(value < 0) *--p = '-';
+    writer_write(w, p, end - p);
+}
+
+void writer_flush(struct writer *w)
+{
+    if(w->file == NULL) return;
+    if(w->len > 0) fwrite(w->buffer, 1, w->len, w->file);
+    w->len = 0;
+    fflush(w->file);
+}
+
+void writer_done(struct writer *w)
+{
+    writer_flush(w);
+    free(w->buffer);
+    w->buffer = NULL;
+    w->capacity = 0;
+}
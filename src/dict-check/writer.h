@@ -0,0 +1,103 @@
+/** @file
+    Interfejs buforowanego wypisywania wyjścia.
+
+    Dane są zbierane w dużym buforze i wypisywane za pomocą jednego
+    wywołania fwrite(), a fragmenty dłuższe niż bufor trafiają
+    do strumienia bezpośrednio. Bufor bez strumienia zbiera
+    wszystkie dane w pamięci.
+
+    @ingroup dict-check
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-22
+    @copyright Uniwersytet Warszawski
+  */
+
+#ifndef DICT_CHECK_WRITER_H
+#define DICT_CHECK_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/// Domyślny rozmiar bufora wyjścia.
+#define WRITER_BUFFER (256 * 1024)
+
+/**
+  Bufor wyjścia.
+  */
+struct writer
+{
+    FILE *file;         ///< Strumień docelowy lub NULL.
+    char *buffer;       ///< Bufor.
+    size_t len;         ///< Liczba bajtów w buforze.
+    size_t capacity;    ///< Pojemność bufora.
+    bool failed;        ///< Czy zabrakło pamięci (tylko bez strumienia).
+};
+
+/**
+  Tworzy bufor wyjścia.
+  @param[out] w Bufor.
+  @param[in] file Strumień docelowy lub NULL, jeśli dane mają zostać w pamięci.
+  @param[in] capacity Pojemność bufora (początkowa, jeśli nie ma strumienia).
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+int writer_init(struct writer *w, FILE *file, size_t capacity);
+
+/**
+  Wypisuje fragment danych.
+  @param[in,out] w Bufor.
+  @param[in] data Dane.
+  @param[in] len Długość danych w bajtach.
+  */
+void writer_write(struct writer *w, const char *data, size_t len);
+
+/**
+  Wypisuje łańcuch znakowy zakończony znakiem '\0'.
+  @param[in,out] w Bufor.
+  @param[in] s Łańcuch.
+  */
+void writer_string(struct writer *w, const char *s);
+
+/**
+  Wypisuje liczbę całkowitą w zapisie dziesiętnym.
+  @param[in,out] w Bufor.
+  @param[in] value Liczba.
+  */
+void writer_int(struct writer *w, long value);
+
+/**
+  Robi miejsce w pełnym buforze: opróżnia go do strumienia
+  albo powiększa, jeśli strumienia nie ma.
+  @param[in,out] w Bufor.
+  @param[in] need Liczba bajtów, które trzeba dopisać.
+  */
+void writer_overflow(struct writer *w, size_t need);
+
+/**
+  Opróżnia bufor do strumienia.
+  @param[in,out] w Bufor.
+  */
+void writer_flush(struct writer *w);
+
+/**
+  Opróżnia i zwalnia bufor.
+  @param[in,out] w Bufor.
+  */
+void writer_done(struct writer *w);
+
+/**
+  Wypisuje jeden bajt.
+  @param[in,out] w Bufor.
+  @param[in] c Bajt.
+  */
+static inline void writer_byte(struct writer *w, char c)
+{
+    if(w->len == w->capacity)
+    {
+        writer_overflow(w, 1);
+        if(w->len == w->capacity) return;
+    }
+    w->buffer[w->len++] = c;
+}
+
+#endif /* DICT_CHECK_WRITER_H */
@@ -0,0 +1,109 @@
+/** @file
+  Test buforowanego wypisywania wyjścia.
+
+  @ingroup dict-check
+  @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+  @copyright Uniwersytet Warszawski
+  @date 2015-06-22
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmocka.h>
+#include "writer.h"
+
+/**
+  Zwraca zawartość pliku.
+  @param[in] f Plik.
+  @param[out] buffer Bufor.
+  @param[in] size Rozmiar bufora.
+  @return Liczba przeczytanych bajtów.
+  */
+static size_t contents(FILE *f, char *buffer, size_t size)
+{
+    rewind(f);
+    size_t n = fread(buffer, 1, size, f);
+    fseek(f, 0, SEEK_END);
+    return n;
+}
+
+/// Testuje, czy dane trafiają do strumienia dopiero przy opróżnianiu bufora.
+static void writer_buffer_test(void **state)
+{
+    FILE *f = tmpfile();
+    assert_true(f != NULL);
+    struct writer w;
+    assert_int_equal(writer_init(&w, f, 16), 0);
+    writer_string(&w, "ala");
+    writer_byte(&w, ' ');
+    writer_write(&w, "ma", 2);
+    char buffer[64];
+    assert_int_equal(contents(f, buffer, sizeof(buffer)), 0);
+    assert_int_equal(w.len, 6);
+    writer_flush(&w);
+    assert_int_equal(w.len, 0);
+    assert_int_equal(contents(f, buffer, sizeof(buffer)), 6);
+    assert_memory_equal(buffer, "ala ma", 6);
+    writer_done(&w);
+    fclose(f);
+}
+
+/// Testuje zachowanie kolejności fragmentów, które nie mieszczą się w buforze.
+static void writer_overflow_test(void **state)
+{
+    FILE *f = tmpfile();
+    assert_true(f != NULL);
+    struct writer w;
+    assert_int_equal(writer_init(&w, f, 8), 0);
+    writer_string(&w, "abcde");
+    writer_string(&w, "fghij");
+    assert_int_equal(w.len, 5);
+    writer_string(&w, "0123456789");
+    assert_int_equal(w.len, 0);
+    for(int i = 0; i < 10; i++)
+        writer_byte(&w, 'A' + i);
+    writer_done(&w);
+    char buffer[64];
+    assert_int_equal(contents(f, buffer, sizeof(buffer)), 30);
+    assert_memory_equal(buffer, "abcdefghij0123456789ABCDEFGHIJ", 30);
+    fclose(f);
+}
+
+/// Testuje wypisywanie liczb.
+static void writer_int_test(void **state)
+{
+    FILE *f = tmpfile();
+    assert_true(f != NULL);
+    struct writer w;
+    assert_int_equal(writer_init(&w, f, 64), 0);
+    writer_int(&w, 0);
+    writer_byte(&w, ' ');
+    writer_int(&w, 1234);
+    writer_byte(&w, ' ');
+    writer_int(&w, -56);
+    writer_byte(&w, ' ');
+    writer_int(&w, LONG_MIN);
+    writer_done(&w);
+    char expected[64];
+    char buffer[64];
+    int n = snprintf(expected, sizeof(expected), "0 1234 -56 %ld", LONG_MIN);
+    assert_int_equal(contents(f, buffer, sizeof(buffer)), n);
+    assert_memory_equal(buffer, expected, n);
+    fclose(f);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(writer_buffer_test),
+        cmocka_unit_test(writer_overflow_test),
+        cmocka_unit_test(writer_int_test),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -33,10 +33,16 @@ enum Command {
     DELETE,
     FIND,
     HINTS,
+    FREQUENCY,
     SAVE,
     LOAD,
+    MERGE,
+    SUBTRACT,
+    INTERSECT,
+    DIFF,
     QUIT,
     CLEAR,
+    INDEX,
     COMMANDS_COUNT };
 
 
@@ -49,10 +55,16 @@ static const char *commands[] =
     "delete",
     "find",
     "hints",
+    "frequency",
     "save",
     "load",
+    "merge",
+    "subtract",
+    "intersect",
+    "diff",
     "quit",
-    "clear"
+    "clear",
+    "index"
 };
 
 /** Maksymalna długość komendy.
@@ -68,6 +80,9 @@ static const char *commands[] =
   */
 #define MAX_FILE_LENGTH 511
 
+/** Rozmiar bufora na nazwę pliku (z miejscem na przyrostek pliku indeksu). */
+#define FILE_BUFFER (MAX_FILE_LENGTH + sizeof(DICTIONARY_INDEX_SUFFIX))
+
 
 /** Wczytuje wejście do napotkania znaku nowej linii.
   */
@@ -161,6 +176,20 @@ static int dict_command(struct dictionary **dict, enum Command c)
                 word_list_done(&list);
                 break;
             }
+        case FREQUENCY:
+            {
+                unsigned int freq;
+                if (scanf("%u", &freq) <= 0)
+                {
+                    fprintf(stderr, "Failed to read frequency\n");
+                    return ignored();
+                }
+                if (dictionary_set_frequency(*dict, word, freq))
+                    printf("frequency: %ls %u\n", word, dictionary_frequency(*dict, word));
+                else
+                    return ignored();
+                break;
+            }
         default:
             assert(false);
     }
@@ -176,7 +205,7 @@ static int dict_command(struct dictionary **dict, enum Command c)
  */
 static int file_command(struct dictionary **dict, enum Command c) 
 {
-    char filename[MAX_FILE_LENGTH+1];
+    char filename[FILE_BUFFER];
     if (scanf("%" xstr(MAX_FILE_LENGTH) "s", filename) <= 0)
     {
         fprintf(stderr, "Failed to read filename\n");
@@ -194,6 +223,18 @@ static int file_command(struct dictionary **dict, enum Command c)
                 }
                 fclose(f);
                 printf("dictionary saved in file %s\n", filename);
+                if (dictionary_has_index(*dict))
+                {
+                    strcat(filename, DICTIONARY_INDEX_SUFFIX);
+                    f = fopen(filename, "wb");
+                    if (!f || dictionary_index_save(*dict, f))
+                    {
+                        fprintf(stderr, "Failed to save index\n");
+                        exit(1);
+                    }
+                    fclose(f);
+                    printf("index saved in file %s\n", filename);
+                }
                 break;
             }
         case LOAD:
@@ -209,6 +250,54 @@ static int file_command(struct dictionary **dict, enum Command c)
                 printf("dictionary loaded from file %s\n", filename);
                 dictionary_done(*dict);
                 *dict = new_dict;
+                // Indeks zapisany obok słownika jest opcjonalny
+                strcat(filename, DICTIONARY_INDEX_SUFFIX);
+                if (dictionary_index_load(*dict, filename) == 0)
+                    printf("index loaded from file %s\n", filename);
+                break;
+            }
+        case MERGE:
+        case SUBTRACT:
+        case INTERSECT:
+        case DIFF:
+            {
+                FILE *f = fopen(filename, "r");
+                struct dictionary *other, *new_dict;
+                const char *message;
+                if (!f || !(other = dictionary_load(f)))
+                {
+                    fprintf(stderr, "Failed to load dictionary\n");
+                    exit(1);
+                }
+                fclose(f);
+                switch (c)
+                {
+                    case MERGE:
+                        new_dict = dictionary_merge(*dict, other);
+                        message = "dictionary merged with file %s\n";
+                        break;
+                    case SUBTRACT:
+                        new_dict = dictionary_subtract(*dict, other);
+                        message = "file %s subtracted from dictionary\n";
+                        break;
+                    case INTERSECT:
+                        new_dict = dictionary_intersect(*dict, other);
+                        message = "dictionary intersected with file %s\n";
+                        break;
+                    default:
+                        new_dict = dictionary_diff(*dict, other);
+                        message = "dictionary diffed with file %s\n";
+                        break;
+                }
+                dictionary_done(other);
+                if (!new_dict)
+                {
+                    fprintf(stderr, "Failed to combine dictionaries\n");
+                    exit(1);
+                }
+                dictionary_done(*dict);
+                *dict = new_dict;
+                printf(message, filename);
                 break;
             }
         default:
@@ -255,6 +344,17 @@ int try_process_command(struct dictionary **dict)
         skip_line();
         return 1;
     }
+    else if (c == INDEX)
+    {
+        if (dictionary_index_build(*dict))
+        {
+            fprintf(stderr, "Failed to build index\n");
+            exit(1);
+        }
+        printf("indexed\n");
+        skip_line();
+        return 1;
+    }
     else if (c < SAVE)
     {
         return dict_command(dict, c);
@@ -0,0 +1,202 @@
+/** @defgroup dict-export Moduł dict-export
+    Program wypisujący słowa słownika.
+  */
+/** @file
+    Główny plik modułu dict-export
+    @ingroup dict-export
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-28
+    @copyright Uniwersytet Warszawski
+  */
+
+#include "dictionary.h"
+#include "utf8.h"
+#include <locale.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/// Rozmiar bufora standardowego wyjścia.
+#define OUTPUT_BUFFER (1 << 16)
+
+/**
+ * Stany parsowania lini komend.
+ */
+enum ProgramOptionsParsingState
+{
+    PositionalParameters,
+    PrefixParameter,
+    FromParameter,
+    ToParameter
+};
+
+/**
+  Wypisuje sposób użycia programu.
+  @param[in] name Nazwa programu.
+  */
+static void usage(const char *name)
+{
+    printf(" %s [-f] [-p <prefix>] <dictionary file>\n", name);
+    printf(" %s [-f] [--from <first word>] [--to <word after last>] <dictionary file>\n", name);
+}
+
+/**
+  Zamienia słowo z UTF-8 na `wchar_t`.
+  @param[in] word Słowo w UTF-8.
+  @return Słowo (do zwolnienia przez free()) lub NULL,
+  jeśli słowo nie jest poprawnym UTF-8 albo brakło pamięci.
+  */
+static wchar_t * decode_word(const char *word)
+{
+    size_t len = strlen(word);
+    wchar_t *w = malloc((len + 1) * sizeof(wchar_t));
+    if(w == NULL) return NULL;
+    size_t n = 0;
+    while(len > 0)
+    {
+        size_t l = utf8_decode(word, len, &w[n++]);
+        if(l == 0)
+        {
+            free(w);
+            return NULL;
+        }
+        word += l;
+        len -= l;
+    }
+    w[n] = 0;
+    return w;
+}
+
+/**
+  Wypisuje słowo w UTF-8.
+  @param[in] word Słowo.
+  @param[in] freq Częstość słowa.
+  @param[in] with_freq Czy wypisać częstość.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+static int write_word(const wchar_t *word, unsigned int freq, bool with_freq)
+{
+    char buffer[UTF8_MAX_LENGTH];
+    for(; *word != 0; word++)
+    {
+        size_t l = utf8_encode(*word, buffer);
+        if(fwrite(buffer, 1, l, stdout) != l) return -1;
+    }
+    if(with_freq && printf("\t%u", freq) < 0) return -1;
+    return putchar('\n') == EOF ? -1 : 0;
+}
+
+/**
+  Funkcja main.
+  @param[in] argc Liczba parametrów linii komend
+  @param[in] argv Lista argumentów linii komend
+  @return 0 jeśli program zakończył się powodzeniem, 1 jeśli nastąpił błąd
+ */
+int main(int argc, char *argv[])
+{
+    setlocale(LC_ALL, "pl_PL.UTF-8");
+    
+    // Opcje linii komend
+    bool with_freq = false;
+    char *dictfile = NULL;
+    const char *prefix = NULL, *from = NULL, *to = NULL;
+    enum ProgramOptionsParsingState pars = PositionalParameters;
+    for(int i = 1; i < argc; i++)
+    {
+        switch(pars)
+        {
+            case PositionalParameters:
+            {
+                if(strcmp("-f", argv[i]) == 0) with_freq = true;
+                else if(strcmp("-p", argv[i]) == 0) pars = PrefixParameter;
+                else if(strcmp("--from", argv[i]) == 0) pars = FromParameter;
+                else if(strcmp("--to", argv[i]) == 0) pars = ToParameter;
+                else if(argv[i][0] == '-' && argv[i][1] != 0)
+                {
+                    printf("Unknown command line option.\n");
+                    usage(argv[0]);
+                    return 1;
+                }
+                else if(dictfile == NULL) dictfile = argv[i];
+                else
+                {
+                    printf("Too many dictionary files.\n");
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            }
+            case PrefixParameter:
+                prefix = argv[i];
+                pars = PositionalParameters;
+                break;
+            case FromParameter:
+                from = argv[i];
+                pars = PositionalParameters;
+                break;
+            case ToParameter:
+                to = argv[i];
+                pars = PositionalParameters;
+                break;
+        }
+    }
+    if(pars != PositionalParameters)
+    {
+        printf("Missing option value.\n");
+        usage(argv[0]);
+        return 1;
+    }
+    if(prefix != NULL && (from != NULL || to != NULL))
+    {
+        printf("Prefix cannot be used with a range.\n");
+        usage(argv[0]);
+        return 1;
+    }
+    if(dictfile == NULL)
+    {
+        printf("Dictionary file not specified.\n");
+        usage(argv[0]);
+        return 1;
+    }
+    wchar_t *wprefix = NULL, *wfrom = NULL, *wto = NULL;
+    if((prefix != NULL && (wprefix = decode_word(prefix)) == NULL)
+       || (from != NULL && (wfrom = decode_word(from)) == NULL)
+       || (to != NULL && (wto = decode_word(to)) == NULL))
+    {
+        printf("Invalid word in command line.\n");
+        return 1;
+    }
+
+    FILE *fdict = fopen(dictfile, "rb");
+    if(fdict == NULL)
+    {
+        printf("Could not open dictionary file: %s\n", dictfile);
+        return 1;
+    }
+    struct dictionary *dict = dictionary_load(fdict);
+    fclose(fdict);
+    if(dict == NULL)
+    {
+        printf("Could not parse dictionary file.\n");
+        return 1;
+    }
+
+    struct dictionary_iter *iter = prefix != NULL ? dictionary_iter_begin(dict, wprefix)
+                                                  : dictionary_iter_range(dict, wfrom, wto);
+    int r = iter == NULL ? -1 : 0;
+    setvbuf(stdout, NULL, _IOFBF, OUTPUT_BUFFER);
+    const wchar_t *word;
+    unsigned int freq;
+    while(r == 0 && (r = dictionary_iter_next(iter, &word, &freq)) > 0)
+        r = write_word(word, freq, with_freq);
+    if(fflush(stdout) == EOF) r = -1;
+    if(r < 0) fprintf(stderr, "Could not export dictionary.\n");
+    if(iter != NULL) dictionary_iter_done(iter);
+    dictionary_done(dict);
+    free(wprefix);
+    free(wfrom);
+    free(wto);
+    return r < 0 ? 1 : 0;
+}
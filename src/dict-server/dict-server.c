@@ -0,0 +1,475 @@
+/** @defgroup dict-server Moduł dict-server
+    Serwer słownikowy.
+    Wczytuje słowniki raz i odpowiada na zapytania klientów
+    przez gniazdo uniksowe (protokół opisany w protocol.h).
+  */
+/** @file
+    Główny plik modułu dict-server
+    @ingroup dict-server
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-24
+    @copyright Uniwersytet Warszawski
+  */
+
+#include "checker.h"
+#include "dictionary.h"
+#include "letters.h"
+#include "protocol.h"
+#include "reader.h"
+#include "utf8.h"
+#include "writer.h"
+#include <errno.h>
+#include <limits.h>
+#include <locale.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/// Domyślna liczba wątków obsługujących połączenia.
+#define SERVER_DEFAULT_THREADS 4
+
+/// Rozmiar buforów wyjścia przy sprawdzaniu tekstu.
+#define SERVER_WRITER_BUFFER (16 * 1024)
+
+/**
+ * Stany parsowania lini komend.
+ */
+enum ProgramOptionsParsingState
+{
+    PositionalParameters,
+    ThreadsParameter,
+    MemoLimitParameter
+};
+
+/**
+  Wątek obsługujący połączenia.
+  */
+struct worker
+{
+    pthread_t thread;           ///< Wątek.
+    struct server *server;      ///< Serwer.
+    struct checker *checkers;   ///< Stan sprawdzania dla każdego słownika i trybu sprawdzania.
+    int fd;                     ///< Obsługiwane połączenie lub -1.
+};
+
+/**
+  Stan serwera.
+  */
+struct server
+{
+    struct dictionary **dicts;  ///< Wczytane słowniki (tylko do odczytu).
+    size_t dicts_no;            ///< Liczba słowników.
+    pthread_mutex_t lock;       ///< Blokada kolejki i pól `fd` wątków.
+    pthread_cond_t cond;        ///< Zmienna warunkowa kolejki.
+    int *queue;                 ///< Kolejka (cykliczna) przyjętych połączeń.
+    size_t queue_head;          ///< Początek kolejki.
+    size_t queue_len;           ///< Liczba połączeń w kolejce.
+    size_t queue_cap;           ///< Pojemność kolejki.
+    bool stop;                  ///< Czy kończyć pracę.
+};
+
+/// Ustawiane przez obsługę sygnałów kończących pracę.
+static volatile sig_atomic_t stopping = 0;
+
+/** @name Funkcje pomocnicze
+ * @{
+ */
+
+/**
+  Obsługa sygnałów SIGINT i SIGTERM.
+  @param[in] sig Numer sygnału.
+  */
+static void on_signal(int sig)
+{
+    (void)sig;
+    stopping = 1;
+}
+
+/**
+  Wypisuje sposób użycia programu.
+  @param[in] name Nazwa programu.
+  */
+static void usage(const char *name)
+{
+    printf(" %s [-t <threads>] [-m <memo limit in MB>] <socket> <dictionary file>...\n", name);
+}
+
+/**
+  Wstawia połączenie do kolejki.
+  @param[in,out] s Serwer.
+  @param[in] fd Połączenie.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+static int queue_push(struct server *s, int fd)
+{
+    pthread_mutex_lock(&s->lock);
+    if(s->queue_len == s->queue_cap)
+    {
+        size_t cap = s->queue_cap == 0 ? 16 : s->queue_cap * 2;
+        int *q = malloc(cap * sizeof(int));
+        if(q == NULL)
+        {
+            pthread_mutex_unlock(&s->lock);
+            return -1;
+        }
+        for(size_t i = 0; i < s->queue_len; i++)
+            q[i] = s->queue[(s->queue_head + i) % s->queue_cap];
+        free(s->queue);
+        s->queue = q;
+        s->queue_head = 0;
+        s->queue_cap = cap;
+    }
+    s->queue[(s->queue_head + s->queue_len) % s->queue_cap] = fd;
+    s->queue_len++;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    return 0;
+}
+
+/**
+  Wyjmuje połączenie z kolejki i oznacza je jako obsługiwane przez wątek.
+  Czeka, jeśli kolejka jest pusta.
+  @param[in,out] w Wątek.
+  @return Połączenie lub -1, jeśli serwer kończy pracę.
+  */
+static int queue_pop(struct worker *w)
+{
+    struct server *s = w->server;
+    pthread_mutex_lock(&s->lock);
+    while(s->queue_len == 0 && !s->stop)
+        pthread_cond_wait(&s->cond, &s->lock);
+    int fd = -1;
+    if(!s->stop)
+    {
+        fd = s->queue[s->queue_head];
+        s->queue_head = (s->queue_head + 1) % s->queue_cap;
+        s->queue_len--;
+    }
+    w->fd = fd;
+    pthread_mutex_unlock(&s->lock);
+    return fd;
+}
+
+/**
+  Sprawdza, czy słowo z zapytania jest poprawnym tekstem w UTF-8
+  bez znaków '\0' (tak jak przy podpowiedziach).
+  @param[in] word Słowo.
+  @param[in] len Długość słowa w bajtach.
+  @return Czy słowo jest poprawne.
+  */
+static bool valid_word(const char *word, size_t len)
+{
+    while(len > 0)
+    {
+        wchar_t c;
+        size_t l = utf8_decode(word, len, &c);
+        if(l == 0 || c == 0) return false;
+        word += l;
+        len -= l;
+    }
+    return true;
+}
+
+/**
+  Odpowiada na zapytanie PROTOCOL_CHECK.
+  @param[in,out] checkers Stany sprawdzania dla słownika (po jednym na tryb sprawdzania).
+  @param[in,out] c Połączenie.
+  @param[in] f Zapytanie.
+  @return 0 jeśli się udało, -1 jeśli brakło pamięci.
+  */
+static int answer_check(struct checker *checkers, struct protocol_conn *c,
+        const struct protocol_frame *f)
+{
+    struct check_options opts;
+    opts.verbose = f->flags & PROTOCOL_VERBOSE;
+    opts.echo = !(f->flags & PROTOCOL_NO_ECHO);
+    opts.format = f->flags & PROTOCOL_JSONL ? CHECK_JSONL
+                : f->flags & PROTOCOL_TSV ? CHECK_TSV : CHECK_PLAIN;
+    struct reader in;
+    struct writer out, err;
+    int r = -1;
+    err.buffer = NULL;
+    if(writer_init(&out, NULL, SERVER_WRITER_BUFFER) < 0
+       || writer_init(&err, NULL, SERVER_WRITER_BUFFER) < 0) goto done;
+    reader_open_memory(&in, f->payload, f->len);
+    r = checker_run(&checkers[check_mode(&opts)], &opts, NULL, &in, &out, &err) < 0 ? -1 : 0;
+    reader_done(&in);
+    if(out.failed || err.failed) r = -1;
+    if(r == 0)
+    {
+        if(protocol_begin(c, PROTOCOL_CHECK, f->dict, f->flags) < 0
+           || protocol_append_u32(c, out.len) < 0
+           || protocol_append(c, out.buffer, out.len) < 0
+           || protocol_append(c, err.buffer, err.len) < 0
+           || protocol_end(c) < 0)
+            r = -1;
+    }
+done:
+    if(out.buffer != NULL) writer_done(&out);
+    if(err.buffer != NULL) writer_done(&err);
+    return r;
+}
+
+/**
+  Odpowiada na zapytanie.
+  @param[in] s Serwer.
+  @param[in,out] checkers Stany sprawdzania wątku.
+  @param[in,out] c Połączenie.
+  @param[in] f Zapytanie.
+  @return 0 jeśli się udało, -1 jeśli nie udało się zbudować odpowiedzi.
+  */
+static int answer(struct server *s, struct checker *checkers, struct protocol_conn *c,
+        const struct protocol_frame *f)
+{
+    static const char no_dict[] = "no such dictionary";
+    static const char bad_word[] = "invalid word";
+    static const char bad_type[] = "unknown request";
+    static const char no_memory[] = "out of memory";
+    if(f->dict >= s->dicts_no)
+        return protocol_send(c, PROTOCOL_ERROR, f->dict, 0, no_dict, strlen(no_dict));
+    const struct dictionary *dict = s->dicts[f->dict];
+    switch(f->type)
+    {
+        case PROTOCOL_FIND:
+        {
+            if(!valid_word(f->payload, f->len))
+                return protocol_send(c, PROTOCOL_ERROR, f->dict, 0, bad_word, strlen(bad_word));
+            char found = dictionary_find_utf8(dict, f->payload, f->len);
+            return protocol_send(c, PROTOCOL_FIND, f->dict, 0, &found, 1);
+        }
+        case PROTOCOL_HINTS:
+        {
+            char *list;
+            size_t len;
+            int r = dictionary_hints_utf8(dict, f->payload, f->len, &list, &len);
+            if(r >= 0) r = protocol_send(c, PROTOCOL_HINTS, f->dict, 0, list, len);
+            else r = protocol_send(c, PROTOCOL_ERROR, f->dict, 0, bad_word, strlen(bad_word));
+            free(list);
+            return r;
+        }
+        case PROTOCOL_CHECK:
+        {
+            if(answer_check(&checkers[f->dict * CHECK_MODES], c, f) == 0) return 0;
+            return protocol_send(c, PROTOCOL_ERROR, f->dict, 0, no_memory, strlen(no_memory));
+        }
+        default:
+            return protocol_send(c, PROTOCOL_ERROR, f->dict, 0, bad_type, strlen(bad_type));
+    }
+}
+
+/**
+  Obsługuje połączenie aż do jego zamknięcia.
+  @param[in] s Serwer.
+  @param[in,out] checkers Stany sprawdzania wątku.
+  @param[in] fd Połączenie.
+  */
+static void serve(struct server *s, struct checker *checkers, int fd)
+{
+    struct protocol_conn c;
+    struct protocol_frame f;
+    if(protocol_init(&c, fd) < 0) return;
+    while(protocol_next(&c, &f) == 1)
+    {
+        if(answer(s, checkers, &c, &f) < 0) break;
+    }
+    protocol_flush(&c);
+    protocol_done(&c);
+}
+
+/**
+  Pętla wątku obsługującego połączenia.
+  @param[in] arg Wątek (struct worker).
+  @return NULL.
+  */
+static void * worker_main(void *arg)
+{
+    struct worker *w = arg;
+    int fd;
+    while((fd = queue_pop(w)) >= 0)
+    {
+        serve(w->server, w->checkers, fd);
+        pthread_mutex_lock(&w->server->lock);
+        w->fd = -1;
+        pthread_mutex_unlock(&w->server->lock);
+        close(fd);
+    }
+    return NULL;
+}
+
+/**
+ * @}
+ */
+
+/**
+  Funkcja main.
+  @param[in] argc Liczba parametrów linii komend
+  @param[in] argv Lista argumentów linii komend
+  @return 0 jeśli program zakończył się powodzeniem, 1 jeśli nastąpił błąd
+ */
+int main(int argc, char *argv[])
+{
+    setlocale(LC_ALL, "pl_PL.UTF-8");
+
+    // Opcje linii komend
+    unsigned long threads = SERVER_DEFAULT_THREADS;
+    size_t memo_limit = MEMO_DEFAULT_LIMIT;
+    char *path = NULL;
+    char **dictfiles = malloc(argc * sizeof(char *));
+    size_t dicts_no = 0;
+    enum ProgramOptionsParsingState pars = PositionalParameters;
+    for(int i = 1; i < argc; i++)
+    {
+        switch(pars)
+        {
+            case PositionalParameters:
+            {
+                if(strcmp("-t", argv[i]) == 0) pars = ThreadsParameter;
+                else if(strcmp("-m", argv[i]) == 0) pars = MemoLimitParameter;
+                else if(path == NULL) path = argv[i];
+                else dictfiles[dicts_no++] = argv[i];
+                break;
+            }
+            case ThreadsParameter:
+            case MemoLimitParameter:
+            {
+                char *end;
+                unsigned long v = strtoul(argv[i], &end, 10);
+                if(*argv[i] == 0 || *end != 0 || (pars == ThreadsParameter && v == 0))
+                {
+                    printf("Invalid option value: %s\n", argv[i]);
+                    usage(argv[0]);
+                    return 1;
+                }
+                if(pars == ThreadsParameter) threads = v;
+                else memo_limit = v;
+                pars = PositionalParameters;
+                break;
+            }
+        }
+    }
+    if(pars != PositionalParameters || path == NULL || dicts_no == 0)
+    {
+        printf("Socket or dictionary files not specified.\n");
+        usage(argv[0]);
+        return 1;
+    }
+    if(dicts_no > UCHAR_MAX + 1)
+    {
+        printf("Too many dictionaries.\n");
+        return 1;
+    }
+
+    // Wczytywanie słowników
+    struct server s;
+    s.dicts = malloc(dicts_no * sizeof(struct dictionary *));
+    s.dicts_no = dicts_no;
+    for(size_t i = 0; i < dicts_no; i++)
+    {
+        FILE *fdict = fopen(dictfiles[i], "rb");
+        if(fdict == NULL)
+        {
+            printf("Could not open dictionary file: %s\n", dictfiles[i]);
+            return 1;
+        }
+        s.dicts[i] = dictionary_load(fdict);
+        fclose(fdict);
+        if(s.dicts[i] == NULL)
+        {
+            printf("Could not parse dictionary file: %s\n", dictfiles[i]);
+            return 1;
+        }
+        // Indeks podpowiedzi obok słownika jest opcjonalny
+        char *findex = malloc(strlen(dictfiles[i]) + sizeof(DICTIONARY_INDEX_SUFFIX));
+        if(findex != NULL)
+        {
+            strcat(strcpy(findex, dictfiles[i]), DICTIONARY_INDEX_SUFFIX);
+            dictionary_index_load(s.dicts[i], findex);
+            free(findex);
+        }
+    }
+    free(dictfiles);
+    letters_init();
+
+    // Gniazdo i sygnały
+    int lfd = protocol_listen(path);
+    if(lfd < 0)
+    {
+        printf("Could not listen on socket: %s\n", path);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // Wątki
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.cond, NULL);
+    s.queue = NULL;
+    s.queue_head = s.queue_len = s.queue_cap = 0;
+    s.stop = false;
+    struct worker *workers = malloc(threads * sizeof(struct worker));
+    for(size_t i = 0; i < threads; i++)
+    {
+        workers[i].server = &s;
+        workers[i].fd = -1;
+        workers[i].checkers = malloc(dicts_no * CHECK_MODES * sizeof(struct checker));
+        for(size_t j = 0; j < dicts_no * CHECK_MODES; j++)
+        {
+            if(checker_init(&workers[i].checkers[j], s.dicts[j / CHECK_MODES],
+                            memo_limit * 1024 * 1024 / (dicts_no * CHECK_MODES)) < 0)
+            {
+                printf("Out of memory.\n");
+                return 1;
+            }
+        }
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+
+    // Przyjmowanie połączeń
+    while(!stopping)
+    {
+        int fd = accept(lfd, NULL, NULL);
+        if(fd < 0)
+        {
+            if(errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept");
+            break;
+        }
+        if(queue_push(&s, fd) < 0) close(fd);
+    }
+
+    // Kończenie pracy: przerywamy obsługiwane połączenia i czekamy na wątki
+    close(lfd);
+    unlink(path);
+    pthread_mutex_lock(&s.lock);
+    s.stop = true;
+    for(size_t i = 0; i < threads; i++)
+        if(workers[i].fd >= 0) shutdown(workers[i].fd, SHUT_RD);
+    pthread_cond_broadcast(&s.cond);
+    pthread_mutex_unlock(&s.lock);
+    for(size_t i = 0; i < threads; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        for(size_t j = 0; j < dicts_no * CHECK_MODES; j++)
+            checker_done(&workers[i].checkers[j]);
+        free(workers[i].checkers);
+    }
+    free(workers);
+    for(size_t i = 0; i < s.queue_len; i++)
+        close(s.queue[(s.queue_head + i) % s.queue_cap]);
+    free(s.queue);
+    pthread_cond_destroy(&s.cond);
+    pthread_mutex_destroy(&s.lock);
+    for(size_t i = 0; i < dicts_no; i++)
+        dictionary_done(s.dicts[i]);
+    free(s.dicts);
+    return 0;
+}
@@ -0,0 +1,295 @@
+/** @file
+  Test serwera słownikowego.
+
+  Uruchamia program dict-server (ścieżka w pierwszym argumencie)
+  ze słownikiem zapisanym w katalogu tymczasowym i wysyła mu zapytania
+  przez gniazdo.
+
+  @ingroup dict-server
+  @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+  @copyright Uniwersytet Warszawski
+  @date 2015-06-24
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <locale.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cmocka.h>
+#include "dictionary.h"
+#include "protocol.h"
+
+/// Ścieżka programu dict-server.
+static const char *server_path;
+
+/// Katalog tymczasowy ze słownikiem i gniazdem.
+static char dir[] = "/tmp/dict-server-test.XXXXXX";
+
+/// Ścieżka pliku słownika.
+static char dict_path[sizeof(dir) + 16];
+
+/// Ścieżka gniazda.
+static char socket_path[sizeof(dir) + 16];
+
+/// Proces serwera.
+static pid_t server_pid = -1;
+
+/**
+  Zapisuje słownik testowy i uruchamia serwer.
+  @param[in] state Nieużywany.
+  @return 0 jeśli serwer przyjmuje połączenia, -1 w p.p.
+  */
+static int server_start(void **state)
+{
+    setlocale(LC_ALL, "pl_PL.UTF-8");
+    if(mkdtemp(dir) == NULL) return -1;
+    sprintf(dict_path, "%s/test.dict", dir);
+    sprintf(socket_path, "%s/socket", dir);
+    struct dictionary *dict = dictionary_new();
+    dictionary_insert(dict, L"ala");
+    dictionary_insert(dict, L"ma");
+    dictionary_insert(dict, L"kota");
+    dictionary_insert(dict, L"lan");
+    dictionary_insert(dict, L"lon");
+    dictionary_insert(dict, L"dom");
+    dictionary_rule_add(dict, L"0", L"1", false, 1, RULE_NORMAL);
+    dictionary_hints_max_cost(dict, 1);
+    FILE *f = fopen(dict_path, "w");
+    if(f == NULL) return -1;
+    int r = dictionary_save(dict, f);
+    fclose(f);
+    dictionary_done(dict);
+    if(r < 0) return -1;
+
+    server_pid = fork();
+    if(server_pid < 0) return -1;
+    if(server_pid == 0)
+    {
+        execl(server_path, server_path, "-t", "2", socket_path, dict_path, (char *)NULL);
+        _exit(127);
+    }
+    // Czekamy, aż serwer wczyta słownik i zacznie nasłuchiwać
+    for(int i = 0; i < 500; i++)
+    {
+        int fd = protocol_connect(socket_path);
+        if(fd >= 0)
+        {
+            close(fd);
+            return 0;
+        }
+        usleep(10000);
+    }
+    return -1;
+}
+
+/**
+  Zatrzymuje serwer i usuwa katalog tymczasowy.
+  @param[in] state Nieużywany.
+  @return 0 jeśli serwer zakończył pracę poprawnie, -1 w p.p.
+  */
+static int server_stop(void **state)
+{
+    int status = -1;
+    if(server_pid > 0)
+    {
+        kill(server_pid, SIGTERM);
+        waitpid(server_pid, &status, 0);
+    }
+    unlink(socket_path);
+    unlink(dict_path);
+    rmdir(dir);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+/**
+  Łączy się z serwerem.
+  @param[out] c Połączenie.
+  */
+static void connect_server(struct protocol_conn *c)
+{
+    int fd = protocol_connect(socket_path);
+    assert_true(fd >= 0);
+    assert_int_equal(protocol_init(c, fd), 0);
+}
+
+/**
+  Zamyka połączenie z serwerem.
+  @param[in,out] c Połączenie.
+  */
+static void disconnect_server(struct protocol_conn *c)
+{
+    close(c->fd);
+    protocol_done(c);
+}
+
+/**
+  Odbiera odpowiedź i porównuje ją z oczekiwaną.
+  @param[in,out] c Połączenie.
+  @param[in] type Oczekiwany typ ramki.
+  @param[in] data Oczekiwane dane.
+  @param[in] len Długość oczekiwanych danych.
+  */
+static void expect(struct protocol_conn *c, unsigned char type, const char *data, size_t len)
+{
+    struct protocol_frame f;
+    assert_int_equal(protocol_next(c, &f), 1);
+    assert_int_equal(f.type, type);
+    assert_int_equal(f.len, len);
+    assert_memory_equal(f.payload, data, len);
+}
+
+/// Oczekiwana odpowiedź na błędne słowo.
+#define BAD_WORD "invalid word"
+
+/// Testuje zapytania o słowa.
+static void server_find_test(void **state)
+{
+    struct protocol_conn c;
+    connect_server(&c);
+    assert_int_equal(protocol_send(&c, PROTOCOL_FIND, 0, 0, "ala", 3), 0);
+    expect(&c, PROTOCOL_FIND, "\1", 1);
+    assert_int_equal(protocol_send(&c, PROTOCOL_FIND, 0, 0, "kot", 3), 0);
+    expect(&c, PROTOCOL_FIND, "\0", 1);
+    assert_int_equal(protocol_send(&c, PROTOCOL_FIND, 0, 0, "al\xc5", 3), 0);
+    expect(&c, PROTOCOL_ERROR, BAD_WORD, strlen(BAD_WORD));
+    assert_int_equal(protocol_send(&c, PROTOCOL_FIND, 0, 0, "al\0a", 4), 0);
+    expect(&c, PROTOCOL_ERROR, BAD_WORD, strlen(BAD_WORD));
+    assert_int_equal(protocol_send(&c, PROTOCOL_FIND, 1, 0, "ala", 3), 0);
+    expect(&c, PROTOCOL_ERROR, "no such dictionary", 18);
+    disconnect_server(&c);
+}
+
+/// Testuje zapytania o podpowiedzi.
+static void server_hints_test(void **state)
+{
+    struct protocol_conn c;
+    connect_server(&c);
+    assert_int_equal(protocol_send(&c, PROTOCOL_HINTS, 0, 0, "len", 3), 0);
+    expect(&c, PROTOCOL_HINTS, "lan\0lon", 8);
+    assert_int_equal(protocol_send(&c, PROTOCOL_HINTS, 0, 0, "xyzw", 4), 0);
+    expect(&c, PROTOCOL_HINTS, "", 0);
+    assert_int_equal(protocol_send(&c, PROTOCOL_HINTS, 0, 0, "\xff", 1), 0);
+    expect(&c, PROTOCOL_ERROR, BAD_WORD, strlen(BAD_WORD));
+    disconnect_server(&c);
+}
+
+/// Testuje sprawdzanie tekstu.
+static void server_check_test(void **state)
+{
+    static const char text[] = "ala ma kot\nlen\n";
+    static const char out[] = "ala ma #kot\n#len\n";
+    static const char hints[] = "1,8 kot: \n2,1 len: lan lon\n";
+    struct protocol_conn c;
+    connect_server(&c);
+    assert_int_equal(protocol_send(&c, PROTOCOL_CHECK, 0, 0, text, strlen(text)), 0);
+    struct protocol_frame f;
+    assert_int_equal(protocol_next(&c, &f), 1);
+    assert_int_equal(f.type, PROTOCOL_CHECK);
+    assert_int_equal(f.len, 4 + strlen(out));
+    assert_int_equal(protocol_get_u32(f.payload), strlen(out));
+    assert_memory_equal(f.payload + 4, out, strlen(out));
+
+    assert_int_equal(protocol_send(&c, PROTOCOL_CHECK, 0, PROTOCOL_VERBOSE, text, strlen(text)), 0);
+    assert_int_equal(protocol_next(&c, &f), 1);
+    assert_int_equal(f.type, PROTOCOL_CHECK);
+    assert_int_equal(protocol_get_u32(f.payload), strlen(out));
+    assert_memory_equal(f.payload + 4, out, strlen(out));
+    const char *err = f.payload + 4 + strlen(out);
+    size_t err_len = f.len - 4 - strlen(out);
+    assert_int_equal(err_len, strlen(hints));
+    assert_memory_equal(err, hints, err_len);
+    disconnect_server(&c);
+}
+
+/// Testuje wiele zapytań wysłanych bez czekania na odpowiedzi.
+static void server_pipelined_test(void **state)
+{
+    struct protocol_conn c;
+    connect_server(&c);
+    for(int i = 0; i < 100; i++)
+    {
+        assert_int_equal(protocol_send(&c, PROTOCOL_FIND, 0, 0, i % 2 ? "ma" : "mam", i % 2 ? 2 : 3), 0);
+        assert_int_equal(protocol_send(&c, PROTOCOL_HINTS, 0, 0, "lon", 3), 0);
+        assert_int_equal(protocol_send(&c, 'X', 0, 0, NULL, 0), 0);
+    }
+    for(int i = 0; i < 100; i++)
+    {
+        expect(&c, PROTOCOL_FIND, i % 2 ? "\1" : "\0", 1);
+        expect(&c, PROTOCOL_HINTS, "lon\0lan", 8);
+        expect(&c, PROTOCOL_ERROR, "unknown request", 15);
+    }
+    disconnect_server(&c);
+}
+
+/// Testuje zapytanie wysłane bajt po bajcie.
+static void server_split_test(void **state)
+{
+    char frame[PROTOCOL_HEADER + 4] = { PROTOCOL_FIND, 0, 0, 0, 0, 0, 0, 4, 'k', 'o', 't', 'a' };
+    struct protocol_conn c;
+    connect_server(&c);
+    for(size_t i = 0; i < sizeof(frame); i++)
+    {
+        assert_int_equal(write(c.fd, frame + i, 1), 1);
+        usleep(1000);
+    }
+    expect(&c, PROTOCOL_FIND, "\1", 1);
+    disconnect_server(&c);
+}
+
+/// Testuje nagłówki z niepoprawną długością i ucięte ramki.
+static void server_garbage_test(void **state)
+{
+    struct protocol_conn c;
+    struct protocol_frame f;
+
+    // Za długa ramka zamyka połączenie po odpowiedziach na wcześniejsze zapytania
+    unsigned char garbage[PROTOCOL_HEADER] = { PROTOCOL_CHECK, 0, 0, 0, 0x7f, 0xff, 0xff, 0xff };
+    connect_server(&c);
+    assert_int_equal(protocol_send(&c, PROTOCOL_FIND, 0, 0, "ala", 3), 0);
+    assert_int_equal(protocol_append(&c, garbage, sizeof(garbage)), 0);
+    assert_int_equal(protocol_flush(&c), 0);
+    expect(&c, PROTOCOL_FIND, "\1", 1);
+    assert_int_equal(protocol_next(&c, &f), 0);
+    disconnect_server(&c);
+
+    // Ucięta ramka
+    connect_server(&c);
+    assert_int_equal(write(c.fd, garbage, 5), 5);
+    shutdown(c.fd, SHUT_WR);
+    assert_int_equal(protocol_next(&c, &f), 0);
+    disconnect_server(&c);
+
+    // Serwer dalej obsługuje nowe połączenia
+    connect_server(&c);
+    assert_int_equal(protocol_send(&c, PROTOCOL_FIND, 0, 0, "dom", 3), 0);
+    expect(&c, PROTOCOL_FIND, "\1", 1);
+    disconnect_server(&c);
+}
+
+int main(int argc, char *argv[]) {
+    if(argc != 2)
+    {
+        fprintf(stderr, "usage: %s <dict-server>\n", argv[0]);
+        return 1;
+    }
+    server_path = argv[1];
+    signal(SIGPIPE, SIG_IGN);
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(server_find_test),
+        cmocka_unit_test(server_hints_test),
+        cmocka_unit_test(server_check_test),
+        cmocka_unit_test(server_pipelined_test),
+        cmocka_unit_test(server_split_test),
+        cmocka_unit_test(server_garbage_test),
+    };
+
+    return cmocka_run_group_tests(tests, server_start, server_stop);
+}
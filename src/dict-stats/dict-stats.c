@@ -0,0 +1,133 @@
+/** @defgroup dict-stats Moduł dict-stats
+    Program wypisujący zużycie pamięci i kształt słownika.
+  */
+/** @file
+    Główny plik modułu dict-stats
+    @ingroup dict-stats
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+    @date 2015-06-28
+    @copyright Uniwersytet Warszawski
+  */
+
+#include "dictionary.h"
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+
+/**
+  Wypisuje sposób użycia programu.
+  @param[in] name Nazwa programu.
+  */
+static void usage(const char *name)
+{
+    printf(" %s <dictionary file>\n", name);
+}
+
+/**
+  Wypisuje rozmiar w bajtach i jego udział w całości.
+  @param[in] name Nazwa pozycji.
+  @param[in] bytes Rozmiar.
+  @param[in] total Rozmiar całości.
+  */
+static void print_bytes(const char *name, size_t bytes, size_t total)
+{
+    printf("  %-20s %12zu  %5.1f%%\n", name, bytes, total > 0 ? 100.0 * bytes / total : 0.0);
+}
+
+/**
+  Wypisuje histogram.
+  @param[in] name Nazwa histogramu.
+  @param[in] hist Liczności kolejnych wartości.
+  @param[in] len Liczba wartości (ostatnia liczy też większe).
+  */
+static void print_histogram(const char *name, const size_t *hist, size_t len)
+{
+    printf("%s:\n", name);
+    for(size_t i = 0; i < len; i++)
+        if(hist[i] > 0)
+            printf("  %2zu%s %12zu\n", i, i == len - 1 ? "+" : " ", hist[i]);
+}
+
+/**
+  Wypisuje statystyki słownika.
+  @param[in] st Statystyki.
+  */
+static void print_memory_stats(const struct dictionary_memory_stats *st)
+{
+    printf("Trie:\n");
+    printf("  nodes: %zu (words: %zu, shared: %zu)\n", st->nodes, st->leaves, st->shared_nodes);
+    printf("  max depth: %zu, max children: %zu\n", st->max_depth, st->max_fanout);
+    if(st->nodes > 1)
+        printf("  average children of inner nodes: %.2f\n",
+               (double)(st->nodes - 1) / (st->nodes - st->fanouts[0]));
+    printf("Memory [bytes]:\n");
+    print_bytes("nodes", st->node_bytes, st->total_bytes);
+    print_bytes("child arrays", st->child_bytes, st->total_bytes);
+    print_bytes("  unused capacity", st->child_wasted_bytes, st->total_bytes);
+    print_bytes("rules", st->rule_bytes, st->total_bytes);
+    print_bytes("alphabet", st->alphabet_bytes, st->total_bytes);
+    print_bytes("hint index", st->index_bytes, st->total_bytes);
+    print_bytes("removed words", st->removed_bytes, st->total_bytes);
+    print_bytes("total", st->total_bytes, st->total_bytes);
+    printf("Rules: %zu\n", st->rules);
+    print_histogram("Nodes per depth", st->depths, DICTIONARY_MEMORY_DEPTHS);
+    print_histogram("Nodes per number of children", st->fanouts, DICTIONARY_MEMORY_FANOUTS);
+    printf("Words per first letter:\n");
+    for(size_t i = 0; i < st->letters_no; i++)
+        printf("  %lc %12zu\n", (wint_t)st->letters[i], st->letter_words[i]);
+}
+
+/**
+  Funkcja main.
+  @param[in] argc Liczba parametrów linii komend
+  @param[in] argv Lista argumentów linii komend
+  @return 0 jeśli program zakończył się powodzeniem, 1 jeśli nastąpił błąd
+ */
+int main(int argc, char *argv[])
+{
+    setlocale(LC_ALL, "pl_PL.UTF-8");
+
+    if(argc != 2 || (argv[1][0] == '-' && argv[1][1] != 0))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *dictfile = argv[1];
+    FILE *fdict = fopen(dictfile, "rb");
+    if(fdict == NULL)
+    {
+        printf("Could not open dictionary file: %s\n", dictfile);
+        return 1;
+    }
+    struct dictionary *dict = dictionary_load(fdict);
+    fclose(fdict);
+    if(dict == NULL)
+    {
+        printf("Could not parse dictionary file.\n");
+        return 1;
+    }
+    // Indeks podpowiedzi obok słownika jest opcjonalny
+    char *findex = malloc(strlen(dictfile) + sizeof(DICTIONARY_INDEX_SUFFIX));
+    if(findex != NULL)
+    {
+        strcat(strcpy(findex, dictfile), DICTIONARY_INDEX_SUFFIX);
+        dictionary_index_load(dict, findex);
+        free(findex);
+    }
+
+    struct dictionary_memory_stats *st = malloc(sizeof(*st));
+    if(st == NULL)
+    {
+        printf("Out of memory.\n");
+        dictionary_done(dict);
+        return 1;
+    }
+    dictionary_memory_stats(dict, st);
+    print_memory_stats(st);
+    free(st);
+    dictionary_done(dict);
+    return 0;
+}
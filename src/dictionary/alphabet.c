@@ -0,0 +1,271 @@
+/** @file
+    Implementacja alfabetu słownika.
+
+    @ingroup dictionary
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+    @copyright Uniwerstet Warszawski
+    @date 2015-06-21
+ */
+
+#include "alphabet.h"
+#include "serialization.h"
+#include "utf8.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+#include "../testable.h"
+
+/**
+ * Litery o kodach mniejszych od tej wartości są wyszukiwane w tablicy.
+ * Obejmuje Latin-1 i Latin Extended-A, czyli m.in. wszystkie polskie litery.
+ */
+#define ALPHABET_DIRECT 0x180
+
+/**
+ * Struktura przechowująca alfabet.
+ */
+struct alphabet
+{
+    int size;                                   ///< Liczba liter.
+    wchar_t letters[256];                       ///< Litery indeksowane symbolami.
+    symbol_t direct[ALPHABET_DIRECT];           ///< Symbole liter o małych kodach.
+    int other_cnt;                              ///< Liczba pozostałych liter.
+    wchar_t other_letters[ALPHABET_CAPACITY];   ///< Pozostałe litery (posortowane).
+    symbol_t other_symbols[ALPHABET_CAPACITY];  ///< Symbole pozostałych liter.
+    int shared;                                 ///< Liczba dodatkowych właścicieli.
+};
+
+/** @name Funkcje pomocnicze
+ * @{
+ */
+
+/**
+ * Znajduje miejsce litery w tablicy rzadziej używanych liter.
+ *
+ * @param[in] a Alfabet.
+ * @param[in] c Litera.
+ * @return Indeks pierwszej litery nie mniejszej niż c.
+ */
+static int alphabet_other_index(const struct alphabet *a, wchar_t c)
+{
+    int begin = 0, end = a->other_cnt;
+    while(begin < end)
+    {
+        int middle = (begin + end) / 2;
+        if(a->other_letters[middle] < c) begin = middle + 1;
+        else end = middle;
+    }
+    return begin;
+}
+
+/**
+ * Litery spoza alfabetu napotkane w zapytaniu.
+ */
+struct query_letters
+{
+    wchar_t letters[ALPHABET_CAPACITY + 1]; ///< Napotkane litery.
+    int cnt;                                ///< Liczba napotkanych liter.
+    int free;                               ///< Liczba wolnych symboli.
+};
+
+/**
+ * Zwraca symbol litery w zapytaniu.
+ * Litery spoza alfabetu dostają wolne symbole od końca przestrzeni symboli.
+ *
+ * @param[in] a Alfabet.
+ * @param[in,out] q Litery spoza alfabetu napotkane do tej pory.
+ * @param[in] c Litera.
+ * @return Symbol.
+ */
+static symbol_t alphabet_query_symbol(const struct alphabet *a, struct query_letters *q, wchar_t c)
+{
+    symbol_t s = alphabet_symbol(a, c);
+    if(s != 0) return s;
+    int i = 0;
+    while(i < q->cnt && q->letters[i] != c) i++;
+    if(i == q->cnt)
+    {
+        if(q->cnt < q->free) q->letters[q->cnt++] = c;
+        else i = q->free - 1;
+    }
+    return 255 - i;
+}
+
+/**
+ * @}
+ */
+
+/** @name Elementy interfejsu
+ * @{
+ */
+
+struct alphabet * alphabet_new(void)
+{
+    struct alphabet *a = malloc(sizeof(struct alphabet));
+    if(a == NULL) return NULL;
+    memset(a, 0, sizeof(struct alphabet));
+    return a;
+}
+
+struct alphabet * alphabet_copy(const struct alphabet *a)
+{
+    struct alphabet *c = malloc(sizeof(struct alphabet));
+    if(c == NULL) return NULL;
+    memcpy(c, a, sizeof(struct alphabet));
+    c->shared = 0;
+    return c;
+}
+
+void alphabet_done(struct alphabet *a)
+{
+    if(a->shared > 0) a->shared--;
+    else free(a);
+}
+
+struct alphabet * alphabet_share(struct alphabet *a)
+{
+    a->shared++;
+    return a;
+}
+
+struct alphabet * alphabet_unshare(struct alphabet *a)
+{
+    if(a->shared == 0) return a;
+    struct alphabet *c = alphabet_copy(a);
+    if(c != NULL) a->shared--;
+    return c;
+}
+
+int alphabet_size(const struct alphabet *a)
+{
+    return a->size;
+}
+
+size_t alphabet_memory(const struct alphabet *a)
+{
+    return sizeof(*a);
+}
+
+symbol_t alphabet_symbol(const struct alphabet *a, wchar_t c)
+{
+    if(c >= 0 && c < ALPHABET_DIRECT) return a->direct[c];
+    int i = alphabet_other_index(a, c);
+    if(i < a->other_cnt && a->other_letters[i] == c) return a->other_symbols[i];
+    return 0;
+}
+
+symbol_t alphabet_add(struct alphabet *a, wchar_t c)
+{
+    symbol_t s = alphabet_symbol(a, c);
+    if(s != 0) return s;
+    if(c == 0 || a->size >= ALPHABET_CAPACITY) return 0;
+    s = SYMBOL_LETTER_FIRST + a->size;
+    a->letters[s] = c;
+    a->size++;
+    if(c >= 0 && c < ALPHABET_DIRECT)
+    {
+        a->direct[c] = s;
+        return s;
+    }
+    int i = alphabet_other_index(a, c);
+    memmove(a->other_letters + i + 1, a->other_letters + i, (a->other_cnt - i) * sizeof(wchar_t));
+    memmove(a->other_symbols + i + 1, a->other_symbols + i, (a->other_cnt - i) * sizeof(symbol_t));
+    a->other_letters[i] = c;
+    a->other_symbols[i] = s;
+    a->other_cnt++;
+    return s;
+}
+
+wchar_t alphabet_letter(const struct alphabet *a, symbol_t s)
+{
+    return a->letters[s];
+}
+
+int alphabet_encode(const struct alphabet *a, const wchar_t *word, symbol_t *out)
+{
+    for(; *word != 0; word++, out++)
+    {
+        *out = alphabet_symbol(a, *word);
+        if(*out == 0) return -1;
+    }
+    *out = 0;
+    return 0;
+}
+
+int alphabet_encode_add(struct alphabet *a, const wchar_t *word, symbol_t *out)
+{
+    for(; *word != 0; word++, out++)
+    {
+        *out = alphabet_add(a, *word);
+        if(*out == 0) return -1;
+    }
+    *out = 0;
+    return 0;
+}
+
+void alphabet_encode_query(const struct alphabet *a, const wchar_t *word, symbol_t *out)
+{
+    struct query_letters q;
+    q.cnt = 0;
+    q.free = ALPHABET_CAPACITY + 1 - a->size;
+    for(; *word != 0; word++, out++)
+        *out = alphabet_query_symbol(a, &q, *word);
+    *out = 0;
+}
+
+int alphabet_encode_query_utf8(const struct alphabet *a, const char *word, size_t len, symbol_t *out)
+{
+    struct query_letters q;
+    q.cnt = 0;
+    q.free = ALPHABET_CAPACITY + 1 - a->size;
+    int n = 0;
+    while(len > 0)
+    {
+        wchar_t c;
+        size_t l = utf8_decode(word, len, &c);
+        if(l == 0 || c == 0) return -1;
+        word += l;
+        len -= l;
+        out[n++] = alphabet_query_symbol(a, &q, c);
+    }
+    out[n] = 0;
+    return n;
+}
+
+int alphabet_serialize(const struct alphabet *a, FILE *file)
+{
+    if(int32_serialize(a->size, file)<0) return -1;
+    for(int i = 0; i < a->size; i++)
+    {
+        if(fputwc(a->letters[SYMBOL_LETTER_FIRST + i], file)<0) return -1;
+    }
+    return 0;
+}
+
+struct alphabet * alphabet_deserialize(FILE *file)
+{
+    int size;
+    if(int32_deserialize(&size, file)<0) return NULL;
+    if(size < 0 || size > ALPHABET_CAPACITY) return NULL;
+    struct alphabet *a = alphabet_new();
+    if(a == NULL) return NULL;
+    for(int i = 0; i < size; i++)
+    {
+        wint_t c = fgetwc(file);
+        if(c == WEOF || c == 0) goto fail;
+        // Powtórzona litera oznacza uszkodzony plik
+        if(alphabet_symbol(a, c) != 0) goto fail;
+        alphabet_add(a, c);
+    }
+    return a;
+fail:
+    alphabet_done(a);
+    return NULL;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,198 @@
+/** @file
+    Interfejs alfabetu słownika.
+
+    Alfabet przypisuje każdej literze występującej w słowniku (lub w regułach
+    podpowiedzi) jednobajtowy symbol. Drzewo TRIE i silnik reguł pracują
+    wyłącznie na symbolach, a litery (`wchar_t`) pojawiają się tylko
+    na granicy interfejsu słownika.
+
+    Przestrzeń symboli:
+      - 0 kończy napis,
+      - od SYMBOL_VARIABLE_FIRST to zmienne '0'..'9' we wzorcach reguł,
+      - od SYMBOL_LETTER_FIRST do 254 to litery (255 jest zawsze wolny).
+
+    Symbole liter są przydzielane po kolei, w kolejności pojawiania się liter.
+
+    @ingroup dictionary
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+    @copyright Uniwerstet Warszawski
+    @date 2015-06-21
+ */
+
+#ifndef DICTIONARY_ALPHABET_H
+#define DICTIONARY_ALPHABET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+/**
+  Symbol alfabetu.
+  */
+typedef unsigned char symbol_t;
+
+/// Symbol pierwszej zmiennej ('0') we wzorcach reguł.
+#define SYMBOL_VARIABLE_FIRST 1
+
+/// Liczba zmiennych we wzorcach reguł.
+#define SYMBOL_VARIABLES 10
+
+/// Symbol pierwszej litery.
+#define SYMBOL_LETTER_FIRST (SYMBOL_VARIABLE_FIRST + SYMBOL_VARIABLES)
+
+/// Maksymalna liczba liter w alfabecie (symbol 255 zawsze zostaje wolny).
+#define ALPHABET_CAPACITY (255 - SYMBOL_LETTER_FIRST)
+
+/// Czy symbol jest zmienną.
+#define symbol_is_variable(s) \
+    ((s) >= SYMBOL_VARIABLE_FIRST && (s) < SYMBOL_LETTER_FIRST)
+
+/// Numer zmiennej (0..9) odpowiadający symbolowi.
+#define symbol_variable_index(s) ((s) - SYMBOL_VARIABLE_FIRST)
+
+/// Długość napisu złożonego z symboli.
+#define symbol_len(s) strlen((const char *)(s))
+
+/**
+  Struktura przechowująca alfabet.
+  */
+struct alphabet;
+
+/**
+  Tworzy pusty alfabet.
+  @return Alfabet lub NULL jeśli alokacja się nie powiodła.
+  */
+struct alphabet * alphabet_new(void);
+
+/**
+  Kopiuje alfabet.
+  Symbole liter w kopii są takie same jak w oryginale.
+  @param[in] a Alfabet.
+  @return Kopia alfabetu lub NULL jeśli alokacja się nie powiodła.
+  */
+struct alphabet * alphabet_copy(const struct alphabet *a);
+
+/**
+  Niszczy alfabet.
+  Współdzielony alfabet traci tylko jednego właściciela.
+  @param[in] a Alfabet.
+  */
+void alphabet_done(struct alphabet *a);
+
+/**
+  Dodaje alfabetowi właściciela (kopia przy zapisie).
+  Każdy właściciel zwalnia alfabet przez alphabet_done().
+  @param[in,out] a Alfabet.
+  @return Ten sam alfabet.
+  */
+struct alphabet * alphabet_share(struct alphabet *a);
+
+/**
+  Przygotowuje alfabet do zmian: współdzielony alfabet jest zastępowany
+  kopią, a pozostali właściciele zachowują oryginał.
+  @param[in,out] a Alfabet.
+  @return Alfabet, który można zmieniać, lub NULL jeśli alokacja się nie
+  powiodła (wtedy oryginał zostaje u właściciela).
+  */
+struct alphabet * alphabet_unshare(struct alphabet *a);
+
+/**
+  Zwraca liczbę liter w alfabecie.
+  @param[in] a Alfabet.
+  @return Liczba liter.
+  */
+int alphabet_size(const struct alphabet *a);
+
+/**
+  Zwraca liczbę bajtów pamięci zajmowanej przez alfabet.
+  @param[in] a Alfabet.
+  @return Rozmiar alfabetu w bajtach.
+  */
+size_t alphabet_memory(const struct alphabet *a);
+
+/**
+  Zwraca symbol litery.
+  @param[in] a Alfabet.
+  @param[in] c Litera.
+  @return Symbol lub 0 jeśli litery nie ma w alfabecie.
+  */
+symbol_t alphabet_symbol(const struct alphabet *a, wchar_t c);
+
+/**
+  Zwraca symbol litery, w razie potrzeby dodając ją do alfabetu.
+  @param[in,out] a Alfabet.
+  @param[in] c Litera (różna od 0).
+  @return Symbol lub 0 jeśli alfabet jest pełny.
+  */
+symbol_t alphabet_add(struct alphabet *a, wchar_t c);
+
+/**
+  Zwraca literę odpowiadającą symbolowi.
+  @param[in] a Alfabet.
+  @param[in] s Symbol litery.
+  @return Litera lub 0 jeśli symbol nie jest przydzielony.
+  */
+wchar_t alphabet_letter(const struct alphabet *a, symbol_t s);
+
+/**
+  Zamienia słowo na napis z symboli.
+  @param[in] a Alfabet.
+  @param[in] word Słowo.
+  @param[out] out Bufor na co najmniej `wcslen(word) + 1` symboli.
+  @return 0 jeśli się udało, -1 jeśli w słowie jest litera spoza alfabetu.
+  */
+int alphabet_encode(const struct alphabet *a, const wchar_t *word, symbol_t *out);
+
+/**
+  Zamienia słowo na napis z symboli, dodając nowe litery do alfabetu.
+  @param[in,out] a Alfabet.
+  @param[in] word Słowo.
+  @param[out] out Bufor na co najmniej `wcslen(word) + 1` symboli.
+  @return 0 jeśli się udało, -1 jeśli alfabet się przepełnił.
+  */
+int alphabet_encode_add(struct alphabet *a, const wchar_t *word, symbol_t *out);
+
+/**
+  Zamienia zapytanie na napis z symboli.
+
+  Literom spoza alfabetu przydzielane są tymczasowe, nieużywane symbole
+  (różnym literom różne, o ile starczy wolnych symboli), więc takie litery
+  nie pasują do żadnego węzła drzewa, ale wciąż mogą być dopasowane
+  do zmiennych w regułach.
+
+  @param[in] a Alfabet.
+  @param[in] word Słowo.
+  @param[out] out Bufor na co najmniej `wcslen(word) + 1` symboli.
+  */
+void alphabet_encode_query(const struct alphabet *a, const wchar_t *word, symbol_t *out);
+
+/**
+  Zamienia zapytanie zapisane w UTF-8 na napis z symboli.
+  Działa jak alphabet_encode_query(), ale dekoduje słowo w locie.
+  @param[in] a Alfabet.
+  @param[in] word Słowo w UTF-8 (nie musi kończyć się zerem).
+  @param[in] len Długość słowa w bajtach.
+  @param[out] out Bufor na co najmniej `len + 1` symboli.
+  @return Liczba symboli lub -1, jeśli słowo nie jest poprawnym UTF-8.
+  */
+int alphabet_encode_query_utf8(const struct alphabet *a, const char *word, size_t len, symbol_t *out);
+
+/**
+  Zapisuje alfabet do pliku.
+  @param[in] a Alfabet.
+  @param[in] file Plik.
+  @return 0 jeśli się udało, -1 w p.p.
+  */
+int alphabet_serialize(const struct alphabet *a, FILE *file);
+
+/**
+  Wczytuje alfabet z pliku.
+  @param[in] file Plik.
+  @return Alfabet lub NULL jeśli się nie udało.
+  */
+struct alphabet * alphabet_deserialize(FILE *file);
+
+#endif /* DICTIONARY_ALPHABET_H */
@@ -0,0 +1,123 @@
+/** @file
+  Test implementacji alfabetu słownika.
+
+  @ingroup dictionary
+  @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+  @copyright Uniwerstet Warszawski
+  @date 2015-06-21
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <cmocka.h>
+#include "alphabet.h"
+#include "../testable.h"
+
+/**
+ * Testuje przydzielanie symboli literom.
+ */
+static void alphabet_add_test(void **state)
+{
+    struct alphabet *a = alphabet_new();
+    assert_int_equal(alphabet_size(a), 0);
+    assert_int_equal(alphabet_symbol(a, L'ż'), 0);
+    assert_int_equal(alphabet_add(a, L'ż'), SYMBOL_LETTER_FIRST);
+    assert_int_equal(alphabet_add(a, L'a'), SYMBOL_LETTER_FIRST + 1);
+    assert_int_equal(alphabet_add(a, L'ж'), SYMBOL_LETTER_FIRST + 2);
+    assert_int_equal(alphabet_add(a, L'ż'), SYMBOL_LETTER_FIRST);
+    assert_int_equal(alphabet_size(a), 3);
+    assert_int_equal(alphabet_symbol(a, L'ж'), SYMBOL_LETTER_FIRST + 2);
+    assert_int_equal(alphabet_letter(a, SYMBOL_LETTER_FIRST), L'ż');
+    assert_int_equal(alphabet_letter(a, SYMBOL_LETTER_FIRST + 2), L'ж');
+    assert_int_equal(alphabet_letter(a, SYMBOL_LETTER_FIRST + 3), 0);
+    alphabet_done(a);
+}
+
+/**
+ * Testuje zachowanie pełnego alfabetu.
+ */
+static void alphabet_full_test(void **state)
+{
+    struct alphabet *a = alphabet_new();
+    for(int i = 0; i < ALPHABET_CAPACITY; i++)
+        assert_int_not_equal(alphabet_add(a, 0x400 + i), 0);
+    assert_int_equal(alphabet_size(a), ALPHABET_CAPACITY);
+    assert_int_equal(alphabet_add(a, L'a'), 0);
+    assert_int_equal(alphabet_add(a, 0x400), SYMBOL_LETTER_FIRST);
+    assert_int_equal(alphabet_letter(a, 255), 0);
+    alphabet_done(a);
+}
+
+/**
+ * Testuje kodowanie słów.
+ */
+static void alphabet_encode_test(void **state)
+{
+    struct alphabet *a = alphabet_new();
+    symbol_t out[8];
+    assert_int_equal(alphabet_encode(a, L"kot", out), -1);
+    assert_int_equal(alphabet_encode_add(a, L"kot", out), 0);
+    assert_int_equal(out[0], SYMBOL_LETTER_FIRST);
+    assert_int_equal(out[1], SYMBOL_LETTER_FIRST + 1);
+    assert_int_equal(out[2], SYMBOL_LETTER_FIRST + 2);
+    assert_int_equal(out[3], 0);
+    assert_int_equal(alphabet_encode(a, L"tok", out), 0);
+    assert_int_equal(out[0], SYMBOL_LETTER_FIRST + 2);
+    assert_int_equal(out[2], SYMBOL_LETTER_FIRST);
+    assert_int_equal(alphabet_encode(a, L"koty", out), -1);
+    alphabet_done(a);
+}
+
+/**
+ * Testuje kodowanie zapytań z literami spoza alfabetu.
+ */
+static void alphabet_encode_query_test(void **state)
+{
+    struct alphabet *a = alphabet_new();
+    alphabet_add(a, L'a');
+    symbol_t out[8];
+    alphabet_encode_query(a, L"xaxy", out);
+    assert_int_equal(out[1], SYMBOL_LETTER_FIRST);
+    assert_true(out[0] > SYMBOL_LETTER_FIRST);
+    assert_int_equal(out[0], out[2]);
+    assert_int_not_equal(out[0], out[3]);
+    assert_int_equal(alphabet_letter(a, out[0]), 0);
+    assert_int_equal(alphabet_letter(a, out[3]), 0);
+    assert_int_equal(out[4], 0);
+    alphabet_done(a);
+}
+
+/**
+ * Testuje kodowanie zapytań zapisanych w UTF-8.
+ */
+static void alphabet_encode_query_utf8_test(void **state)
+{
+    struct alphabet *a = alphabet_new();
+    alphabet_add(a, L'ł');
+    symbol_t out[8];
+    assert_int_equal(alphabet_encode_query_utf8(a, "x\xc5\x82x!", 4, out), 3);
+    assert_int_equal(out[1], SYMBOL_LETTER_FIRST);
+    assert_int_equal(out[0], out[2]);
+    assert_int_not_equal(out[0], SYMBOL_LETTER_FIRST);
+    assert_int_equal(out[3], 0);
+    assert_int_equal(alphabet_encode_query_utf8(a, "\xc5", 1, out), -1);
+    alphabet_done(a);
+}
+
+/**
+ * Uruchamia testy.
+ */
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(alphabet_add_test),
+        cmocka_unit_test(alphabet_full_test),
+        cmocka_unit_test(alphabet_encode_test),
+        cmocka_unit_test(alphabet_encode_query_test),
+        cmocka_unit_test(alphabet_encode_query_utf8_test),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,548 @@
+/** @file
+    Implementacja indeksu usunięć.
+
+    Blok pamięci indeksu składa się z 32-bitowych słów:
+    - nagłówka (DELETION_INDEX_HEADER słów, zob. enum header_field),
+    - początków słów w tekście (liczba słów + 1),
+    - tekstu słów w symbolach alfabetu (dopełnionego do 4 bajtów),
+    - początków kubełków (liczba kubełków + 1),
+    - skrótów i numerów słów w kolejności kubełków.
+
+    Kubełek wpisu wyznaczają najstarsze bity skrótu.
+
+    @ingroup dictionary
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+    @copyright Uniwerstet Warszawski
+    @date 2015-06-26
+ */
+
+#include "deletion_index.h"
+#include "trie.h"
+#include "vector.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Znacznik na początku indeksu ("DIX1").
+#define DELETION_INDEX_MAGIC 0x31584944u
+
+/// Liczba słów nagłówka.
+#define DELETION_INDEX_HEADER 8
+
+/// Największa obsługiwana głębokość indeksu.
+#define DELETION_INDEX_MAX_DEPTH 4
+
+/// Średnia liczba wpisów w kubełku.
+#define DELETION_INDEX_BUCKET_LOAD 4
+
+/**
+ * Pola nagłówka indeksu.
+ */
+enum header_field
+{
+    HEADER_MAGIC,           ///< DELETION_INDEX_MAGIC.
+    HEADER_DEPTH,           ///< Największa liczba usuwanych liter.
+    HEADER_WORDS,           ///< Liczba słów.
+    HEADER_TEXT,            ///< Długość tekstu słów w bajtach.
+    HEADER_BUCKET_BITS,     ///< Logarytm liczby kubełków.
+    HEADER_ENTRIES,         ///< Liczba wpisów.
+    HEADER_FINGERPRINT_LO,  ///< Młodsza połowa odcisku zbioru słów.
+    HEADER_FINGERPRINT_HI   ///< Starsza połowa odcisku zbioru słów.
+};
+
+/**
+ * Indeks usunięć.
+ */
+struct deletion_index
+{
+    uint32_t *data;                 ///< Blok pamięci indeksu.
+    size_t size;                    ///< Rozmiar bloku w bajtach.
+    bool mapped;                    ///< Czy blok jest zmapowanym plikiem.
+    int depth;                      ///< Największa liczba usuwanych liter.
+    uint32_t words;                 ///< Liczba słów.
+    uint32_t bucket_bits;           ///< Logarytm liczby kubełków.
+    const uint32_t *word_start;     ///< Początki słów w tekście.
+    const symbol_t *text;           ///< Tekst słów.
+    const uint32_t *bucket_start;   ///< Początki kubełków.
+    const uint32_t *hash;           ///< Skróty wpisów.
+    const uint32_t *id;             ///< Numery słów wpisów.
+    int shared;                     ///< Liczba dodatkowych właścicieli.
+};
+
+/// Wektor 32-bitowych liczb.
+VECTOR_DEFINE(uint32_vector, uint32_t)
+/// Wektor symboli.
+VECTOR_DEFINE(symbol_vector, symbol_t)
+
+/**
+ * Porządek na liczbach.
+ * @param[in] a Pierwsza liczba.
+ * @param[in] b Druga liczba.
+ * @return True jeśli pierwsza liczba jest mniejsza.
+ */
+static inline bool uint32_less(const uint32_t *a, const uint32_t *b)
+{
+    return *a < *b;
+}
+
+/**
+ * Równość liczb.
+ * @param[in] a Pierwsza liczba.
+ * @param[in] b Druga liczba.
+ * @return True jeśli liczby są równe.
+ */
+static inline bool uint32_equal(const uint32_t *a, const uint32_t *b)
+{
+    return *a == *b;
+}
+
+VECTOR_DEFINE_SORT(uint32_vector, uint32_t, uint32_less)
+VECTOR_DEFINE_UNIQUE(uint32_vector, uint32_t, uint32_equal)
+
+/**
+ * Słowa z drzewa zbierane przy budowaniu indeksu albo sprawdzaniu,
+ * czy indeks pasuje do drzewa.
+ */
+struct word_collector
+{
+    const struct alphabet *alphabet;    ///< Alfabet drzewa.
+    struct symbol_vector path;          ///< Litery na ścieżce od korzenia.
+    struct symbol_vector text;          ///< Tekst zebranych słów.
+    struct uint32_vector start;         ///< Początki zebranych słów.
+    size_t words;                       ///< Liczba zebranych słów.
+    uint64_t fingerprint;               ///< Odcisk zebranych słów.
+    bool keep;                          ///< Czy zapisywać słowa (czy tylko liczyć odcisk).
+    bool failed;                        ///< Czy brakło pamięci.
+};
+
+#include "../testable.h"
+
+/** @name Funkcje pomocnicze
+ * @{
+ */
+
+/**
+ * Liczy skrót napisu z symboli.
+ * @param[in] s Napis.
+ * @param[in] len Długość napisu.
+ * @return Skrót.
+ */
+static uint32_t symbols_hash(const symbol_t *s, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < len; i++)
+    {
+        h ^= s[i];
+        h *= 16777619u;
+    }
+    // Wymieszanie bitów, bo kubełek wyznaczają najstarsze bity
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+/**
+ * Dopisuje skróty słowa i słów powstałych z niego przez usunięcie
+ * co najwyżej `deletions` liter. Usuwane są litery na pozycjach
+ * od `from`, więc każdy zbiór pozycji jest rozpatrywany raz.
+ * @param[in] word Słowo.
+ * @param[in] len Długość słowa.
+ * @param[in] from Pierwsza pozycja, z której można usunąć literę.
+ * @param[in] deletions Największa liczba usuwanych liter.
+ * @param[in] buf Bufor na `deletions * len` symboli.
+ * @param[in,out] out Wektor skrótów.
+ * @return True jeśli się udało, false jeśli brakło pamięci.
+ */
+static bool add_variants(const symbol_t *word, size_t len, size_t from, int deletions,
+                         symbol_t *buf, struct uint32_vector *out)
+{
+    if(!uint32_vector_push(out, symbols_hash(word, len))) return false;
+    if(deletions == 0) return true;
+    for(size_t i = from; i < len; i++)
+    {
+        // Usunięcie jednej z równych sąsiednich liter daje to samo słowo
+        if(i > from && word[i] == word[i - 1]) continue;
+        memcpy(buf, word, i);
+        memcpy(buf + i, word + i + 1, len - i - 1);
+        if(!add_variants(buf, len - 1, i, deletions - 1, buf + len, out)) return false;
+    }
+    return true;
+}
+
+/**
+ * Dopisuje do odcisku zbioru słów jedno słowo.
+ * Odcisk zależy od liter, a nie od symboli, więc uwzględnia też alfabet.
+ * @param[in,out] wc Zbierane słowa.
+ */
+static void fingerprint_word(struct word_collector *wc)
+{
+    uint64_t h = wc->fingerprint;
+    for(size_t i = 0; i < wc->path.size; i++)
+    {
+        h ^= (uint64_t)alphabet_letter(wc->alphabet, wc->path.array[i]);
+        h *= 1099511628211ull;
+    }
+    h ^= 0xffu;
+    h *= 1099511628211ull;
+    wc->fingerprint = h;
+}
+
+/**
+ * Zbiera słowa z poddrzewa w kolejności drzewa.
+ * @param[in,out] wc Zbierane słowa.
+ * @param[in] n Węzeł, którego ścieżka jest w `wc->path`.
+ */
+static void collect_words(struct word_collector *wc, const struct trie_node *n)
+{
+    if(trie_is_leaf(n))
+    {
+        fingerprint_word(wc);
+        wc->words++;
+        if(wc->keep && (!uint32_vector_push(&wc->start, wc->text.size) ||
+                        !symbol_vector_append(&wc->text, wc->path.array, wc->path.size)))
+            wc->failed = true;
+    }
+    const struct trie_node **nodes;
+    int cnt = trie_get_children(n, &nodes);
+    for(int i = 0; i < cnt; i++)
+    {
+        if(!symbol_vector_push(&wc->path, trie_get_value(nodes[i])))
+        {
+            wc->failed = true;
+            return;
+        }
+        collect_words(wc, nodes[i]);
+        wc->path.size--;
+    }
+}
+
+/**
+ * Przygotowuje zbieranie słów.
+ * @param[out] wc Zbierane słowa.
+ * @param[in] alphabet Alfabet drzewa.
+ * @param[in] keep Czy zapisywać słowa.
+ */
+static void word_collector_init(struct word_collector *wc, const struct alphabet *alphabet, bool keep)
+{
+    wc->alphabet = alphabet;
+    symbol_vector_init(&wc->path);
+    symbol_vector_init(&wc->text);
+    uint32_vector_init(&wc->start);
+    wc->words = 0;
+    wc->fingerprint = 14695981039346656037ull;
+    wc->keep = keep;
+    wc->failed = false;
+}
+
+/**
+ * Zwalnia pamięć zbieranych słów.
+ * @param[in,out] wc Zbierane słowa.
+ */
+static void word_collector_done(struct word_collector *wc)
+{
+    symbol_vector_done(&wc->path);
+    symbol_vector_done(&wc->text);
+    uint32_vector_done(&wc->start);
+}
+
+/**
+ * Liczy rozmiar bloku indeksu o danym nagłówku.
+ * @param[in] header Nagłówek.
+ * @return Rozmiar w 32-bitowych słowach.
+ */
+static size_t layout_size(const uint32_t *header)
+{
+    return DELETION_INDEX_HEADER
+        + (size_t)header[HEADER_WORDS] + 1
+        + ((size_t)header[HEADER_TEXT] + 3) / 4
+        + ((size_t)1 << header[HEADER_BUCKET_BITS]) + 1
+        + 2 * (size_t)header[HEADER_ENTRIES];
+}
+
+/**
+ * Ustawia wskaźniki na części bloku indeksu.
+ * @param[in,out] index Indeks z ustawionym blokiem pamięci.
+ */
+static void layout_set(struct deletion_index *index)
+{
+    const uint32_t *h = index->data;
+    index->depth = h[HEADER_DEPTH];
+    index->words = h[HEADER_WORDS];
+    index->bucket_bits = h[HEADER_BUCKET_BITS];
+    const uint32_t *p = h + DELETION_INDEX_HEADER;
+    index->word_start = p;
+    p += h[HEADER_WORDS] + 1;
+    index->text = (const symbol_t *)p;
+    p += ((size_t)h[HEADER_TEXT] + 3) / 4;
+    index->bucket_start = p;
+    p += ((size_t)1 << h[HEADER_BUCKET_BITS]) + 1;
+    index->hash = p;
+    p += h[HEADER_ENTRIES];
+    index->id = p;
+}
+
+/**
+ * Sprawdza spójność zmapowanego indeksu, żeby uszkodzony plik
+ * nie prowadził do czytania poza blokiem.
+ * @param[in] index Indeks.
+ * @return True jeśli indeks jest spójny.
+ */
+static bool layout_valid(const struct deletion_index *index)
+{
+    const uint32_t *h = index->data;
+    for(uint32_t i = 0; i < index->words; i++)
+        if(index->word_start[i] > index->word_start[i + 1]) return false;
+    if(index->word_start[index->words] != h[HEADER_TEXT]) return false;
+    size_t buckets = (size_t)1 << index->bucket_bits;
+    for(size_t i = 0; i < buckets; i++)
+        if(index->bucket_start[i] > index->bucket_start[i + 1]) return false;
+    if(index->bucket_start[buckets] != h[HEADER_ENTRIES]) return false;
+    for(uint32_t i = 0; i < h[HEADER_ENTRIES]; i++)
+        if(index->id[i] >= index->words) return false;
+    return true;
+}
+
+/**
+ * Wyznacza kubełek skrótu.
+ * @param[in] index Indeks.
+ * @param[in] hash Skrót.
+ * @return Numer kubełka.
+ */
+static uint32_t bucket_of(const struct deletion_index *index, uint32_t hash)
+{
+    return hash >> (32 - index->bucket_bits);
+}
+
+/**
+ * @}
+ */
+
+/** @name Elementy interfejsu
+ * @{
+ */
+
+struct deletion_index * deletion_index_build(const struct trie_node *root,
+        const struct alphabet *alphabet, int depth)
+{
+    if(depth < 0 || depth > DELETION_INDEX_MAX_DEPTH) return NULL;
+    struct deletion_index *index = NULL;
+    struct word_collector wc;
+    word_collector_init(&wc, alphabet, true);
+    struct uint32_vector variants;
+    uint32_vector_init(&variants);
+    struct uint32_vector entries;       // Na przemian skrót i numer słowa
+    uint32_vector_init(&entries);
+    uint32_t *count = NULL;
+    symbol_t *buf = NULL;
+    collect_words(&wc, root);
+    if(wc.failed || !uint32_vector_push(&wc.start, wc.text.size)) goto done;
+    uint32_t words = wc.words;
+    size_t longest = 0;
+    for(uint32_t i = 0; i < words; i++)
+        if(wc.start.array[i + 1] - wc.start.array[i] > longest)
+            longest = wc.start.array[i + 1] - wc.start.array[i];
+    buf = malloc(depth * longest + 1);
+    if(buf == NULL) goto done;
+    for(uint32_t i = 0; i < words; i++)
+    {
+        uint32_vector_clear(&variants);
+        if(!add_variants(wc.text.array + wc.start.array[i], wc.start.array[i + 1] - wc.start.array[i],
+                         0, depth, buf, &variants)) goto done;
+        uint32_vector_sort(&variants);
+        uint32_vector_unique(&variants, NULL);
+        if(!uint32_vector_grow(&entries, 2 * variants.size)) goto done;
+        for(size_t j = 0; j < variants.size; j++)
+        {
+            entries.array[entries.size++] = variants.array[j];
+            entries.array[entries.size++] = i;
+        }
+    }
+    size_t entries_no = entries.size / 2;
+    uint32_t bits = 1;
+    while(bits < 31 && ((size_t)1 << bits) * DELETION_INDEX_BUCKET_LOAD < entries_no) bits++;
+    uint32_t header[DELETION_INDEX_HEADER] = {
+        DELETION_INDEX_MAGIC, depth, words, wc.text.size, bits, entries_no,
+        (uint32_t)wc.fingerprint, (uint32_t)(wc.fingerprint >> 32)
+    };
+    size_t size = layout_size(header);
+    index = malloc(sizeof(struct deletion_index));
+    if(index == NULL) goto done;
+    index->data = malloc(size * sizeof(uint32_t));
+    if(index->data == NULL)
+    {
+        free(index);
+        index = NULL;
+        goto done;
+    }
+    memset(index->data, 0, size * sizeof(uint32_t));
+    index->size = size * sizeof(uint32_t);
+    index->mapped = false;
+    index->shared = 0;
+    memcpy(index->data, header, sizeof(header));
+    layout_set(index);
+    memcpy((uint32_t *)index->word_start, wc.start.array, (words + 1) * sizeof(uint32_t));
+    if(wc.text.size > 0) memcpy((symbol_t *)index->text, wc.text.array, wc.text.size);
+    // Sortowanie wpisów przez zliczanie po kubełkach; wpisy w kubełku
+    // zostają w kolejności numerów słów
+    uint32_t *bucket_start = (uint32_t *)index->bucket_start;
+    uint32_t *hash = (uint32_t *)index->hash;
+    uint32_t *id = (uint32_t *)index->id;
+    size_t buckets = (size_t)1 << bits;
+    for(size_t j = 0; j < entries_no; j++)
+        bucket_start[bucket_of(index, entries.array[2 * j]) + 1]++;
+    for(size_t b = 0; b < buckets; b++)
+        bucket_start[b + 1] += bucket_start[b];
+    count = malloc(buckets * sizeof(uint32_t));
+    if(count == NULL)
+    {
+        deletion_index_done(index);
+        index = NULL;
+        goto done;
+    }
+    memcpy(count, bucket_start, buckets * sizeof(uint32_t));
+    for(size_t j = 0; j < entries_no; j++)
+    {
+        uint32_t pos = count[bucket_of(index, entries.array[2 * j])]++;
+        hash[pos] = entries.array[2 * j];
+        id[pos] = entries.array[2 * j + 1];
+    }
+done:
+    free(count);
+    free(buf);
+    uint32_vector_done(&entries);
+    uint32_vector_done(&variants);
+    word_collector_done(&wc);
+    return index;
+}
+
+struct deletion_index * deletion_index_map(const char *path,
+        const struct trie_node *root, const struct alphabet *alphabet)
+{
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return NULL;
+    struct stat st;
+    void *data = MAP_FAILED;
+    if(fstat(fd, &st) == 0 && st.st_size >= DELETION_INDEX_HEADER * (off_t)sizeof(uint32_t))
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) return NULL;
+    const uint32_t *h = data;
+    struct deletion_index *index = NULL;
+    if(h[HEADER_MAGIC] != DELETION_INDEX_MAGIC || h[HEADER_DEPTH] > DELETION_INDEX_MAX_DEPTH
+       || h[HEADER_BUCKET_BITS] < 1 || h[HEADER_BUCKET_BITS] > 31
+       || layout_size(h) * sizeof(uint32_t) != (size_t)st.st_size)
+        goto fail;
+    // Indeks musi opisywać te same słowa, co drzewo
+    struct word_collector wc;
+    word_collector_init(&wc, alphabet, false);
+    collect_words(&wc, root);
+    bool same = !wc.failed && wc.words == h[HEADER_WORDS]
+        && (uint32_t)wc.fingerprint == h[HEADER_FINGERPRINT_LO]
+        && (uint32_t)(wc.fingerprint >> 32) == h[HEADER_FINGERPRINT_HI];
+    word_collector_done(&wc);
+    if(!same) goto fail;
+    index = malloc(sizeof(struct deletion_index));
+    if(index == NULL) goto fail;
+    index->data = data;
+    index->size = st.st_size;
+    index->shared = 0;
+    index->mapped = true;
+    layout_set(index);
+    if(!layout_valid(index)) goto fail;
+    return index;
+fail:
+    free(index);
+    munmap(data, st.st_size);
+    return NULL;
+}
+
+int deletion_index_save(const struct deletion_index *index, FILE *file)
+{
+    if(fwrite(index->data, 1, index->size, file) != index->size) return -1;
+    return 0;
+}
+
+void deletion_index_done(struct deletion_index *index)
+{
+    if(index == NULL) return;
+    if(index->shared > 0)
+    {
+        index->shared--;
+        return;
+    }
+    if(index->mapped) munmap(index->data, index->size);
+    else free(index->data);
+    free(index);
+}
+
+struct deletion_index * deletion_index_share(struct deletion_index *index)
+{
+    if(index != NULL) index->shared++;
+    return index;
+}
+
+int deletion_index_depth(const struct deletion_index *index)
+{
+    return index->depth;
+}
+
+size_t deletion_index_memory(const struct deletion_index *index)
+{
+    return sizeof(*index) + index->size;
+}
+
+int deletion_index_candidates(const struct deletion_index *index,
+        const symbol_t *word, int deletions, uint32_t **ids)
+{
+    *ids = NULL;
+    size_t len = symbol_len(word);
+    struct uint32_vector variants;
+    uint32_vector_init(&variants);
+    struct uint32_vector found;
+    uint32_vector_init(&found);
+    symbol_t *buf = malloc(deletions * len + 1);
+    int r = -1;
+    if(buf == NULL || !add_variants(word, len, 0, deletions, buf, &variants)) goto done;
+    uint32_vector_sort(&variants);
+    uint32_vector_unique(&variants, NULL);
+    for(size_t i = 0; i < variants.size; i++)
+    {
+        uint32_t h = variants.array[i];
+        uint32_t b = bucket_of(index, h);
+        for(uint32_t j = index->bucket_start[b]; j < index->bucket_start[b + 1]; j++)
+            if(index->hash[j] == h && !uint32_vector_push(&found, index->id[j])) goto done;
+    }
+    uint32_vector_sort(&found);
+    uint32_vector_unique(&found, NULL);
+    r = found.size;
+    if(r > 0)
+    {
+        *ids = found.array;
+        uint32_vector_init(&found);
+    }
+done:
+    free(buf);
+    uint32_vector_done(&found);
+    uint32_vector_done(&variants);
+    return r;
+}
+
+const symbol_t * deletion_index_word(const struct deletion_index *index,
+        uint32_t id, size_t *len)
+{
+    *len = index->word_start[id + 1] - index->word_start[id];
+    return index->text + index->word_start[id];
+}
+
+/**
+ * @}
+ */
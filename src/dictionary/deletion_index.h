@@ -0,0 +1,134 @@
+/** @file
+    Interfejs indeksu usunięć.
+
+    Indeks przechowuje skróty wszystkich słów powstałych ze słów słownika
+    przez usunięcie co najwyżej kilku liter (jak w algorytmie SymSpell).
+    Jeśli słowo ze słownika jest w odległości co najwyżej k operacji
+    edycyjnych (usunięcie, wstawienie, zamiana, przestawienie) od zapytania,
+    to po usunięciu co najwyżej k liter z każdego z nich dostajemy to samo słowo.
+    Kandydatów na podpowiedzi znajduje się więc przez sprawdzenie w indeksie
+    skrótów słów powstałych z zapytania; kandydatów trzeba potem sprawdzić,
+    bo skróty mogą się powtarzać.
+
+    Indeks jest jednym ciągłym blokiem pamięci bez wskaźników, więc można
+    go zapisać do pliku i potem zmapować do pamięci bez wczytywania.
+    Słowa mają w indeksie numery nadawane w kolejności drzewa.
+
+    @ingroup dictionary
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+    @copyright Uniwerstet Warszawski
+    @date 2015-06-26
+ */
+
+#ifndef DICTIONARY_DELETION_INDEX_H
+#define DICTIONARY_DELETION_INDEX_H
+
+#include "alphabet.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Indeks usunięć.
+ */
+struct deletion_index;
+
+struct trie_node;
+
+/**
+ * Buduje indeks słów z drzewa.
+ *
+ * @param[in] root Korzeń drzewa TRIE.
+ * @param[in] alphabet Alfabet, w którym zapisano drzewo.
+ * @param[in] depth Największa liczba usuwanych liter.
+ * @return Nowy indeks lub NULL, jeśli brakło pamięci.
+ */
+struct deletion_index * deletion_index_build(const struct trie_node *root,
+        const struct alphabet *alphabet, int depth);
+
+/**
+ * Mapuje do pamięci indeks zapisany w pliku.
+ * Indeks zbudowany dla innego zbioru słów jest odrzucany.
+ *
+ * @param[in] path Ścieżka do pliku.
+ * @param[in] root Korzeń drzewa TRIE, dla którego zbudowano indeks.
+ * @param[in] alphabet Alfabet, w którym zapisano drzewo.
+ * @return Indeks lub NULL, jeśli pliku nie ma, jest niepoprawny
+ * albo nie pasuje do drzewa.
+ */
+struct deletion_index * deletion_index_map(const char *path,
+        const struct trie_node *root, const struct alphabet *alphabet);
+
+/**
+ * Zapisuje indeks do pliku.
+ *
+ * @param[in] index Indeks.
+ * @param[in,out] file Plik otwarty w trybie binarnym.
+ * @return 0 jeśli się udało, -1 w p.p.
+ */
+int deletion_index_save(const struct deletion_index *index, FILE *file);
+
+/**
+ * Usuwa indeks.
+ * Współdzielony indeks traci tylko jednego właściciela.
+ *
+ * @param[in] index Indeks lub NULL.
+ */
+void deletion_index_done(struct deletion_index *index);
+
+/**
+ * Dodaje indeksowi właściciela; indeks się nie zmienia, więc może go
+ * używać kilka słowników o tych samych słowach.
+ * Każdy właściciel zwalnia indeks przez deletion_index_done().
+ *
+ * @param[in,out] index Indeks lub NULL.
+ * @return Ten sam indeks.
+ */
+struct deletion_index * deletion_index_share(struct deletion_index *index);
+
+/**
+ * Zwraca największą liczbę liter usuwanych ze słów słownika.
+ *
+ * @param[in] index Indeks.
+ * @return Głębokość indeksu.
+ */
+int deletion_index_depth(const struct deletion_index *index);
+
+/**
+ * Zwraca liczbę bajtów pamięci zajmowanej przez indeks
+ * (razem z blokiem zmapowanym z pliku).
+ *
+ * @param[in] index Indeks.
+ * @return Rozmiar indeksu w bajtach.
+ */
+size_t deletion_index_memory(const struct deletion_index *index);
+
+/**
+ * Znajduje kandydatów na podpowiedzi: słowa, z których po usunięciu
+ * co najwyżej deletion_index_depth() liter dostaje się to samo, co ze
+ * słowa po usunięciu co najwyżej `deletions` liter.
+ * Wśród kandydatów mogą być słowa, które tylko mają taki sam skrót.
+ *
+ * @param[in] index Indeks.
+ * @param[in] word Słowo.
+ * @param[in] deletions Największa liczba liter usuwanych ze słowa.
+ * @param[out] ids Tablica numerów kandydatów posortowana rosnąco
+ * (do zwolnienia przez free(); NULL, jeśli kandydatów nie ma).
+ * @return Liczba kandydatów lub -1, jeśli brakło pamięci.
+ */
+int deletion_index_candidates(const struct deletion_index *index,
+        const symbol_t *word, int deletions, uint32_t **ids);
+
+/**
+ * Zwraca słowo o danym numerze.
+ *
+ * @param[in] index Indeks.
+ * @param[in] id Numer słowa.
+ * @param[out] len Długość słowa.
+ * @return Słowo w symbolach alfabetu (niezakończone zerem).
+ */
+const symbol_t * deletion_index_word(const struct deletion_index *index,
+        uint32_t id, size_t *len);
+
+#endif /* DICTIONARY_DELETION_INDEX_H */
@@ -0,0 +1,187 @@
+/** @file
+  Test implementacji indeksu usunięć.
+
+  @ingroup dictionary
+  @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+  @copyright Uniwerstet Warszawski
+  @date 2015-06-26
+ */
+
+#include <stdlib.h>
+#include <locale.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <cmocka.h>
+#include "alphabet.h"
+#include "deletion_index.h"
+#include "trie.h"
+#include "../testable.h"
+
+/// Słowa w testowym drzewie.
+static const wchar_t *words[] = { L"kot", L"kto", L"ko", L"kotek", L"lot", L"pies" };
+
+/// Liczba słów w testowym drzewie.
+#define WORDS_NO (sizeof(words) / sizeof(words[0]))
+
+/**
+ * Testowe drzewo z alfabetem.
+ */
+struct fixture
+{
+    struct trie_node *root;     ///< Drzewo.
+    struct alphabet *alphabet;  ///< Alfabet drzewa.
+};
+
+/**
+ * Tworzy drzewo z testowymi słowami.
+ */
+static int fixture_setup(void **state)
+{
+    struct fixture *f = malloc(sizeof(struct fixture));
+    f->root = trie_init();
+    f->alphabet = alphabet_new();
+    symbol_t buffer[16];
+    for(size_t i = 0; i < WORDS_NO; i++)
+    {
+        alphabet_encode_add(f->alphabet, words[i], buffer);
+        trie_insert(f->root, buffer);
+    }
+    *state = f;
+    return 0;
+}
+
+/**
+ * Usuwa drzewo z testowymi słowami.
+ */
+static int fixture_teardown(void **state)
+{
+    struct fixture *f = *state;
+    trie_done(f->root);
+    alphabet_done(f->alphabet);
+    free(f);
+    return 0;
+}
+
+/**
+ * Porównuje słowo z indeksu ze słowem w postaci znaków.
+ */
+static bool word_equal(const struct deletion_index *index, const struct alphabet *alphabet,
+        uint32_t id, const wchar_t *word)
+{
+    size_t len;
+    const symbol_t *s = deletion_index_word(index, id, &len);
+    if(len != wcslen(word)) return false;
+    for(size_t i = 0; i < len; i++)
+        if(alphabet_letter(alphabet, s[i]) != word[i]) return false;
+    return true;
+}
+
+/**
+ * Sprawdza, czy wśród kandydatów jest dane słowo.
+ */
+static bool has_candidate(const struct deletion_index *index, const struct alphabet *alphabet,
+        const uint32_t *ids, int n, const wchar_t *word)
+{
+    for(int i = 0; i < n; i++)
+        if(word_equal(index, alphabet, ids[i], word)) return true;
+    return false;
+}
+
+/**
+ * Sprawdza kandydatów dla zapytania.
+ */
+static void check_candidates(const struct deletion_index *index, const struct alphabet *alphabet)
+{
+    symbol_t query[16];
+    uint32_t *ids;
+    // "kot" przez usunięcie z "kotek" i sam ze sobą
+    alphabet_encode_query(alphabet, L"kot", query);
+    int n = deletion_index_candidates(index, query, 0, &ids);
+    assert_int_equal(n, 2);
+    assert_true(ids[0] < ids[1]);
+    assert_true(has_candidate(index, alphabet, ids, n, L"kot"));
+    assert_true(has_candidate(index, alphabet, ids, n, L"kotek"));
+    free(ids);
+    // Z jednym usunięciem z zapytania dochodzą "ko", "kto" i "lot"
+    n = deletion_index_candidates(index, query, 1, &ids);
+    assert_int_equal(n, 5);
+    assert_false(has_candidate(index, alphabet, ids, n, L"pies"));
+    free(ids);
+    // Brak wspólnych słów
+    alphabet_encode_query(alphabet, L"zzzzzzz", query);
+    n = deletion_index_candidates(index, query, 1, &ids);
+    assert_int_equal(n, 0);
+    assert_true(ids == NULL);
+}
+
+/**
+ * Testuje budowanie indeksu i szukanie kandydatów.
+ */
+static void deletion_index_build_test(void **state)
+{
+    struct fixture *f = *state;
+    struct deletion_index *index = deletion_index_build(f->root, f->alphabet, 2);
+    assert_true(index != NULL);
+    assert_int_equal(deletion_index_depth(index), 2);
+    for(size_t i = 0; i < WORDS_NO; i++)
+    {
+        bool found = false;
+        for(uint32_t id = 0; id < WORDS_NO; id++)
+            found |= word_equal(index, f->alphabet, id, words[i]);
+        assert_true(found);
+    }
+    check_candidates(index, f->alphabet);
+    deletion_index_done(index);
+}
+
+/**
+ * Testuje zapis indeksu i mapowanie go z pliku.
+ */
+static void deletion_index_map_test(void **state)
+{
+    struct fixture *f = *state;
+    char path[] = "/tmp/deletion_index_testXXXXXX";
+    int fd = mkstemp(path);
+    assert_true(fd >= 0);
+    FILE *file = fdopen(fd, "wb");
+    struct deletion_index *index = deletion_index_build(f->root, f->alphabet, 2);
+    assert_int_equal(deletion_index_save(index, file), 0);
+    fclose(file);
+    deletion_index_done(index);
+
+    index = deletion_index_map(path, f->root, f->alphabet);
+    assert_true(index != NULL);
+    assert_int_equal(deletion_index_depth(index), 2);
+    check_candidates(index, f->alphabet);
+    deletion_index_done(index);
+
+    // Indeks innego zbioru słów jest odrzucany
+    symbol_t buffer[16];
+    alphabet_encode_add(f->alphabet, L"kotka", buffer);
+    trie_insert(f->root, buffer);
+    assert_true(deletion_index_map(path, f->root, f->alphabet) == NULL);
+    trie_delete(f->root, buffer);
+    assert_true(deletion_index_map("/nonexistent/deletion_index", f->root, f->alphabet) == NULL);
+
+    // Ucięty plik jest odrzucany
+    assert_int_equal(truncate(path, 40), 0);
+    assert_true(deletion_index_map(path, f->root, f->alphabet) == NULL);
+    unlink(path);
+}
+
+/**
+ * Uruchamia testy.
+ */
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(deletion_index_build_test, fixture_setup, fixture_teardown),
+        cmocka_unit_test_setup_teardown(deletion_index_map_test, fixture_setup, fixture_teardown),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -10,13 +10,18 @@
   @date 2015-06-15
  */
 
+#include "alphabet.h"
 #include "conf.h"
+#include "deletion_index.h"
 #include "dictionary.h"
 #include "list.h"
 #include "rule.h"
 #include "serialization.h"
 #include "trie.h"
+#include "utf8.h"
+#include "vector.h"
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,22 +30,184 @@
 
 #define _GNU_SOURCE
 
+/**
+  Znacznik na początku pliku słownika zapisanego wraz z alfabetem.
+  Pliki w starym formacie zaczynają się od litery albo od końca drzewa (2).
+ */
+#define DICTIONARY_FORMAT_ALPHABET 3
+
+/**
+  Długość słów, które są kodowane w buforze na stosie.
+ */
+#define DICTIONARY_WORD_BUFFER 64
+
+/**
+  Wczytany słownik jest zagęszczany, jeśli wolne miejsca zajmują co najmniej
+  taką część pamięci tablic dzieci (zob. dictionary_compact()).
+ */
+#define DICTIONARY_COMPACT_WASTE 0.25
+
 /**
   Struktura przechowująca słownik.
   
-  Słowa są przechowywane w drzewie TRIE.
+  Słowa są przechowywane w drzewie TRIE jako napisy z symboli alfabetu.
  */
 struct dictionary
 {
     struct trie_node *root;      ///< Korzeń drzewa TRIE
     int max_cost;                ///< Maksymalny koszt podpowiedzi.
+    int threads;                 ///< Liczba wątków do generowania jednej podpowiedzi.
     struct list *rules;          ///< Lista reguł podpowiedzi.
+    struct alphabet *alphabet;   ///< Alfabet słownika.
+    struct deletion_index *index;   ///< Indeks usunięć lub NULL.
+    const struct dictionary *base;  ///< Słownik pod nakładką lub NULL.
+    struct trie_node *removed;      ///< Słowa usunięte ze słownika pod nakładką lub NULL.
+#ifdef DICTIONARY_HINT_STATS
+    struct hint_stats *stats;       ///< Statystyki generowania podpowiedzi lub NULL.
+#endif
+};
+
+#ifdef DICTIONARY_HINT_STATS
+/// Statystyki generowania podpowiedzi słownika przekazywane do trie_hints().
+#define DICTIONARY_STATS(dict) ((dict)->stats)
+#else
+#define DICTIONARY_STATS(dict) NULL
+#endif
+
+/**
+  Podpowiedź znaleziona w jednej z warstw słownika.
+ */
+struct layer_hint
+{
+    const wchar_t *text;        ///< Podpowiedź (po zebraniu podpowiedzi ze wszystkich warstw).
+    size_t id;                  ///< Numer podpowiedzi na liście tekstów.
+    int cost;                   ///< Koszt podpowiedzi.
+    unsigned int freq;          ///< Częstość podpowiedzi.
+};
+
+/**
+  Porządek podpowiedzi z warstw: jak w trie_hints().
+  @param[in] a Pierwsza podpowiedź.
+  @param[in] b Druga podpowiedź.
+  @return True jeśli pierwsza podpowiedź jest przed drugą.
+ */
+static inline bool layer_hint_less(const struct layer_hint *a, const struct layer_hint *b)
+{
+    if(a->cost != b->cost) return a->cost < b->cost;
+    if(a->freq != b->freq) return a->freq > b->freq;
+    int c = wcscoll(a->text, b->text);
+    if(c != 0) return c < 0;
+    return a->id < b->id;
+}
+
+/**
+  Porządek uzupełnień z warstw: jak w trie_complete().
+  @param[in] a Pierwsze uzupełnienie.
+  @param[in] b Drugie uzupełnienie.
+  @return True jeśli pierwsze uzupełnienie jest przed drugim.
+ */
+static inline bool layer_completion_less(const struct layer_hint *a, const struct layer_hint *b)
+{
+    if(a->freq != b->freq) return a->freq > b->freq;
+    size_t al = wcslen(a->text), bl = wcslen(b->text);
+    if(al != bl) return al < bl;
+    int c = wcscmp(a->text, b->text);
+    if(c != 0) return c < 0;
+    return a->id < b->id;
+}
+
+VECTOR_DEFINE(layer_hint_vector, struct layer_hint)
+VECTOR_DEFINE_SORT(layer_hint_vector, struct layer_hint, layer_hint_less)
+VECTOR_DEFINE(layer_completion_vector, struct layer_hint)
+VECTOR_DEFINE_SORT(layer_completion_vector, struct layer_hint, layer_completion_less)
+
+/**
+  Przeglądanie słów jednej warstwy słownika.
+ */
+struct layer_cursor
+{
+    struct trie_iter *it;           ///< Przeglądanie drzewa warstwy.
+    const wchar_t *word;            ///< Bieżące słowo warstwy lub NULL na końcu.
+    const struct trie_node *node;   ///< Węzeł bieżącego słowa.
+    bool consumed;                  ///< Czy bieżące słowo zostało już zwrócone.
+};
+
+/**
+  Przeglądanie słów słownika: słowa wszystkich warstw są scalane
+  po kolei, a słowa zasłonięte przez wyższe warstwy są pomijane.
+ */
+struct dictionary_iter
+{
+    const struct dictionary *dict;  ///< Słownik.
+    size_t layers;                  ///< Liczba warstw.
+    struct layer_cursor cursors[];  ///< Przeglądanie kolejnych warstw od najwyższej.
 };
 
 /** @name Funkcje pomocnicze
   @{
  */
 
+/**
+ * Tworzy wyzerowane statystyki generowania podpowiedzi słownika.
+ * Bez opcji `DICTIONARY_HINT_STATS` nic nie robi.
+ * @param[in,out] dict Słownik.
+ */
+static void stats_init(struct dictionary *dict)
+{
+#ifdef DICTIONARY_HINT_STATS
+    dict->stats = hint_stats_new(list_size(dict->rules));
+#endif
+}
+
+/**
+ * Zeruje liczniki reguł po zmianie listy reguł słownika,
+ * bo reguły mogły zmienić numery.
+ * Bez opcji `DICTIONARY_HINT_STATS` nic nie robi.
+ * @param[in,out] dict Słownik.
+ */
+static void stats_rules_changed(struct dictionary *dict)
+{
+#ifdef DICTIONARY_HINT_STATS
+    if(dict->stats != NULL) hint_stats_rules_reset(dict->stats, list_size(dict->rules));
+#endif
+}
+
+/**
+ * Zagęszcza drzewo słownika i drzewo słów usuniętych.
+ * @param[in,out] dict Słownik.
+ * @param[in] threads Liczba wątków kopiujących poddrzewa korzenia.
+ * @return 0 jeśli się udało, -1 jeśli brakło pamięci.
+ */
+static int compact(struct dictionary *dict, int threads)
+{
+    struct trie_node *root = trie_compact(dict->root, threads);
+    if(root == NULL) return -1;
+    dict->root = root;
+    if(dict->removed != NULL)
+    {
+        struct trie_node *removed = trie_compact(dict->removed, 1);
+        if(removed == NULL) return -1;
+        dict->removed = removed;
+    }
+    return 0;
+}
+
+/**
+ * Zagęszcza słownik, jeśli tablice dzieci mają co najmniej
+ * DICTIONARY_COMPACT_WASTE wolnych miejsc. Kopiujemy w jednym wątku,
+ * bo biblioteka nie uruchamia wątków, o które nie poprosił użytkownik
+ * (równolegle zagęszcza dictionary_compact()). Brak pamięci na zagęszczenie
+ * nie jest błędem, bo słownik się wtedy nie zmienia.
+ * @param[in,out] dict Słownik.
+ */
+static void compact_wasteful(struct dictionary *dict)
+{
+    size_t used;
+    size_t slots = trie_child_slots(dict->root, &used);
+    if(slots == used || slots - used < DICTIONARY_COMPACT_WASTE * slots) return;
+    compact(dict, 1);
+}
+
 /**
  * Filters only files with .dict extension.
  * @param[in] f Filter entity.
@@ -67,6 +234,573 @@ void rule_done_wrapper(void *r, void *ctx)
         rule_done((struct hint_rule*)r);
 }
 
+/**
+ * Zwraca bufor na zakodowane słowo.
+ * @param[in] stack Bufor na stosie (DICTIONARY_WORD_BUFFER symboli).
+ * @param[in] len Maksymalna długość zakodowanego słowa.
+ * @return Bufor na stosie, jeśli słowo się w nim zmieści, w p.p. nowo
+ * zaalokowany bufor (NULL, jeśli brakło pamięci).
+ */
+static symbol_t * word_buffer(symbol_t *stack, size_t len)
+{
+    if(len < DICTIONARY_WORD_BUFFER) return stack;
+    return malloc((len + 1) * sizeof(symbol_t));
+}
+
+/**
+ * Zwalnia bufor zwrócony przez word_buffer().
+ * @param[in] stack Bufor na stosie.
+ * @param[in] buffer Bufor do zwolnienia.
+ */
+static void word_buffer_done(symbol_t *stack, symbol_t *buffer)
+{
+    if(buffer != stack) free(buffer);
+}
+
+/**
+ * Zapisuje podpowiedzi w UTF-8 jako łańcuchy oddzielone znakiem '\0'.
+ * @param[in] hints Podpowiedzi.
+ * @param[out] list Bufor z podpowiedziami (NULL, jeśli lista jest pusta).
+ * @param[out] list_len Długość bufora.
+ * @return Liczba podpowiedzi lub -1, jeśli brakło pamięci.
+ */
+static int hints_to_utf8(const struct word_list *hints, char **list, size_t *list_len)
+{
+    size_t n = word_list_size(hints);
+    const wchar_t * const *words = word_list_get(hints);
+    size_t len = 0;
+    for(size_t i = 0; i < n; i++)
+        len += utf8_length(words[i]) + 1;
+    if(len == 0) return 0;
+    char *out = malloc(len);
+    if(out == NULL) return -1;
+    char *end = out;
+    for(size_t i = 0; i < n; i++)
+    {
+        for(const wchar_t *c = words[i]; *c != 0; c++)
+            end += utf8_encode(*c, end);
+        *end++ = 0;
+    }
+    *list = out;
+    *list_len = len;
+    return n;
+}
+
+/**
+ * Dekoduje słowo zapisane w UTF-8.
+ * @param[in] word Słowo w UTF-8.
+ * @param[in] len Długość słowa w bajtach.
+ * @return Słowo zakończone zerem (do zwolnienia przez free()) lub NULL,
+ * jeśli słowo nie jest poprawnym UTF-8 albo brakło pamięci.
+ */
+static wchar_t * utf8_to_wide(const char *word, size_t len)
+{
+    wchar_t *w = malloc((len + 1) * sizeof(wchar_t));
+    if(w == NULL) return NULL;
+    size_t n = 0;
+    while(len > 0)
+    {
+        size_t l = utf8_decode(word, len, &w[n++]);
+        if(l == 0)
+        {
+            free(w);
+            return NULL;
+        }
+        word += l;
+        len -= l;
+    }
+    w[n] = 0;
+    return w;
+}
+
+/**
+ * Tłumaczy reguły na symbole alfabetu i usuwa reguły zbędne.
+ * @param[in] rules Lista reguł.
+ * @param[in,out] alphabet Alfabet.
+ * @return 0 jeśli się udało, -1 w p.p.
+ */
+static int compile_rules(struct list *rules, struct alphabet *alphabet)
+{
+    struct hint_rule **r = (struct hint_rule **)list_get(rules);
+    for(size_t i = 0; i < list_size(rules); i++)
+    {
+        // list_deserialize() wstawia NULL za reguły, których nie udało się wczytać
+        if(r[i] == NULL) return -1;
+        rule_canonicalize(r[i]);
+        if(rule_compile(r[i], alphabet)<0) return -1;
+    }
+    // Zbędne reguły z plików zapisanych przed ich odrzucaniem
+    rule_normalize(rules, NULL);
+    return 0;
+}
+
+/**
+ * Koduje słowo, dodając brakujące litery do alfabetu słownika.
+ * Alfabet współdzielony z klonami jest kopiowany tylko wtedy, gdy
+ * brakuje w nim liter słowa.
+ * @param[in,out] dict Słownik.
+ * @param[in] word Słowo.
+ * @param[out] out Bufor na zakodowane słowo.
+ * @return 0 jeśli się udało, -1 w p.p.
+ */
+static int encode_add(struct dictionary *dict, const wchar_t *word, symbol_t *out)
+{
+    if(alphabet_encode(dict->alphabet, word, out) == 0) return 0;
+    struct alphabet *alphabet = alphabet_unshare(dict->alphabet);
+    if(alphabet == NULL) return -1;
+    dict->alphabet = alphabet;
+    return alphabet_encode_add(alphabet, word, out);
+}
+
+/**
+ * Przygotowuje drzewa słownika do zmian; korzenie współdzielone
+ * z klonami są kopiowane.
+ * @param[in,out] dict Słownik.
+ */
+static void trees_unshare(struct dictionary *dict)
+{
+    dict->root = trie_unshare(dict->root);
+    if(dict->removed != NULL) dict->removed = trie_unshare(dict->removed);
+}
+
+/**
+ * Zamienia działanie na zbiorach słów na słowa zachowywane przez trie_combine().
+ * @param[in] op Działanie.
+ * @return Suma flag enum trie_keep.
+ */
+static int combine_keep(enum dictionary_set_op op)
+{
+    switch(op)
+    {
+        case DICTIONARY_MERGE:
+            return TRIE_KEEP_ONLY_A | TRIE_KEEP_ONLY_B | TRIE_KEEP_BOTH;
+        case DICTIONARY_SUBTRACT:
+            return TRIE_KEEP_ONLY_A;
+        case DICTIONARY_INTERSECT:
+            return TRIE_KEEP_BOTH;
+        case DICTIONARY_DIFF:
+            return TRIE_KEEP_ONLY_A | TRIE_KEEP_ONLY_B;
+    }
+    return 0;
+}
+
+/**
+ * Tworzy alfabet wyniku działania na dwóch słownikach: alfabet pierwszego
+ * uzupełniony o litery drugiego.
+ * @param[in] a Pierwszy słownik.
+ * @param[in] b Drugi słownik.
+ * @param[out] map Tablica (indeksowana symbolami) na symbole liter drugiego
+ * słownika w nowym alfabecie.
+ * @return Nowy alfabet lub NULL, jeśli brakło pamięci lub miejsca w alfabecie.
+ */
+static struct alphabet * combine_alphabet(const struct dictionary *a,
+        const struct dictionary *b, symbol_t *map)
+{
+    struct alphabet *alphabet = alphabet_copy(a->alphabet);
+    if(alphabet == NULL) return NULL;
+    for(int i = 0; i < alphabet_size(b->alphabet); i++)
+    {
+        symbol_t s = SYMBOL_LETTER_FIRST + i;
+        map[s] = alphabet_add(alphabet, alphabet_letter(b->alphabet, s));
+        if(map[s] == 0)
+        {
+            alphabet_done(alphabet);
+            return NULL;
+        }
+    }
+    return alphabet;
+}
+
+/**
+ * Sprawdza, czy litery drugiego słownika mają w alfabecie wyniku te same symbole.
+ * @param[in] b Drugi słownik.
+ * @param[in] map Symbole liter drugiego słownika w alfabecie wyniku.
+ * @return Tablica `map` lub NULL, jeśli nie trzeba tłumaczyć symboli.
+ */
+static const symbol_t * combine_map(const struct dictionary *b, const symbol_t *map)
+{
+    for(int i = 0; i < alphabet_size(b->alphabet); i++)
+        if(map[SYMBOL_LETTER_FIRST + i] != SYMBOL_LETTER_FIRST + i) return map;
+    return NULL;
+}
+
+/**
+ * Tworzy słownik z wyniku działania na zbiorach słów dwóch słowników.
+ * @param[in,out] a Pierwszy słownik.
+ * @param[in,out] b Drugi słownik.
+ * @param[in] op Działanie.
+ * @return Nowy słownik lub NULL, jeśli wystąpił błąd.
+ */
+static struct dictionary * dictionary_combine(struct dictionary *a,
+        struct dictionary *b, enum dictionary_set_op op)
+{
+    if(a->base != NULL || b->base != NULL) return NULL;
+    symbol_t map[UCHAR_MAX + 1];
+    struct alphabet *alphabet = combine_alphabet(a, b, map);
+    struct dictionary *dict = alphabet != NULL ? malloc(sizeof(struct dictionary)) : NULL;
+    struct list *rules = dict != NULL ? list_init() : NULL;
+    if(rules == NULL)
+    {
+        if(alphabet != NULL) alphabet_done(alphabet);
+        free(dict);
+        return NULL;
+    }
+    // Reguły pierwszego słownika pasują do alfabetu, który go rozszerza
+    struct hint_rule **r = (struct hint_rule **)list_get(a->rules);
+    for(size_t i = 0; i < list_size(a->rules); i++)
+        list_add(rules, rule_share(r[i]));
+    list_terminate(rules);
+    dict->root = trie_combine(a->root, b->root, combine_map(b, map), combine_keep(op));
+    dict->max_cost = a->max_cost;
+    dict->threads = a->threads;
+    dict->rules = rules;
+    dict->alphabet = alphabet;
+    dict->index = NULL;
+    dict->base = NULL;
+    dict->removed = NULL;
+    stats_init(dict);
+    return dict;
+}
+
+/**
+ * Usuwa indeks usunięć, bo zmieniły się słowa słownika.
+ * @param[in,out] dict Słownik.
+ */
+static void index_drop(struct dictionary *dict)
+{
+    deletion_index_done(dict->index);
+    dict->index = NULL;
+}
+
+/**
+ * Znajduje słowo w drzewie jednej warstwy słownika.
+ * @param[in] root Drzewo.
+ * @param[in] alphabet Alfabet, w którym zapisano drzewo.
+ * @param[in] word Słowo.
+ * @param[in] len Długość słowa.
+ * @return Węzeł kończący słowo lub NULL, jeśli słowa nie ma w drzewie.
+ */
+static const struct trie_node * layer_node(const struct trie_node *root,
+        const struct alphabet *alphabet, const wchar_t *word, size_t len)
+{
+    const struct trie_node *node = root;
+    for(size_t i = 0; i < len && node != NULL; i++)
+    {
+        symbol_t s = alphabet_symbol(alphabet, word[i]);
+        if(s == 0) return NULL;
+        node = trie_get_child(node, s);
+    }
+    if(node == NULL || !trie_is_leaf(node)) return NULL;
+    return node;
+}
+
+/**
+ * Sprawdza, czy nakładka usuwa słowo ze słownika pod spodem.
+ * @param[in] dict Warstwa słownika.
+ * @param[in] word Słowo.
+ * @param[in] len Długość słowa.
+ * @return True jeśli słowo jest usunięte w tej warstwie.
+ */
+static bool layer_removed(const struct dictionary *dict, const wchar_t *word, size_t len)
+{
+    return dict->removed != NULL && layer_node(dict->removed, dict->alphabet, word, len) != NULL;
+}
+
+/**
+ * Znajduje słowo w słowniku razem z warstwami pod nim.
+ * @param[in] dict Słownik.
+ * @param[in] word Słowo.
+ * @param[in] len Długość słowa.
+ * @return Węzeł kończący słowo w najwyższej warstwie, która je zawiera,
+ * lub NULL, jeśli słowa nie ma albo zostało usunięte.
+ */
+static const struct trie_node * stack_node(const struct dictionary *dict,
+        const wchar_t *word, size_t len)
+{
+    for(; dict != NULL; dict = dict->base)
+    {
+        const struct trie_node *node = layer_node(dict->root, dict->alphabet, word, len);
+        if(node != NULL) return node;
+        if(layer_removed(dict, word, len)) return NULL;
+    }
+    return NULL;
+}
+
+/**
+ * Sprawdza, czy podpowiedź z warstwy słownika jest widoczna spod warstw
+ * nad nią i wyznacza jej częstość.
+ * Pojedyncze słowo jest zasłonięte, jeśli jest też w wyższej warstwie
+ * (wtedy liczy się podpowiedź z tamtej warstwy). Podpowiedź z kilku słów
+ * jest ukryta, jeśli któreś z nich usunięto w wyższej warstwie.
+ * @param[in] top Najwyższa warstwa.
+ * @param[in] layer Warstwa, z której pochodzi podpowiedź.
+ * @param[in] hint Podpowiedź (słowa oddzielone spacjami).
+ * @param[out] freq Najmniejsza częstość słowa podpowiedzi w całym słowniku.
+ * @return True jeśli podpowiedź jest widoczna.
+ */
+static bool hint_visible(const struct dictionary *top, const struct dictionary *layer,
+        const wchar_t *hint, unsigned int *freq)
+{
+    bool single = wcschr(hint, L' ') == NULL;
+    *freq = DICTIONARY_MAX_FREQUENCY;
+    for(const wchar_t *w = hint; ; w++)
+    {
+        size_t len = wcscspn(w, L" ");
+        for(const struct dictionary *d = top; d != layer; d = d->base)
+            if(layer_removed(d, w, len)
+               || (single && layer_node(d->root, d->alphabet, w, len) != NULL))
+                return false;
+        const struct trie_node *node = stack_node(top, w, len);
+        if(node != NULL && trie_get_frequency(node) < *freq) *freq = trie_get_frequency(node);
+        w += len;
+        if(*w == 0) break;
+    }
+    return true;
+}
+
+/**
+ * Tłumaczy reguły najwyższej warstwy na symbole alfabetu niższej warstwy.
+ * Nowe litery trafiają do kopii alfabetu, więc warstwa się nie zmienia.
+ * @param[in] rules Reguły najwyższej warstwy.
+ * @param[in] layer Niższa warstwa.
+ * @param[out] alphabet Kopia alfabetu warstwy z literami reguł.
+ * @return Lista przetłumaczonych reguł lub NULL, jeśli brakło pamięci.
+ */
+static struct list * layer_rules(struct list *rules, const struct dictionary *layer,
+        struct alphabet **alphabet)
+{
+    struct list *compiled = list_init();
+    *alphabet = alphabet_copy(layer->alphabet);
+    if(compiled == NULL || *alphabet == NULL) goto fail;
+    struct hint_rule **r = (struct hint_rule **)list_get(rules);
+    for(size_t i = 0; i < list_size(rules); i++)
+    {
+        struct hint_rule *c = rule_copy(r[i]);
+        if(c == NULL) goto fail;
+        list_add(compiled, c);
+        if(rule_compile(c, *alphabet) < 0) goto fail;
+    }
+    list_terminate(compiled);
+    return compiled;
+fail:
+    if(compiled != NULL)
+    {
+        list_iter(compiled, NULL, rule_done_wrapper);
+        list_done(compiled);
+    }
+    if(*alphabet != NULL) alphabet_done(*alphabet);
+    *alphabet = NULL;
+    return NULL;
+}
+
+/**
+ * Przenosi widoczne podpowiedzi z listy warstwy do wspólnej listy tekstów.
+ * Podpowiedzi od `before` mają numery na liście warstwy, a dostają numery
+ * na wspólnej liście.
+ * @param[in,out] found Podpowiedzi.
+ * @param[in] before Liczba podpowiedzi z poprzednich warstw.
+ * @param[in] words Lista warstwy.
+ * @param[in,out] texts Wspólna lista tekstów.
+ */
+static void layer_commit(struct layer_hint_vector *found, size_t before,
+        const struct word_list *words, struct word_list *texts)
+{
+    for(size_t j = before; j < found->size; j++)
+    {
+        size_t id = found->array[j].id;
+        found->array[j].id = word_list_size(texts);
+        word_list_add(texts, word_list_get(words)[id]);
+    }
+}
+
+/**
+ * Dopisuje widoczne podpowiedzi z jednej warstwy słownika, wygenerowane
+ * według reguł najwyższej warstwy.
+ * Podpowiedzi zasłonięte przez wyższe warstwy zajmują miejsca na liście,
+ * więc warstwa jest pytana o coraz więcej podpowiedzi, aż widocznych
+ * jest DICTIONARY_MAX_HINTS albo warstwa nie ma więcej podpowiedzi.
+ * @param[in] top Najwyższa warstwa.
+ * @param[in] layer Warstwa.
+ * @param[in] word Słowo.
+ * @param[in,out] found Podpowiedzi.
+ * @param[in,out] texts Teksty podpowiedzi.
+ * @return 0 jeśli się udało, -1 jeśli brakło pamięci.
+ */
+static int layer_hints(const struct dictionary *top, const struct dictionary *layer,
+        const wchar_t *word, struct layer_hint_vector *found, struct word_list *texts)
+{
+    struct alphabet *scratch = NULL;
+    struct list *rules = top->rules;
+    if(layer != top && (rules = layer_rules(top->rules, layer, &scratch)) == NULL)
+        return -1;
+    const struct alphabet *alphabet = scratch != NULL ? scratch : layer->alphabet;
+    int r = -1;
+    symbol_t stack[DICTIONARY_WORD_BUFFER];
+    symbol_t *sw = word_buffer(stack, wcslen(word));
+    if(sw == NULL) goto done;
+    alphabet_encode_query(alphabet, word, sw);
+    size_t before = found->size;
+    for(int limit = DICTIONARY_MAX_HINTS; r < 0; limit *= 2)
+    {
+        int *costs = malloc(limit * sizeof(int));
+        if(costs == NULL) break;
+        struct word_list list;
+        word_list_init(&list);
+        trie_hints(layer->root, alphabet, sw, &list, rules, layer->index, top->max_cost, limit, costs, top->threads, DICTIONARY_STATS(top));
+        size_t n = word_list_size(&list);
+        bool failed = false;
+        found->size = before;
+        for(size_t i = 0; i < n && !failed; i++)
+        {
+            struct layer_hint h = { NULL, i, costs[i], 0 };
+            if(hint_visible(top, layer, word_list_get(&list)[i], &h.freq))
+                failed = !layer_hint_vector_push(found, h);
+        }
+        free(costs);
+        if(!failed && (found->size - before >= DICTIONARY_MAX_HINTS || n < (size_t)limit))
+        {
+            layer_commit(found, before, &list, texts);
+            r = 0;
+        }
+        word_list_done(&list);
+        if(failed) break;
+    }
+    if(r < 0) found->size = before;
+done:
+    word_buffer_done(stack, sw);
+    if(scratch != NULL)
+    {
+        list_iter(rules, NULL, rule_done_wrapper);
+        list_done(rules);
+        alphabet_done(scratch);
+    }
+    return r;
+}
+
+/**
+ * Dopisuje widoczne uzupełnienia prefiksu z jednej warstwy słownika.
+ * Warstwa jest pytana o coraz więcej słów, jak w layer_hints().
+ * @param[in] top Najwyższa warstwa.
+ * @param[in] layer Warstwa.
+ * @param[in] prefix Prefiks.
+ * @param[in] k Największa liczba słów.
+ * @param[in,out] found Uzupełnienia.
+ * @param[in,out] texts Teksty uzupełnień.
+ * @return 0 jeśli się udało, -1 jeśli brakło pamięci.
+ */
+static int layer_complete(const struct dictionary *top, const struct dictionary *layer,
+        const wchar_t *prefix, size_t k, struct layer_hint_vector *found,
+        struct word_list *texts)
+{
+    symbol_t stack[DICTIONARY_WORD_BUFFER];
+    symbol_t *sw = word_buffer(stack, wcslen(prefix));
+    if(sw == NULL) return -1;
+    int r = 0;
+    // Prefiks z literą spoza alfabetu nie ma uzupełnień w tej warstwie
+    if(alphabet_encode(layer->alphabet, prefix, sw) == 0)
+    {
+        size_t before = found->size;
+        for(size_t limit = k; ; limit *= 2)
+        {
+            struct word_list words;
+            word_list_init(&words);
+            int n = trie_complete(layer->root, layer->alphabet, sw, limit, &words);
+            found->size = before;
+            for(int i = 0; i < n; i++)
+            {
+                struct layer_hint h = { NULL, i, 0, 0 };
+                if(hint_visible(top, layer, word_list_get(&words)[i], &h.freq)
+                   && !layer_hint_vector_push(found, h))
+                    n = -1;
+            }
+            bool done = n < 0 || found->size - before >= k || (size_t)n < limit;
+            if(n < 0)
+            {
+                found->size = before;
+                r = -1;
+            }
+            else if(done) layer_commit(found, before, &words, texts);
+            word_list_done(&words);
+            if(done) break;
+        }
+    }
+    word_buffer_done(stack, sw);
+    return r;
+}
+
+/**
+ * Tworzy podpowiedzi ze wszystkich warstw słownika.
+ * @param[in] dict Najwyższa warstwa.
+ * @param[in] word Słowo.
+ * @param[in,out] list Lista, do której dopisać podpowiedzi.
+ * @param[out] costs Tablica na koszty podpowiedzi albo NULL.
+ */
+static void stack_hints(const struct dictionary *dict, const wchar_t *word,
+        struct word_list *list, int *costs)
+{
+    struct layer_hint_vector found;
+    struct word_list texts;
+    layer_hint_vector_init(&found);
+    word_list_init(&texts);
+    for(const struct dictionary *d = dict; d != NULL; d = d->base)
+        if(layer_hints(dict, d, word, &found, &texts) < 0) break;
+    for(size_t j = 0; j < found.size; j++)
+        found.array[j].text = word_list_get(&texts)[found.array[j].id];
+    layer_hint_vector_sort(&found);
+    const struct layer_hint *last = NULL;
+    for(size_t j = 0; j < found.size && word_list_size(list) < DICTIONARY_MAX_HINTS; j++)
+    {
+        const struct layer_hint *h = &found.array[j];
+        // Równoważne napisy w jednej grupie są podawane raz, jak w trie_hints()
+        if(last != NULL && last->cost == h->cost && last->freq == h->freq
+           && wcscoll(last->text, h->text) == 0)
+            continue;
+        // Podpowiedź z kilku słów mogła przyjść z kilku warstw
+        bool dup = false;
+        for(size_t k = 0; k < word_list_size(list) && !dup; k++)
+            dup = wcscmp(word_list_get(list)[k], h->text) == 0;
+        if(dup) continue;
+        if(costs != NULL) costs[word_list_size(list)] = h->cost;
+        word_list_add(list, h->text);
+        last = h;
+    }
+    word_list_done(&texts);
+    layer_hint_vector_done(&found);
+}
+
+/**
+ * Znajduje najlepsze uzupełnienia prefiksu ze wszystkich warstw słownika.
+ * @param[in] dict Najwyższa warstwa.
+ * @param[in] prefix Prefiks.
+ * @param[in] k Największa liczba słów.
+ * @param[in,out] list Lista, do której dopisać słowa.
+ * @return Liczba dopisanych słów lub -1, jeśli brakło pamięci.
+ */
+static int stack_complete(const struct dictionary *dict, const wchar_t *prefix,
+        size_t k, struct word_list *list)
+{
+    struct layer_hint_vector found;
+    struct word_list texts;
+    layer_hint_vector_init(&found);
+    word_list_init(&texts);
+    int r = 0;
+    for(const struct dictionary *d = dict; d != NULL && r == 0; d = d->base)
+        r = layer_complete(dict, d, prefix, k, &found, &texts);
+    for(size_t j = 0; j < found.size; j++)
+        found.array[j].text = word_list_get(&texts)[found.array[j].id];
+    struct layer_completion_vector sorted;
+    layer_completion_vector_init(&sorted);
+    if(r == 0 && !layer_completion_vector_append(&sorted, found.array, found.size)) r = -1;
+    layer_completion_vector_sort(&sorted);
+    if(r == 0)
+        for(; (size_t)r < k && (size_t)r < sorted.size; r++)
+            word_list_add(list, sorted.array[r].text);
+    layer_completion_vector_done(&sorted);
+    word_list_done(&texts);
+    layer_hint_vector_done(&found);
+    return r;
+}
+
 /**
  * @}
  */
@@ -80,7 +814,14 @@ struct dictionary * dictionary_new()
         (struct dictionary *) malloc(sizeof(struct dictionary));
     dict->root = trie_init();
     dict->rules = list_init();
+    list_terminate(dict->rules);
     dict->max_cost = 0;
+    dict->threads = 1;
+    dict->alphabet = alphabet_new();
+    dict->index = NULL;
+    dict->base = NULL;
+    dict->removed = NULL;
+    stats_init(dict);
     return dict;
 }
 
@@ -89,38 +830,146 @@ void dictionary_done(struct dictionary *dict)
     trie_done(dict->root);
     list_iter(dict->rules, NULL, rule_done_wrapper);
     list_done(dict->rules);
+    alphabet_done(dict->alphabet);
+    deletion_index_done(dict->index);
+    if(dict->removed != NULL) trie_done(dict->removed);
+#ifdef DICTIONARY_HINT_STATS
+    hint_stats_done(dict->stats);
+#endif
     free(dict);
 }
 
 int dictionary_insert(struct dictionary *dict, const wchar_t *word)
 {
-    return trie_insert(dict->root, word);
+    size_t len = wcslen(word);
+    if(dict->base != NULL && stack_node(dict, word, len) != NULL) return 0;
+    symbol_t stack[DICTIONARY_WORD_BUFFER];
+    symbol_t *sw = word_buffer(stack, len);
+    if(sw == NULL) return 0;
+    int r = 0;
+    if(encode_add(dict, word, sw) == 0)
+    {
+        trees_unshare(dict);
+        // Słowo usunięte spod nakładki wystarczy przywrócić, chyba że ma
+        // częstość (wstawione na nowo słowo ma zerową)
+        const struct trie_node *below;
+        if(dict->removed != NULL && trie_delete(dict->removed, sw)
+           && (below = stack_node(dict->base, word, len)) != NULL
+           && trie_get_frequency(below) == 0)
+            r = 1;
+        else if((r = trie_insert(dict->root, sw)))
+            index_drop(dict);
+    }
+    word_buffer_done(stack, sw);
+    return r;
 }
 
 int dictionary_delete(struct dictionary *dict, const wchar_t *word)
 {
-    return trie_delete(dict->root, word);
+    size_t len = wcslen(word);
+    if(dict->base != NULL && stack_node(dict, word, len) == NULL) return 0;
+    symbol_t stack[DICTIONARY_WORD_BUFFER];
+    symbol_t *sw = word_buffer(stack, len);
+    if(sw == NULL) return 0;
+    int r = 0;
+    // Litery słowa spod nakładki mogą nie być jeszcze w jej alfabecie
+    if((dict->base == NULL ? alphabet_encode(dict->alphabet, word, sw)
+                           : encode_add(dict, word, sw)) == 0)
+    {
+        trees_unshare(dict);
+        if((r = trie_delete(dict->root, sw)))
+            index_drop(dict);
+        // Słowo spod nakładki jest tylko oznaczane jako usunięte
+        if(dict->base != NULL && stack_node(dict->base, word, len) != NULL)
+            r |= trie_insert(dict->removed, sw);
+    }
+    word_buffer_done(stack, sw);
+    return r;
 }
 
 bool dictionary_find(const struct dictionary *dict, const wchar_t* word)
 {
-    return trie_find(dict->root, word);
+    if(dict->base != NULL) return stack_node(dict, word, wcslen(word)) != NULL;
+    symbol_t stack[DICTIONARY_WORD_BUFFER];
+    symbol_t *sw = word_buffer(stack, wcslen(word));
+    if(sw == NULL) return false;
+    bool r = false;
+    if(alphabet_encode(dict->alphabet, word, sw) == 0)
+        r = trie_find(dict->root, sw);
+    word_buffer_done(stack, sw);
+    return r;
+}
+
+int dictionary_set_frequency(struct dictionary *dict, const wchar_t *word,
+        unsigned int freq)
+{
+    symbol_t stack[DICTIONARY_WORD_BUFFER];
+    symbol_t *sw = word_buffer(stack, wcslen(word));
+    if(sw == NULL) return 0;
+    int r = 0;
+    if(dict->base == NULL)
+    {
+        if(alphabet_encode(dict->alphabet, word, sw) == 0)
+        {
+            trees_unshare(dict);
+            r = trie_set_frequency(dict->root, sw, freq);
+        }
+    }
+    else if(stack_node(dict, word, wcslen(word)) != NULL
+            && encode_add(dict, word, sw) == 0)
+    {
+        trees_unshare(dict);
+        // Słowo spod nakładki dostaje w nakładce kopię z nową częstością
+        if(trie_insert(dict->root, sw)) index_drop(dict);
+        r = trie_set_frequency(dict->root, sw, freq);
+    }
+    word_buffer_done(stack, sw);
+    return r;
+}
+
+unsigned int dictionary_frequency(const struct dictionary *dict, const wchar_t *word)
+{
+    const struct trie_node *node = stack_node(dict, word, wcslen(word));
+    return node != NULL ? trie_get_frequency(node) : 0;
 }
 
 int dictionary_save(const struct dictionary *dict, FILE* stream)
 {
+    if(fputwc(DICTIONARY_FORMAT_ALPHABET, stream)<0) return -1;
+    if(alphabet_serialize(dict->alphabet, stream)<0) return -1;
     if(trie_serialize(dict->root, stream)<0) return -1;
     if(list_serialize(dict->rules, stream, (int(*)(void*,FILE*))rule_serialize)<0) return -1;
     if(int32_serialize(dict->max_cost, stream)<0) return -1;
+    if(dict->removed != NULL && trie_serialize(dict->removed, stream)<0) return -1;
     return 0;
 }
 
 struct dictionary * dictionary_load(FILE* stream)
 {
-    struct trie_node * root = trie_deserialize(stream);
+    struct alphabet *alphabet = NULL;
+    struct trie_node *root = NULL;
+    struct list *rules = NULL;
+    wint_t marker = fgetwc(stream);
+    if(marker == WEOF) goto fail;
+    if(marker == DICTIONARY_FORMAT_ALPHABET)
+    {
+        alphabet = alphabet_deserialize(stream);
+        if(alphabet == NULL) goto fail;
+        root = trie_deserialize(stream, NULL);
+    }
+    else
+    {
+        // Stary format: etykietami węzłów są litery
+        ungetwc(marker, stream);
+        alphabet = alphabet_new();
+        if(alphabet == NULL) goto fail;
+        root = trie_deserialize(stream, alphabet);
+    }
     if(root == NULL) goto fail;
-    struct list *rules = list_deserialize(stream, (void * (*)(FILE*))rule_deserialize);
+    rules = list_deserialize(stream, (void * (*)(FILE*))rule_deserialize);
     if(rules == NULL) goto fail;
+    if(compile_rules(rules, alphabet)<0) goto fail;
+    list_terminate(rules);
     int mcost;
     if(int32_deserialize(&mcost, stream)<0) goto fail;
     if(mcost < 0) goto fail;
@@ -129,8 +978,17 @@ struct dictionary * dictionary_load(FILE* stream)
     dict->root = root;
     dict->rules = rules;
     dict->max_cost = mcost;
+    dict->threads = 1;
+    dict->alphabet = alphabet;
+    dict->index = NULL;
+    dict->base = NULL;
+    dict->removed = NULL;
+    stats_init(dict);
+    // Tablice dzieci wczytanego drzewa rosły dwukrotnie
+    compact_wasteful(dict);
     return dict;
 fail:
+    if(alphabet != NULL) alphabet_done(alphabet);
     if(root != NULL) trie_done(root);
     if(rules != NULL)
     {
@@ -140,11 +998,319 @@ fail:
     return NULL;
 }
 
+struct dictionary * dictionary_clone(struct dictionary *dict)
+{
+    struct dictionary *clone = malloc(sizeof(struct dictionary));
+    struct list *rules = list_init();
+    if(clone == NULL || rules == NULL)
+    {
+        free(clone);
+        list_done(rules);
+        return NULL;
+    }
+    // Reguły są współdzielone, kopiowana jest tylko lista wskaźników
+    struct hint_rule **r = (struct hint_rule **)list_get(dict->rules);
+    for(size_t i = 0; i < list_size(dict->rules); i++)
+        list_add(rules, rule_share(r[i]));
+    list_terminate(rules);
+    clone->root = trie_share(dict->root);
+    clone->max_cost = dict->max_cost;
+    clone->threads = dict->threads;
+    clone->rules = rules;
+    clone->alphabet = alphabet_share(dict->alphabet);
+    clone->index = deletion_index_share(dict->index);
+    clone->base = dict->base;
+    clone->removed = dict->removed != NULL ? trie_share(dict->removed) : NULL;
+    stats_init(clone);
+    return clone;
+}
+
+struct dictionary * dictionary_merge(struct dictionary *a, struct dictionary *b)
+{
+    return dictionary_combine(a, b, DICTIONARY_MERGE);
+}
+
+struct dictionary * dictionary_subtract(struct dictionary *a, struct dictionary *b)
+{
+    return dictionary_combine(a, b, DICTIONARY_SUBTRACT);
+}
+
+struct dictionary * dictionary_intersect(struct dictionary *a, struct dictionary *b)
+{
+    return dictionary_combine(a, b, DICTIONARY_INTERSECT);
+}
+
+struct dictionary * dictionary_diff(struct dictionary *a, struct dictionary *b)
+{
+    return dictionary_combine(a, b, DICTIONARY_DIFF);
+}
+
+int dictionary_combine_save(const struct dictionary *a, const struct dictionary *b,
+        enum dictionary_set_op op, FILE *stream)
+{
+    if(a->base != NULL || b->base != NULL) return -1;
+    symbol_t map[UCHAR_MAX + 1];
+    struct alphabet *alphabet = combine_alphabet(a, b, map);
+    if(alphabet == NULL) return -1;
+    int r = -1;
+    if(fputwc(DICTIONARY_FORMAT_ALPHABET, stream)<0) goto done;
+    if(alphabet_serialize(alphabet, stream)<0) goto done;
+    if(trie_combine_serialize(a->root, b->root, combine_map(b, map), combine_keep(op), stream)<0) goto done;
+    if(list_serialize(a->rules, stream, (int(*)(void*,FILE*))rule_serialize)<0) goto done;
+    if(int32_serialize(a->max_cost, stream)<0) goto done;
+    r = 0;
+done:
+    alphabet_done(alphabet);
+    return r;
+}
+
+struct dictionary * dictionary_overlay_new(const struct dictionary *base)
+{
+    struct dictionary *dict = dictionary_new();
+    if(dict == NULL) return NULL;
+    dict->base = base;
+    dict->removed = trie_init();
+    dict->max_cost = base->max_cost;
+    dict->threads = base->threads;
+    // Nakładka zaczyna od alfabetu i reguł słownika pod spodem
+    struct alphabet *alphabet;
+    struct list *rules = dict->removed != NULL ? layer_rules(base->rules, base, &alphabet) : NULL;
+    if(rules == NULL)
+    {
+        dictionary_done(dict);
+        return NULL;
+    }
+    alphabet_done(dict->alphabet);
+    dict->alphabet = alphabet;
+    list_done(dict->rules);
+    dict->rules = rules;
+    stats_rules_changed(dict);
+    return dict;
+}
+
+struct dictionary * dictionary_overlay_load(FILE *stream, const struct dictionary *base)
+{
+    struct dictionary *dict = dictionary_load(stream);
+    if(dict == NULL) return NULL;
+    dict->base = base;
+    dict->removed = trie_deserialize(stream, NULL);
+    if(dict->removed == NULL)
+    {
+        dictionary_done(dict);
+        return NULL;
+    }
+    return dict;
+}
+
+int dictionary_index_build(struct dictionary *dict)
+{
+    struct deletion_index *index = deletion_index_build(dict->root, dict->alphabet, DICTIONARY_INDEX_DEPTH);
+    if(index == NULL) return -1;
+    deletion_index_done(dict->index);
+    dict->index = index;
+    return 0;
+}
+
+bool dictionary_has_index(const struct dictionary *dict)
+{
+    return dict->index != NULL;
+}
+
+int dictionary_index_save(const struct dictionary *dict, FILE *stream)
+{
+    if(dict->index == NULL) return -1;
+    return deletion_index_save(dict->index, stream);
+}
+
+int dictionary_index_load(struct dictionary *dict, const char *path)
+{
+    struct deletion_index *index = deletion_index_map(path, dict->root, dict->alphabet);
+    if(index == NULL) return -1;
+    deletion_index_done(dict->index);
+    dict->index = index;
+    return 0;
+}
+
 void dictionary_hints(const struct dictionary *dict, const wchar_t* word,
         struct word_list *list)
 {
     word_list_init(list);
-    trie_hints(dict->root, word, list, dict->rules, dict->max_cost, DICTIONARY_MAX_HINTS);
+    if(dict->base != NULL)
+    {
+        stack_hints(dict, word, list, NULL);
+        return;
+    }
+    symbol_t stack[DICTIONARY_WORD_BUFFER];
+    symbol_t *sw = word_buffer(stack, wcslen(word));
+    if(sw == NULL) return;
+    alphabet_encode_query(dict->alphabet, word, sw);
+    trie_hints(dict->root, dict->alphabet, sw, list, dict->rules, dict->index, dict->max_cost, DICTIONARY_MAX_HINTS, NULL, dict->threads, DICTIONARY_STATS(dict));
+    word_buffer_done(stack, sw);
+}
+
+int dictionary_complete(const struct dictionary *dict, const wchar_t *prefix,
+        size_t k, struct word_list *list)
+{
+    word_list_init(list);
+    if(dict->base != NULL) return stack_complete(dict, prefix, k, list);
+    symbol_t stack[DICTIONARY_WORD_BUFFER];
+    symbol_t *sw = word_buffer(stack, wcslen(prefix));
+    if(sw == NULL) return -1;
+    int r = 0;
+    if(alphabet_encode(dict->alphabet, prefix, sw) == 0)
+        r = trie_complete(dict->root, dict->alphabet, sw, k, list);
+    word_buffer_done(stack, sw);
+    return r;
+}
+
+struct dictionary_iter * dictionary_iter_begin(const struct dictionary *dict,
+        const wchar_t *prefix)
+{
+    if(prefix == NULL || *prefix == 0) return dictionary_iter_range(dict, NULL, NULL);
+    // Słowa z prefiksem to zakres od prefiksu do prefiksu z następną ostatnią literą
+    size_t len = wcslen(prefix);
+    wchar_t *to = malloc((len + 1) * sizeof(wchar_t));
+    if(to == NULL) return NULL;
+    memcpy(to, prefix, (len + 1) * sizeof(wchar_t));
+    to[len - 1]++;
+    struct dictionary_iter *iter = dictionary_iter_range(dict, prefix, to);
+    free(to);
+    return iter;
+}
+
+struct dictionary_iter * dictionary_iter_range(const struct dictionary *dict,
+        const wchar_t *from, const wchar_t *to)
+{
+    size_t layers = 0;
+    for(const struct dictionary *d = dict; d != NULL; d = d->base)
+        layers++;
+    struct dictionary_iter *iter =
+        malloc(sizeof(struct dictionary_iter) + layers * sizeof(struct layer_cursor));
+    if(iter == NULL) return NULL;
+    iter->dict = dict;
+    iter->layers = 0;
+    for(const struct dictionary *d = dict; d != NULL; d = d->base)
+    {
+        struct layer_cursor *c = &iter->cursors[iter->layers];
+        c->it = trie_iter_new(d->root, d->alphabet, from, to);
+        if(c->it == NULL)
+        {
+            dictionary_iter_done(iter);
+            return NULL;
+        }
+        c->word = NULL;
+        c->node = NULL;
+        c->consumed = true;
+        iter->layers++;
+    }
+    return iter;
+}
+
+int dictionary_iter_next(struct dictionary_iter *iter, const wchar_t **word,
+                         unsigned int *freq)
+{
+    for(;;)
+    {
+        struct layer_cursor *min = NULL;
+        for(size_t i = 0; i < iter->layers; i++)
+        {
+            struct layer_cursor *c = &iter->cursors[i];
+            if(c->consumed)
+            {
+                int r = trie_iter_next(c->it, &c->word, &c->node);
+                if(r < 0) return -1;
+                if(r == 0) c->word = NULL;
+                c->consumed = false;
+            }
+            if(c->word != NULL && (min == NULL || wcscmp(c->word, min->word) < 0))
+                min = c;
+        }
+        if(min == NULL) return 0;
+        const struct trie_node *node = min->node;
+        for(size_t i = 0; i < iter->layers; i++)
+        {
+            struct layer_cursor *c = &iter->cursors[i];
+            c->consumed = c->word != NULL && (c == min || wcscmp(c->word, min->word) == 0);
+        }
+        // Słowo z niższej warstwy mogło zostać usunięte albo zmienione wyżej
+        if(iter->layers > 1) node = stack_node(iter->dict, min->word, wcslen(min->word));
+        if(node == NULL) continue;
+        *word = min->word;
+        if(freq != NULL) *freq = trie_get_frequency(node);
+        return 1;
+    }
+}
+
+void dictionary_iter_done(struct dictionary_iter *iter)
+{
+    for(size_t i = 0; i < iter->layers; i++)
+        trie_iter_done(iter->cursors[i].it);
+    free(iter);
+}
+
+bool dictionary_find_utf8(const struct dictionary *dict, const char *word, size_t len)
+{
+    if(dict->base != NULL)
+    {
+        wchar_t *w = utf8_to_wide(word, len);
+        bool r = w != NULL && stack_node(dict, w, wcslen(w)) != NULL;
+        free(w);
+        return r;
+    }
+    const struct trie_node *node = dict->root;
+    while(len > 0)
+    {
+        wchar_t c;
+        size_t l = utf8_decode(word, len, &c);
+        if(l == 0) return false;
+        symbol_t s = alphabet_symbol(dict->alphabet, c);
+        if(s == 0) return false;
+        node = trie_get_child(node, s);
+        if(node == NULL) return false;
+        word += l;
+        len -= l;
+    }
+    return trie_is_leaf(node);
+}
+
+int dictionary_hints_utf8(const struct dictionary *dict, const char *word,
+        size_t len, char **list, size_t *list_len)
+{
+    return dictionary_hints_costs_utf8(dict, word, len, list, list_len, NULL);
+}
+
+int dictionary_hints_costs_utf8(const struct dictionary *dict, const char *word,
+        size_t len, char **list, size_t *list_len, int *costs)
+{
+    *list = NULL;
+    *list_len = 0;
+    if(dict->base != NULL)
+    {
+        wchar_t *w = utf8_to_wide(word, len);
+        if(w == NULL) return -1;
+        struct word_list hints;
+        word_list_init(&hints);
+        stack_hints(dict, w, &hints, costs);
+        free(w);
+        int r = hints_to_utf8(&hints, list, list_len);
+        word_list_done(&hints);
+        return r;
+    }
+    symbol_t stack[DICTIONARY_WORD_BUFFER];
+    symbol_t *sw = word_buffer(stack, len);
+    if(sw == NULL) return -1;
+    if(alphabet_encode_query_utf8(dict->alphabet, word, len, sw)<0)
+    {
+        word_buffer_done(stack, sw);
+        return -1;
+    }
+    struct word_list hints;
+    word_list_init(&hints);
+    trie_hints(dict->root, dict->alphabet, sw, &hints, dict->rules, dict->index, dict->max_cost, DICTIONARY_MAX_HINTS, costs, dict->threads, DICTIONARY_STATS(dict));
+    word_buffer_done(stack, sw);
+    int r = hints_to_utf8(&hints, list, list_len);
+    word_list_done(&hints);
+    return r;
 }
 
 
@@ -227,21 +1393,84 @@ int dictionary_save_lang(const struct dictionary *dict, const char *lang)
     return r;
 }
 
+struct dictionary * dictionary_load_user_lang(const struct dictionary *base,
+        const char *lang)
+{
+    int cp_len = strlen(CONF_PATH);
+    int lg_len = strlen(lang);
+    char * fname = malloc((cp_len+1+lg_len+5+1)*sizeof(char));
+    memcpy(fname, CONF_PATH, cp_len);
+    fname[cp_len] = '/';
+    memcpy(fname+cp_len+1, lang, lg_len);
+    memcpy(fname+cp_len+1+lg_len, ".user", 6);
+    FILE * f = fopen(fname, "r");
+    free(fname);
+    if(f == NULL) return dictionary_overlay_new(base);
+    struct dictionary *r = dictionary_overlay_load(f, base);
+    fclose(f);
+    return r;
+}
+
+int dictionary_save_user_lang(const struct dictionary *dict, const char *lang)
+{
+    mkdir(CONF_PATH, S_IRWXU);
+    int cp_len = strlen(CONF_PATH);
+    int lg_len = strlen(lang);
+    char * fname = malloc((cp_len+1+lg_len+5+1)*sizeof(char));
+    memcpy(fname, CONF_PATH, cp_len);
+    fname[cp_len] = '/';
+    memcpy(fname+cp_len+1, lang, lg_len);
+    memcpy(fname+cp_len+1+lg_len, ".user", 6);
+    FILE * f = fopen(fname, "w");
+    free(fname);
+    if(f == NULL) return -1;
+    int r = dictionary_save(dict, f);
+    fclose(f);
+    return r;
+}
+
 void dictionary_rule_clear(struct dictionary* dict)
 {
+    list_iter(dict->rules, NULL, rule_done_wrapper);
     list_clear(dict->rules);
+    list_terminate(dict->rules);
+    stats_rules_changed(dict);
 }
 
 int dictionary_rule_add(struct dictionary* dict, const wchar_t* left, const wchar_t* right, bool bidirectional, int cost, enum rule_flag flag)
 {
     struct hint_rule *r = rule_make(left, right, cost, flag);
-    int ret = 1;
-    if(r != NULL) list_add(dict->rules, r);
-    else ret = 0;
+    if(r != NULL) rule_canonicalize(r);
+    // Reguła może dodać litery do alfabetu
+    struct alphabet *alphabet = r != NULL ? alphabet_unshare(dict->alphabet) : NULL;
+    if(alphabet != NULL) dict->alphabet = alphabet;
+    if(r != NULL && (alphabet == NULL || rule_compile(r, alphabet)<0))
+    {
+        rule_done(r);
+        r = NULL;
+    }
+    int ret = 0;
+    if(r != NULL)
+    {
+        // Reguła zbędna wobec już dodanych nie jest liczona
+        list_add(dict->rules, r);
+        rule_normalize(dict->rules, NULL);
+        struct hint_rule **rules = (struct hint_rule **)list_get(dict->rules);
+        for(size_t i = 0; i < list_size(dict->rules); i++)
+            if(rules[i] == r) ret = 1;
+        stats_rules_changed(dict);
+    }
     if(bidirectional) ret += dictionary_rule_add(dict, right, left, false, cost, flag);
     return ret;
 }
 
+size_t dictionary_rule_normalize(struct dictionary *dict, struct word_list *removed)
+{
+    size_t r = rule_normalize(dict->rules, removed);
+    stats_rules_changed(dict);
+    return r;
+}
+
 int dictionary_hints_max_cost(struct dictionary* dict, int new_cost)
 {
     int r = dict->max_cost;
@@ -249,5 +1478,81 @@ int dictionary_hints_max_cost(struct dictionary* dict, int new_cost)
     return r;
 }
 
+int dictionary_hints_threads(struct dictionary *dict, int threads)
+{
+    int r = dict->threads;
+    dict->threads = threads > 1 ? threads : 1;
+    return r;
+}
+
+int dictionary_stats(const struct dictionary *dict, struct dictionary_stats *stats)
+{
+#ifdef DICTIONARY_HINT_STATS
+    if(dict->stats == NULL) return -1;
+    hint_stats_read(dict->stats, stats);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+int dictionary_rule_stats(const struct dictionary *dict, struct word_list *rules,
+                          struct dictionary_rule_stats **stats)
+{
+#ifdef DICTIONARY_HINT_STATS
+    size_t n = list_size(dict->rules);
+    *stats = NULL;
+    if(dict->stats == NULL) return -1;
+    if(n == 0) return 0;
+    *stats = malloc(n * sizeof(struct dictionary_rule_stats));
+    if(*stats == NULL) return -1;
+    struct hint_rule **r = (struct hint_rule **)list_get(dict->rules);
+    for(size_t i = 0; i < n; i++)
+    {
+        rule_describe(r[i], rules);
+        hint_stats_rule(dict->stats, i, &(*stats)[i]);
+    }
+    return n;
+#else
+    *stats = NULL;
+    return -1;
+#endif
+}
+
+void dictionary_stats_reset(struct dictionary *dict)
+{
+#ifdef DICTIONARY_HINT_STATS
+    if(dict->stats != NULL) hint_stats_reset(dict->stats);
+#endif
+}
+
+void dictionary_memory_stats(const struct dictionary *dict,
+                             struct dictionary_memory_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    trie_memory_stats(dict->root, dict->alphabet, stats);
+    stats->rules = list_size(dict->rules);
+    struct hint_rule **r = (struct hint_rule **)list_get(dict->rules);
+    for(size_t i = 0; i < stats->rules; i++)
+        stats->rule_bytes += rule_memory(r[i]);
+    stats->alphabet_bytes = alphabet_memory(dict->alphabet);
+    if(dict->index != NULL) stats->index_bytes = deletion_index_memory(dict->index);
+    if(dict->removed != NULL)
+    {
+        struct dictionary_memory_stats removed;
+        memset(&removed, 0, sizeof(removed));
+        trie_memory_stats(dict->removed, dict->alphabet, &removed);
+        stats->removed_bytes = removed.node_bytes + removed.child_bytes;
+    }
+    stats->total_bytes = sizeof(*dict) + stats->node_bytes + stats->child_bytes
+                         + stats->rule_bytes + stats->alphabet_bytes
+                         + stats->index_bytes + stats->removed_bytes;
+}
+
+int dictionary_compact(struct dictionary *dict)
+{
+    return compact(dict, dict->threads);
+}
+
 
 /**@}*/
@@ -26,6 +26,12 @@
 struct dictionary;
 
 
+/**
+  Największa częstość słowa pamiętana przez słownik.
+  */
+#define DICTIONARY_MAX_FREQUENCY 65535
+
+
 /**
   Inicjalizacja słownika.
   Słownik ten należy zniszczyć za pomocą dictionary_done().
@@ -41,11 +47,29 @@ struct dictionary * dictionary_new(void);
 void dictionary_done(struct dictionary *dict);
 
 
+/**
+  Tworzy klon słownika: słownik niezależny od oryginału, który na początku
+  współdzieli z nim drzewo słów, alfabet, reguły i indeks usunięć.
+  Zmiana słowa w klonie lub w oryginale kopiuje tylko węzły na ścieżce
+  do tego słowa, więc klon zajmuje pamięć tylko na różnice.
+  Koszt nie zależy od liczby słów (kopiowana jest tylko lista wskaźników
+  na reguły). Klon nakładki używa tego samego słownika pod spodem.
+  Klonowanie i zmiany klonów poprawiają liczniki współdzielenia, więc
+  nie wolno ich wykonywać, gdy inne wątki używają oryginału lub klonów.
+  Klon należy zniszczyć za pomocą dictionary_done().
+  @param[in,out] dict Słownik.
+  @return Nowy słownik lub NULL, jeśli brakło pamięci.
+  */
+struct dictionary * dictionary_clone(struct dictionary *dict);
+
+
 /**
   Wstawia podane słowo do słownika.
   @param[in,out] dict Słownik.
   @param[in] word Słowo, które należy wstawić do słownika.
-  @return 0 jeśli słowo było już w słowniku, 1 jeśli udało się wstawić.
+  @return 0 jeśli słowo było już w słowniku (lub nie udało się go wstawić,
+  bo słowo zawiera nową literę, a w alfabecie słownika nie ma już miejsca),
+  1 jeśli udało się wstawić.
   */
 int dictionary_insert(struct dictionary *dict, const wchar_t* word);
 
@@ -68,8 +92,34 @@ int dictionary_delete(struct dictionary *dict, const wchar_t* word);
 bool dictionary_find(const struct dictionary *dict, const wchar_t* word);
 
 
+/**
+  Ustawia częstość słowa w słowniku.
+  Częstość jest zapisywana razem ze słownikiem. Przy równym koszcie
+  częstsze słowa są podpowiadane wcześniej. Słowa mają początkowo
+  częstość 0 (nieznaną).
+  @param[in,out] dict Słownik.
+  @param[in] word Słowo.
+  @param[in] freq Częstość; większe niż DICTIONARY_MAX_FREQUENCY są obcinane.
+  @return 1 jeśli ustawiono częstość, 0 jeśli słowa nie ma w słowniku.
+  */
+int dictionary_set_frequency(struct dictionary *dict, const wchar_t *word,
+                             unsigned int freq);
+
+
+/**
+  Zwraca częstość słowa.
+  @param[in] dict Słownik.
+  @param[in] word Słowo.
+  @return Częstość słowa lub 0, jeśli słowa nie ma w słowniku.
+  */
+unsigned int dictionary_frequency(const struct dictionary *dict,
+                                  const wchar_t *word);
+
+
 /**
   Zapisuje słownik.
+  Nakładka jest zapisywana bez słownika pod spodem
+  (wczytuje się ją przez dictionary_overlay_load()).
   @param[in] dict Słownik.
   @param[in,out] stream Strumień, gdzie ma być zapisany słownik.
   @return <0 jeśli operacja się nie powiedzie, 0 w p.p.
@@ -86,11 +136,179 @@ int dictionary_save(const struct dictionary *dict, FILE* stream);
 struct dictionary * dictionary_load(FILE* stream);
 
 
+/**
+  Działania na zbiorach słów dwóch słowników.
+  */
+enum dictionary_set_op
+{
+    DICTIONARY_MERGE,       ///< Słowa z któregokolwiek słownika.
+    DICTIONARY_SUBTRACT,    ///< Słowa z pierwszego słownika, których nie ma w drugim.
+    DICTIONARY_INTERSECT,   ///< Słowa z obu słowników.
+    DICTIONARY_DIFF         ///< Słowa z dokładnie jednego słownika.
+};
+
+
+/**
+  Łączy słowa dwóch słowników w nowy słownik.
+  Drzewa słów są przeglądane jednocześnie, w jednym przejściu, bez
+  wstawiania słów po kolei. Wynik ma reguły i maksymalny koszt pierwszego
+  słownika, a alfabet pierwszego uzupełniony o litery drugiego. Słowo
+  z obu słowników dostaje większą z częstości. Poddrzewa przechodzące
+  do wyniku w całości są współdzielone ze słownikami wejściowymi jak
+  w dictionary_clone() (tyczy się to tych samych ograniczeń co do wątków).
+  Słowniki nie mogą być nakładkami.
+  Wynik należy zniszczyć za pomocą dictionary_done().
+  @param[in,out] a Pierwszy słownik.
+  @param[in,out] b Drugi słownik.
+  @return Słownik ze słowami z `a` lub `b` albo NULL, jeśli wystąpił błąd
+  (brak pamięci, przepełniony alfabet lub nakładka).
+  */
+struct dictionary * dictionary_merge(struct dictionary *a, struct dictionary *b);
+
+
+/**
+  Tworzy słownik ze słów pierwszego słownika, których nie ma w drugim.
+  Działa jak dictionary_merge().
+  @param[in,out] a Pierwszy słownik.
+  @param[in,out] b Drugi słownik.
+  @return Nowy słownik lub NULL, jeśli wystąpił błąd.
+  */
+struct dictionary * dictionary_subtract(struct dictionary *a, struct dictionary *b);
+
+
+/**
+  Tworzy słownik ze słów występujących w obu słownikach.
+  Działa jak dictionary_merge().
+  @param[in,out] a Pierwszy słownik.
+  @param[in,out] b Drugi słownik.
+  @return Nowy słownik lub NULL, jeśli wystąpił błąd.
+  */
+struct dictionary * dictionary_intersect(struct dictionary *a, struct dictionary *b);
+
+
+/**
+  Tworzy słownik ze słów występujących w dokładnie jednym ze słowników.
+  Działa jak dictionary_merge().
+  @param[in,out] a Pierwszy słownik.
+  @param[in,out] b Drugi słownik.
+  @return Nowy słownik lub NULL, jeśli wystąpił błąd.
+  */
+struct dictionary * dictionary_diff(struct dictionary *a, struct dictionary *b);
+
+
+/**
+  Zapisuje wynik działania na dwóch słownikach od razu do strumienia,
+  bez budowania go w pamięci. Zapis można wczytać przez dictionary_load()
+  i jest taki sam, jak zapis słownika z dictionary_merge() i pozostałych.
+  @param[in] a Pierwszy słownik.
+  @param[in] b Drugi słownik.
+  @param[in] op Działanie.
+  @param[in,out] stream Strumień.
+  @return <0 jeśli operacja się nie powiedzie, 0 w p.p.
+  */
+int dictionary_combine_save(const struct dictionary *a, const struct dictionary *b,
+        enum dictionary_set_op op, FILE *stream);
+
+
+/**
+  Tworzy pustą nakładkę na słownik.
+
+  Nakładka to słownik, który przechowuje tylko swoje zmiany względem
+  słownika pod spodem: wstawione słowa, ustawione częstości i usunięte
+  słowa (usunięcie słowa ze słownika pod spodem zapamiętuje tylko, że
+  jest ono usunięte). Słownik pod spodem nie jest kopiowany ani zmieniany
+  i sam może być nakładką, np. słownik języka, na nim nakładka użytkownika,
+  a na niej nakładka sesji.
+
+  Wyszukiwanie, częstości i uzupełnienia działają tak, jakby wszystkie
+  warstwy były jednym słownikiem. Podpowiedzi również, z wyjątkiem
+  podpowiedzi z kilku słów (reguły z flagą `s`): są one tworzone
+  tylko ze słów jednej warstwy, więc podział na słowa z różnych warstw
+  nie zostanie znaleziony. Podpowiedzi są generowane według reguł
+  i maksymalnego kosztu nakładki, które przy tworzeniu są kopiowane
+  ze słownika pod spodem.
+
+  Słownik pod spodem musi istnieć dłużej niż nakładka.
+  Nakładkę należy zniszczyć za pomocą dictionary_done().
+  @param[in] base Słownik pod spodem.
+  @return Nowa nakładka lub NULL, jeśli brakło pamięci.
+  */
+struct dictionary * dictionary_overlay_new(const struct dictionary *base);
+
+
+/**
+  Wczytuje nakładkę zapisaną przez dictionary_save().
+  Nakładkę należy zniszczyć za pomocą dictionary_done().
+  @param[in] stream Strumień.
+  @param[in] base Słownik pod spodem.
+  @return Nakładka lub NULL, jeśli wystąpił błąd.
+  */
+struct dictionary * dictionary_overlay_load(FILE *stream,
+        const struct dictionary *base);
+
+
+/**
+  Przyrostek nazwy pliku z indeksem usunięć zapisywanego obok pliku słownika.
+  */
+#define DICTIONARY_INDEX_SUFFIX ".index"
+
+
+/**
+  Największa liczba liter usuwanych ze słów przy budowaniu indeksu usunięć.
+  */
+#define DICTIONARY_INDEX_DEPTH 2
+
+
+/**
+  Buduje indeks usunięć: skróty słów powstałych ze słów słownika przez
+  usunięcie co najwyżej DICTIONARY_INDEX_DEPTH liter.
+  Jeśli reguły słownika to tylko usunięcie, wstawienie, zamiana
+  i przestawienie dowolnych liter, a do maksymalnego kosztu podpowiedzi
+  wystarczy tyle operacji, podpowiedzi są szukane w indeksie zamiast
+  w drzewie (z tym samym wynikiem). W p.p. indeks nie jest używany.
+  Wstawienie lub usunięcie słowa usuwa indeks.
+  @param[in,out] dict Słownik.
+  @return <0 jeśli brakło pamięci, 0 w p.p.
+  */
+int dictionary_index_build(struct dictionary *dict);
+
+
+/**
+  Sprawdza, czy słownik ma indeks usunięć.
+  @param[in] dict Słownik.
+  @return Czy słownik ma indeks.
+  */
+bool dictionary_has_index(const struct dictionary *dict);
+
+
+/**
+  Zapisuje indeks usunięć słownika.
+  @param[in] dict Słownik.
+  @param[in,out] stream Strumień otwarty w trybie binarnym.
+  @return <0 jeśli słownik nie ma indeksu lub zapis się nie powiedzie, 0 w p.p.
+  */
+int dictionary_index_save(const struct dictionary *dict, FILE *stream);
+
+
+/**
+  Mapuje do pamięci indeks usunięć zapisany przez dictionary_index_save().
+  Indeks zbudowany dla innego zbioru słów jest odrzucany.
+  @param[in,out] dict Słownik.
+  @param[in] path Ścieżka do pliku z indeksem.
+  @return <0 jeśli pliku nie ma, jest niepoprawny albo nie pasuje do słownika,
+  0 w p.p.
+  */
+int dictionary_index_load(struct dictionary *dict, const char *path);
+
+
 /**
   Tworzy możliwe podpowiedzi dla zadanego słowa.
   Jeżeli pojedyncza podpowiedź składa się z kilku słów,
   wtedy powinien być to jeden łańcuch znaków,
   w którym słowa są pooddzielane pojedynczymi spacjami.
+  Podpowiedzi są uporządkowane niemalejąco po koszcie, przy równym koszcie
+  nierosnąco po częstości (dla kilku słów: najmniejszej z ich częstości),
+  a przy równej częstości alfabetycznie.
   @param[in] dict Słownik.
   @param[in] word Szukane słowo.
   @param[in,out] list Lista, w której zostaną umieszczone podpowiedzi.
@@ -99,6 +317,125 @@ void dictionary_hints(const struct dictionary *dict, const wchar_t* word,
                       struct word_list *list);
 
 
+/**
+  Znajduje najlepsze uzupełnienia prefiksu, czyli słowa ze słownika
+  zaczynające się od `prefix` (łącznie z samym prefiksem, jeśli jest słowem).
+  Uzupełnienia są uporządkowane nierosnąco po częstości
+  (patrz dictionary_set_frequency()), przy równej częstości
+  od najkrótszych, a przy równej długości alfabetycznie.
+  @param[in] dict Słownik.
+  @param[in] prefix Prefiks.
+  @param[in] k Największa liczba uzupełnień.
+  @param[out] list Lista, w której zostaną umieszczone uzupełnienia.
+  @return Liczba uzupełnień lub <0, jeśli brakło pamięci.
+  */
+int dictionary_complete(const struct dictionary *dict, const wchar_t *prefix,
+                        size_t k, struct word_list *list);
+
+
+/**
+  Przeglądanie słów słownika (zob. dictionary_iter_begin()).
+  */
+struct dictionary_iter;
+
+
+/**
+  Zaczyna przeglądanie słów słownika zaczynających się od `prefix`
+  (łącznie z samym prefiksem, jeśli jest słowem).
+  Słowa są zwracane rosnąco w kolejności kodów znaków (jak wcscmp(),
+  niezależnie od locale), bez rekursji i bez przydzielania pamięci
+  dla każdego słowa. Słownika nie można zmieniać, dopóki jest przeglądany.
+  Przeglądanie należy zakończyć za pomocą dictionary_iter_done().
+  @param[in] dict Słownik.
+  @param[in] prefix Prefiks (pusty lub NULL oznacza wszystkie słowa).
+  @return Przeglądanie lub NULL, jeśli brakło pamięci.
+  */
+struct dictionary_iter * dictionary_iter_begin(const struct dictionary *dict,
+        const wchar_t *prefix);
+
+
+/**
+  Zaczyna przeglądanie słów słownika z zakresu [from, to)
+  w porządku jak w dictionary_iter_begin().
+  @param[in] dict Słownik.
+  @param[in] from Najmniejsze słowo zakresu lub NULL (bez ograniczenia).
+  @param[in] to Pierwsze słowo za zakresem lub NULL (bez ograniczenia).
+  @return Przeglądanie lub NULL, jeśli brakło pamięci.
+  */
+struct dictionary_iter * dictionary_iter_range(const struct dictionary *dict,
+        const wchar_t *from, const wchar_t *to);
+
+
+/**
+  Przechodzi do następnego słowa.
+  @param[in,out] iter Przeglądanie.
+  @param[out] word Słowo, ważne do następnego wywołania.
+  @param[out] freq Częstość słowa lub NULL.
+  @return 1 jeśli jest następne słowo, 0 po ostatnim słowie,
+  <0 jeśli brakło pamięci.
+  */
+int dictionary_iter_next(struct dictionary_iter *iter, const wchar_t **word,
+                         unsigned int *freq);
+
+
+/**
+  Kończy przeglądanie słów.
+  @param[in] iter Przeglądanie.
+  */
+void dictionary_iter_done(struct dictionary_iter *iter);
+
+
+/**
+  Sprawdza, czy dane słowo zapisane w UTF-8 znajduje się w słowniku.
+  Słowo jest dekodowane w trakcie przechodzenia drzewa, bez zamiany
+  na `wchar_t` i bez alokacji pamięci.
+  @param[in] dict Słownik.
+  @param[in] word Słowo w UTF-8 (nie musi kończyć się znakiem '\0').
+  @param[in] len Długość słowa w bajtach.
+  @return Wynik sprawdzenia: false dla słowa spoza słownika
+  lub niepoprawnego UTF-8.
+  */
+bool dictionary_find_utf8(const struct dictionary *dict, const char *word,
+                          size_t len);
+
+
+/**
+  Sprawdza, czy dane słowo zapisane w UTF-8 znajduje się w słowniku
+  i zwraca podpowiedzi zapisane w UTF-8.
+  Podpowiedzi są takie same jak w dictionary_hints(). Reprezentacja listy
+  jest taka sama jak w dictionary_lang_list(): łańcuchy znakowe
+  jeden po drugim pooddzielane znakiem '\0' w buforze długości `*list_len`.
+  Dla pustej listy `*list` jest równe NULL. Użytkownik jest odpowiedzialny
+  za zwolnienie listy przez `free(*list)`.
+  @param[in] dict Słownik.
+  @param[in] word Słowo w UTF-8 (nie musi kończyć się znakiem '\0').
+  @param[in] len Długość słowa w bajtach.
+  @param[out] list Bufor z podpowiedziami.
+  @param[out] list_len Długość bufora.
+  @return Liczba podpowiedzi lub <0, jeśli słowo nie jest poprawnym UTF-8
+  albo brakło pamięci.
+  */
+int dictionary_hints_utf8(const struct dictionary *dict, const char *word,
+                          size_t len, char **list, size_t *list_len);
+
+/**
+  Działa jak dictionary_hints_utf8(), a dodatkowo zwraca koszty podpowiedzi,
+  czyli sumy kosztów reguł, którymi otrzymano podpowiedzi ze słowa.
+  Podpowiedzi są uporządkowane jak w dictionary_hints().
+  @param[in] dict Słownik.
+  @param[in] word Słowo w UTF-8 (nie musi kończyć się znakiem '\0').
+  @param[in] len Długość słowa w bajtach.
+  @param[out] list Bufor z podpowiedziami.
+  @param[out] list_len Długość bufora.
+  @param[out] costs Tablica (co najmniej DICTIONARY_MAX_HINTS elementów)
+  na koszty kolejnych podpowiedzi albo NULL.
+  @return Liczba podpowiedzi lub <0, jeśli słowo nie jest poprawnym UTF-8
+  albo brakło pamięci.
+  */
+int dictionary_hints_costs_utf8(const struct dictionary *dict, const char *word,
+        size_t len, char **list, size_t *list_len, int *costs);
+
+
 /**
   Zwraca nazwy języków, dla których dostępne są słowniki.
   Powinny to być nazwy lokali bez kodowania. np.
@@ -137,6 +474,27 @@ struct dictionary * dictionary_load_lang(const char *lang);
 int dictionary_save_lang(const struct dictionary *dict, const char *lang);
 
 
+/**
+  Wczytuje nakładkę użytkownika na słownik języka.
+  Jeśli użytkownik nie zapisał jeszcze nakładki, to tworzy pustą.
+  Nakładkę należy zniszczyć za pomocą dictionary_done().
+  @param[in] base Słownik języka.
+  @param[in] lang Nazwa języka.
+  @return Nakładka lub NULL, jeśli wystąpił błąd.
+  */
+struct dictionary * dictionary_load_user_lang(const struct dictionary *base,
+        const char *lang);
+
+
+/**
+  Zapisuje nakładkę użytkownika na słownik języka.
+  @param[in] dict Nakładka.
+  @param[in] lang Nazwa języka.
+  @return <0 jeśli operacja się nie powiedzie, 0 w p.p.
+  */
+int dictionary_save_user_lang(const struct dictionary *dict, const char *lang);
+
+
 /**
   Ustawia maksymalny koszt z jakim jest generowana podpowiedź.
   @param[in,out] dict Słownik.
@@ -146,6 +504,150 @@ int dictionary_save_lang(const struct dictionary *dict, const char *lang);
 int dictionary_hints_max_cost(struct dictionary *dict, int new_cost);
 
 
+/**
+  Ustawia liczbę wątków, w których może być generowana jedna podpowiedź.
+  Przy dużym maksymalnym koszcie i długich słowach kolejne warstwy stanów
+  ogólnego algorytmu są wtedy rozwijane równolegle. Podpowiedzi są takie
+  same jak w jednym wątku, a wątki są tworzone tylko dla dużych warstw.
+  @param[in,out] dict Słownik.
+  @param[in] threads Liczba wątków (1 oznacza generowanie w jednym wątku).
+  @return Dotychczasowa liczba wątków.
+  */
+int dictionary_hints_threads(struct dictionary *dict, int threads);
+
+/**
+  Liczba warstw kosztu rozróżnianych w struct dictionary_stats.
+  */
+#define DICTIONARY_STATS_LAYERS 16
+
+/**
+  Statystyki generowania podpowiedzi przez reguły (zob. dictionary_stats()).
+  Czasy są w nanosekundach i sumują się po wszystkich słowach.
+  */
+struct dictionary_stats
+{
+    unsigned long long queries;         ///< Liczba słów, dla których generowano podpowiedzi.
+    unsigned long long edit_queries;    ///< Słowa obsłużone przez odległość edycyjną, bez stanów.
+    unsigned long long states[DICTIONARY_STATS_LAYERS]; ///< Stany utworzone w warstwach kolejnych kosztów (ostatnia liczy też droższe).
+    unsigned long long duplicates;      ///< Stany usunięte jako powtórzenia.
+    unsigned long long nodes;           ///< Węzły drzewa odwiedzone przy stosowaniu reguł.
+    unsigned long long rule_tries;      ///< Zastosowania reguł do stanów.
+    unsigned long long rule_successes;  ///< Zastosowania, które dały co najmniej jeden nowy stan.
+    unsigned long long preprocess_ns;   ///< Czas wyboru reguł pasujących do sufiksów.
+    unsigned long long expand_ns;       ///< Czas rozwijania warstw stanów.
+    unsigned long long unify_ns;        ///< Czas usuwania powtórzeń stanów.
+    unsigned long long text_ns;         ///< Czas odtwarzania tekstu podpowiedzi.
+};
+
+/**
+  Statystyki jednej reguły (zob. dictionary_rule_stats()).
+  */
+struct dictionary_rule_stats
+{
+    unsigned long long tries;           ///< Zastosowania reguły do stanów.
+    unsigned long long successes;       ///< Zastosowania, które dały co najmniej jeden nowy stan.
+};
+
+/**
+  Odczytuje statystyki generowania podpowiedzi słownika.
+  Statystyki są zbierane tylko, gdy biblioteka jest zbudowana z opcją
+  `DICTIONARY_HINT_STATS`; w p.p. kod liczników nie jest w ogóle kompilowany.
+  Podpowiedzi z warstw nakładki są liczone w najwyższej warstwie.
+  @param[in] dict Słownik.
+  @param[out] stats Statystyki.
+  @return 0 jeśli się udało, -1 jeśli statystyki nie są zbierane.
+  */
+int dictionary_stats(const struct dictionary *dict, struct dictionary_stats *stats);
+
+/**
+  Odczytuje liczniki kolejnych reguł słownika.
+  Liczniki należą do słownika, a nie do reguł, więc klony słownika
+  (zob. dictionary_clone()) liczą osobno. Każda zmiana reguł słownika
+  zeruje liczniki reguł.
+  @param[in] dict Słownik.
+  @param[in,out] rules Lista, na której końcu zostaną dopisane reguły
+  w postaci `lewa -> prawa : koszt,flaga`.
+  @param[out] stats Nowa tablica liczników kolejnych reguł, którą trzeba
+  zwolnić przez free(), albo NULL, jeśli słownik nie ma reguł.
+  @return Liczba reguł lub -1, jeśli statystyki nie są zbierane albo
+  brakło pamięci.
+  */
+int dictionary_rule_stats(const struct dictionary *dict, struct word_list *rules,
+                          struct dictionary_rule_stats **stats);
+
+/**
+  Zeruje statystyki generowania podpowiedzi słownika i liczniki jego reguł.
+  @param[in,out] dict Słownik.
+  */
+void dictionary_stats_reset(struct dictionary *dict);
+
+/**
+  Liczba głębokości rozróżnianych w struct dictionary_memory_stats.
+  */
+#define DICTIONARY_MEMORY_DEPTHS 32
+
+/**
+  Liczba stopni węzłów rozróżnianych w struct dictionary_memory_stats.
+  */
+#define DICTIONARY_MEMORY_FANOUTS 32
+
+/**
+  Największa liczba pierwszych liter słów w struct dictionary_memory_stats.
+  */
+#define DICTIONARY_MEMORY_LETTERS 256
+
+/**
+  Zużycie pamięci przez słownik (zob. dictionary_memory_stats()).
+  Rozmiary są w bajtach i nie obejmują narzutu alokatora.
+  */
+struct dictionary_memory_stats
+{
+    size_t nodes;               ///< Węzły drzewa (razem z korzeniem).
+    size_t leaves;              ///< Węzły, w których kończy się słowo (liczba słów).
+    size_t shared_nodes;        ///< Węzły współdzielone z klonami słownika.
+    size_t node_bytes;          ///< Pamięć węzłów.
+    size_t child_bytes;         ///< Pamięć tablic dzieci (razem z wolnymi miejscami).
+    size_t child_wasted_bytes;  ///< Pamięć wolnych miejsc w tablicach dzieci.
+    size_t rules;               ///< Liczba reguł.
+    size_t rule_bytes;          ///< Pamięć reguł.
+    size_t alphabet_bytes;      ///< Pamięć alfabetu.
+    size_t index_bytes;         ///< Pamięć indeksu usunięć (także zmapowanego z pliku).
+    size_t removed_bytes;       ///< Pamięć drzewa słów usuniętych w nakładce.
+    size_t total_bytes;         ///< Suma powyższych rozmiarów.
+    size_t max_depth;           ///< Największa głębokość węzła.
+    size_t max_fanout;          ///< Największa liczba dzieci węzła.
+    size_t depths[DICTIONARY_MEMORY_DEPTHS];   ///< Węzły na kolejnych głębokościach (ostatnia liczy też głębsze).
+    size_t fanouts[DICTIONARY_MEMORY_FANOUTS]; ///< Węzły o kolejnych liczbach dzieci (ostatnia liczy też większe).
+    size_t letters_no;          ///< Liczba różnych pierwszych liter słów.
+    wchar_t letters[DICTIONARY_MEMORY_LETTERS];      ///< Pierwsze litery słów (w kolejności symboli).
+    size_t letter_words[DICTIONARY_MEMORY_LETTERS];  ///< Liczby słów zaczynających się od kolejnych liter.
+};
+
+/**
+  Liczy zużycie pamięci przez słownik.
+  Węzły współdzielone z klonami są liczone w każdym z nich, a słownik
+  pod nakładką nie jest liczony wcale.
+  @param[in] dict Słownik.
+  @param[out] stats Statystyki.
+  */
+void dictionary_memory_stats(const struct dictionary *dict,
+                             struct dictionary_memory_stats *stats);
+
+/**
+  Zagęszcza drzewo słownika: przydziela tablice dzieci węzłów dokładnie
+  na miarę i układa węzły w pamięci w kolejności przechodzenia w głąb.
+  Poddrzewa korzenia są kopiowane w tylu wątkach, ile ustawiono przez
+  dictionary_hints_threads(). Drzewa współdzielonego z klonami słownika
+  nie zagęszcza, żeby nie zajmować pamięci na jego kopię.
+  dictionary_load() zagęszcza wczytany słownik sam, jeśli tablice dzieci
+  mają dużo wolnych miejsc.
+  @param[in,out] dict Słownik.
+  @return 0 jeśli się udało, -1 jeśli brakło pamięci (słownik się wtedy
+  nie zmienia).
+  */
+int dictionary_compact(struct dictionary *dict);
+
+
 /**
   Usuwa wszystkie reguły ze słownika
   @param[in,out] dict Słownik.
@@ -197,7 +699,12 @@ enum rule_flag
   
   Reguły, w których prawa strona ma więcej niż jedną zmienną,
   która nie występuje po prawej stronie są odrzucane.
-  Jeśli obie strony są puste, to musi się to wiązać z użyciem flagi `s`, w p.p. reguła jest odrzucana. Funkcja zwraca liczbę reguł dodanych (bez uwzględnienia reguł odrzuconych).
+  Jeśli obie strony są puste, to musi się to wiązać z użyciem flagi `s`, w p.p. reguła jest odrzucana.
+  Odrzucane są też reguły, które nie mogą dać żadnej nowej ani tańszej
+  podpowiedzi (zob. dictionary_rule_normalize()): niczego nie zmieniające
+  i takie same jak już dodane (z dokładnością do numeracji zmiennych),
+  ale nie tańsze. Tańsza reguła zastępuje wcześniej dodane droższe.
+  Funkcja zwraca liczbę reguł dodanych (bez uwzględnienia reguł odrzuconych).
   @param[in,out] dict Słownik.
   @param[in] left Lewa strona reguły.
   @param[in] right Prawa strona reguły.
@@ -213,5 +720,19 @@ int dictionary_rule_add(struct dictionary *dict,
                         int cost,
                         enum rule_flag flag);
 
+/**
+  Usuwa z reguł słownika reguły zbędne: niczego nie zmieniające oraz
+  takie same jak inna reguła (z dokładnością do numeracji zmiennych)
+  o nie większym koszcie. Reguła bez flagi czyni zbędną taką samą regułę
+  z flagą `b` lub `e`. Kolejność pozostałych reguł się nie zmienia,
+  a podpowiedzi pozostają takie same.
+  Reguły dodawane i wczytywane są porządkowane w ten sposób od razu.
+  @param[in,out] dict Słownik.
+  @param[in,out] removed Lista, na której końcu zostaną dopisane usunięte
+  reguły w postaci `lewa -> prawa : koszt,flaga`, albo NULL.
+  @return Liczba usuniętych reguł.
+  */
+size_t dictionary_rule_normalize(struct dictionary *dict, struct word_list *removed);
+
 
 #endif /* __DICTIONARY_H__ */
@@ -15,7 +15,9 @@
 #include <stddef.h>
 #include <setjmp.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <cmocka.h>
+#include "alphabet.h"
 #include "dictionary.h"
 #include "word_list.h"
 #include "trie.h"
@@ -23,15 +25,31 @@
 /**
   Struktura przechowująca słownik.
   
-  Słowa są przechowywane w drzewie TRIE.
+  Słowa są przechowywane w drzewie TRIE jako napisy z symboli alfabetu.
  */
 struct dictionary
 {
     struct trie_node *root;      ///< Korzeń drzewa TRIE
     int max_cost;                ///< Maksymalny koszt podpowiedzi.
+    int threads;                 ///< Liczba wątków do generowania jednej podpowiedzi.
     struct list *rules;          ///< Lista reguł podpowiedzi.
+    struct alphabet *alphabet;   ///< Alfabet słownika.
 };
 
+extern int wreadp;
+extern int wwritep;
+extern int wfilelen;
+
+/**
+ * Sprawdza, czy słowo jest w drzewie słownika.
+ */
+static bool dict_trie_find(struct dictionary *dict, const wchar_t *word)
+{
+    symbol_t sw[64];
+    if(alphabet_encode(dict->alphabet, word, sw) < 0) return false;
+    return trie_find(dict->root, sw);
+}
+
 
 /**
  * Testuje tworzenie i usuwanie słownika.
@@ -50,7 +68,7 @@ static void dictionary_insert_test(void **state)
 {
     struct dictionary *dict = dictionary_new();
     dictionary_insert(dict, L"słowo");
-    assert_true(trie_find(dict->root, L"słowo"));
+    assert_true(dict_trie_find(dict, L"słowo"));
     dictionary_done(dict);
 }
 
@@ -62,7 +80,7 @@ static void dictionary_delete_test(void **state)
     struct dictionary *dict = dictionary_new();
     dictionary_insert(dict, L"słowo");
     dictionary_delete(dict, L"słowo");
-    assert_false(trie_find(dict->root, L"słowo"));
+    assert_false(dict_trie_find(dict, L"słowo"));
     dictionary_done(dict);
 }
 
@@ -104,6 +122,658 @@ static void dictionary_hints_test(void **state)
     dictionary_done(dict);
 }
 
+/**
+ * Testuje wczytywanie uciętego pliku słownika.
+ * Alfabet i drzewo trafiają do zmockowanego pliku (testable.h),
+ * a reguły i maksymalny koszt do prawdziwego, który ucinamy
+ * w środku ostatniej reguły.
+ */
+static void dictionary_load_truncated_test(void **state)
+{
+    struct dictionary *dict = dictionary_new();
+    dictionary_insert(dict, L"ala");
+    dictionary_rule_add(dict, L"a", L"b", false, 1, RULE_NORMAL);
+    dictionary_rule_add(dict, L"b", L"c", false, 1, RULE_NORMAL);
+    FILE *f = tmpfile();
+    assert_true(f != NULL);
+    wwritep = wfilelen = 0;
+    assert_int_equal(dictionary_save(dict, f), 0);
+    dictionary_done(dict);
+    fflush(f);
+    long size = ftell(f);
+    // Maksymalny koszt zajmuje 8 znaków, flaga ostatniej reguły kolejne 8
+    assert_int_equal(ftruncate(fileno(f), size - 12), 0);
+    rewind(f);
+    wreadp = 0;
+    assert_true(dictionary_load(f) == NULL);
+    fclose(f);
+}
+
+/**
+ * Testuje znajdowanie słów zapisanych w UTF-8.
+ */
+static void dictionary_find_utf8_test(void **state)
+{
+    struct dictionary *dict = dictionary_new();
+    dictionary_insert(dict, L"słowo");
+    const char *text = "słowo słowa";
+    assert_true(dictionary_find_utf8(dict, text, 6));
+    assert_false(dictionary_find_utf8(dict, text + 7, 6));
+    assert_false(dictionary_find_utf8(dict, text, 5));
+    assert_false(dictionary_find_utf8(dict, text, 2));
+    assert_false(dictionary_find_utf8(dict, "", 0));
+    dictionary_done(dict);
+}
+
+/**
+ * Testuje znajdowanie podpowiedzi w UTF-8.
+ */
+static void dictionary_hints_utf8_test(void **state)
+{
+    struct dictionary *dict = dictionary_new();
+    dictionary_insert(dict, L"łan");
+    dictionary_insert(dict, L"łon");
+    dictionary_insert(dict, L"dom");
+    dictionary_rule_add(dict, L"0", L"1", false, 1, RULE_NORMAL);
+    dictionary_hints_max_cost(dict, 1);
+    char *list;
+    size_t len;
+    assert_int_equal(dictionary_hints_utf8(dict, "łen!", 4, &list, &len), 2);
+    assert_int_equal(len, 10);
+    assert_memory_equal(list, "łan\0łon\0", 10);
+    free(list);
+    assert_int_equal(dictionary_hints_utf8(dict, "xyz", 3, &list, &len), 0);
+    assert_true(list == NULL);
+    assert_int_equal(len, 0);
+    assert_true(dictionary_hints_utf8(dict, "\xc5", 1, &list, &len) < 0);
+    dictionary_done(dict);
+}
+
+/**
+ * Testuje koszty podpowiedzi w UTF-8.
+ */
+static void dictionary_hints_costs_utf8_test(void **state)
+{
+    struct dictionary *dict = dictionary_new();
+    dictionary_insert(dict, L"łan");
+    dictionary_insert(dict, L"łon");
+    dictionary_insert(dict, L"łany");
+    dictionary_rule_add(dict, L"0", L"1", false, 1, RULE_NORMAL);
+    dictionary_rule_add(dict, L"", L"1", false, 2, RULE_NORMAL);
+    dictionary_hints_max_cost(dict, 3);
+    char *list;
+    size_t len;
+    int costs[DICTIONARY_MAX_HINTS];
+    assert_int_equal(dictionary_hints_costs_utf8(dict, "łen", 4, &list, &len, costs), 3);
+    assert_int_equal(len, 16);
+    assert_memory_equal(list, "łan\0łon\0łany\0", 16);
+    assert_int_equal(costs[0], 1);
+    assert_int_equal(costs[1], 1);
+    assert_int_equal(costs[2], 3);
+    free(list);
+    dictionary_done(dict);
+}
+
+/**
+ * Testuje odrzucanie zbędnych reguł.
+ */
+static void dictionary_rule_add_useless_test(void **state)
+{
+    struct dictionary *dict = dictionary_new();
+    dictionary_insert(dict, L"łan");
+    dictionary_insert(dict, L"łon");
+    assert_int_equal(dictionary_rule_add(dict, L"0", L"1", true, 1, RULE_NORMAL), 1);
+    assert_int_equal(dictionary_rule_add(dict, L"5", L"7", false, 2, RULE_BEGIN), 0);
+    assert_int_equal(dictionary_rule_add(dict, L"ł", L"ł", false, 1, RULE_NORMAL), 0);
+    assert_int_equal(dictionary_rule_add(dict, L"ą", L"a", false, 1, RULE_END), 1);
+    assert_int_equal(dictionary_rule_add(dict, L"ą", L"a", false, 1, RULE_NORMAL), 1);
+    struct word_list removed;
+    word_list_init(&removed);
+    assert_int_equal(dictionary_rule_normalize(dict, &removed), 0);
+    assert_int_equal(word_list_size(&removed), 0);
+    word_list_done(&removed);
+    dictionary_hints_max_cost(dict, 1);
+    struct word_list list;
+    dictionary_hints(dict, L"łen", &list);
+    assert_int_equal(word_list_size(&list), 2);
+    word_list_done(&list);
+    dictionary_done(dict);
+}
+
+/**
+ * Testuje statystyki generowania podpowiedzi.
+ */
+static void dictionary_stats_test(void **state)
+{
+    struct dictionary *dict = dictionary_new();
+    dictionary_insert(dict, L"łan");
+    dictionary_insert(dict, L"łon");
+    dictionary_rule_add(dict, L"0", L"1", false, 1, RULE_NORMAL);
+    dictionary_rule_add(dict, L"ą", L"a", false, 1, RULE_BEGIN);
+    dictionary_hints_max_cost(dict, 2);
+    struct word_list list;
+    dictionary_hints(dict, L"łen", &list);
+    word_list_done(&list);
+    struct dictionary_stats stats;
+    struct dictionary_rule_stats *rule_stats;
+    struct word_list rules;
+    word_list_init(&rules);
+#ifdef DICTIONARY_HINT_STATS
+    assert_int_equal(dictionary_stats(dict, &stats), 0);
+    assert_int_equal(stats.queries, 1);
+    assert_int_equal(stats.edit_queries, 0);
+    assert_true(stats.states[0] > 0);
+    assert_true(stats.nodes > 0);
+    assert_true(stats.rule_successes > 0);
+    assert_true(stats.rule_tries >= stats.rule_successes);
+    assert_int_equal(dictionary_rule_stats(dict, &rules, &rule_stats), 2);
+    assert_int_equal(word_list_size(&rules), 2);
+    assert_true(wcscmp(word_list_get(&rules)[1], L"ą -> a : 1,b") == 0);
+    assert_true(rule_stats[0].successes > 0);
+    assert_int_equal(rule_stats[1].tries, 0);
+    assert_int_equal(rule_stats[0].tries + rule_stats[1].tries, stats.rule_tries);
+    unsigned long long tries = rule_stats[0].tries;
+    free(rule_stats);
+    // Klon ma te same reguły, ale liczy je osobno
+    struct dictionary *clone = dictionary_clone(dict);
+    dictionary_hints(clone, L"łen", &list);
+    dictionary_hints(clone, L"łen", &list);
+    word_list_done(&list);
+    assert_int_equal(dictionary_rule_stats(clone, &rules, &rule_stats), 2);
+    assert_int_equal(rule_stats[0].tries, 2 * tries);
+    free(rule_stats);
+    assert_int_equal(dictionary_rule_stats(dict, &rules, &rule_stats), 2);
+    assert_int_equal(rule_stats[0].tries, tries);
+    free(rule_stats);
+    dictionary_done(clone);
+    // Zmiana reguł zeruje ich liczniki
+    dictionary_rule_add(dict, L"0", L"", false, 1, RULE_NORMAL);
+    assert_int_equal(dictionary_rule_stats(dict, &rules, &rule_stats), 3);
+    assert_int_equal(rule_stats[0].tries, 0);
+    free(rule_stats);
+    dictionary_stats_reset(dict);
+    assert_int_equal(dictionary_stats(dict, &stats), 0);
+    assert_int_equal(stats.queries, 0);
+    assert_int_equal(stats.nodes, 0);
+#else
+    assert_int_equal(dictionary_stats(dict, &stats), -1);
+    assert_int_equal(dictionary_rule_stats(dict, &rules, &rule_stats), -1);
+    assert_true(rule_stats == NULL);
+    assert_int_equal(word_list_size(&rules), 0);
+#endif
+    word_list_done(&rules);
+    dictionary_done(dict);
+}
+
+/**
+ * Test zużycia pamięci przez słownik.
+ * @param state Środowisko testowe.
+ */
+static void dictionary_memory_stats_test(void **state)
+{
+    struct dictionary *dict = dictionary_new();
+    dictionary_insert(dict, L"kot");
+    dictionary_insert(dict, L"kotek");
+    dictionary_insert(dict, L"kura");
+    dictionary_insert(dict, L"ala");
+    dictionary_rule_add(dict, L"ą", L"a", false, 1, RULE_NORMAL);
+    struct dictionary_memory_stats stats;
+    dictionary_memory_stats(dict, &stats);
+    assert_int_equal(stats.nodes, 12);
+    assert_int_equal(stats.leaves, 4);
+    assert_int_equal(stats.shared_nodes, 0);
+    assert_int_equal(stats.max_depth, 5);
+    assert_int_equal(stats.max_fanout, 2);
+    size_t depths[] = { 1, 2, 3, 3, 2, 1 };
+    for(int i = 0; i < 6; i++)
+        assert_int_equal(stats.depths[i], depths[i]);
+    assert_int_equal(stats.depths[6], 0);
+    assert_int_equal(stats.fanouts[0], 3);
+    assert_int_equal(stats.fanouts[1], 7);
+    assert_int_equal(stats.fanouts[2], 2);
+    assert_true(stats.child_wasted_bytes < stats.child_bytes);
+    assert_int_equal(stats.rules, 1);
+    assert_true(stats.rule_bytes > 0);
+    assert_int_equal(stats.index_bytes, 0);
+    assert_int_equal(stats.removed_bytes, 0);
+    assert_true(stats.total_bytes > stats.node_bytes + stats.child_bytes
+                                   + stats.rule_bytes + stats.alphabet_bytes);
+    assert_int_equal(stats.letters_no, 2);
+    for(size_t i = 0; i < stats.letters_no; i++)
+        assert_int_equal(stats.letter_words[i], stats.letters[i] == L'k' ? 3 : 1);
+
+    // Klon współdzieli całe drzewo
+    struct dictionary *clone = dictionary_clone(dict);
+    dictionary_memory_stats(clone, &stats);
+    assert_int_equal(stats.shared_nodes, stats.nodes);
+    dictionary_done(clone);
+
+    dictionary_index_build(dict);
+    dictionary_memory_stats(dict, &stats);
+    assert_true(stats.index_bytes > 0);
+
+    // Zagęszczone tablice dzieci nie mają wolnych miejsc
+    size_t nodes = stats.nodes;
+    assert_true(stats.child_wasted_bytes > 0);
+    assert_int_equal(dictionary_compact(dict), 0);
+    dictionary_memory_stats(dict, &stats);
+    assert_int_equal(stats.child_wasted_bytes, 0);
+    assert_int_equal(stats.child_bytes, (nodes - 1) * sizeof(void *));
+    assert_true(dictionary_find(dict, L"kotek"));
+    assert_true(dictionary_find(dict, L"ala"));
+    assert_int_equal(dictionary_insert(dict, L"koty"), 1);
+    assert_true(dictionary_find(dict, L"kot"));
+    dictionary_done(dict);
+}
+
+/**
+ * Testuje ustawianie i odczytywanie częstości słów.
+ */
+static void dictionary_frequency_test(void **state)
+{
+    struct dictionary *dict = dictionary_new();
+    dictionary_insert(dict, L"łan");
+    assert_int_equal(dictionary_frequency(dict, L"łan"), 0);
+    assert_int_equal(dictionary_set_frequency(dict, L"łan", 42), 1);
+    assert_int_equal(dictionary_frequency(dict, L"łan"), 42);
+    assert_int_equal(dictionary_set_frequency(dict, L"ła", 1), 0);
+    assert_int_equal(dictionary_set_frequency(dict, L"żan", 1), 0);
+    assert_int_equal(dictionary_frequency(dict, L"ła"), 0);
+    assert_int_equal(dictionary_frequency(dict, L"żan"), 0);
+    dictionary_set_frequency(dict, L"łan", DICTIONARY_MAX_FREQUENCY + 1);
+    assert_int_equal(dictionary_frequency(dict, L"łan"), DICTIONARY_MAX_FREQUENCY);
+    dictionary_done(dict);
+}
+
+/**
+ * Testuje kolejność podpowiedzi o równym koszcie według częstości.
+ */
+static void dictionary_hints_frequency_test(void **state)
+{
+    struct dictionary *dict = dictionary_new();
+    dictionary_insert(dict, L"łan");
+    dictionary_insert(dict, L"łon");
+    dictionary_insert(dict, L"łun");
+    dictionary_insert(dict, L"łen");
+    dictionary_set_frequency(dict, L"łun", 5);
+    dictionary_set_frequency(dict, L"łen", 9);
+    dictionary_rule_add(dict, L"0", L"1", false, 1, RULE_NORMAL);
+    dictionary_hints_max_cost(dict, 1);
+    char *list;
+    size_t len;
+    int costs[DICTIONARY_MAX_HINTS];
+    // Słowo ze słownika ma koszt 0, więc jest pierwsze mimo częstości
+    assert_int_equal(dictionary_hints_costs_utf8(dict, "łon", 4, &list, &len, costs), 4);
+    assert_int_equal(len, 20);
+    assert_memory_equal(list, "łon\0łen\0łun\0łan\0", 20);
+    assert_int_equal(costs[0], 0);
+    assert_int_equal(costs[1], 1);
+    assert_int_equal(costs[3], 1);
+    free(list);
+    dictionary_done(dict);
+}
+
+/**
+ * Testuje uzupełnianie prefiksów.
+ */
+static void dictionary_complete_test(void **state)
+{
+    setlocale(LC_ALL, "pl_PL.UTF-8");
+    struct dictionary *dict = dictionary_new();
+    dictionary_insert(dict, L"dom");
+    dictionary_insert(dict, L"domy");
+    dictionary_insert(dict, L"domek");
+    dictionary_insert(dict, L"dol");
+    dictionary_insert(dict, L"kot");
+    dictionary_set_frequency(dict, L"domek", 3);
+    struct word_list list;
+    assert_int_equal(dictionary_complete(dict, L"do", 3, &list), 3);
+    assert_true(wcscmp(word_list_get(&list)[0], L"domek") == 0);
+    assert_true(wcscmp(word_list_get(&list)[1], L"dol") == 0);
+    assert_true(wcscmp(word_list_get(&list)[2], L"dom") == 0);
+    word_list_done(&list);
+    dictionary_set_frequency(dict, L"domek", 0);
+    dictionary_set_frequency(dict, L"domy", 1);
+    assert_int_equal(dictionary_complete(dict, L"dom", 10, &list), 3);
+    assert_true(wcscmp(word_list_get(&list)[0], L"domy") == 0);
+    assert_true(wcscmp(word_list_get(&list)[1], L"dom") == 0);
+    assert_true(wcscmp(word_list_get(&list)[2], L"domek") == 0);
+    word_list_done(&list);
+    assert_int_equal(dictionary_complete(dict, L"x", 10, &list), 0);
+    word_list_done(&list);
+    assert_int_equal(dictionary_complete(dict, L"kota", 10, &list), 0);
+    word_list_done(&list);
+    dictionary_done(dict);
+}
+
+/**
+ * Testuje podpowiedzi z indeksem usunięć.
+ */
+static void dictionary_index_test(void **state)
+{
+    setlocale(LC_ALL, "pl_PL.UTF-8");
+    struct dictionary *dict = dictionary_new();
+    const wchar_t *words[] = { L"kot", L"kto", L"ko", L"kotek", L"lot", L"koty", L"pies" };
+    for(size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++)
+        dictionary_insert(dict, words[i]);
+    dictionary_set_frequency(dict, L"lot", 2);
+    dictionary_rule_add(dict, L"0", L"", false, 1, RULE_NORMAL);
+    dictionary_rule_add(dict, L"", L"0", false, 1, RULE_NORMAL);
+    dictionary_rule_add(dict, L"0", L"1", false, 1, RULE_NORMAL);
+    dictionary_rule_add(dict, L"01", L"10", false, 1, RULE_NORMAL);
+    dictionary_hints_max_cost(dict, 2);
+    const wchar_t *queries[] = { L"kot", L"okt", L"kotk", L"x", L"pise", L"ktoe" };
+    struct word_list expected[sizeof(queries) / sizeof(queries[0])];
+    for(size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++)
+        dictionary_hints(dict, queries[i], &expected[i]);
+    assert_false(dictionary_has_index(dict));
+    assert_int_equal(dictionary_index_save(dict, stdout), -1);
+    assert_int_equal(dictionary_index_build(dict), 0);
+    assert_true(dictionary_has_index(dict));
+    for(size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++)
+    {
+        struct word_list list;
+        dictionary_hints(dict, queries[i], &list);
+        assert_int_equal(word_list_size(&list), word_list_size(&expected[i]));
+        for(size_t j = 0; j < word_list_size(&list); j++)
+            assert_true(wcscmp(word_list_get(&list)[j], word_list_get(&expected[i])[j]) == 0);
+        word_list_done(&list);
+        word_list_done(&expected[i]);
+    }
+    // Zmiana częstości nie unieważnia indeksu, zmiana słów tak
+    dictionary_set_frequency(dict, L"kot", 3);
+    assert_true(dictionary_has_index(dict));
+    dictionary_insert(dict, L"kotka");
+    assert_false(dictionary_has_index(dict));
+    dictionary_done(dict);
+}
+
+/**
+ * Testuje wstawianie i usuwanie słów w nakładkach.
+ */
+static void dictionary_overlay_test(void **state)
+{
+    struct dictionary *base = dictionary_new();
+    dictionary_insert(base, L"kot");
+    dictionary_insert(base, L"pies");
+    dictionary_set_frequency(base, L"pies", 5);
+    struct dictionary *user = dictionary_overlay_new(base);
+    struct dictionary *session = dictionary_overlay_new(user);
+    assert_true(dictionary_find(session, L"kot"));
+    assert_int_equal(dictionary_frequency(session, L"pies"), 5);
+
+    assert_int_equal(dictionary_insert(user, L"kotek"), 1);
+    assert_int_equal(dictionary_insert(user, L"kot"), 0);
+    assert_int_equal(dictionary_delete(session, L"kot"), 1);
+    assert_int_equal(dictionary_delete(session, L"kot"), 0);
+    assert_int_equal(dictionary_delete(session, L"kotek"), 1);
+    assert_false(dictionary_find(session, L"kot"));
+    assert_false(dictionary_find(session, L"kotek"));
+    assert_true(dictionary_find(user, L"kot"));
+    assert_true(dictionary_find(user, L"kotek"));
+    assert_true(dictionary_find(base, L"kot"));
+    assert_false(dictionary_find(base, L"kotek"));
+    assert_true(dictionary_find_utf8(user, "kotek", 5));
+    assert_false(dictionary_find_utf8(session, "kotek", 5));
+
+    // Zmiana częstości słowa spod spodu nie zmienia słownika pod spodem
+    assert_int_equal(dictionary_set_frequency(session, L"pies", 7), 1);
+    assert_int_equal(dictionary_set_frequency(session, L"kot", 7), 0);
+    assert_int_equal(dictionary_frequency(session, L"pies"), 7);
+    assert_int_equal(dictionary_frequency(base, L"pies"), 5);
+
+    // Ponownie wstawione słowo jest nowe, więc ma zerową częstość
+    assert_int_equal(dictionary_delete(user, L"pies"), 1);
+    assert_true(dictionary_find(session, L"pies"));
+    assert_int_equal(dictionary_insert(user, L"pies"), 1);
+    assert_int_equal(dictionary_frequency(user, L"pies"), 0);
+    assert_int_equal(dictionary_insert(session, L"kot"), 1);
+    assert_true(dictionary_find(session, L"kot"));
+    assert_int_equal(dictionary_insert(session, L"żółw"), 1);
+    assert_false(dictionary_find(user, L"żółw"));
+
+    dictionary_done(session);
+    dictionary_done(user);
+    dictionary_done(base);
+}
+
+/**
+ * Testuje podpowiedzi i uzupełnienia z nakładek.
+ */
+static void dictionary_overlay_hints_test(void **state)
+{
+    setlocale(LC_ALL, "pl_PL.UTF-8");
+    struct dictionary *base = dictionary_new();
+    dictionary_insert(base, L"kot");
+    dictionary_insert(base, L"kto");
+    dictionary_insert(base, L"koty");
+    dictionary_set_frequency(base, L"koty", 2);
+    dictionary_rule_add(base, L"0", L"", false, 1, RULE_NORMAL);
+    dictionary_rule_add(base, L"", L"0", false, 1, RULE_NORMAL);
+    dictionary_rule_add(base, L"01", L"10", false, 1, RULE_NORMAL);
+    dictionary_hints_max_cost(base, 1);
+    struct dictionary *user = dictionary_overlay_new(base);
+    dictionary_insert(user, L"okt");
+    dictionary_delete(user, L"kto");
+    dictionary_set_frequency(user, L"kot", 3);
+    struct word_list list;
+    dictionary_hints(user, L"kot", &list);
+    assert_int_equal(word_list_size(&list), 3);
+    assert_true(wcscmp(word_list_get(&list)[0], L"kot") == 0);
+    assert_true(wcscmp(word_list_get(&list)[1], L"koty") == 0);
+    assert_true(wcscmp(word_list_get(&list)[2], L"okt") == 0);
+    word_list_done(&list);
+    dictionary_hints(user, L"ko", &list);
+    assert_int_equal(word_list_size(&list), 1);
+    assert_true(wcscmp(word_list_get(&list)[0], L"kot") == 0);
+    word_list_done(&list);
+
+    char *hints;
+    size_t len;
+    int costs[DICTIONARY_MAX_HINTS];
+    assert_int_equal(dictionary_hints_costs_utf8(user, "kot", 3, &hints, &len, costs), 3);
+    assert_int_equal(len, 13);
+    assert_true(memcmp(hints, "kot\0koty\0okt", len) == 0);
+    assert_int_equal(costs[0], 0);
+    assert_int_equal(costs[1], 1);
+    assert_int_equal(costs[2], 1);
+    free(hints);
+
+    assert_int_equal(dictionary_complete(user, L"k", 10, &list), 2);
+    assert_true(wcscmp(word_list_get(&list)[0], L"kot") == 0);
+    assert_true(wcscmp(word_list_get(&list)[1], L"koty") == 0);
+    word_list_done(&list);
+    dictionary_done(user);
+    dictionary_done(base);
+}
+
+/**
+ * Testuje klonowanie słownika.
+ */
+static void dictionary_clone_test(void **state)
+{
+    struct dictionary *dict = dictionary_new();
+    dictionary_insert(dict, L"kot");
+    dictionary_insert(dict, L"kotek");
+    dictionary_insert(dict, L"pies");
+    dictionary_set_frequency(dict, L"kot", 3);
+    dictionary_rule_add(dict, L"o", L"e", true, 1, RULE_NORMAL);
+    dictionary_hints_max_cost(dict, 1);
+    assert_int_equal(dictionary_index_build(dict), 0);
+    struct dictionary *clone = dictionary_clone(dict);
+    struct dictionary *second = dictionary_clone(clone);
+    assert_true(dictionary_find(clone, L"kot"));
+    assert_int_equal(dictionary_frequency(clone, L"kot"), 3);
+    assert_true(dictionary_has_index(clone));
+
+    // Zmiany w klonie nie są widoczne w oryginale i na odwrót
+    assert_int_equal(dictionary_insert(clone, L"kotka"), 1);
+    assert_int_equal(dictionary_delete(clone, L"kotek"), 1);
+    assert_int_equal(dictionary_set_frequency(clone, L"pies", 4), 1);
+    assert_int_equal(dictionary_insert(clone, L"żółw"), 1);
+    assert_int_equal(dictionary_delete(dict, L"kot"), 1);
+    assert_false(dictionary_has_index(clone));
+    assert_true(dictionary_find(clone, L"kot"));
+    assert_true(dictionary_find(clone, L"kotka"));
+    assert_false(dictionary_find(clone, L"kotek"));
+    assert_true(dictionary_find(clone, L"żółw"));
+    assert_false(dictionary_find(dict, L"kot"));
+    assert_false(dictionary_find(dict, L"kotka"));
+    assert_true(dictionary_find(dict, L"kotek"));
+    assert_false(dictionary_find(dict, L"żółw"));
+    assert_int_equal(dictionary_frequency(dict, L"pies"), 0);
+    assert_int_equal(dictionary_frequency(clone, L"pies"), 4);
+    assert_true(dictionary_find(second, L"kot"));
+    assert_true(dictionary_find(second, L"kotek"));
+    assert_false(dictionary_find(second, L"żółw"));
+    assert_true(dictionary_has_index(second));
+
+    // Reguły są wspólne, dopóki któryś słownik ich nie zmieni
+    struct word_list list;
+    dictionary_hints(second, L"ket", &list);
+    assert_int_equal(word_list_size(&list), 1);
+    assert_true(wcscmp(word_list_get(&list)[0], L"kot") == 0);
+    word_list_done(&list);
+    dictionary_rule_clear(dict);
+    dictionary_hints(dict, L"ket", &list);
+    assert_int_equal(word_list_size(&list), 0);
+    word_list_done(&list);
+    dictionary_hints(clone, L"ket", &list);
+    assert_int_equal(word_list_size(&list), 1);
+    word_list_done(&list);
+
+    dictionary_done(dict);
+    dictionary_done(clone);
+    dictionary_done(second);
+}
+
+/**
+ * Testuje działania na zbiorach słów dwóch słowników.
+ */
+static void dictionary_set_operations_test(void **state)
+{
+    struct dictionary *a = dictionary_new();
+    struct dictionary *b = dictionary_new();
+    dictionary_insert(a, L"kot");
+    dictionary_insert(a, L"pies");
+    dictionary_set_frequency(a, L"kot", 2);
+    // Inna kolejność liter w alfabecie drugiego słownika
+    dictionary_insert(b, L"żółw");
+    dictionary_insert(b, L"kot");
+    dictionary_insert(b, L"kotek");
+    dictionary_set_frequency(b, L"kot", 5);
+    dictionary_rule_add(a, L"o", L"e", true, 1, RULE_NORMAL);
+    dictionary_hints_max_cost(a, 1);
+
+    struct dictionary *merged = dictionary_merge(a, b);
+    assert_true(dictionary_find(merged, L"kot"));
+    assert_true(dictionary_find(merged, L"kotek"));
+    assert_true(dictionary_find(merged, L"pies"));
+    assert_true(dictionary_find(merged, L"żółw"));
+    assert_int_equal(dictionary_frequency(merged, L"kot"), 5);
+    struct word_list list;
+    dictionary_hints(merged, L"ket", &list);
+    assert_int_equal(word_list_size(&list), 1);
+    word_list_done(&list);
+    // Wynik jest niezależny od słowników wejściowych
+    assert_int_equal(dictionary_delete(merged, L"pies"), 1);
+    assert_true(dictionary_find(a, L"pies"));
+
+    struct dictionary *sub = dictionary_subtract(a, b);
+    assert_false(dictionary_find(sub, L"kot"));
+    assert_true(dictionary_find(sub, L"pies"));
+    assert_false(dictionary_find(sub, L"kotek"));
+    struct dictionary *inter = dictionary_intersect(a, b);
+    assert_true(dictionary_find(inter, L"kot"));
+    assert_false(dictionary_find(inter, L"pies"));
+    assert_false(dictionary_find(inter, L"kotek"));
+    struct dictionary *diff = dictionary_diff(a, b);
+    assert_false(dictionary_find(diff, L"kot"));
+    assert_true(dictionary_find(diff, L"kotek"));
+    assert_true(dictionary_find(diff, L"pies"));
+    assert_true(dictionary_find(diff, L"żółw"));
+
+    // Nakładek nie można łączyć
+    struct dictionary *overlay = dictionary_overlay_new(a);
+    assert_true(dictionary_merge(overlay, b) == NULL);
+
+    dictionary_done(overlay);
+    dictionary_done(diff);
+    dictionary_done(inter);
+    dictionary_done(sub);
+    dictionary_done(merged);
+    dictionary_done(a);
+    dictionary_done(b);
+}
+
+/**
+ * Sprawdza, czy przeglądanie zwraca po kolei dane słowa.
+ */
+static void check_iter(struct dictionary_iter *iter, const wchar_t **words, size_t n)
+{
+    assert_true(iter != NULL);
+    const wchar_t *word;
+    unsigned int freq;
+    for(size_t i = 0; i < n; i++)
+    {
+        assert_int_equal(dictionary_iter_next(iter, &word, &freq), 1);
+        assert_true(wcscmp(word, words[i]) == 0);
+    }
+    assert_int_equal(dictionary_iter_next(iter, &word, &freq), 0);
+    dictionary_iter_done(iter);
+}
+
+/**
+ * Testuje przeglądanie słów słownika.
+ */
+static void dictionary_iter_test(void **state)
+{
+    struct dictionary *dict = dictionary_new();
+    // Symbole liter nie są w kolejności ich kodów
+    dictionary_insert(dict, L"pies");
+    dictionary_insert(dict, L"kot");
+    dictionary_insert(dict, L"kotek");
+    dictionary_insert(dict, L"żółw");
+    dictionary_insert(dict, L"ala");
+    dictionary_insert(dict, L"kura");
+    dictionary_set_frequency(dict, L"kotek", 7);
+    const wchar_t *all[] = { L"ala", L"kot", L"kotek", L"kura", L"pies", L"żółw" };
+    check_iter(dictionary_iter_begin(dict, NULL), all, 6);
+    check_iter(dictionary_iter_begin(dict, L""), all, 6);
+    check_iter(dictionary_iter_begin(dict, L"ko"), all + 1, 2);
+    check_iter(dictionary_iter_begin(dict, L"kot"), all + 1, 2);
+    check_iter(dictionary_iter_begin(dict, L"x"), NULL, 0);
+    check_iter(dictionary_iter_range(dict, L"kotek", L"pies"), all + 2, 2);
+    check_iter(dictionary_iter_range(dict, L"kou", NULL), all + 3, 3);
+    check_iter(dictionary_iter_range(dict, NULL, L"kot"), all, 1);
+    check_iter(dictionary_iter_range(dict, L"b", L"zz"), all + 1, 4);
+    check_iter(dictionary_iter_range(dict, L"pies", L"kot"), NULL, 0);
+
+    struct dictionary_iter *iter = dictionary_iter_begin(dict, L"kote");
+    const wchar_t *word;
+    unsigned int freq;
+    assert_int_equal(dictionary_iter_next(iter, &word, &freq), 1);
+    assert_int_equal(freq, 7);
+    dictionary_iter_done(iter);
+
+    // Nakładka: słowa warstw są scalane, a usunięte pomijane
+    struct dictionary *overlay = dictionary_overlay_new(dict);
+    dictionary_delete(overlay, L"kot");
+    dictionary_insert(overlay, L"bóbr");
+    dictionary_insert(overlay, L"kotka");
+    dictionary_set_frequency(overlay, L"kotek", 3);
+    const wchar_t *layered[] = { L"ala", L"bóbr", L"kotek", L"kotka", L"kura", L"pies", L"żółw" };
+    check_iter(dictionary_iter_begin(overlay, NULL), layered, 7);
+    check_iter(dictionary_iter_begin(overlay, L"ko"), layered + 2, 2);
+    iter = dictionary_iter_begin(overlay, L"kote");
+    assert_int_equal(dictionary_iter_next(iter, &word, &freq), 1);
+    assert_int_equal(freq, 3);
+    dictionary_iter_done(iter);
+
+    dictionary_done(overlay);
+    dictionary_done(dict);
+}
+
 /**
  * Uruchamia testy.
  */
@@ -114,6 +784,22 @@ int main(void) {
         cmocka_unit_test(dictionary_delete_test),
         cmocka_unit_test(dictionary_find_test),
         cmocka_unit_test(dictionary_hints_test),
+        cmocka_unit_test(dictionary_load_truncated_test),
+        cmocka_unit_test(dictionary_find_utf8_test),
+        cmocka_unit_test(dictionary_hints_utf8_test),
+        cmocka_unit_test(dictionary_hints_costs_utf8_test),
+        cmocka_unit_test(dictionary_frequency_test),
+        cmocka_unit_test(dictionary_hints_frequency_test),
+        cmocka_unit_test(dictionary_complete_test),
+        cmocka_unit_test(dictionary_index_test),
+        cmocka_unit_test(dictionary_overlay_test),
+        cmocka_unit_test(dictionary_overlay_hints_test),
+        cmocka_unit_test(dictionary_clone_test),
+        cmocka_unit_test(dictionary_set_operations_test),
+        cmocka_unit_test(dictionary_iter_test),
+        cmocka_unit_test(dictionary_rule_add_useless_test),
+        cmocka_unit_test(dictionary_stats_test),
+        cmocka_unit_test(dictionary_memory_stats_test),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -0,0 +1,206 @@
+/** @file
+    Program mierzący czas generowania podpowiedzi.
+
+    Buduje słownik z pseudolosowych słów (zawsze tych samych),
+    a następnie generuje podpowiedzi dla słów z wprowadzonymi literówkami.
+
+    Użycie: hints_benchmark [liczba słów] [liczba zapytań] [maksymalny koszt]
+    [liczba wątków]
+
+    Przy więcej niż jednym wątku każde zapytanie jest wykonywane dwukrotnie:
+    w jednym wątku i w podanej liczbie wątków. Program porównuje wyniki
+    i kończy się kodem 1, jeśli choć jedna lista podpowiedzi się różni.
+
+    @ingroup dictionary
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+    @copyright Uniwerstet Warszawski
+    @date 2015-06-20
+ */
+
+#include "dictionary.h"
+
+#include <locale.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wchar.h>
+
+/// Maksymalna długość generowanego słowa.
+#define MAX_WORD_LENGTH 32
+
+/// Sylaby, z których składamy słowa.
+static const wchar_t *syllables[] = {
+    L"ba", L"ce", L"cho", L"dą", L"dzi", L"fa", L"gę", L"ha", L"ja", L"ko",
+    L"ła", L"mi", L"nie", L"ną", L"o", L"pra", L"rze", L"sło", L"śni", L"ta",
+    L"u", L"wie", L"zó", L"ży", L"ść", L"ka", L"le", L"my", L"no", L"py"
+};
+
+/// Litery używane do wprowadzania literówek.
+static const wchar_t letters[] = L"aąbcćdeęfghijklłmnńoóprsśtuwyzźż";
+
+/// Stan generatora liczb pseudolosowych.
+static unsigned long long seed = 20150620;
+
+/**
+ * Zwraca kolejną liczbę pseudolosową.
+ * @return Liczba z przedziału [0, 2^31).
+ */
+static unsigned next_random(void)
+{
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned)(seed >> 33);
+}
+
+/**
+ * Generuje słowo z sylab.
+ * @param[out] word Bufor na słowo (co najmniej MAX_WORD_LENGTH znaków).
+ */
+static void random_word(wchar_t *word)
+{
+    size_t ns = sizeof(syllables) / sizeof(syllables[0]);
+    int cnt = 1 + next_random() % 5;
+    word[0] = 0;
+    for(int i = 0; i < cnt; i++)
+    {
+        const wchar_t *s = syllables[next_random() % ns];
+        if(wcslen(word) + wcslen(s) >= MAX_WORD_LENGTH - 2) break;
+        wcscat(word, s);
+    }
+}
+
+/**
+ * Wprowadza do słowa jedną literówkę.
+ * @param[in,out] word Słowo.
+ */
+static void make_typo(wchar_t *word)
+{
+    size_t len = wcslen(word);
+    size_t nl = wcslen(letters);
+    size_t pos = next_random() % (len + 1);
+    switch(next_random() % 4)
+    {
+        case 0:     // usunięcie
+            if(pos < len) wmemmove(word + pos, word + pos + 1, len - pos);
+            break;
+        case 1:     // wstawienie
+            wmemmove(word + pos + 1, word + pos, len - pos + 1);
+            word[pos] = letters[next_random() % nl];
+            break;
+        case 2:     // zamiana
+            if(pos < len) word[pos] = letters[next_random() % nl];
+            break;
+        default:    // przestawienie
+            if(pos + 1 < len)
+            {
+                wchar_t c = word[pos];
+                word[pos] = word[pos + 1];
+                word[pos + 1] = c;
+            }
+    }
+}
+
+/**
+ * Porównuje dwie listy podpowiedzi.
+ * @param[in] a Pierwsza lista.
+ * @param[in] b Druga lista.
+ * @return Czy listy są identyczne (łącznie z kolejnością).
+ */
+static bool same_hints(const struct word_list *a, const struct word_list *b)
+{
+    if(word_list_size(a) != word_list_size(b)) return false;
+    const wchar_t * const *wa = word_list_get(a);
+    const wchar_t * const *wb = word_list_get(b);
+    for(size_t i = 0; i < word_list_size(a); i++)
+    {
+        if(wcscmp(wa[i], wb[i]) != 0) return false;
+    }
+    return true;
+}
+
+/**
+ * Zwraca czas zegara monotonicznego.
+ * @return Czas w sekundach.
+ */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Funkcja main.
+ * @param[in] argc Liczba argumentów.
+ * @param[in] argv Argumenty.
+ * @return Kod wyjścia.
+ */
+int main(int argc, char **argv)
+{
+    setlocale(LC_ALL, "pl_PL.UTF-8");
+    int words = argc > 1 ? atoi(argv[1]) : 50000;
+    int queries = argc > 2 ? atoi(argv[2]) : 1000;
+    int max_cost = argc > 3 ? atoi(argv[3]) : 2;
+    int threads = argc > 4 ? atoi(argv[4]) : 1;
+
+    struct dictionary *dict = dictionary_new();
+    if(dict == NULL) return 1;
+    dictionary_hints_max_cost(dict, max_cost);
+    // Podstawowe operacje edycyjne: usunięcie, wstawienie, zamiana, przestawienie
+    dictionary_rule_add(dict, L"0", L"", false, 1, RULE_NORMAL);
+    dictionary_rule_add(dict, L"", L"0", false, 1, RULE_NORMAL);
+    dictionary_rule_add(dict, L"0", L"1", false, 1, RULE_NORMAL);
+    dictionary_rule_add(dict, L"01", L"10", false, 1, RULE_NORMAL);
+    // Same operacje edycyjne obsługuje szybka ścieżka w jednym wątku.
+    // Dodatkowa reguła wymusza ogólny algorytm, który dzieli warstwy na wątki.
+    if(threads > 1) dictionary_rule_add(dict, L"rz", L"ż", true, 1, RULE_NORMAL);
+    wchar_t word[MAX_WORD_LENGTH];
+    for(int i = 0; i < words; i++)
+    {
+        random_word(word);
+        dictionary_insert(dict, word);
+    }
+
+    size_t hints = 0;
+    size_t mismatches = 0;
+    double seconds = 0.0, threaded_seconds = 0.0;
+    for(int i = 0; i < queries; i++)
+    {
+        random_word(word);
+        make_typo(word);
+        struct word_list list;
+        dictionary_hints_threads(dict, 1);
+        double start = now();
+        dictionary_hints(dict, word, &list);
+        seconds += now() - start;
+        hints += word_list_size(&list);
+        if(threads > 1)
+        {
+            struct word_list threaded;
+            dictionary_hints_threads(dict, threads);
+            start = now();
+            dictionary_hints(dict, word, &threaded);
+            threaded_seconds += now() - start;
+            if(!same_hints(&list, &threaded))
+            {
+                fprintf(stderr, "different hints for: %ls\n", word);
+                mismatches++;
+            }
+            word_list_done(&threaded);
+        }
+        word_list_done(&list);
+    }
+
+    printf("words: %d, queries: %d, max cost: %d\n", words, queries, max_cost);
+    printf("hints: %zu, time: %.3f s, %.1f us/query\n",
+           hints, seconds, queries > 0 ? seconds * 1e6 / queries : 0.0);
+    if(threads > 1)
+    {
+        printf("threads: %d, time: %.3f s, %.1f us/query, mismatches: %zu\n",
+               threads, threaded_seconds,
+               queries > 0 ? threaded_seconds * 1e6 / queries : 0.0, mismatches);
+    }
+    dictionary_done(dict);
+    return mismatches > 0 ? 1 : 0;
+}
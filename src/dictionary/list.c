@@ -116,9 +116,8 @@ size_t list_reserve(struct list *l, size_t s)
 {
     if(s <= 0) s = 1;
     if(l->size > s) s = l->size;
-    void **na = malloc(s * sizeof(void*));
-    memcpy(na, l->array, l->size * sizeof(void*));
-    free(l->array);
+    void **na = realloc(l->array, s * sizeof(void*));
+    if(na == NULL) return l->capacity;
     l->array = na;
     l->capacity = s;
     return s;
@@ -154,30 +153,20 @@ void list_sort_and_unify(struct list *l, int (*f)(const void*, const void*), int
 {
     if(l->size <= 1) return;
     list_sort(l, f);
-    void **na = malloc(l->capacity * sizeof(void*));
-    void **nab = na;
+    // Usuwamy duplikaty w miejscu
     size_t ns = 1;
-    void **oa = l->array;
-    *na = *oa;
-    na++;
-    oa++;
-    for(int i = 1; i < l->size; i++)
+    for(size_t i = 1; i < l->size; i++)
     {
-        if(g(oa-1, oa) != 0)
+        if(g(&l->array[ns-1], &l->array[i]) != 0)
         {
-            *na = *oa;
-            na++;
-            ns++;
+            l->array[ns++] = l->array[i];
         }
         else
         {
             if(dups != NULL)
-                list_add(dups, *oa);
+                list_add(dups, l->array[i]);
         }
-        oa++;
     }
-    free(l->array);
-    l->array = nab;
     l->size = ns;
 }
 
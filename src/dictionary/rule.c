@@ -8,20 +8,26 @@
     @date 2015-06-15
  */
 
+#include "alphabet.h"
+#include "deletion_index.h"
 #include "dictionary.h"
 #include "list.h"
 #include "serialization.h"
 #include "str.h"
 #include "trie.h"
+#include "vector.h"
+#include "word_list.h"
 
 #include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <wchar.h>
 #include <wctype.h>
 
-#include "../testable.h"
-
 /**
  * Reguła podpowiadania słów z drzewa.
  */
@@ -29,8 +35,13 @@ struct hint_rule
 {
     wchar_t *src;               ///< Wzorzec do zastąpienia.
     wchar_t *dst;               ///< Tekst, którym zastąpić wzorzec.
+    symbol_t *ssrc;             ///< Wzorzec w symbolach alfabetu (po rule_compile).
+    symbol_t *sdst;             ///< Tekst docelowy w symbolach alfabetu (po rule_compile).
+    size_t slen;                ///< Długość wzorca w symbolach (po rule_compile).
+    unsigned int vars;          ///< Maska zmiennych wzorca (po rule_compile), 0 jeśli wzorzec to same litery.
     int cost;                   ///< Koszt użycia reguły.
     enum rule_flag flag;        ///< Flagi reguły.
+    int shared;                 ///< Liczba dodatkowych właścicieli reguły.
 };
 
 /**
@@ -38,12 +49,12 @@ struct hint_rule
  */
 struct state
 {
-    const wchar_t *suf;               ///< Sufiks do poprawienia
+    const symbol_t *suf;              ///< Sufiks do poprawienia
     const struct trie_node * node;    ///< Aktualny węzeł w słowniku
     const struct trie_node * prev;    ///< NULL jeśli nie ma poprzedniego słowa lub wskaźnik na poprzednie słowo
     struct state *prnt;               ///< Poprzedni stan
     struct hint_rule *rule;           ///< Reguła wykorzystana do przejścia z poprzedniego do aktualnego stanu.
-    wchar_t free_variable;            ///< Wartość po prawej stronie reguły, która mogła być dowolna.
+    symbol_t free_variable;           ///< Wartość po prawej stronie reguły, która mogła być dowolna.
 };
 
 /**
@@ -55,63 +66,540 @@ struct costed_state
     int cost;                           ///< Koszt stanu
 };
 
-/** @name Funkcje pomocnicze
- * @{
+/**
+ * Stan końcowy uzupełniony o częstość podpowiedzi, którą generuje.
  */
+struct ranked_state
+{
+    struct state *s;                    ///< Stan końcowy
+    unsigned int freq;                  ///< Częstość podpowiedzi
+};
 
 /**
- * Porządek częściowy na stanach.
- * @param[in] a Wskaźnik na wskaźnik na pierwszy stan.
- * @param[in] b Wskaźnik na wskaźnik na drugi stan.
- * @return 0 jeśli są równe, liczbę dodatnią lub ujemną
+ * Koszty podstawowych operacji edycyjnych.
+ * Koszt większy od maksymalnego kosztu podpowiedzi oznacza,
+ * że operacji nie można użyć.
+ */
+struct edit_costs
+{
+    int del;                            ///< Usunięcie litery (`0 -> `).
+    int ins;                            ///< Wstawienie litery (` -> 0`).
+    int sub;                            ///< Zamiana litery (`0 -> 1`).
+    int swap;                           ///< Przestawienie sąsiednich liter (`01 -> 10`).
+};
+
+/**
+ * Słowo ze słownika znalezione przez edit_search_node().
+ */
+struct edit_hint
+{
+    int cost;                           ///< Odległość edycyjna od szukanego słowa.
+    unsigned int freq;                  ///< Częstość słowa.
+    size_t text;                        ///< Początek słowa w buforze liter.
+    size_t len;                         ///< Długość słowa.
+};
+
+/**
+ * Reguły pogrupowane po pierwszym symbolu wzorca.
+ * Do sufiksu mogą pasować tylko reguły z grupy jego pierwszej litery
+ * i reguły, których wzorzec jest pusty lub zaczyna się zmienną (grupa 0).
+ */
+struct rule_dispatch
+{
+    int *order;                         ///< Numery reguł kolejnymi grupami, w grupie rosnąco.
+    size_t start[UCHAR_MAX + 2];        ///< Początki grup w `order` (grupa `c` to `start[c]`..`start[c+1]`).
+    struct hint_rule **selected;        ///< Bufor na reguły wybrane dla sufiksu.
+};
+
+/**
+ * Informacje o regułach pasujących do sufiksu danej długości,
+ * z których liczymy dolne ograniczenie kosztu dokończenia podpowiedzi.
+ * 
+ * Koszt skracania (wydłużania) tekstu to najmniejszy koszt reguły
+ * przypadający na literę, o którą reguła skraca (wydłuża) tekst.
+ * Skracanie, wydłużanie i podział dotyczą reguł dla sufiksów
+ * nie dłuższych niż dany, bo tylko takich można jeszcze użyć.
+ */
+struct suffix_bound
+{
+    int min_cost;                       ///< Koszt najtańszej reguły dla sufiksu tej długości.
+    int shrink_cost;                    ///< Koszt najtańszego skracania (licznik).
+    int shrink_len;                     ///< Koszt najtańszego skracania (mianownik, 0 jeśli nie można skracać).
+    int grow_cost;                      ///< Koszt najtańszego wydłużania (licznik).
+    int grow_len;                       ///< Koszt najtańszego wydłużania (mianownik, 0 jeśli nie można wydłużać).
+    int split_cost;                     ///< Koszt najtańszej reguły RULE_SPLIT.
+};
+
+/**
+ * Dolne ograniczenie kosztu dokończenia podpowiedzi ze stanu (jak w A*).
+ * 
+ * Ze stanu można przejść bez kosztu tylko wzdłuż drzewa, dopóki litery
+ * sufiksu zgadzają się z dziećmi węzła. Jeśli ta ścieżka nie kończy się
+ * podpowiedzią, trzeba gdzieś na niej użyć reguły pasującej do sufiksu,
+ * a najtańsze takie reguły znamy z preprocessingu.
+ * 
+ * Poza tym słowa poniżej węzła mają ograniczoną długość, więc za różnicę
+ * między długością sufiksu a długością dopisanych liter trzeba zapłacić
+ * regułami, które skracają lub wydłużają tekst.
+ */
+struct hint_bound
+{
+    const symbol_t *end;                ///< Koniec słowa, dla którego szukamy podpowiedzi.
+    struct suffix_bound *suf;           ///< Informacje o regułach indeksowane po długości sufiksu.
+    int max_cost;                       ///< Maksymalny koszt podpowiedzi.
+};
+
+/**
+ * Liczba stanów w jednym bloku puli stanów.
+ */
+#define STATE_POOL_BLOCK 1024
+
+/**
+ * Blok pamięci puli stanów.
+ */
+struct state_block
+{
+    struct state_block *next;                   ///< Poprzednio zaalokowany blok.
+    struct state states[STATE_POOL_BLOCK];      ///< Stany.
+};
+
+/**
+ * Pula stanów.
+ * 
+ * Stany żyją do końca generowania podpowiedzi dla jednego słowa,
+ * więc zamiast zwalniać je pojedynczo zwalniamy od razu całą pulę.
+ */
+struct state_pool
+{
+    struct state_block *blocks;         ///< Ostatnio zaalokowany blok.
+    size_t used;                        ///< Liczba zajętych stanów w ostatnim bloku.
+};
+
+/**
+ * Najmniejsza liczba stanów, z których rozwijamy warstwę,
+ * przy której opłaca się rozwijać ją w kilku wątkach.
+ */
+#define LAYER_PARALLEL_MIN_STATES 512
+
+/**
+ * Liczba części warstwy przypadających na jeden wątek.
+ * Rozwinięcie stanów trwa bardzo różnie, więc wątki biorą
+ * kolejne części, aż się skończą.
+ */
+#define LAYER_PARALLEL_SPLIT 8
+
+/**
+ * Rozwijanie warstwy stanów o danym koszcie przez kilka wątków.
+ * 
+ * Stany, z których rozwijamy warstwę, są przeglądane w tej samej kolejności
+ * co w jednym wątku i dzielone na kolejne części. Każda część ma własny
+ * wektor stanów pochodnych, a wektory są potem łączone po kolei,
+ * więc warstwa jest dokładnie taka sama jak przy rozwijaniu w jednym wątku.
+ */
+struct layer_work
+{
+    struct state_vector *layers;        ///< Warstwy stanów.
+    int cost;                           ///< Koszt rozwijanej warstwy.
+    const struct trie_node *root;       ///< Korzeń drzewa TRIE.
+    struct rule_vector *pp;             ///< Wynik preprocessingu.
+    struct state *begin;                ///< Stan początkowy.
+    const struct hint_bound *bound;     ///< Ograniczenie kosztu dokończenia podpowiedzi.
+    size_t total;                       ///< Liczba stanów, z których rozwijamy warstwę.
+    size_t chunk;                       ///< Liczba stanów w jednej części.
+    size_t chunks;                      ///< Liczba części.
+    size_t next;                        ///< Następna część do wzięcia.
+    struct state_vector *out;           ///< Stany pochodne z kolejnych części.
+};
+
+/**
+ * Wątek rozwijający warstwy stanów z własną pulą stanów.
+ */
+struct layer_worker
+{
+    struct layer_work *work;            ///< Rozwijana warstwa.
+    struct state_pool pool;             ///< Pula stanów wątku.
+    pthread_t thread;                   ///< Wątek.
+#ifdef DICTIONARY_HINT_STATS
+    struct hint_run_stats *stats;       ///< Statystyki bieżącego generowania lub NULL.
+#endif
+};
+
+#ifdef UNIT_TESTING
+// Przydzielanie pamięci w testach nie jest bezpieczne dla wątków, więc
+// testy dzielą na części nawet małe warstwy, ale rozwijają je w jednym wątku.
+#undef LAYER_PARALLEL_MIN_STATES
+#define LAYER_PARALLEL_MIN_STATES 1
+#define LAYER_PARALLEL_INLINE
+#endif
+
+#ifdef DICTIONARY_HINT_STATS
+/**
+ * Reguła i jej numer na liście reguł słownika.
+ */
+struct rule_slot
+{
+    const struct hint_rule *rule;       ///< Reguła.
+    size_t index;                       ///< Numer reguły.
+};
+
+/**
+ * Statystyki jednego generowania podpowiedzi.
+ */
+struct hint_run_stats
+{
+    struct dictionary_stats total;      ///< Liczniki generowania, doliczane do słownika na końcu.
+    struct hint_stats *dict;            ///< Statystyki słownika.
+    struct rule_slot *slots;            ///< Reguły posortowane po adresach lub NULL, jeśli ich nie liczymy.
+    size_t rules_no;                    ///< Liczba reguł w `slots`.
+};
+
+/**
+ * Statystyki generowania podpowiedzi, które wykonuje ten wątek, lub NULL.
+ * Wątki rozwijające warstwę liczą do statystyk tego samego generowania.
+ */
+static __thread struct hint_run_stats *hint_stats = NULL;
+
+/// Dolicza `n` do licznika statystyk `stats` (można liczyć z kilku wątków).
+#define HINT_STATS_ADD(stats, counter, n) \
+    do { if((stats) != NULL) __atomic_fetch_add(&(stats)->counter, (n), __ATOMIC_RELAXED); } while(0)
+/// Zapamiętuje czas rozpoczęcia etapu generowania.
+#define HINT_STAT_START(t) unsigned long long t = hint_stats != NULL ? hint_stats_now() : 0
+/// Dolicza czas, który upłynął od HINT_STAT_START(t), do licznika czasu.
+#define HINT_STAT_STOP(t, counter) HINT_STATS_ADD(hint_stats, total.counter, hint_stats != NULL ? hint_stats_now() - (t) : 0)
+#else
+#define HINT_STATS_ADD(stats, counter, n) do { } while(0)
+#define HINT_STAT_START(t) do { } while(0)
+#define HINT_STAT_STOP(t, counter) do { } while(0)
+#endif
+/// Dolicza `n` do licznika statystyk bieżącego generowania.
+#define HINT_STAT_ADD(counter, n) HINT_STATS_ADD(hint_stats, total.counter, n)
+
+/**
+ * Porządek liniowy na stanach.
+ * 
+ * Porównuje długości sufiksów przez porównanie wskaźników,
+ * bo wszystkie stany wskazują na sufiksy tego samego słowa.
+ * 
+ * @param[in] a Pierwszy stan.
+ * @param[in] b Drugi stan.
+ * @return 0 jeśli są równe, liczbę dodatnią lub ujemną
  * jeśli odpowiednio pierwszy stan jest większy od drugiego lub drugi od pierwszego.
  */
-static int state_sorter(const void *a, const void *b)
+static inline int state_compare(const struct state *a, const struct state *b)
 {
-    struct state *A = *(struct state**)a;
-    struct state *B = *(struct state**)b;
-    if((size_t)A->node - (size_t)B->node != 0) return (size_t)A->node - (size_t)B->node;
-    if((size_t)A->prev - (size_t)B->prev != 0) return (size_t)A->prev - (size_t)B->prev;
-    if((A->rule != NULL && A->rule->flag == RULE_END) && (B->rule == NULL || B->rule->flag != RULE_END)) return 1;
-    if((A->rule == NULL || A->rule->flag != RULE_END) && (B->rule != NULL && B->rule->flag == RULE_END)) return -1;
-    int alen = wcslen(A->suf);
-    int blen = wcslen(B->suf);
-    return alen - blen;
+    if(a->node != b->node) return a->node < b->node ? -1 : 1;
+    if(a->prev != b->prev) return a->prev < b->prev ? -1 : 1;
+    bool ae = a->rule != NULL && a->rule->flag == RULE_END;
+    bool be = b->rule != NULL && b->rule->flag == RULE_END;
+    if(ae != be) return ae ? 1 : -1;
+    if(a->suf != b->suf) return a->suf > b->suf ? -1 : 1;
+    return 0;
 }
 
 /**
- * Porządek częściowy na stanach wzbogaconych o koszty.
+ * Porządek na stanach wzbogaconych o koszty.
  * Sortujemy najpierw po stanie bazowym, a potem po koszcie.
+ * Z równych stanów o tym samym koszcie pierwszy jest ten, który można
+ * dalej rozwijać (nie powstał z reguły RULE_BEGIN), więc to, który z nich
+ * zostanie, nie zależy od kolejności stanów w warstwie.
  * 
- * @param[in] a Wskaźnik na wskaźnik na pierwszy stan.
- * @param[in] b Wskaźnik na wskaźnik na drugi stan.
- * @return 0 jeśli są równe, liczbę dodatnią lub ujemną jeśli
- * odpowiednio pierwszy stan jest większy od drugiego lub drugi od pierwszego.
+ * @param[in] a Pierwszy stan.
+ * @param[in] b Drugi stan.
+ * @return True jeśli pierwszy stan jest mniejszy od drugiego.
  */
-static int costed_state_sorter(const void *a, const void *b)
+static inline bool costed_state_less(const struct costed_state *a, const struct costed_state *b)
 {
-    struct costed_state *A = *(struct costed_state**)a;
-    struct costed_state *B = *(struct costed_state**)b;
-    int cmp = state_sorter(&(A->s), &(B->s));
-    if(cmp != 0) return cmp;
-    else return A->cost - B->cost;
+    int cmp = state_compare(a->s, b->s);
+    if(cmp != 0) return cmp < 0;
+    if(a->cost != b->cost) return a->cost < b->cost;
+    bool ab = a->s->rule != NULL && a->s->rule->flag == RULE_BEGIN;
+    bool bb = b->s->rule != NULL && b->s->rule->flag == RULE_BEGIN;
+    return !ab && bb;
 }
 
 /**
  * Porównuje stany wzbogacone o koszty.
  * Stany te są równe jeśli stany bazowe są równe.
- * Czyli wywołanie state_sorter zwraca 0.
  * 
- * @param[in] a Wskaźnik na wskaźnik na pierwszy stan.
- * @param[in] b Wskaźnik na wskaźnik na drugi stan.
- * @return 0 jeśli są równe, cokolwiek niezerowego w p.p.
+ * @param[in] a Pierwszy stan.
+ * @param[in] b Drugi stan.
+ * @return True jeśli stany bazowe są równe.
+ */
+static inline bool costed_state_equal(const struct costed_state *a, const struct costed_state *b)
+{
+    return state_compare(a->s, b->s) == 0;
+}
+
+/**
+ * Porządek na regułach po koszcie.
+ * 
+ * @param[in] a Wskaźnik na pierwszą regułę.
+ * @param[in] b Wskaźnik na drugą regułę.
+ * @return True jeśli pierwsza reguła jest tańsza.
+ */
+static inline bool rule_cost_less(struct hint_rule * const *a, struct hint_rule * const *b)
+{
+    return (*a)->cost < (*b)->cost;
+}
+
+/**
+ * Porządek na stanach końcowych: najpierw częstsze podpowiedzi.
+ * 
+ * @param[in] a Pierwszy stan.
+ * @param[in] b Drugi stan.
+ * @return True jeśli pierwszy stan daje częstszą podpowiedź.
+ */
+static inline bool ranked_state_less(const struct ranked_state *a, const struct ranked_state *b)
+{
+    return a->freq > b->freq;
+}
+
+/**
+ * Porządek na znalezionych słowach: najpierw tańsze, potem częstsze.
+ * 
+ * @param[in] a Pierwsze słowo.
+ * @param[in] b Drugie słowo.
+ * @return True jeśli pierwsze słowo ma być podpowiedziane wcześniej.
+ */
+static inline bool edit_hint_less(const struct edit_hint *a, const struct edit_hint *b)
+{
+    if(a->cost != b->cost) return a->cost < b->cost;
+    return a->freq > b->freq;
+}
+
+/**
+ * Porządek alfabetyczny na w-stringach (według locale).
+ * 
+ * @param[in] a Wskaźnik na pierwszy tekst.
+ * @param[in] b Wskaźnik na drugi tekst.
+ * @return True jeśli pierwszy tekst jest wcześniej.
+ */
+static inline bool locale_less(const wchar_t * const *a, const wchar_t * const *b)
+{
+    return wcscoll(*a, *b) < 0;
+}
+
+/**
+ * Równość w-stringów w porządku alfabetycznym (według locale).
+ * 
+ * @param[in] a Wskaźnik na pierwszy tekst.
+ * @param[in] b Wskaźnik na drugi tekst.
+ * @return True jeśli teksty są równoważne.
+ */
+static inline bool locale_equal(const wchar_t * const *a, const wchar_t * const *b)
+{
+    return wcscoll(*a, *b) == 0;
+}
+
+/**
+ * Porządek na w-stringach po wartościach znaków.
+ * 
+ * @param[in] a Wskaźnik na pierwszy tekst.
+ * @param[in] b Wskaźnik na drugi tekst.
+ * @return True jeśli pierwszy tekst jest mniejszy.
+ */
+static inline bool text_less(const wchar_t * const *a, const wchar_t * const *b)
+{
+    const wchar_t *A = *a;
+    const wchar_t *B = *b;
+    while(*A == *B && *A != 0)
+    {
+        A++; B++;
+    }
+    return *A < *B;
+}
+
+/// Wektor wskaźników na stany.
+VECTOR_DEFINE(state_vector, struct state *)
+/// Wektor stanów z kosztami.
+VECTOR_DEFINE(costed_state_vector, struct costed_state)
+VECTOR_DEFINE_SORT(costed_state_vector, struct costed_state, costed_state_less)
+VECTOR_DEFINE_UNIQUE(costed_state_vector, struct costed_state, costed_state_equal)
+/// Wektor stanów końcowych posortowany nierosnąco po częstości.
+VECTOR_DEFINE(ranked_state_vector, struct ranked_state)
+VECTOR_DEFINE_SORT(ranked_state_vector, struct ranked_state, ranked_state_less)
+/// Wektor wskaźników na reguły.
+VECTOR_DEFINE(rule_vector, struct hint_rule *)
+VECTOR_DEFINE_SORT(rule_vector, struct hint_rule *, rule_cost_less)
+/// Wektor wskaźników na teksty posortowany alfabetycznie.
+VECTOR_DEFINE(text_vector, const wchar_t *)
+VECTOR_DEFINE_SORT(text_vector, const wchar_t *, locale_less)
+VECTOR_DEFINE_UNIQUE(text_vector, const wchar_t *, locale_equal)
+/// Wektor wskaźników na teksty posortowany po wartościach znaków.
+VECTOR_DEFINE(raw_text_vector, const wchar_t *)
+VECTOR_DEFINE_SORT(raw_text_vector, const wchar_t *, text_less)
+/// Wektor słów znalezionych przy odległości edycyjnej.
+VECTOR_DEFINE(edit_hint_vector, struct edit_hint)
+VECTOR_DEFINE_SORT(edit_hint_vector, struct edit_hint, edit_hint_less)
+/// Wektor symboli.
+VECTOR_DEFINE(symbol_vector, symbol_t)
+
+/**
+ * Podpowiedzi dla jednego słowa dopisywane grupami do listy wyjściowej.
+ * 
+ * Grupę tworzą podpowiedzi o tym samym koszcie i tej samej częstości.
+ * Grupy trzeba dopisywać w kolejności rosnących kosztów i malejących
+ * częstości; w grupie podpowiedzi są porządkowane alfabetycznie.
+ */
+struct hint_output
+{
+    struct word_list *list;             ///< Lista wyjściowa.
+    size_t first;                       ///< Rozmiar listy wyjściowej przed dopisaniem podpowiedzi.
+    int max_hints_no;                   ///< Maksymalna liczba podpowiedzi na liście.
+    int *costs;                         ///< Tablica na koszty podpowiedzi albo NULL.
+    struct word_list group;             ///< Podpowiedzi z aktualnej grupy.
+    struct text_vector sorted;          ///< Posortowane podpowiedzi z aktualnej grupy.
+    struct raw_text_vector added;       ///< Dopisane podpowiedzi posortowane po wartościach znaków.
+};
+
+#include "../testable.h"
+
+/** @name Funkcje pomocnicze
+ * @{
+ */
+
+/**
+ * Inicjuje pustą pulę stanów.
+ * 
+ * @param[out] p Pula.
+ */
+static void state_pool_init(struct state_pool *p)
+{
+    p->blocks = NULL;
+    p->used = STATE_POOL_BLOCK;
+}
+
+/**
+ * Zwalnia pulę stanów razem ze wszystkimi stanami.
+ * 
+ * @param[in,out] p Pula.
+ */
+static void state_pool_done(struct state_pool *p)
+{
+    while(p->blocks != NULL)
+    {
+        struct state_block *b = p->blocks;
+        p->blocks = b->next;
+        free(b);
+    }
+    p->used = STATE_POOL_BLOCK;
+}
+
+/**
+ * Przydziela nowy stan z puli.
+ * 
+ * @param[in,out] p Pula.
+ * @return Wskaźnik na stan lub NULL jeśli brakło pamięci.
+ */
+static struct state * state_new(struct state_pool *p)
+{
+    if(p->used == STATE_POOL_BLOCK)
+    {
+        struct state_block *b = malloc(sizeof(struct state_block));
+        if(b == NULL) return NULL;
+        b->next = p->blocks;
+        p->blocks = b;
+        p->used = 0;
+    }
+    return &p->blocks->states[p->used++];
+}
+
+#ifdef DICTIONARY_HINT_STATS
+/**
+ * Zwraca bieżący czas do mierzenia etapów generowania.
+ * 
+ * @return Czas w nanosekundach od nieokreślonej chwili.
+ */
+static unsigned long long hint_stats_now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (unsigned long long)t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+/// Wywołuje `f` dla każdego licznika struct dictionary_stats poza tablicą `states`.
+#define HINT_STATS_COUNTERS(f) \
+    f(queries) f(edit_queries) f(duplicates) f(nodes) f(rule_tries) \
+    f(rule_successes) f(preprocess_ns) f(expand_ns) f(unify_ns) f(text_ns)
+
+/**
+ * Dolicza statystyki jednego generowania do statystyk słownika.
+ * 
+ * @param[in,out] to Statystyki słownika (mogą je uaktualniać inne wątki).
+ * @param[in] from Statystyki jednego generowania.
+ */
+static void hint_stats_merge(struct dictionary_stats *to, const struct dictionary_stats *from)
+{
+#define HINT_STATS_MERGE(counter) \
+    if(from->counter != 0) __atomic_fetch_add(&to->counter, from->counter, __ATOMIC_RELAXED);
+    HINT_STATS_COUNTERS(HINT_STATS_MERGE)
+#undef HINT_STATS_MERGE
+    for(int i = 0; i < DICTIONARY_STATS_LAYERS; i++)
+        if(from->states[i] != 0) __atomic_fetch_add(&to->states[i], from->states[i], __ATOMIC_RELAXED);
+}
+
+/**
+ * Porządek na regułach według adresów.
+ * 
+ * @param[in] a Pierwsza reguła (struct rule_slot).
+ * @param[in] b Druga reguła (struct rule_slot).
+ * @return Wynik porównania jak w qsort().
+ */
+static int rule_slot_compare(const void *a, const void *b)
+{
+    uintptr_t x = (uintptr_t)((const struct rule_slot *)a)->rule;
+    uintptr_t y = (uintptr_t)((const struct rule_slot *)b)->rule;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Przygotowuje statystyki jednego generowania.
+ * Reguły są liczone tylko wtedy, gdy słownik ma liczniki dla tylu reguł,
+ * ile dostało generowanie (reguły niższych warstw są przetłumaczonymi
+ * kopiami reguł słownika w tej samej kolejności).
+ * 
+ * @param[out] rs Statystyki generowania.
+ * @param[in] stats Statystyki słownika.
+ * @param[in] rules NULL-terminated lista reguł.
+ */
+static void hint_run_stats_init(struct hint_run_stats *rs, struct hint_stats *stats, struct hint_rule **rules)
+{
+    memset(&rs->total, 0, sizeof(rs->total));
+    rs->dict = stats;
+    rs->slots = NULL;
+    rs->rules_no = 0;
+    size_t n = 0;
+    while(rules[n] != NULL) n++;
+    if(n == 0 || n != stats->rules_no) return;
+    rs->slots = malloc(n * sizeof(struct rule_slot));
+    if(rs->slots == NULL) return;
+    for(size_t i = 0; i < n; i++)
+    {
+        rs->slots[i].rule = rules[i];
+        rs->slots[i].index = i;
+    }
+    qsort(rs->slots, n, sizeof(struct rule_slot), rule_slot_compare);
+    rs->rules_no = n;
+}
+
+/**
+ * Dolicza zastosowanie reguły do liczników reguł słownika.
+ * 
+ * @param[in] r Reguła.
+ * @param[in] success Czy zastosowanie dało nowy stan.
  */
-static int costed_state_comparer(const void *a, const void *b)
+static void hint_stats_rule_applied(const struct hint_rule *r, bool success)
 {
-    struct costed_state *A = *(struct costed_state**)a;
-    struct costed_state *B = *(struct costed_state**)b;
-    return state_sorter(&(A->s), &(B->s));
+    if(hint_stats == NULL || hint_stats->slots == NULL) return;
+    struct rule_slot key = { r, 0 };
+    const struct rule_slot *slot = bsearch(&key, hint_stats->slots, hint_stats->rules_no,
+                                           sizeof(struct rule_slot), rule_slot_compare);
+    if(slot == NULL) return;
+    struct dictionary_rule_stats *c = &hint_stats->dict->rules[slot->index];
+    __atomic_fetch_add(&c->tries, 1, __ATOMIC_RELAXED);
+    if(success) __atomic_fetch_add(&c->successes, 1, __ATOMIC_RELAXED);
 }
+#endif
 
 /**
  * Próbuje przypasować wzorzec do tekstu.
@@ -121,68 +609,57 @@ static int costed_state_comparer(const void *a, const void *b)
  * @param[in,out] memory Pamięć, gdzie zapisać przypisania wartości do zmiennych.
  * @return True jeśli udało się dopasować, false w p.p.
  */
-static bool pattern_matches(const wchar_t *pattern, const wchar_t *text, wchar_t memory[10])
+static bool pattern_matches(const symbol_t *pattern, const symbol_t *text, symbol_t memory[10])
 {
     for(int i = 0; i < 10; i++) memory[i] = 0;
     while(*pattern != 0)
     {
         if(*text == 0) return false;
-        if(iswalpha(*pattern))
-        {
-            if(*pattern != *text) return false;
-            pattern++; text++;
-        }
-        else if(*pattern >= L'0' && *pattern <= L'9')
+        if(symbol_is_variable(*pattern))
         {
-            int addr = *pattern - L'0';
+            int addr = symbol_variable_index(*pattern);
             if(memory[addr] == 0)
-            {
                 memory[addr] = *text;
-                pattern++; text++;
-            }
-            else
-            {
-                if(memory[addr] != *text) return false;
-                pattern++; text++;
-            }
+            else if(memory[addr] != *text)
+                return false;
         }
-        else assert(false);
+        else if(*pattern != *text) return false;
+        pattern++; text++;
     }
     return true;
 }
 
 /**
- * Zamienia literę z tekstu zastępczego na właściwą literę uwzględniając zmienne.
+ * Zamienia symbol z tekstu zastępczego na właściwą literę uwzględniając zmienne.
  * 
- * @param[in] c Znak z tekstu zastępczego.
+ * @param[in] c Symbol z tekstu zastępczego.
  * @param[in] memory Pamięć z przypisaniem zmiennych.
- * @return Wynikowa litera.
+ * @return Symbol wynikowej litery lub numer zmiennej (mniejszy od SYMBOL_VARIABLES),
+ * jeśli zmienna nie ma przypisanej wartości.
  */
-static wchar_t translate_letter(wchar_t c, wchar_t memory[10])
+static int translate_letter(symbol_t c, symbol_t memory[10])
 {
-    if(iswalpha(c)) return c;
-    if(c >= L'0' && c <= L'9')
-    {
-        if(memory[c-L'0'] == 0) return c - L'0';
-        return memory[c - L'0'];
-    }
-    return -1;
+    if(!symbol_is_variable(c)) return c;
+    int addr = symbol_variable_index(c);
+    if(memory[addr] == 0) return addr;
+    return memory[addr];
 }
 
 /**
- * Porządek częściowy na regułach do sortowania po koszcie.
+ * Próbuje przypasować wzorzec reguły do tekstu.
+ * Wzorzec bez zmiennych jest porównywany bezpośrednio, bez zapamiętywania
+ * przypisań.
  * 
- * @param[in] a Wskaźnik na wskaźnik na pierwszą regułę.
- * @param[in] b Wskaźnik na wskaźnik na drugą regułę.
- * @return 0 jeśli koszty są równe, liczba dodatnia lub ujemna
- * jeśli odpowiednio pierwsza reguła jest droższa od drugiej
- * lub druga od pierwszej.
+ * @param[in] r Przetłumaczona reguła.
+ * @param[in] text Tekst.
+ * @param[out] memory Pamięć, gdzie zapisać przypisania wartości do zmiennych.
+ * @return True jeśli udało się dopasować, false w p.p.
  */
-static int rule_cost_sorter(const void *a, const void *b)
+static bool rule_matches(const struct hint_rule *r, const symbol_t *text, symbol_t memory[10])
 {
-    struct hint_rule *A = *(struct hint_rule**)a;
-    struct hint_rule *B = *(struct hint_rule**)b;
-    return A->cost - B->cost;
+    if(r->vars != 0) return pattern_matches(r->ssrc, text, memory);
+    memset(memory, 0, SYMBOL_VARIABLES * sizeof(symbol_t));
+    return strncmp((const char *)r->ssrc, (const char *)text, r->slen) == 0;
 }
 
 /**
@@ -193,413 +670,1218 @@ static int rule_cost_sorter(const void *a, const void *b)
  * @param[in] word Sufiks.
  * @param[in] begin Czy sufiks jest całym słowem do wygenerowania podpowiedzi.
  * @param[in] max_cost Maksymalny koszt podpowiedzi.
- * @return Wskaźnik na tablicę list wskaźników na reguły.
- * Tablica jest indeksowana po kosztach reguł.
+ * @return Wektor wskaźników na pasujące reguły posortowany po kosztach.
  */
-static struct list * preprocess_suffix(struct hint_rule **rules, int rcnt, const wchar_t *word, bool begin, int max_cost)
+static struct rule_vector preprocess_suffix(struct hint_rule **rules, int rcnt, const symbol_t *word, bool begin, int max_cost)
 {
     // Sprawdzić, które reguły pasują
-    struct list *ret = list_init();
-    list_reserve(ret, rcnt);    // So O(1) additions only
-    
+    struct rule_vector ret;
+    rule_vector_init(&ret);
+    size_t wlen = symbol_len(word);
+    for(int i = 0; i < rcnt; i++)
+    {
+        struct hint_rule *it = rules[i];
+        if(it->cost > max_cost) continue;
+        symbol_t memory[10];
+        if(rule_matches(it, word, memory))
+        {
+            if(it->flag == RULE_BEGIN && begin == false) continue;
+            if(it->flag == RULE_END && it->slen != wlen) continue;
+            rule_vector_push(&ret, it);
+        }
+    }
+    // Posortować reguły
+    rule_vector_sort(&ret);
+    return ret;
+}
+
+/**
+ * Zwraca grupę reguły w struct rule_dispatch.
+ * 
+ * @param[in] r Przetłumaczona reguła.
+ * @return Pierwszy symbol wzorca albo 0, jeśli wzorzec może pasować
+ * do sufiksu zaczynającego się dowolną literą.
+ */
+static symbol_t rule_dispatch_key(const struct hint_rule *r)
+{
+    return symbol_is_variable(r->ssrc[0]) ? 0 : r->ssrc[0];
+}
+
+/**
+ * Grupuje reguły po pierwszym symbolu wzorca.
+ * Reguły droższe niż maksymalny koszt podpowiedzi są pomijane.
+ * 
+ * @param[out] d Grupy reguł.
+ * @param[in] rules Tablica reguł.
+ * @param[in] rcnt Liczba reguł.
+ * @param[in] max_cost Maksymalny koszt podpowiedzi.
+ * @return 0 jeśli się udało, -1 jeśli brakło pamięci.
+ */
+static int rule_dispatch_init(struct rule_dispatch *d, struct hint_rule **rules, int rcnt, int max_cost)
+{
+    d->order = malloc((rcnt + 1) * sizeof(int));
+    d->selected = malloc((rcnt + 1) * sizeof(struct hint_rule *));
+    if(d->order == NULL || d->selected == NULL)
+    {
+        free(d->order);
+        free(d->selected);
+        return -1;
+    }
+    size_t fill[UCHAR_MAX + 1];
+    memset(d->start, 0, sizeof(d->start));
+    for(int i = 0; i < rcnt; i++)
+        if(rules[i]->cost <= max_cost) d->start[rule_dispatch_key(rules[i]) + 1]++;
+    for(int c = 0; c <= UCHAR_MAX; c++)
+    {
+        d->start[c + 1] += d->start[c];
+        fill[c] = d->start[c];
+    }
     for(int i = 0; i < rcnt; i++)
+        if(rules[i]->cost <= max_cost) d->order[fill[rule_dispatch_key(rules[i])]++] = i;
+    return 0;
+}
+
+/**
+ * Wybiera reguły, które mogą pasować do sufiksu.
+ * Wybrane reguły są w tej samej kolejności co na liście reguł.
+ * 
+ * @param[in,out] d Grupy reguł.
+ * @param[in] rules Tablica reguł, z której zbudowano grupy.
+ * @param[in] suf Sufiks.
+ * @return Liczba reguł zapisanych w `d->selected`.
+ */
+static int rule_dispatch_select(struct rule_dispatch *d, struct hint_rule **rules, const symbol_t *suf)
+{
+    symbol_t c = symbol_is_variable(*suf) ? 0 : *suf;
+    const int *a = d->order + d->start[0], *ae = d->order + d->start[1];
+    const int *b = d->order + d->start[c], *be = d->order + d->start[c + 1];
+    if(c == 0) b = be;
+    int n = 0;
+    while(a != ae || b != be)
+    {
+        if(b == be || (a != ae && *a < *b)) d->selected[n++] = rules[*a++];
+        else d->selected[n++] = rules[*b++];
+    }
+    return n;
+}
+
+/**
+ * Zwalnia pamięć grup reguł.
+ * 
+ * @param[in,out] d Grupy reguł.
+ */
+static void rule_dispatch_done(struct rule_dispatch *d)
+{
+    free(d->order);
+    free(d->selected);
+}
+
+/**
+ * Wykonuje preprocessing dla danego słowa.
+ * 
+ * @param[in] rules NULL-terminated lista reguł.
+ * @param[in] word Słowo do wygenerowania podpowiedzi.
+ * @param[in] max_cost Maksymalny koszt podpowiedzi.
+ * @return Tablica wektorów wskaźników na reguły indeksowana po długości sufiksu
+ * lub NULL, jeśli brakło pamięci. Wektory są posortowane po koszcie reguł.
+ */
+static struct rule_vector * preprocess(struct hint_rule **rules, const symbol_t *word, int max_cost)
+{
+    int rcnt = 0;
+    while(rules[rcnt] != NULL) rcnt++;
+    struct rule_dispatch d;
+    if(rule_dispatch_init(&d, rules, rcnt, max_cost)<0) return NULL;
+    int wlen = symbol_len(word);
+    struct rule_vector *output = malloc((wlen+1) * sizeof(struct rule_vector));
+    if(output == NULL)
+    {
+        rule_dispatch_done(&d);
+        return NULL;
+    }
+    struct rule_vector *output_walker = output + wlen;
+    bool begin = true;
+    while(*word != 0)
+    {
+        int n = rule_dispatch_select(&d, rules, word);
+        *output_walker = preprocess_suffix(d.selected, n, word, begin, max_cost);
+        output_walker--;
+        word++;
+        begin = false;
+    }
+    int n = rule_dispatch_select(&d, rules, word);
+    *output = preprocess_suffix(d.selected, n, word, begin, max_cost);  // last one...
+    rule_dispatch_done(&d);
+    return output;
+}
+
+/**
+ * Zwalnia pamięć zaalokowaną przez preprocess_suffix.
+ * 
+ * @param[in] pp Wektor zwrócony przez tą funkcję.
+ */
+static void free_preprocessing_data_for_suffix(struct rule_vector *pp)
+{
+    rule_vector_done(pp);
+}
+
+/**
+ * Zwalnia pamięć zaalokowaną przez preprocess.
+ * 
+ * @param[in] pp Wskaźnik zwrócony przez tą funkcję.
+ * @param[in] wlen Długość słowa, dla którego szukaliśmy podpowiedzi.
+ */
+static void free_preprocessing_data(struct rule_vector *pp, int wlen)
+{
+    for(int i = 0; i <= wlen; i++)
+    {
+        free_preprocessing_data_for_suffix(&pp[i]);
+    }
+    free(pp);
+}
+
+/**
+ * Sprawdza, czy stosunek kosztu do liczby liter jest mniejszy od danego.
+ * 
+ * @param[in] cost Koszt.
+ * @param[in] len Liczba liter (dodatnia).
+ * @param[in] best_cost Koszt, z którym porównujemy.
+ * @param[in] best_len Liczba liter, z którą porównujemy (0 oznacza nieskończony stosunek).
+ * @return True jeśli cost / len < best_cost / best_len.
+ */
+static bool cost_rate_less(int cost, int len, int best_cost, int best_len)
+{
+    return best_len == 0 || (long)cost * best_len < (long)best_cost * len;
+}
+
+/**
+ * Sprawdza, czy pokrycie różnicy długości kosztuje więcej niż budżet.
+ * 
+ * @param[in] need Liczba liter, o którą trzeba skrócić lub wydłużyć tekst.
+ * @param[in] cost Koszt najtańszej zmiany długości (licznik).
+ * @param[in] len Koszt najtańszej zmiany długości (mianownik, 0 jeśli nie można).
+ * @param[in] budget Budżet.
+ * @return True jeśli budżet nie wystarczy.
+ */
+static bool cost_rate_exceeds(int need, int cost, int len, int budget)
+{
+    return need > 0 && (len == 0 || (long)need * cost > (long)budget * len);
+}
+
+/**
+ * Wyznacza informacje o regułach dla każdej długości sufiksu.
+ * 
+ * @param[out] b Ograniczenie.
+ * @param[in] pp Wynik preprocessingu.
+ * @param[in] word Słowo, dla którego szukamy podpowiedzi.
+ * @param[in] max_cost Maksymalny koszt podpowiedzi.
+ * @return 0 jeśli się udało, -1 w p.p.
+ */
+static int hint_bound_init(struct hint_bound *b, const struct rule_vector *pp, const symbol_t *word, int max_cost)
+{
+    size_t wlen = symbol_len(word);
+    b->end = word + wlen;
+    b->max_cost = max_cost;
+    b->suf = malloc((wlen + 1) * sizeof(struct suffix_bound));
+    if(b->suf == NULL) return -1;
+    struct suffix_bound acc = { INT_MAX, 0, 0, 0, 0, INT_MAX };
+    for(size_t i = 0; i <= wlen; i++)
+    {
+        // Reguły są posortowane po koszcie, a droższe od max_cost są pominięte
+        acc.min_cost = pp[i].size > 0 ? pp[i].array[0]->cost : INT_MAX;
+        for(size_t j = 0; j < pp[i].size; j++)
+        {
+            const struct hint_rule *r = pp[i].array[j];
+            int delta = (int)symbol_len(r->sdst) - (int)r->slen;
+            if(delta < 0 && cost_rate_less(r->cost, -delta, acc.shrink_cost, acc.shrink_len))
+            {
+                acc.shrink_cost = r->cost;
+                acc.shrink_len = -delta;
+            }
+            if(delta > 0 && cost_rate_less(r->cost, delta, acc.grow_cost, acc.grow_len))
+            {
+                acc.grow_cost = r->cost;
+                acc.grow_len = delta;
+            }
+            if(r->flag == RULE_SPLIT && r->cost < acc.split_cost)
+                acc.split_cost = r->cost;
+        }
+        b->suf[i] = acc;
+    }
+    return 0;
+}
+
+/**
+ * Zwalnia pamięć ograniczenia.
+ * 
+ * @param[in,out] b Ograniczenie.
+ */
+static void hint_bound_done(struct hint_bound *b)
+{
+    free(b->suf);
+}
+
+/**
+ * Sprawdza, czy ze stanu nie da się już dojść do podpowiedzi.
+ * 
+ * Wynik zależy tylko od węzła, poprzedniego słowa i sufiksu stanu,
+ * więc z równych stanów o tym samym koszcie odrzucane są wszystkie albo żaden.
+ * 
+ * @param[in] s Stan.
+ * @param[in] cost Koszt stanu.
+ * @param[in] b Ograniczenie.
+ * @return True jeśli każda podpowiedź ze stanu kosztowałaby więcej niż maksymalny koszt.
+ */
+static bool state_hopeless(const struct state *s, int cost, const struct hint_bound *b)
+{
+    int budget = b->max_cost - cost;
+    const struct trie_node *node = s->node;
+    const symbol_t *suf = s->suf;
+    int len = b->end - suf;
+    const struct suffix_bound *sb = &b->suf[len];
+    int min_depth = trie_get_min_depth(node);
+    int max_depth = trie_get_max_depth(node);
+    if(max_depth < min_depth) return true;
+    // Po podziale słowa reszta tekstu może trafić do dowolnie długiego słowa
+    bool split = s->prev == NULL && sb->split_cost <= budget;
+    if(!split && max_depth < UCHAR_MAX &&
+       cost_rate_exceeds(len - max_depth, sb->shrink_cost, sb->shrink_len, budget))
+        return true;
+    if(cost_rate_exceeds(min_depth - len, sb->grow_cost, sb->grow_len, budget))
+        return true;
+    for(;;)
+    {
+        if(*suf == 0 && trie_is_leaf(node)) return false;
+        if(b->suf[b->end - suf].min_cost <= budget) return false;
+        if(*suf == 0) return true;
+        node = trie_get_child(node, *suf);
+        if(node == NULL) return true;
+        suf++;
+    }
+}
+
+/**
+ * Sprawdza, czy z żadnego węzła danej głębokości w poddrzewie nie da się
+ * już dojść do podpowiedzi, korzystając tylko z podsumowania poddrzewa.
+ * 
+ * Ograniczenie jest słabsze niż state_hopeless() dla każdego z tych węzłów,
+ * ale pozwala pominąć całe poddrzewo. Za darmo można przejść tylko po literach,
+ * które występują w poddrzewie, więc jeśli sufiksu nie da się tak przejść
+ * do końca, gdzieś po drodze trzeba użyć reguły.
+ * 
+ * @param[in] n Korzeń poddrzewa.
+ * @param[in] skip Głębokość węzłów w poddrzewie.
+ * @param[in] suf Sufiks stanów.
+ * @param[in] prev Poprzednie słowo stanów.
+ * @param[in] cost Koszt stanów.
+ * @param[in] b Ograniczenie.
+ * @return True jeśli każda podpowiedź z takich stanów kosztowałaby więcej niż maksymalny koszt.
+ */
+static bool branch_hopeless(const struct trie_node *n, int skip, const symbol_t *suf,
+                            const struct trie_node *prev, int cost, const struct hint_bound *b)
+{
+    int budget = b->max_cost - cost;
+    int len = b->end - suf;
+    const struct suffix_bound *sb = &b->suf[len];
+    int min_depth = trie_get_min_depth(n);
+    int max_depth = trie_get_max_depth(n);
+    if(max_depth < min_depth || max_depth < skip) return true;
+    bool split = prev == NULL && sb->split_cost <= budget;
+    if(!split && max_depth < UCHAR_MAX &&
+       cost_rate_exceeds(len - (max_depth - skip), sb->shrink_cost, sb->shrink_len, budget))
+        return true;
+    if(cost_rate_exceeds(min_depth - skip - len, sb->grow_cost, sb->grow_len, budget))
+        return true;
+    uint32_t letters = trie_get_letters(n);
+    int k = 0;
+    while(suf[k] != 0 && (letters & trie_letter_bit(suf[k])) != 0) k++;
+    if(suf[k] == 0) return false;
+    for(int i = 0; i <= k; i++)
+        if(b->suf[len - i].min_cost <= budget) return false;
+    return true;
+}
+
+/**
+ * Dodaje stany pochodne bez użycia reguł.
+ * 
+ * @param[in] s Stan do rozwinięcia.
+ * @param[in,out] pool Pula, z której brać nowe stany.
+ * @param[in,out] out Wektor, na koniec którego dopisać stan
+ * i stany pochodne o tym samym koszcie.
+ */
+static void extend_state(struct state *s, struct state_pool *pool, struct state_vector *out)
+{
+    state_vector_push(out, s);
+    while(1)
+    {
+        if(s->suf[0] == 0) return;
+        const struct trie_node *nn = trie_get_child(s->node, s->suf[0]);
+        if(nn == NULL) return;
+        struct state *ns = state_new(pool);
+        if(ns == NULL) return;
+        ns->prnt = s;
+        ns->rule = NULL; // Special rule for extending :P
+        ns->suf = s->suf + 1;
+        ns->node = nn;
+        ns->prev = s->prev;
+        ns->free_variable = 0;
+        state_vector_push(out, ns);
+        s = ns;
+    }
+}
+
+/**
+ * Próbuje zaaplikować regułę do stanu. Funkcja pomocnicza.
+ * 
+ * @param[in] n Aktualny węzeł drzewa TRIE.
+ * @param[in] dst Sufiks tekstu zastępczego.
+ * @param[in,out] memory Pamięć dla zmiennych w regule.
+ * @param[in,out] pool Pula, z której brać nowe stany.
+ * @param[in,out] l Wektor do którego dodać uzyskane stany.
+ * @param[in] ps Stan źródłowy.
+ * @param[in] r Zastosowana reguła.
+ * @param[in] suf Sufiks tekstu do zastąpienia.
+ * @param[in] root Korzeń drzewa TRIE.
+ * @param[in] last_guessed Wartość ostatniej wolnej zmiennej.
+ * @param[in] bound Ograniczenie kosztu dokończenia podpowiedzi lub NULL.
+ * @param[in] cost Koszt uzyskanych stanów.
+ */
+static void explore_trie(const struct trie_node *n,
+                         const symbol_t *dst,
+                         symbol_t memory[10],
+                         struct state_pool *pool,
+                         struct state_vector *l,
+                         struct state *ps,
+                         struct hint_rule *r,
+                         const symbol_t *suf,
+                         const struct trie_node *root,
+                         symbol_t last_guessed,
+                         const struct hint_bound *bound,
+                         int cost)
+{
+    HINT_STAT_ADD(nodes, 1);
+    if(*dst == 0)
+    {
+        const struct trie_node *node = n;
+        const struct trie_node *prev = ps->prev;
+        if(r->flag == RULE_SPLIT || r->flag == RULE_END)
+        {
+            if(!trie_is_leaf(n)) return;
+        }
+        if(r->flag == RULE_SPLIT)
+        {
+            if(prev != NULL) return;
+            prev = node;
+            node = root;
+        }
+        struct state ns = { suf, node, prev, ps, r, last_guessed };
+        // Ze stanów pochodnych też nie da się dojść do podpowiedzi
+        if(bound != NULL && state_hopeless(&ns, cost, bound)) return;
+        struct state *s = state_new(pool);
+        if(s == NULL) return;
+        *s = ns;
+        extend_state(s, pool, l);
+        return;
+    }
+    int addtn = translate_letter(*dst, memory);
+    if(addtn < SYMBOL_VARIABLES)
+    {
+        const struct trie_node **nodes;
+        int cnt = trie_get_children(n, &nodes);
+        // Po podziale stan trafia do korzenia, więc poddrzewo nic o nim nie mówi
+        bool cut = bound != NULL && r->flag != RULE_SPLIT;
+        int skip = cut ? symbol_len(dst + 1) : 0;
+        for(int i = 0; i < cnt; i++)
+        {
+            const struct trie_node *curr = nodes[i];
+            if(cut && branch_hopeless(curr, skip, suf, ps->prev, cost, bound)) continue;
+            memory[addtn] = trie_get_value(curr);
+            explore_trie(curr, dst+1, memory, pool, l, ps, r, suf, root, trie_get_value(curr), bound, cost);
+        }
+        memory[addtn] = 0;
+    }
+    else
+    {
+        const struct trie_node *curr = trie_get_child(n, addtn);
+        if(curr == NULL) return;
+        explore_trie(curr, dst+1, memory, pool, l, ps, r, suf, root, last_guessed, bound, cost);
+    }
+}
+
+/**
+ * Próbuje zaaplikować regułę do stanu.
+ * 
+ * @param[in] s Stan.
+ * @param[in] r Reguła.
+ * @param[in] root Korzeń drzewa TRIE.
+ * @param[in] bound Ograniczenie kosztu dokończenia podpowiedzi lub NULL.
+ * @param[in] cost Koszt stanów pochodnych.
+ * @param[in,out] pool Pula, z której brać nowe stany.
+ * @param[in,out] out Wektor, do którego dopisać stany pochodne.
+ * @return True jeśli reguła pasuje do stanu, false w p.p.
+ */
+static bool apply_rule(struct state *s, struct hint_rule *r, const struct trie_node *root, const struct hint_bound *bound, int cost, struct state_pool *pool, struct state_vector *out)
+{
+    symbol_t memory[10];
+    if(!rule_matches(r, s->suf, memory)) return false;
+    HINT_STAT_ADD(rule_tries, 1);
+#ifdef DICTIONARY_HINT_STATS
+    size_t before = out->size;
+#endif
+    explore_trie(s->node, r->sdst, memory, pool, out, s, r, s->suf + r->slen, root, 0, bound, cost);
+#ifdef DICTIONARY_HINT_STATS
+    if(out->size > before) HINT_STAT_ADD(rule_successes, 1);
+    hint_stats_rule_applied(r, out->size > before);
+#endif
+    return true;
+}
+
+/**
+ * Znajduje reguły o danym koszcie w wektorze posortowanym po kosztach.
+ * 
+ * @param[in] c Koszt.
+ * @param[in] l Posortowany wektor.
+ * @param[out] o Wskaźnik na pierwszą regułę o danym koszcie.
+ * @param[out] s Liczba elementów o danym koszcie.
+ */
+static void find_rules_with_cost(int c, const struct rule_vector *l, struct hint_rule ***o, int *s)
+{
+    size_t lo = 0, hi = l->size;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(l->array[mid]->cost < c) lo = mid + 1;
+        else hi = mid;
+    }
+    size_t e = lo;
+    while(e < l->size && l->array[e]->cost == c) e++;
+    *o = l->array + lo;
+    *s = e - lo;
+}
+
+/**
+ * Próbuje zaaplikować reguły do stanów.
+ * 
+ * @param[in] s Tablica stanów.
+ * @param[in] n Liczba stanów.
+ * @param[in] c Koszt reguły do zastosowania.
+ * @param[in] root Korzeń drzewa TRIE.
+ * @param[in] pp Wynik preprocessingu.
+ * @param[in] begin Stan początkowy.
+ * @param[in] bound Ograniczenie kosztu dokończenia podpowiedzi lub NULL.
+ * @param[in] cost Koszt stanów pochodnych.
+ * @param[in,out] pool Pula, z której brać nowe stany.
+ * @param[in,out] out Wektor, do którego dopisać stany pochodne.
+ */
+static void apply_rules_to_states(struct state * const *s, size_t n, int c, const struct trie_node *root, struct rule_vector *pp, struct state *begin, const struct hint_bound *bound, int cost, struct state_pool *pool, struct state_vector *out)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        struct state *ss = s[i];
+        if(begin != ss  && ss->rule != NULL && ss->rule->flag == RULE_BEGIN)
+            continue;
+        if(ss->rule != NULL && ss->rule->flag == RULE_END)
+            continue;
+        // Find specific rules (filter costs) in pp
+        struct hint_rule **rs = NULL;
+        int rl = 0;
+        find_rules_with_cost(c, &pp[symbol_len(ss->suf)], &rs, &rl);
+        for(int j = 0; j < rl; j++)
+        {
+            apply_rule(ss, rs[j], root, bound, cost, pool, out);
+        }
+    }
+}
+
+/**
+ * Rozwija kolejne części warstwy, aż się skończą.
+ * 
+ * @param[in,out] w Rozwijana warstwa.
+ * @param[in,out] pool Pula, z której brać nowe stany.
+ */
+static void layer_work_run(struct layer_work *w, struct state_pool *pool)
+{
+    for(;;)
+    {
+        size_t c = __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED);
+        if(c >= w->chunks) return;
+        size_t b = c * w->chunk;
+        size_t e = b + w->chunk < w->total ? b + w->chunk : w->total;
+        // Stany z kolejnych warstw, od najdroższej, jak w expand_layer()
+        size_t off = 0;
+        for(int j = 1; j <= w->cost && b < e; j++)
+        {
+            const struct state_vector *src = &w->layers[w->cost - j];
+            if(b < off + src->size)
+            {
+                size_t hi = e - off < src->size ? e - off : src->size;
+                apply_rules_to_states(src->array + (b - off), hi - (b - off), j, w->root, w->pp,
+                                      w->begin, w->bound, w->cost, pool, &w->out[c]);
+                b = off + hi;
+            }
+            off += src->size;
+        }
+    }
+}
+
+/**
+ * Funkcja wątku rozwijającego warstwę.
+ * 
+ * @param[in,out] arg Wątek (struct layer_worker).
+ * @return NULL.
+ */
+static void * layer_worker_main(void *arg)
+{
+    struct layer_worker *worker = arg;
+#ifdef DICTIONARY_HINT_STATS
+    hint_stats = worker->stats;
+#endif
+    layer_work_run(worker->work, &worker->pool);
+    return NULL;
+}
+
+/**
+ * Rozwija warstwę stanów o danym koszcie ze wszystkich tańszych warstw.
+ * 
+ * Duże warstwy są rozwijane przez kilka wątków (zob. struct layer_work),
+ * z tym samym wynikiem co w jednym wątku. Reguły nie tworzą stanów,
+ * z których nie da się dojść do podpowiedzi (zob. struct hint_bound).
+ * 
+ * @param[in,out] layers Warstwy stanów.
+ * @param[in] cost Koszt rozwijanej warstwy.
+ * @param[in] root Korzeń drzewa TRIE.
+ * @param[in] pp Wynik preprocessingu.
+ * @param[in] begin Stan początkowy.
+ * @param[in] bound Ograniczenie kosztu dokończenia podpowiedzi.
+ * @param[in,out] pool Pula, z której brać nowe stany.
+ * @param[in,out] workers Dodatkowe wątki z własnymi pulami.
+ * @param[in] workers_no Liczba dodatkowych wątków.
+ */
+static void expand_layer(struct state_vector *layers, int cost, const struct trie_node *root,
+                         struct rule_vector *pp, struct state *begin, const struct hint_bound *bound,
+                         struct state_pool *pool, struct layer_worker *workers, int workers_no)
+{
+    struct layer_work w = { layers, cost, root, pp, begin, bound, 0, 0, 0, 0, NULL };
+    for(int j = 1; j <= cost; j++)
+        w.total += layers[cost - j].size;
+    if(workers_no > 0 && w.total >= LAYER_PARALLEL_MIN_STATES)
+    {
+        w.chunks = (size_t)(workers_no + 1) * LAYER_PARALLEL_SPLIT;
+        w.chunk = (w.total + w.chunks - 1) / w.chunks;
+        w.chunks = (w.total + w.chunk - 1) / w.chunk;
+        w.out = malloc(w.chunks * sizeof(struct state_vector));
+    }
+    if(w.out == NULL)
+    {
+        for(int j = 1; j <= cost; j++)
+            apply_rules_to_states(layers[cost - j].array, layers[cost - j].size, j,
+                                  root, pp, begin, bound, cost, pool, &layers[cost]);
+        return;
+    }
+    for(size_t c = 0; c < w.chunks; c++)
+        state_vector_init(&w.out[c]);
+    int started = 0;
+#ifndef LAYER_PARALLEL_INLINE
+    for(; started < workers_no; started++)
+    {
+        workers[started].work = &w;
+        if(pthread_create(&workers[started].thread, NULL, layer_worker_main, &workers[started]) != 0)
+            break;
+    }
+#endif
+    layer_work_run(&w, pool);
+    for(int i = 0; i < started; i++)
+        pthread_join(workers[i].thread, NULL);
+    for(size_t c = 0; c < w.chunks; c++)
+    {
+        state_vector_append(&layers[cost], w.out[c].array, w.out[c].size);
+        state_vector_done(&w.out[c]);
+    }
+    free(w.out);
+}
+
+/**
+ * Usuwa duplikaty stanów.
+ * 
+ * Z każdej grupy równych stanów zostaje ten o najmniejszym koszcie.
+ * Usunięte stany zostają w puli i są zwalniane razem z nią.
+ * 
+ * @param[in,out] ll Tablica wektorów stanów. Każdy wektor przechowuje stany o innym koszcie.
+ * @param[in] mc Maksymalny koszt jaki uwzględnić.
+ */
+static void unify_states(struct state_vector *ll, int mc)
+{
+    struct costed_state_vector all;
+    costed_state_vector_init(&all);
+    size_t sno = 0;
+    for(int i = 0; i <= mc; i++) sno += ll[i].size;
+    costed_state_vector_reserve(&all, sno);
+    for(int i = 0; i <= mc; i++)
+    {
+        for(size_t j = 0; j < ll[i].size; j++)
+        {
+            struct costed_state cs = { ll[i].array[j], i };
+            costed_state_vector_push(&all, cs);
+        }
+        state_vector_clear(&ll[i]);
+    }
+    costed_state_vector_sort(&all);
+    costed_state_vector_unique(&all, NULL);
+    for(size_t i = 0; i < all.size; i++)
+    {
+        state_vector_push(&ll[all.array[i].cost], all.array[i].s);
+    }
+    costed_state_vector_done(&all);
+}
+
+/**
+ * Oblicza tekst wygenerowany przez stan i dopisuje go do listy słów.
+ * 
+ * Najpierw wyznacza długość tekstu, a potem wypełnia go od końca,
+ * idąc po kolejnych poprzednikach stanu.
+ * 
+ * @param[in] s Stan.
+ * @param[in] alphabet Alfabet, w którym zapisano drzewo.
+ * @param[in,out] l Lista, na końcu której zapisać tekst.
+ * @return Wskaźnik na tekst w liście lub NULL, jeśli brakło pamięci.
+ */
+static const wchar_t * get_text(struct state *s, const struct alphabet *alphabet, struct word_list *l)
+{
+    size_t len = 0;
+    for(struct state *it = s; it->prnt != NULL; it = it->prnt)
+    {
+        if(it->rule == NULL)
+        {
+            len++;
+            continue;
+        }
+        len += symbol_len(it->rule->sdst);
+        // when used split rule -> add space
+        if(it->rule->flag == RULE_SPLIT) len++;
+    }
+    wchar_t *rt = word_list_add_empty(l, len);
+    if(rt == NULL) return NULL;
+    wchar_t *end = rt + len;
+    for(struct state *it = s; it->prnt != NULL; it = it->prnt)
+    {
+        if(it->rule == NULL)
+        {
+            *--end = alphabet_letter(alphabet, trie_get_value(it->node));
+            continue;
+        }
+        if(it->rule->flag == RULE_SPLIT) *--end = L' ';
+        symbol_t memory[10];
+        rule_matches(it->rule, it->prnt->suf, memory);
+        for(int i = 0; i < 10; i++) if(memory[i] == 0) memory[i] = it->free_variable;
+        const symbol_t *dst = it->rule->sdst;
+        const struct trie_node *on = it->prnt->node;
+        end -= symbol_len(dst);
+        for(int i = 0; dst[i] != 0; i++)
+        {
+            on = trie_get_child(on, translate_letter(dst[i], memory));
+            end[i] = alphabet_letter(alphabet, trie_get_value(on));
+        }
+    }
+    return rt;
+}
+
+/**
+ * Oblicza częstość podpowiedzi generowanej przez stan końcowy.
+ * Podpowiedź z dwóch słów jest tak częsta jak rzadsze z nich.
+ * 
+ * @param[in] s Stan końcowy.
+ * @return Częstość podpowiedzi.
+ */
+static unsigned int hint_frequency(const struct state *s)
+{
+    unsigned int freq = trie_get_frequency(s->node);
+    if(s->prev != NULL && trie_get_frequency(s->prev) < freq)
+        freq = trie_get_frequency(s->prev);
+    return freq;
+}
+
+/**
+ * Porównuje w-stringi po wartościach znaków.
+ * 
+ * @param[in] a Wskaźnik na pierwszy tekst.
+ * @param[in] b Wskaźnik na drugi tekst.
+ * @return 0 jeśli są równe, liczbę dodatnią lub ujemną
+ * jeśli odpowiednio pierwszy tekst jest większy od drugiego lub drugi od pierwszego.
+ */
+static int text_sorter(const void *a, const void *b)
+{
+    wchar_t *A = *(wchar_t**)a;
+    wchar_t *B = *(wchar_t**)b;
+    
+    while(*A == *B && *A != 0)
+    {
+        A++; B++;
+    }
+    return *A - *B;
+}
+
+/**
+ * Przygotowuje dopisywanie podpowiedzi do listy.
+ * 
+ * @param[out] o Podpowiedzi.
+ * @param[in,out] list Lista wyjściowa.
+ * @param[in] max_hints_no Maksymalna liczba podpowiedzi na liście.
+ * @param[out] costs Tablica na koszty podpowiedzi albo NULL.
+ */
+static void hint_output_init(struct hint_output *o, struct word_list *list, int max_hints_no, int *costs)
+{
+    o->list = list;
+    o->first = word_list_size(list);
+    o->max_hints_no = max_hints_no;
+    o->costs = costs;
+    word_list_init(&o->group);
+    text_vector_init(&o->sorted);
+    raw_text_vector_init(&o->added);
+}
+
+/**
+ * Zwalnia pamięć używaną przy dopisywaniu podpowiedzi.
+ * 
+ * @param[in,out] o Podpowiedzi.
+ */
+static void hint_output_done(struct hint_output *o)
+{
+    raw_text_vector_done(&o->added);
+    text_vector_done(&o->sorted);
+    word_list_done(&o->group);
+}
+
+/**
+ * Sprawdza, czy lista wyjściowa jest pełna.
+ * 
+ * @param[in] o Podpowiedzi.
+ * @return True jeśli nie można dopisać więcej podpowiedzi.
+ */
+static bool hint_output_full(const struct hint_output *o)
+{
+    return word_list_size(o->list) >= (size_t)o->max_hints_no;
+}
+
+/**
+ * Dopisuje podpowiedzi z aktualnej grupy do listy wyjściowej.
+ * Podpowiedzi są sortowane alfabetycznie, a te, które już są
+ * na liście, są pomijane. Grupa jest potem czyszczona.
+ * 
+ * @param[in,out] o Podpowiedzi.
+ * @param[in] cost Koszt podpowiedzi z grupy.
+ */
+static void hint_output_flush(struct hint_output *o, int cost)
+{
+    text_vector_clear(&o->sorted);
+    text_vector_append(&o->sorted, word_list_get(&o->group), word_list_size(&o->group));
+    text_vector_sort(&o->sorted);
+    text_vector_unique(&o->sorted, NULL);
+    // Dopisywanie do listy wyjściowej unieważnia wskaźniki z added,
+    // więc najpierw wybieramy nowe podpowiedzi, a dopiero potem je dopisujemy.
+    size_t fresh = 0;
+    for(size_t j = 0; j < o->sorted.size; j++)
     {
-        struct hint_rule *it = rules[i];
-        if(it->cost > max_cost) continue;
-        wchar_t memory[10];
-        if(pattern_matches(it->src, word, memory))
-        {
-            if(it->flag == RULE_BEGIN && begin == false) continue;
-            if(it->flag == RULE_END && wcslen(it->src) != wcslen(word)) continue;
-            list_add(ret, it);
-        }
+        const wchar_t *e = o->sorted.array[j];
+        if(o->added.size > 0
+           && bsearch(&e, o->added.array, o->added.size, sizeof(const wchar_t*), text_sorter) != NULL)
+            continue;
+        o->sorted.array[fresh++] = e;
     }
-    if(list_size(ret) == 0)
+    for(size_t j = 0; j < fresh; j++)
     {
-        list_reserve(ret, 0);   // Shrink maximally to save memory
-        return ret;
+        if(hint_output_full(o)) break;
+        if(o->costs != NULL) o->costs[word_list_size(o->list) - o->first] = cost;
+        word_list_add(o->list, o->sorted.array[j]);
     }
-    // Posortować reguły
-    list_sort(ret, rule_cost_sorter);
-    list_reserve(ret, 0);
-    return ret;
+    // Wskaźniki na słowa mogły się zmienić, więc budujemy wektor od nowa.
+    raw_text_vector_clear(&o->added);
+    raw_text_vector_append(&o->added, word_list_get(o->list), word_list_size(o->list));
+    raw_text_vector_sort(&o->added);
+    word_list_clear(&o->group);
 }
 
 /**
- * Wykonuje preprocessing dla danego słowa.
+ * Sprawdza, czy reguły to tylko podstawowe operacje edycyjne
+ * (usunięcie, wstawienie, zamiana i przestawienie dowolnych liter)
+ * i wyznacza ich koszty.
+ * Reguły droższe od maksymalnego kosztu podpowiedzi są pomijane,
+ * bo i tak nie mogą zostać użyte.
  * 
- * @param[in] rules NULL-terminated lista reguł.
- * @param[in] word Słowo do wygenerowania podpowiedzi.
+ * @param[in] rules Tablica wskaźników na reguły zakończona NULL-em.
  * @param[in] max_cost Maksymalny koszt podpowiedzi.
- * @return Wskaźnik na dwuwymiarową tablicę list wskaźników na reguły.
- * Tablica jest indeksowana po 1. długości sufiksu, 2. koszcie reguł.
+ * @param[out] ec Koszty operacji; operacje bez reguły mają koszt `max_cost + 1`.
+ * @return True jeśli reguły są równoważne operacjom edycyjnym, false w p.p.
  */
-static struct list ** preprocess(struct hint_rule **rules, const wchar_t *word, int max_cost)
+static bool edit_costs_from_rules(struct hint_rule **rules, int max_cost, struct edit_costs *ec)
 {
-    int rcnt = 0;
-    while(rules[rcnt] != NULL) rcnt++;
-    int wlen = wcslen(word);
-    struct list **output = malloc((wlen+1) * sizeof(struct list*));
-    struct list **output_walker = output + wlen;
-    bool begin = true;
-    while(*word != 0)
+    ec->del = ec->ins = ec->sub = ec->swap = max_cost + 1;
+    for(; *rules != NULL; rules++)
     {
-        *output_walker = preprocess_suffix(rules, rcnt, word, begin, max_cost);
-        output_walker--;
-        word++;
-        begin = false;
+        const struct hint_rule *r = *rules;
+        if(r->cost > max_cost) continue;
+        if(r->flag != RULE_NORMAL) return false;
+        const symbol_t *s = r->ssrc;
+        const symbol_t *d = r->sdst;
+        size_t sl = symbol_len(s);
+        size_t dl = symbol_len(d);
+        for(size_t i = 0; i < sl; i++) if(!symbol_is_variable(s[i])) return false;
+        for(size_t i = 0; i < dl; i++) if(!symbol_is_variable(d[i])) return false;
+        int *op;
+        if(sl == 1 && dl == 0) op = &ec->del;
+        else if(sl == 0 && dl == 1) op = &ec->ins;
+        else if(sl == 1 && dl == 1 && s[0] != d[0]) op = &ec->sub;
+        else if(sl == 2 && dl == 2 && s[0] != s[1] && s[0] == d[1] && s[1] == d[0]) op = &ec->swap;
+        else return false;
+        if(r->cost < *op) *op = r->cost;
     }
-    *output = preprocess_suffix(rules, rcnt, word, begin, max_cost);  // last one...
-    return output;
+    return true;
 }
 
 /**
- * Zwalnia pamięć zaalokowaną przez preprocess_suffix.
- * 
- * @param[in] pp Wskaźnik zwrócony przez tą funkcję.
+ * Stan przeszukiwania drzewa przy odległości edycyjnej.
  */
-static void free_preprocessing_data_for_suffix(struct list *pp)
+struct edit_search
 {
-    list_done(pp);
-}
+    const symbol_t *word;               ///< Słowo, dla którego szukamy podpowiedzi.
+    int wlen;                           ///< Długość słowa.
+    struct edit_costs c;                ///< Koszty operacji.
+    int limit;                          ///< Najmniejszy koszt, którego już nie podpowiadamy.
+    int max_depth;                      ///< Głębokość, poniżej której odległości przekraczają limit.
+    int *rows;                          ///< Wiersze tablicy odległości dla kolejnych głębokości.
+    symbol_t *path;                     ///< Litery na ścieżce od korzenia.
+    struct edit_hint_vector found;      ///< Znalezione słowa.
+    struct symbol_vector texts;         ///< Litery znalezionych słów.
+};
 
 /**
- * Zwalnia pamięć zaalokowaną przez preprocess.
+ * Przeszukuje poddrzewo, licząc odległość optymalnego dopasowania
+ * (Levenshteina z przestawieniami sąsiednich liter) między słowem
+ * a prefiksami ze słownika.
  * 
- * @param[in] pp Wskaźnik zwrócony przez tą funkcję.
- * @param[in] wlen Długość słowa, dla którego szukaliśmy podpowiedzi.
+ * Wiersz tablicy odległości dla głębokości `depth` musi być już policzony.
+ * Poddrzewo jest pomijane, gdy żadna odległość w nim nie może być
+ * mniejsza od limitu: wartości w kolejnych wierszach nie mogą spaść poniżej
+ * minimum ostatniego wiersza ani poniżej minimum przedostatniego
+ * powiększonego o koszt przestawienia.
+ * 
+ * @param[in,out] es Stan przeszukiwania.
+ * @param[in] n Węzeł.
+ * @param[in] depth Głębokość węzła.
+ * @param[in] row_min Minimum wiersza dla głębokości węzła.
  */
-static void free_preprocessing_data(struct list **pp, int wlen)
+static void edit_search_node(struct edit_search *es, const struct trie_node *n, int depth, int row_min)
 {
-    for(int i = 0; i <= wlen; i++)
+    const int w = es->wlen + 1;
+    const int *row = es->rows + depth * w;
+    const int *prev = depth > 0 ? row - w : row;
+    int *next = es->rows + (depth + 1) * w;
+    if(trie_is_leaf(n) && row[es->wlen] < es->limit)
     {
-        free_preprocessing_data_for_suffix(pp[i]);
+        struct edit_hint h = { row[es->wlen], trie_get_frequency(n), es->texts.size, depth };
+        edit_hint_vector_push(&es->found, h);
+        symbol_vector_append(&es->texts, es->path, depth);
+    }
+    const struct trie_node **nodes;
+    int cnt = trie_get_children(n, &nodes);
+    for(int i = 0; i < cnt; i++)
+    {
+        symbol_t a = trie_get_value(nodes[i]);
+        es->path[depth] = a;
+        int best = row[0] + es->c.ins;
+        if(best > es->limit) best = es->limit;
+        next[0] = best;
+        for(int j = 1; j < w; j++)
+        {
+            int v = row[j - 1] + (es->word[j - 1] == a ? 0 : es->c.sub);
+            if(row[j] + es->c.ins < v) v = row[j] + es->c.ins;
+            if(next[j - 1] + es->c.del < v) v = next[j - 1] + es->c.del;
+            if(depth > 0 && j > 1 && a == es->word[j - 2] && es->path[depth - 1] == es->word[j - 1]
+                    && prev[j - 2] + es->c.swap < v)
+                v = prev[j - 2] + es->c.swap;
+            if(v > es->limit) v = es->limit;
+            next[j] = v;
+            if(v < best) best = v;
+        }
+        if(depth < es->max_depth && (best < es->limit || row_min + es->c.swap < es->limit))
+            edit_search_node(es, nodes[i], depth + 1, best);
     }
-    free(pp);
 }
 
 /**
- * Dodaje stany pochodne bez użycia reguł.
+ * Dopisuje znalezione słowa do podpowiedzi w kolejności kosztów
+ * i częstości.
  * 
- * @param[in] s Stan do rozwinięcia.
- * @return Lista stanów pochodnych o tym samym koszcie.
+ * @param[in,out] found Znalezione słowa (wektor jest sortowany).
+ * @param[in] texts Bufor liter słów.
+ * @param[in] min_cost Koszt, od którego dopisywać słowa (tańsze są pomijane).
+ * @param[in] alphabet Alfabet, w którym zapisano słowa.
+ * @param[in,out] o Podpowiedzi.
  */
-static struct list * extend_state(struct state *s)
+static void edit_output_hints(struct edit_hint_vector *found, const symbol_t *texts, int min_cost,
+                              const struct alphabet *alphabet, struct hint_output *o)
 {
-    struct list * ret = list_init();
-    list_add(ret, s);
-    while(1)
+    edit_hint_vector_sort(found);
+    size_t g = 0;
+    while(g < found->size && found->array[g].cost < min_cost) g++;
+    while(g < found->size && !hint_output_full(o))
     {
-        if(s->suf[0] == 0) return ret;
-        const struct trie_node *nn = trie_get_child(s->node, s->suf[0]);
-        if(nn == NULL) return ret;
-        struct state *ns = malloc(sizeof(struct state));
-        ns->prnt = s;
-        ns->rule = NULL; // Special rule for extending :P
-        ns->suf = s->suf + 1;
-        ns->node = nn;
-        ns->prev = s->prev;
-        list_add(ret, ns);
-        s = ns;
+        size_t end = g;
+        for(; end < found->size && !edit_hint_less(&found->array[g], &found->array[end]); end++)
+        {
+            const struct edit_hint *h = &found->array[end];
+            wchar_t *t = word_list_add_empty(&o->group, h->len);
+            if(t == NULL) continue;
+            for(size_t k = 0; k < h->len; k++)
+                t[k] = alphabet_letter(alphabet, texts[h->text + k]);
+        }
+        hint_output_flush(o, found->array[g].cost);
+        g = end;
     }
 }
 
 /**
- * Próbuje zaaplikować regułę do stanu. Funkcja pomocnicza.
+ * Generuje podpowiedzi, gdy reguły to tylko podstawowe operacje edycyjne.
  * 
- * @param[in] n Aktualny węzeł drzewa TRIE.
- * @param[in] dst Sufiks tekstu zastępczego.
- * @param[in,out] memory Pamięć dla zmiennych w regule.
- * @param[in,out] l Lista do której dodać uzyskane stany.
- * @param[in] ps Stan źródłowy.
- * @param[in] r Zastosowana reguła.
- * @param[in] suf Sufiks tekstu do zastąpienia.
+ * Daje te same podpowiedzi w tej samej kolejności co ogólny algorytm:
+ * słowa ze słownika o odległości co najwyżej `max_cost`, od najtańszych,
+ * przy równym koszcie od najczęstszych, przy równej częstości alfabetycznie.
+ * 
+ * @param[in] ec Koszty operacji.
+ * @param[in] max_cost Maksymalny koszt podpowiedzi.
  * @param[in] root Korzeń drzewa TRIE.
- * @param[in] last_guessed Wartość ostatniej wolnej zmiennej.
+ * @param[in] alphabet Alfabet, w którym zapisano drzewo.
+ * @param[in] word Słowo (w symbolach), dla którego wygenerować podpowiedzi.
+ * @param[in,out] o Podpowiedzi.
  */
-static void explore_trie(const struct trie_node *n,
-                         wchar_t *dst,
-                         wchar_t memory[10],
-                         struct list *l,
-                         struct state *ps,
-                         struct hint_rule *r,
-                         const wchar_t *suf,
-                         const struct trie_node *root,
-                         wchar_t last_guessed)
+static void edit_generate_hints(const struct edit_costs *ec, int max_cost, const struct trie_node *root,
+                                const struct alphabet *alphabet, const symbol_t *word, struct hint_output *o)
 {
-    if(*dst == 0)
-    {
-        struct state *s = malloc(sizeof(struct state));
-        s->node = n;
-        s->prev = ps->prev;
-        s->rule = r;
-        s->prnt = ps;
-        s->suf = suf;
-        s->free_variable = last_guessed;
-        if(r->flag == RULE_SPLIT || r->flag == RULE_END)
-        {
-            if(!trie_is_leaf(n))
-            {
-                free(s);
-                return;
-            }
-        }
-        if(r->flag == RULE_SPLIT)
-        {
-            if(s->prev != NULL)
-            {
-                free(s);
-                return;
-            }
-            s->prev = s->node;
-            s->node = root;
-        }
-        list_add_list_and_free(l, extend_state(s));
-        return;
-    }
-    wchar_t addtn = translate_letter(*dst, memory);
-    if(addtn == -1) return;
-    if(addtn >= 0 && addtn <= 9)
+    struct edit_search es;
+    es.word = word;
+    es.wlen = symbol_len(word);
+    es.c = *ec;
+    // Poniżej długości słowa każda litera wymaga wstawienia
+    es.max_depth = es.wlen + (ec->ins <= max_cost ? max_cost / ec->ins : 0);
+    es.rows = malloc((size_t)(es.max_depth + 2) * (es.wlen + 1) * sizeof(int));
+    es.path = malloc(es.max_depth + 1);
+    edit_hint_vector_init(&es.found);
+    symbol_vector_init(&es.texts);
+    if(es.rows == NULL || es.path == NULL) goto done;
+    // Tańsze podpowiedzi zwykle wystarczają, żeby zapełnić listę, a przeszukanie
+    // z mniejszym limitem jest dużo szybsze, więc zwiększamy limit o jeden.
+    for(int cost = 0; cost <= max_cost && !hint_output_full(o); cost++)
     {
-        const struct trie_node **nodes;
-        int cnt = trie_get_children(n, &nodes);
-        for(int i = 0; i < cnt; i++)
+        es.limit = cost + 1;
+        es.rows[0] = 0;
+        for(int j = 1; j <= es.wlen; j++)
         {
-            const struct trie_node *curr = nodes[i];
-            memory[addtn] = trie_get_value(curr);
-            explore_trie(curr, dst+1, memory, l, ps, r, suf, root, trie_get_value(curr));
+            int v = es.rows[j - 1] + ec->del;
+            es.rows[j] = v < es.limit ? v : es.limit;
         }
-        memory[addtn] = 0;
-    }
-    else
-    {
-        const struct trie_node *curr = trie_get_child(n, addtn);
-        if(curr == NULL) return;
-        explore_trie(curr, dst+1, memory, l, ps, r, suf, root, last_guessed);
+        edit_hint_vector_clear(&es.found);
+        symbol_vector_clear(&es.texts);
+        edit_search_node(&es, root, 0, 0);
+        // Tańsze słowa zostały dopisane w poprzednich przebiegach
+        edit_output_hints(&es.found, es.texts.array, cost, alphabet, o);
     }
+done:
+    symbol_vector_done(&es.texts);
+    edit_hint_vector_done(&es.found);
+    free(es.path);
+    free(es.rows);
 }
 
 /**
- * Próbuje zaaplikować regułę do stanu.
+ * Liczy odległość optymalnego dopasowania między słowem a słowem ze słownika
+ * (tak samo jak edit_search_node(), ale dla jednego słowa).
  * 
- * @param[in] s Stan.
- * @param[in] r Reguła.
- * @param[in] root Korzeń drzewa TRIE.
- * @return Lista stanów pochodnych.
+ * @param[in] es Stan przeszukiwania (słowo, koszty, limit i bufor
+ * na trzy wiersze tablicy odległości).
+ * @param[in] text Słowo ze słownika.
+ * @param[in] len Długość słowa ze słownika.
+ * @return Odległość albo limit, jeśli odległość nie jest od niego mniejsza.
  */
-static struct list * apply_rule(struct state *s, struct hint_rule *r, const struct trie_node *root)
+static int edit_distance(const struct edit_search *es, const symbol_t *text, size_t len)
 {
-    wchar_t memory[10];
-    struct list *ret = list_init();
-    if(!pattern_matches(r->src, s->suf, memory)) return NULL;
-    explore_trie(s->node, r->dst, memory, ret, s, r, s->suf + wcslen(r->src), root, 0);
-    return ret;
+    const int w = es->wlen + 1;
+    int *prev = es->rows;
+    int *row = prev + w;
+    int *next = row + w;
+    int row_min = 0;
+    row[0] = 0;
+    for(int j = 1; j < w; j++)
+    {
+        int v = row[j - 1] + es->c.del;
+        row[j] = v < es->limit ? v : es->limit;
+    }
+    for(size_t i = 0; i < len; i++)
+    {
+        symbol_t a = text[i];
+        int best = row[0] + es->c.ins;
+        if(best > es->limit) best = es->limit;
+        next[0] = best;
+        for(int j = 1; j < w; j++)
+        {
+            int v = row[j - 1] + (es->word[j - 1] == a ? 0 : es->c.sub);
+            if(row[j] + es->c.ins < v) v = row[j] + es->c.ins;
+            if(next[j - 1] + es->c.del < v) v = next[j - 1] + es->c.del;
+            if(i > 0 && j > 1 && a == es->word[j - 2] && text[i - 1] == es->word[j - 1]
+                    && prev[j - 2] + es->c.swap < v)
+                v = prev[j - 2] + es->c.swap;
+            if(v > es->limit) v = es->limit;
+            next[j] = v;
+            if(v < best) best = v;
+        }
+        if(best >= es->limit && row_min + es->c.swap >= es->limit) return es->limit;
+        int *t = prev;
+        prev = row;
+        row = next;
+        next = t;
+        row_min = best;
+    }
+    return row[es->wlen];
 }
 
 /**
- * Znajduje reguły o danym koszcie na posortowanej liście.
+ * Liczy, ile liter trzeba najwyżej usunąć ze słowa, żeby dostać wspólny
+ * podciąg ze słowem w odległości co najwyżej `max_cost`, gdy każda
+ * z podanych operacji usuwa jedną literę tego słowa.
  * 
- * @param[in] c Koszt.
- * @param[in] l Posortowana lista.
- * @param[out] o Wskaźnik na pierwszą regułę o danym koszcie.
- * @param[out] s Liczba elementów o danym koszcie.
+ * @param[in] a Koszt pierwszej operacji.
+ * @param[in] b Koszt drugiej operacji.
+ * @param[in] c Koszt trzeciej operacji.
+ * @param[in] max_cost Maksymalny koszt podpowiedzi.
+ * @return Liczba usuwanych liter.
  */
-void find_rules_with_cost(int c, struct list *l, struct hint_rule ***o, int *s)
+static int edit_deletions(int a, int b, int c, int max_cost)
 {
-    struct hint_rule *mock = rule_make(L"a", L"b", c, RULE_NORMAL);
-    struct hint_rule **lp = (struct hint_rule**)list_get(l);
-    struct hint_rule **lq = lp + list_size(l);
-    struct hint_rule **lb = bsearch(&mock, lp, list_size(l), sizeof(void*), rule_cost_sorter);
-    struct hint_rule **le = lb;
-    rule_done(mock);
-    if(lb == NULL)
-    {
-        *s = 0;
-        *o = NULL;
-        return;
-    }
-    while(le < lq && le[0]->cost == c) le++;
-    while(lb > lp && lb[-1]->cost == c) lb--;
-    *o = lb;
-    *s = le - lb;
+    int m = a < b ? a : b;
+    if(c < m) m = c;
+    return m > max_cost ? 0 : max_cost / m;
 }
 
 /**
- * Próbuje zaaplikować reguły do stanów.
+ * Generuje podpowiedzi z indeksu usunięć, gdy reguły to tylko podstawowe
+ * operacje edycyjne. Daje ten sam wynik co edit_generate_hints().
  * 
- * @param[in] s Lista stanów.
- * @param[in] c Koszt reguły do zastosowania.
+ * @param[in] index Indeks usunięć.
+ * @param[in] ec Koszty operacji.
+ * @param[in] deletions Liczba liter usuwanych z szukanego słowa.
+ * @param[in] max_cost Maksymalny koszt podpowiedzi.
  * @param[in] root Korzeń drzewa TRIE.
- * @param[in] pp Wynik preprocessingu.
- * @param[in] begin Stan początkowy.
- * @return Lista stanów pochodnych.
+ * @param[in] alphabet Alfabet, w którym zapisano drzewo.
+ * @param[in] word Słowo (w symbolach), dla którego wygenerować podpowiedzi.
+ * @param[in,out] o Podpowiedzi.
  */
-static struct list * apply_rules_to_states(struct list *s, int c, const struct trie_node *root, struct list **pp, struct state *begin)
+static void index_generate_hints(const struct deletion_index *index, const struct edit_costs *ec,
+                                 int deletions, int max_cost, const struct trie_node *root,
+                                 const struct alphabet *alphabet, const symbol_t *word, struct hint_output *o)
 {
-    struct state ** sts = (struct state**)list_get(s);
-    struct list *ret = list_init();
-    for(int i = 0; i < list_size(s); i++)
+    struct edit_search es;
+    es.word = word;
+    es.wlen = symbol_len(word);
+    es.c = *ec;
+    es.limit = max_cost + 1;
+    es.rows = malloc(3 * (size_t)(es.wlen + 1) * sizeof(int));
+    es.path = NULL;
+    edit_hint_vector_init(&es.found);
+    symbol_vector_init(&es.texts);
+    uint32_t *ids = NULL;
+    int cnt = es.rows == NULL ? -1 : deletion_index_candidates(index, word, deletions, &ids);
+    for(int i = 0; i < cnt; i++)
     {
-        struct list *std = list_init();
-        struct state *ss = sts[i];
-        if(begin != ss  && ss->rule != NULL && ss->rule->flag == RULE_BEGIN)
-        {
-            list_done(std);
-            continue;
-        }
-        if(ss->rule != NULL && ss->rule->flag == RULE_END)
-        {
-            list_done(std);
-            continue;
-        }
-        // Find specific rules (filter costs) in pp
-        struct list *rg = pp[wcslen(ss->suf)];
-        struct hint_rule **rs = NULL;
-        int rl = 0;
-        find_rules_with_cost(c, rg, &rs, &rl);
-        for(int i = 0; i < rl; i++, rs++)
-        {
-            list_add_list_and_free(std, apply_rule(ss, *rs, root));
-        }
-        list_add_list_and_free(ret, std);
+        size_t len;
+        const symbol_t *text = deletion_index_word(index, ids[i], &len);
+        int cost = edit_distance(&es, text, len);
+        if(cost > max_cost) continue;
+        const struct trie_node *n = root;
+        for(size_t k = 0; k < len && n != NULL; k++) n = trie_get_child(n, text[k]);
+        if(n == NULL || !trie_is_leaf(n)) continue;
+        struct edit_hint h = { cost, trie_get_frequency(n), es.texts.size, len };
+        if(!symbol_vector_append(&es.texts, text, len)) break;
+        edit_hint_vector_push(&es.found, h);
     }
-    return ret;
+    edit_output_hints(&es.found, es.texts.array, 0, alphabet, o);
+    free(ids);
+    symbol_vector_done(&es.texts);
+    edit_hint_vector_done(&es.found);
+    free(es.rows);
 }
 
 /**
- * Usuwa duplikaty stanów.
+ * Tłumaczy tekst reguły na symbole alfabetu.
+ * Cyfry oznaczają zmienne, pozostałe znaki są literami.
  * 
- * @param[in,out] ll Tablica list stanów. Każda lista przechowuje stany o innej wartości.
- * @param[in] mc Maksymalny koszt jaki uwzględnić.
+ * @param[in] text Tekst reguły.
+ * @param[in,out] alphabet Alfabet, do którego dodać nowe litery.
+ * @param[out] out Bufor na wynik (co najmniej `wcslen(text) + 1` symboli).
+ * @return 0 jeśli się udało, -1 jeśli alfabet się przepełnił.
  */
-static void unify_states(struct list **ll, int mc)
+static int compile_text(const wchar_t *text, struct alphabet *alphabet, symbol_t *out)
 {
-    struct list *ret = list_init();
-    int sno = 0;
-    for(int i = 0; i <= mc; i++) sno += list_size(ll[i]);
-    list_reserve(ret, sno + 4);
-    for(int i = 0; i <= mc; i++)
+    for(; *text != 0; text++, out++)
     {
-        struct state **ss = (struct state **)list_get(ll[i]);
-        for(int j = 0; j < list_size(ll[i]); j++)
-        {
-            struct costed_state *cs = malloc(sizeof(struct costed_state));
-            cs->cost = i;
-            cs->s = ss[j];
-            list_add(ret, cs);
-        }
-    }
-    struct list *dups = list_init();
-    list_sort_and_unify(ret, costed_state_sorter, costed_state_comparer, dups);
-    for(int i = 0; i <= mc; i++)
-    {
-        list_clear(ll[i]);
-    }
-    struct costed_state **css = (struct costed_state **)list_get(ret);
-    for(int i = 0; i < list_size(ret); i++)
-    {
-        struct costed_state *cs = css[i];
-        list_add(ll[cs->cost], cs->s);
-        free(cs);
-    }
-    css = (struct costed_state **)list_get(dups);
-    for(int i = 0; i < list_size(dups); i++)
-    {
-        struct costed_state *cs = css[i];
-        free(cs->s);
-        free(cs);
+        if(*text >= L'0' && *text <= L'9')
+            *out = SYMBOL_VARIABLE_FIRST + (*text - L'0');
+        else
+            *out = alphabet_add(alphabet, *text);
+        if(*out == 0) return -1;
     }
-    list_done(dups);
-    list_done(ret);
+    *out = 0;
+    return 0;
 }
 
 /**
- * Porównuje w-stringi alfabetycznie.
+ * Wylicza długość i maskę zmiennych przetłumaczonego wzorca reguły.
  * 
- * @param[in] a Wskaźnik na pierwszy tekst.
- * @param[in] b Wskaźnik na drugi tekst.
- * @return 0 jeśli są równe, liczbę dodatnią lub ujemną
- * jeśli odpowiednio pierwszy tekst jest większy od drugiego lub drugi od pierwszego.
+ * @param[in,out] r Reguła.
  */
-static int locale_sorter(const void *a, const void *b)
+static void rule_summarize(struct hint_rule *r)
 {
-    return wcscoll(*(const wchar_t**)a, *(const wchar_t**)b);
+    r->slen = symbol_len(r->ssrc);
+    r->vars = 0;
+    for(const symbol_t *c = r->ssrc; *c != 0; c++)
+        if(symbol_is_variable(*c)) r->vars |= 1u << symbol_variable_index(*c);
 }
 
 /**
- * Oblicza tekst wygenerowany przez stan. Funkcja pomocnicza.
+ * Sprawdza, czy reguła niczego nie zmienia (obie strony są takie same).
+ * Taka reguła daje to samo, co darmowe przejście wzdłuż drzewa,
+ * chyba że dzieli słowo.
  * 
- * @param[in] s Aktualny stan.
- * @param[in] l Lista, gdzie zapisać wynik.s
+ * @param[in] r Reguła w postaci kanonicznej.
+ * @return True jeśli reguła jest zbędna.
  */
-static void get_text_helper(struct state *s, struct list *l)
+static bool rule_is_identity(const struct hint_rule *r)
 {
-    if(s->prnt == NULL) return;
-    get_text_helper(s->prnt, l);
-    
-    if(s->rule == NULL)
-    {
-        list_add(l, (void*)trie_get_value_ptr(s->node));
-    }
-    else
-    {
-        wchar_t memory[10];
-        pattern_matches(s->rule->src, s->prnt->suf, memory);
-        wchar_t *dst = s->rule->dst;
-        for(int i = 0; i < 10; i++) if(memory[i] == 0) memory[i] = s->free_variable;
-        const struct trie_node *on = s->prnt->node;
-        while(*dst != 0)
-        {
-            wchar_t val = translate_letter(*dst, memory);
-            on = trie_get_child(on, val);
-            list_add(l, (void*)trie_get_value_ptr(on));
-            dst++;
-        }
-    }
-    // when used split rule -> add space
-    if(s->rule != NULL && s->rule->flag == RULE_SPLIT) list_add(l, NULL);
+    return r->flag != RULE_SPLIT && wcscmp(r->src, r->dst) == 0;
 }
 
 /**
- * Oblicza tekst wygenerowany przez stan. Funkcja pomocnicza.
+ * Sprawdza, czy jedna reguła czyni drugą zbędną.
+ * Reguła bez flagi zastępuje taką samą regułę z flagą `b` lub `e`,
+ * bo stany, które tworzy, można dalej rozwijać.
  * 
- * @param[in] s Stan.
- * @return Tekst.
+ * @param[in] a Reguła, która zostaje.
+ * @param[in] b Sprawdzana reguła.
+ * @return True jeśli `b` nie daje żadnej podpowiedzi taniej niż `a`.
  */
-static wchar_t * get_text(struct state *s)
+static bool rule_dominates(const struct hint_rule *a, const struct hint_rule *b)
 {
-    struct list *l = list_init();
-    get_text_helper(s, l);
-    wchar_t *rt = malloc((list_size(l)+1)*sizeof(wchar_t));
-    wchar_t **ls = (wchar_t**)list_get(l);
-    for(int i = 0; i < list_size(l); i++)
-    {
-        if(ls[i] == NULL) rt[i] = L' ';
-        else rt[i] = *(ls[i]);
-    }
-    rt[list_size(l)] = 0;
-    list_done(l);
-    return rt;
+    if(a->cost > b->cost) return false;
+    if(a->flag != b->flag && (a->flag != RULE_NORMAL || b->flag == RULE_SPLIT)) return false;
+    return wcscmp(a->src, b->src) == 0 && wcscmp(a->dst, b->dst) == 0;
 }
 
 /**
- * Porównuje w-stringi po wartościach znaków.
+ * Usuwa zbędną regułę, zapisując jej opis.
  * 
- * @param[in] a Wskaźnik na pierwszy tekst.
- * @param[in] b Wskaźnik na drugi tekst.
- * @return 0 jeśli są równe, liczbę dodatnią lub ujemną
- * jeśli odpowiednio pierwszy tekst jest większy od drugiego lub drugi od pierwszego.
+ * @param[in,out] r Reguła.
+ * @param[in,out] removed Lista opisów usuniętych reguł lub NULL.
  */
-static int text_sorter(const void *a, const void *b)
+static void rule_drop(struct hint_rule *r, struct word_list *removed)
 {
-    wchar_t *A = *(wchar_t**)a;
-    wchar_t *B = *(wchar_t**)b;
-    
-    while(*A == *B && *A != 0)
-    {
-        A++; B++;
-    }
-    return *A - *B;
+    if(removed != NULL) rule_describe(r, removed);
+    rule_done(r);
 }
 
 /**
@@ -644,105 +1926,362 @@ struct hint_rule * rule_make(const wchar_t *src, const wchar_t *dst, int cost, e
     memcpy(rule->src, src, (sl+1) * sizeof(wchar_t));
     rule->dst = malloc((dl+1) * sizeof(wchar_t));
     memcpy(rule->dst, dst, (dl+1) * sizeof(wchar_t));
+    rule->ssrc = NULL;
+    rule->sdst = NULL;
+    rule->slen = 0;
+    rule->vars = 0;
     rule->cost = cost;
     rule->flag = flag;
+    rule->shared = 0;
     return rule;
 }
 
+struct hint_rule * rule_copy(const struct hint_rule *rule)
+{
+    return rule_make(rule->src, rule->dst, rule->cost, rule->flag);
+}
+
+struct hint_rule * rule_share(struct hint_rule *rule)
+{
+    rule->shared++;
+    return rule;
+}
+
+int rule_compile(struct hint_rule *rule, struct alphabet *alphabet)
+{
+    symbol_t *src = malloc((wcslen(rule->src) + 1) * sizeof(symbol_t));
+    symbol_t *dst = malloc((wcslen(rule->dst) + 1) * sizeof(symbol_t));
+    if(src == NULL || dst == NULL) goto fail;
+    if(compile_text(rule->src, alphabet, src)<0) goto fail;
+    if(compile_text(rule->dst, alphabet, dst)<0) goto fail;
+    free(rule->ssrc);
+    free(rule->sdst);
+    rule->ssrc = src;
+    rule->sdst = dst;
+    rule_summarize(rule);
+    return 0;
+fail:
+    free(src);
+    free(dst);
+    return -1;
+}
+
+void rule_canonicalize(struct hint_rule *rule)
+{
+    assert(rule->shared == 0);
+    // Nowe numery zmiennych według pierwszego wystąpienia
+    int map[SYMBOL_VARIABLES];
+    int next = 0;
+    for(int i = 0; i < SYMBOL_VARIABLES; i++) map[i] = -1;
+    wchar_t *sides[2] = { rule->src, rule->dst };
+    for(int k = 0; k < 2; k++)
+        for(const wchar_t *c = sides[k]; *c != 0; c++)
+            if(*c >= L'0' && *c <= L'9' && map[*c - L'0'] < 0)
+                map[*c - L'0'] = next++;
+    for(int k = 0; k < 2; k++)
+        for(wchar_t *c = sides[k]; *c != 0; c++)
+            if(*c >= L'0' && *c <= L'9') *c = L'0' + map[*c - L'0'];
+    symbol_t *compiled[2] = { rule->ssrc, rule->sdst };
+    for(int k = 0; k < 2; k++)
+        for(symbol_t *c = compiled[k]; c != NULL && *c != 0; c++)
+            if(symbol_is_variable(*c))
+                *c = SYMBOL_VARIABLE_FIRST + map[symbol_variable_index(*c)];
+    if(rule->ssrc != NULL) rule_summarize(rule);
+}
+
+size_t rule_normalize(struct list *rules, struct word_list *removed)
+{
+    struct hint_rule **r = (struct hint_rule **)list_get(rules);
+    size_t n = list_size(rules);
+    size_t kept = 0;
+    for(size_t i = 0; i < n; i++)
+    {
+        bool useless = rule_is_identity(r[i]);
+        for(size_t j = 0; j < kept && !useless; j++)
+            useless = rule_dominates(r[j], r[i]);
+        if(useless)
+        {
+            rule_drop(r[i], removed);
+            continue;
+        }
+        // Nowa reguła zajmuje miejsce pierwszej z reguł, które zastępuje
+        size_t w = 0;
+        bool placed = false;
+        for(size_t j = 0; j < kept; j++)
+        {
+            if(!rule_dominates(r[i], r[j])) r[w++] = r[j];
+            else
+            {
+                rule_drop(r[j], removed);
+                if(!placed) r[w++] = r[i];
+                placed = true;
+            }
+        }
+        if(!placed) r[w++] = r[i];
+        kept = w;
+    }
+    list_resize(rules, kept, NULL);
+    list_terminate(rules);
+    return n - kept;
+}
+
+void rule_describe(const struct hint_rule *rule, struct word_list *list)
+{
+    static const wchar_t flags[] = L" bes";
+    size_t len = wcslen(rule->src) + wcslen(rule->dst) + 32;
+    wchar_t *text = malloc(len * sizeof(wchar_t));
+    if(text == NULL) return;
+    if(rule->flag == RULE_NORMAL) swprintf(text, len, L"%ls -> %ls : %d", rule->src, rule->dst, rule->cost);
+    else swprintf(text, len, L"%ls -> %ls : %d,%lc", rule->src, rule->dst, rule->cost, flags[rule->flag]);
+    word_list_add(list, text);
+    free(text);
+}
+
+#ifdef DICTIONARY_HINT_STATS
+struct hint_stats * hint_stats_new(size_t rules_no)
+{
+    struct hint_stats *stats = malloc(sizeof(struct hint_stats));
+    if(stats == NULL) return NULL;
+    memset(&stats->total, 0, sizeof(stats->total));
+    stats->rules = NULL;
+    stats->rules_no = 0;
+    hint_stats_rules_reset(stats, rules_no);
+    return stats;
+}
+
+void hint_stats_done(struct hint_stats *stats)
+{
+    if(stats == NULL) return;
+    free(stats->rules);
+    free(stats);
+}
+
+void hint_stats_reset(struct hint_stats *stats)
+{
+    memset(&stats->total, 0, sizeof(stats->total));
+    if(stats->rules_no > 0) memset(stats->rules, 0, stats->rules_no * sizeof(struct dictionary_rule_stats));
+}
+
+void hint_stats_rules_reset(struct hint_stats *stats, size_t rules_no)
+{
+    struct dictionary_rule_stats *rules = NULL;
+    if(rules_no > 0) rules = realloc(stats->rules, rules_no * sizeof(struct dictionary_rule_stats));
+    if(rules == NULL)
+    {
+        // Bez pamięci (albo bez reguł) reguły po prostu nie są liczone
+        free(stats->rules);
+        rules_no = 0;
+    }
+    stats->rules = rules;
+    stats->rules_no = rules_no;
+    if(rules_no > 0) memset(rules, 0, rules_no * sizeof(struct dictionary_rule_stats));
+}
+
+void hint_stats_read(const struct hint_stats *stats, struct dictionary_stats *to)
+{
+    const struct dictionary_stats *from = &stats->total;
+#define HINT_STATS_READ(counter) \
+    to->counter = __atomic_load_n(&from->counter, __ATOMIC_RELAXED);
+    HINT_STATS_COUNTERS(HINT_STATS_READ)
+#undef HINT_STATS_READ
+    for(int i = 0; i < DICTIONARY_STATS_LAYERS; i++)
+        to->states[i] = __atomic_load_n(&from->states[i], __ATOMIC_RELAXED);
+}
+
+void hint_stats_rule(const struct hint_stats *stats, size_t i, struct dictionary_rule_stats *to)
+{
+    to->tries = 0;
+    to->successes = 0;
+    if(i >= stats->rules_no) return;
+    to->tries = __atomic_load_n(&stats->rules[i].tries, __ATOMIC_RELAXED);
+    to->successes = __atomic_load_n(&stats->rules[i].successes, __ATOMIC_RELAXED);
+}
+#endif
+
+size_t rule_memory(const struct hint_rule *rule)
+{
+    size_t chars = wcslen(rule->src) + 1 + wcslen(rule->dst) + 1;
+    size_t bytes = sizeof(*rule) + chars * sizeof(wchar_t);
+    // Wersja w symbolach ma te same długości (zob. rule_compile())
+    if(rule->ssrc != NULL) bytes += chars * sizeof(symbol_t);
+    return bytes;
+}
+
 void rule_done(struct hint_rule *rule)
 {
+    if(rule->shared > 0)
+    {
+        rule->shared--;
+        return;
+    }
     free(rule->src);
     free(rule->dst);
+    free(rule->ssrc);
+    free(rule->sdst);
     free(rule);
 }
 
 
-struct list * rule_generate_hints(struct hint_rule **rules, int max_cost, int max_hints_no, struct trie_node *root, const wchar_t *word)
+void rule_generate_hints(struct hint_rule **rules, int max_cost, int max_hints_no, struct trie_node *root, const struct alphabet *alphabet, const symbol_t *word, struct word_list *output, int *costs, int threads, struct hint_stats *stats)
 {
-    int wlen = wcslen(word);
-    struct list **pp = preprocess(rules, word, max_cost);
-    struct state *is = malloc(sizeof(struct state));
+    HINT_STATS_ADD(stats, total.queries, 1);
+    struct hint_output ho;
+    hint_output_init(&ho, output, max_hints_no, costs);
+    struct edit_costs ec;
+    if(edit_costs_from_rules(rules, max_cost, &ec))
+    {
+        HINT_STATS_ADD(stats, total.edit_queries, 1);
+        edit_generate_hints(&ec, max_cost, root, alphabet, word, &ho);
+        hint_output_done(&ho);
+        return;
+    }
+#ifdef DICTIONARY_HINT_STATS
+    // Liczniki jednego generowania są doliczane do statystyk na końcu
+    struct hint_run_stats gs;
+    if(stats != NULL) hint_run_stats_init(&gs, stats, rules);
+    hint_stats = stats != NULL ? &gs : NULL;
+#endif
+    int wlen = symbol_len(word);
+    HINT_STAT_START(preprocess_start);
+    struct rule_vector *pp = preprocess(rules, word, max_cost);
+    HINT_STAT_STOP(preprocess_start, preprocess_ns);
+    if(pp == NULL)
+    {
+        hint_output_done(&ho);
+        goto merge;
+    }
+    struct state_pool pool;
+    state_pool_init(&pool);
+    struct state *is = state_new(&pool);
+    struct state_vector *layers = malloc(sizeof(struct state_vector)*(max_cost+1));
+    for(int i = 0; i <= max_cost; i++)
+    {
+        state_vector_init(&layers[i]);
+    }
+    struct ranked_state_vector fs;  // Stany końcowe z aktualnej warstwy
+    ranked_state_vector_init(&fs);
+    struct hint_bound bound = { NULL, NULL, max_cost };
+    // Dodatkowe wątki do rozwijania dużych warstw
+    int workers_no = threads > 1 ? threads - 1 : 0;
+    struct layer_worker *workers = NULL;
+    if(workers_no > 0) workers = malloc(workers_no * sizeof(struct layer_worker));
+    if(workers == NULL) workers_no = 0;
+    for(int i = 0; i < workers_no; i++)
+    {
+        state_pool_init(&workers[i].pool);
+#ifdef DICTIONARY_HINT_STATS
+        workers[i].stats = hint_stats;
+#endif
+    }
+    if(is == NULL || pp == NULL || layers == NULL || hint_bound_init(&bound, pp, word, max_cost) < 0)
+        goto done;
     is->node = root;
     is->prev = NULL;
     is->prnt = NULL;
     is->rule = NULL;
     is->suf = word;
-    struct list **layers = malloc(sizeof(struct list*)*(max_cost+1));
-    layers[0] = extend_state(is);
-    for(int i = 1; i <= max_cost; i++)
-    {
-        layers[i] = list_init();
-    }
-    struct list *output = list_init();
-    struct list *so = list_init();  // Sorted output
-    struct state **l0 = (struct state**)list_get(layers[0]);
-    for(int i = 0; i < list_size(layers[0]); i++)
-    {
-        if(l0[i]->suf[0] == 0 && trie_is_leaf(l0[i]->node))
-        {
-            // stan końcowy
-            list_add(output, get_text(l0[i]));
-        }
-    }
-    list_add_list(so, output);
-    list_sort(so, text_sorter);
-    for(int i = 1; i <= max_cost; i++)
+    is->free_variable = 0;
+    extend_state(is, &pool, &layers[0]);
+    for(int i = 0; i <= max_cost; i++)
     {
-        struct list *po = list_init();
-        for(int j = 1; j <= i; j++)
+        HINT_STAT_START(expand_start);
+        expand_layer(layers, i, root, pp, is, &bound, &pool, workers, workers_no);
+        HINT_STAT_STOP(expand_start, expand_ns);
+        HINT_STAT_ADD(states[i < DICTIONARY_STATS_LAYERS ? i : DICTIONARY_STATS_LAYERS - 1], layers[i].size);
+        if(i > 0)
         {
-            int lno = i - j;
-            list_add_list_and_free(layers[i], apply_rules_to_states(layers[lno], j, root, pp, is));
+            HINT_STAT_START(unify_start);
+#ifdef DICTIONARY_HINT_STATS
+            size_t before = 0;
+            for(int j = 0; j <= i; j++) before += layers[j].size;
+#endif
+            unify_states(layers, i);
+#ifdef DICTIONARY_HINT_STATS
+            for(int j = 0; j <= i; j++) before -= layers[j].size;
+            HINT_STAT_ADD(duplicates, before);
+#endif
+            HINT_STAT_STOP(unify_start, unify_ns);
         }
-        unify_states(layers, i);
-        struct state **li = (struct state **)list_get(layers[i]);
-        for(int j = 0; j < list_size(layers[i]); j++)
+        ranked_state_vector_clear(&fs);
+        struct state **li = layers[i].array;
+        for(size_t j = 0; j < layers[i].size; j++)
         {
             if(li[j]->suf[0] == 0 && trie_is_leaf(li[j]->node))
             {
                 // stan końcowy
-                list_add(po, get_text(li[j]));
+                struct ranked_state rs = { li[j], hint_frequency(li[j]) };
+                ranked_state_vector_push(&fs, rs);
             }
         }
-        list_sort_and_unify(po, locale_sorter, locale_sorter, NULL);
-        struct list *toadd = list_init();
-        list_reserve(toadd, list_size(po));
-        for(int i = 0; i < list_size(po); i++)
+        ranked_state_vector_sort(&fs);
+        // Stany o równej częstości przeglądamy od najczęstszych. Gdy lista
+        // się zapełni, podpowiedzi z rzadszych grup nie są nawet tworzone.
+        size_t g = 0;
+        HINT_STAT_START(text_start);
+        while(g < fs.size && !hint_output_full(&ho))
         {
-            const wchar_t *e = (const wchar_t*)list_get(po)[i];
-            const wchar_t **t = (const wchar_t**)list_get(so);
-            wchar_t **r =  bsearch(&e, t, list_size(so), sizeof(const wchar_t*), text_sorter);
-            if(r == NULL)
-                list_add(toadd, (void*)e);
-            else
-                free((void*)e);
+            size_t end = g;
+            for(; end < fs.size && fs.array[end].freq == fs.array[g].freq; end++)
+                get_text(fs.array[end].s, alphabet, &ho.group);
+            g = end;
+            hint_output_flush(&ho, i);
         }
-        list_add_list(output, toadd);
-        list_add_list(so, toadd);
-        list_sort(so, text_sorter);
-        list_done(toadd);
-        list_done(po);
-        if(list_size(output) >= max_hints_no) goto done;
+        HINT_STAT_STOP(text_start, text_ns);
+        if(hint_output_full(&ho)) goto done;
     }
 done:
     // Clean-up!
-    for(int i = 0; i <= max_cost; i++)
+    if(layers != NULL)
     {
-        struct list *ll = layers[i];
-        struct state **ss = (struct state**)list_get(ll);
-        for(int j = 0; j < list_size(ll); j++)
+        for(int i = 0; i <= max_cost; i++)
         {
-            free(ss[j]);
+            state_vector_done(&layers[i]);
         }
-        list_done(ll);
+        free(layers);
     }
-    free(layers);
-    list_done(so);
+    state_pool_done(&pool);
+    for(int i = 0; i < workers_no; i++)
+        state_pool_done(&workers[i].pool);
+    free(workers);
+    hint_bound_done(&bound);
+    hint_output_done(&ho);
+    ranked_state_vector_done(&fs);
     // Preprocessing data
-    free_preprocessing_data(pp, wlen);
-    if(list_size(output) > max_hints_no)
-        list_resize(output, max_hints_no, NULL);
-    return output;
+    if(pp != NULL) free_preprocessing_data(pp, wlen);
+merge:
+#ifdef DICTIONARY_HINT_STATS
+    if(stats != NULL)
+    {
+        hint_stats_merge(&stats->total, &gs.total);
+        free(gs.slots);
+    }
+    hint_stats = NULL;
+#endif
+    return;
+}
+
+void rule_generate_hints_indexed(const struct deletion_index *index, struct hint_rule **rules, int max_cost, int max_hints_no, struct trie_node *root, const struct alphabet *alphabet, const symbol_t *word, struct word_list *output, int *costs, int threads, struct hint_stats *stats)
+{
+    struct edit_costs ec;
+    if(index != NULL && edit_costs_from_rules(rules, max_cost, &ec))
+    {
+        // Usunięcie, zamiana i przestawienie usuwają literę ze słowa,
+        // a wstawienie, zamiana i przestawienie ze słowa ze słownika
+        int qd = edit_deletions(ec.del, ec.sub, ec.swap, max_cost);
+        int wd = edit_deletions(ec.ins, ec.sub, ec.swap, max_cost);
+        int depth = deletion_index_depth(index);
+        if(qd <= depth && wd <= depth)
+        {
+            HINT_STATS_ADD(stats, total.queries, 1);
+            HINT_STATS_ADD(stats, total.edit_queries, 1);
+            struct hint_output ho;
+            hint_output_init(&ho, output, max_hints_no, costs);
+            index_generate_hints(index, &ec, qd, max_cost, root, alphabet, word, &ho);
+            hint_output_done(&ho);
+            return;
+        }
+    }
+    rule_generate_hints(rules, max_cost, max_hints_no, root, alphabet, word, output, costs, threads, stats);
 }
 
 int rule_serialize(struct hint_rule *rule, FILE *file)
@@ -768,8 +2307,13 @@ struct hint_rule *rule_deserialize(FILE *file)
     struct hint_rule *rule = malloc(sizeof(struct hint_rule));
     rule->src = string_undress(src);
     rule->dst = string_undress(dst);
+    rule->ssrc = NULL;
+    rule->sdst = NULL;
+    rule->slen = 0;
+    rule->vars = 0;
     rule->cost = cost;
     rule->flag = flag;
+    rule->shared = 0;
     return rule;
 fail:
     if(src != NULL) string_done(src);
@@ -16,9 +16,17 @@
  */
 struct hint_rule;
 
+/**
+ * Statystyki generowania podpowiedzi słownika.
+ */
+struct hint_stats;
+
+#include "alphabet.h"
+#include "deletion_index.h"
 #include "dictionary.h"
 #include "list.h"
 #include "trie.h"
+#include "word_list.h"
 
 /**
  * Tworzy regułę.
@@ -31,8 +39,144 @@ struct hint_rule;
  */
 struct hint_rule * rule_make(const wchar_t *src, const wchar_t *dst, int cost, enum rule_flag flag);
 
+/**
+ * Kopiuje regułę bez jej tłumaczenia na symbole alfabetu.
+ * 
+ * @param[in] rule Reguła.
+ * @return Wskaźnik na nową regułę lub NULL, jeśli brakło pamięci.
+ */
+struct hint_rule * rule_copy(const struct hint_rule *rule);
+
+/**
+ * Tłumaczy wzorzec i tekst docelowy reguły na symbole alfabetu.
+ * Litery użyte w regule są dodawane do alfabetu.
+ * Regułę trzeba przetłumaczyć przed generowaniem podpowiedzi.
+ * 
+ * @param[in,out] rule Reguła.
+ * @param[in,out] alphabet Alfabet.
+ * @return 0 jeśli się udało, -1 jeśli alfabet się przepełnił.
+ */
+int rule_compile(struct hint_rule *rule, struct alphabet *alphabet);
+
+/**
+ * Dodaje regule właściciela.
+ * Reguły nie zmieniają się po przetłumaczeniu, więc można je współdzielić
+ * między słownikami o zgodnych alfabetach; każdy właściciel zwalnia regułę
+ * przez rule_done().
+ * 
+ * @param[in,out] rule Reguła.
+ * @return Ta sama reguła.
+ */
+struct hint_rule * rule_share(struct hint_rule *rule);
+
+/**
+ * Sprowadza regułę do postaci kanonicznej: numeruje zmienne kolejno
+ * według pierwszego wystąpienia (najpierw we wzorcu, potem w tekście
+ * docelowym). Reguła działa tak samo, ale równoważne reguły mają
+ * wtedy te same obie strony.
+ * 
+ * @param[in,out] rule Reguła bez innych właścicieli.
+ */
+void rule_canonicalize(struct hint_rule *rule);
+
+/**
+ * Usuwa z listy reguły, które nie mogą dać żadnej podpowiedzi taniej
+ * niż pozostałe: powtórzenia, te same reguły z większym kosztem
+ * (także z flagą `b` lub `e`, jeśli jest taka sama reguła bez flagi)
+ * i reguły, które niczego nie zmieniają. Z równoważnych reguł zostaje
+ * najtańsza, na miejscu pierwszej z nich, a kolejność pozostałych
+ * reguł się nie zmienia. Reguły muszą być w postaci kanonicznej
+ * (zob. rule_canonicalize()).
+ * 
+ * @param[in,out] rules Lista reguł.
+ * @param[in,out] removed Lista, na końcu której dopisać opisy usuniętych
+ * reguł (w postaci `lewa -> prawa : koszt,flaga`), albo NULL.
+ * @return Liczba usuniętych reguł.
+ */
+size_t rule_normalize(struct list *rules, struct word_list *removed);
+
+/**
+ * Dopisuje opis reguły w postaci `lewa -> prawa : koszt,flaga` do listy.
+ * 
+ * @param[in] rule Reguła.
+ * @param[in,out] list Lista opisów.
+ */
+void rule_describe(const struct hint_rule *rule, struct word_list *list);
+
+#ifdef DICTIONARY_HINT_STATS
+/**
+ * Statystyki generowania podpowiedzi słownika.
+ * Liczniki reguł odpowiadają kolejnym regułom na liście reguł słownika.
+ */
+struct hint_stats
+{
+    struct dictionary_stats total;          ///< Liczniki zbiorcze.
+    struct dictionary_rule_stats *rules;    ///< Liczniki kolejnych reguł lub NULL.
+    size_t rules_no;                        ///< Liczba liczników reguł.
+};
+
+/**
+ * Tworzy wyzerowane statystyki generowania podpowiedzi.
+ * 
+ * @param[in] rules_no Liczba reguł słownika.
+ * @return Nowe statystyki lub NULL, jeśli brakło pamięci.
+ */
+struct hint_stats * hint_stats_new(size_t rules_no);
+
+/**
+ * Usuwa statystyki generowania podpowiedzi.
+ * 
+ * @param[in] stats Statystyki lub NULL.
+ */
+void hint_stats_done(struct hint_stats *stats);
+
+/**
+ * Zeruje wszystkie liczniki statystyk.
+ * 
+ * @param[in,out] stats Statystyki.
+ */
+void hint_stats_reset(struct hint_stats *stats);
+
+/**
+ * Dopasowuje liczniki reguł do zmienionej listy reguł słownika i je zeruje.
+ * 
+ * @param[in,out] stats Statystyki.
+ * @param[in] rules_no Nowa liczba reguł.
+ */
+void hint_stats_rules_reset(struct hint_stats *stats, size_t rules_no);
+
+/**
+ * Kopiuje liczniki zbiorcze, które mogą być właśnie uaktualniane
+ * przez inne wątki.
+ * 
+ * @param[in] stats Statystyki słownika.
+ * @param[out] to Kopia.
+ */
+void hint_stats_read(const struct hint_stats *stats, struct dictionary_stats *to);
+
+/**
+ * Kopiuje liczniki reguły, które mogą być właśnie uaktualniane
+ * przez inne wątki.
+ * 
+ * @param[in] stats Statystyki słownika.
+ * @param[in] i Numer reguły na liście reguł słownika.
+ * @param[out] to Kopia (wyzerowana, jeśli reguły nie liczymy).
+ */
+void hint_stats_rule(const struct hint_stats *stats, size_t i, struct dictionary_rule_stats *to);
+#endif
+
+/**
+ * Zwraca liczbę bajtów pamięci zajmowanej przez regułę
+ * (razem z jej tekstami w obu postaciach).
+ * 
+ * @param[in] rule Reguła.
+ * @return Rozmiar reguły w bajtach.
+ */
+size_t rule_memory(const struct hint_rule *rule);
+
 /**
  * Usuwa regułę.
+ * Współdzielona reguła traci tylko jednego właściciela.
  * 
  * @param[in,out] rule Reguła do usunięcia.
  */
@@ -41,14 +185,48 @@ void rule_done(struct hint_rule *rule);
 /**
  * Generuje podpowiedzi do słowa używając danych reguł.
  * 
+ * Jeśli reguły to tylko usunięcie, wstawienie, zamiana i przestawienie
+ * dowolnych liter (bez flag), podpowiedzi są szukane szybciej przez liczenie
+ * odległości edycyjnej wzdłuż drzewa, z tym samym wynikiem.
+ * 
  * @param[in] rules Tablica wskaźnikóœ na reguły zakończona NULL-em.
  * @param[in] max_cost Maksymalny koszt podpowiedzi.
  * @param[in] max_hints_no Maksymalna liczba podpowiedzi.
  * @param[in] root Korzeń drzewa TRIE.
- * @param[in] word Słowo, dla którego wygenerować podpowiedzi.
- * @return Listę podpowiedzi.
+ * @param[in] alphabet Alfabet, w którym zapisano drzewo i reguły.
+ * @param[in] word Słowo (w symbolach), dla którego wygenerować podpowiedzi.
+ * @param[in,out] output Lista słów, na końcu której zostaną dopisane podpowiedzi.
+ * @param[out] costs Tablica (co najmniej `max_hints_no` elementów) na koszty
+ * kolejnych podpowiedzi albo NULL.
+ * @param[in] threads Liczba wątków do rozwijania dużych warstw stanów
+ * (podpowiedzi są takie same dla każdej liczby wątków).
+ * @param[in,out] stats Statystyki, do których doliczyć to generowanie,
+ * albo NULL (ignorowane bez opcji `DICTIONARY_HINT_STATS`).
+ */
+void rule_generate_hints(struct hint_rule **rules, int max_cost, int max_hints_no, struct trie_node *root, const struct alphabet *alphabet, const symbol_t *word, struct word_list *output, int *costs, int threads, struct hint_stats *stats);
+
+/**
+ * Generuje podpowiedzi do słowa używając danych reguł i indeksu usunięć.
+ * 
+ * Indeks jest używany, jeśli reguły to tylko podstawowe operacje edycyjne
+ * (jak w rule_generate_hints()), a przy maksymalnym koszcie podpowiedzi
+ * nie trzeba usuwać więcej liter niż głębokość indeksu. W p.p. podpowiedzi
+ * generuje rule_generate_hints(). Wynik jest w obu przypadkach ten sam.
+ * 
+ * @param[in] index Indeks usunięć zbudowany ze słów drzewa albo NULL.
+ * @param[in] rules Tablica wskaźników na reguły zakończona NULL-em.
+ * @param[in] max_cost Maksymalny koszt podpowiedzi.
+ * @param[in] max_hints_no Maksymalna liczba podpowiedzi.
+ * @param[in] root Korzeń drzewa TRIE.
+ * @param[in] alphabet Alfabet, w którym zapisano drzewo i reguły.
+ * @param[in] word Słowo (w symbolach), dla którego wygenerować podpowiedzi.
+ * @param[in,out] output Lista słów, na końcu której zostaną dopisane podpowiedzi.
+ * @param[out] costs Tablica (co najmniej `max_hints_no` elementów) na koszty
+ * kolejnych podpowiedzi albo NULL.
+ * @param[in] threads Liczba wątków dla rule_generate_hints().
+ * @param[in,out] stats Statystyki jak w rule_generate_hints() albo NULL.
  */
-struct list * rule_generate_hints(struct hint_rule **rules, int max_cost, int max_hints_no, struct trie_node *root, const wchar_t *word);
+void rule_generate_hints_indexed(const struct deletion_index *index, struct hint_rule **rules, int max_cost, int max_hints_no, struct trie_node *root, const struct alphabet *alphabet, const symbol_t *word, struct word_list *output, int *costs, int threads, struct hint_stats *stats);
 
 /**
  * Zapisuje regułę do pliku.
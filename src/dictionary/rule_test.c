@@ -13,25 +13,32 @@
 #include <stddef.h>
 #include <setjmp.h>
 #include <stdlib.h>
+#include <string.h>
 #include <cmocka.h>
 #include "rule.h"
+#include "vector.h"
 
 struct hint_rule
 {
     wchar_t *src;
     wchar_t *dst;
+    symbol_t *ssrc;
+    symbol_t *sdst;
+    size_t slen;
+    unsigned int vars;
     int cost;
     enum rule_flag flag;
+    int shared;
 };
 
 struct state
 {
-    const wchar_t *suf;
+    const symbol_t *suf;
     const struct trie_node * node;
     const struct trie_node * prev;
     struct state *prnt;
     struct hint_rule *rule;
-    wchar_t free_variable;
+    symbol_t free_variable;
 };
 
 struct costed_state
@@ -40,139 +47,366 @@ struct costed_state
     int cost;
 };
 
+#define STATE_POOL_BLOCK 1024
 
-extern bool pattern_matches(const wchar_t *pattern, const wchar_t *text, wchar_t memory[10]);
-extern wchar_t translate_letter(wchar_t c, wchar_t memory[10]);
-extern struct list * preprocess_suffix(struct hint_rule **rules, int rcnt, const wchar_t *word, bool begin, int max_cost);
-extern struct list ** preprocess(struct hint_rule **rules, const wchar_t *word, int max_cost);
-extern void free_preprocessing_data_for_suffix(struct list *pp);
-extern void free_preprocessing_data(struct list **pp, int wlen);
-extern struct list * extend_state(struct state *s);
-extern void explore_trie(const struct trie_node *n, wchar_t *dst, wchar_t memory[10], struct list *l, struct state *ps, struct hint_rule *r, const wchar_t *suf, const struct trie_node *root, wchar_t last_guessed);
-extern struct list * apply_rule(struct state *s, struct hint_rule *r, const struct trie_node *root);
-extern struct list * apply_rules_to_states(struct list *s, int c, const struct trie_node *root, struct list **pp, struct state *begin);
-extern void unify_states(struct list **ll, int mc);
-extern wchar_t * get_text(struct state *s);
+struct state_block
+{
+    struct state_block *next;
+    struct state states[STATE_POOL_BLOCK];
+};
+
+struct state_pool
+{
+    struct state_block *blocks;
+    size_t used;
+};
+
+struct edit_costs
+{
+    int del;
+    int ins;
+    int sub;
+    int swap;
+};
+
+struct suffix_bound
+{
+    int min_cost;
+    int shrink_cost;
+    int shrink_len;
+    int grow_cost;
+    int grow_len;
+    int split_cost;
+};
+
+struct hint_bound
+{
+    const symbol_t *end;
+    struct suffix_bound *suf;
+    int max_cost;
+};
+
+VECTOR_DEFINE(state_vector, struct state *)
+VECTOR_DEFINE(rule_vector, struct hint_rule *)
+
+
+extern bool pattern_matches(const symbol_t *pattern, const symbol_t *text, symbol_t memory[10]);
+extern int translate_letter(symbol_t c, symbol_t memory[10]);
+extern bool rule_matches(const struct hint_rule *r, const symbol_t *text, symbol_t memory[10]);
+extern void state_pool_init(struct state_pool *p);
+extern void state_pool_done(struct state_pool *p);
+extern struct rule_vector preprocess_suffix(struct hint_rule **rules, int rcnt, const symbol_t *word, bool begin, int max_cost);
+extern struct rule_vector * preprocess(struct hint_rule **rules, const symbol_t *word, int max_cost);
+extern void free_preprocessing_data_for_suffix(struct rule_vector *pp);
+extern void free_preprocessing_data(struct rule_vector *pp, int wlen);
+extern void extend_state(struct state *s, struct state_pool *pool, struct state_vector *out);
+extern void explore_trie(const struct trie_node *n, const symbol_t *dst, symbol_t memory[10], struct state_pool *pool, struct state_vector *l, struct state *ps, struct hint_rule *r, const symbol_t *suf, const struct trie_node *root, symbol_t last_guessed, const struct hint_bound *bound, int cost);
+extern bool apply_rule(struct state *s, struct hint_rule *r, const struct trie_node *root, const struct hint_bound *bound, int cost, struct state_pool *pool, struct state_vector *out);
+extern void apply_rules_to_states(struct state * const *s, size_t n, int c, const struct trie_node *root, struct rule_vector *pp, struct state *begin, const struct hint_bound *bound, int cost, struct state_pool *pool, struct state_vector *out);
+extern int hint_bound_init(struct hint_bound *b, const struct rule_vector *pp, const symbol_t *word, int max_cost);
+extern void hint_bound_done(struct hint_bound *b);
+extern bool state_hopeless(const struct state *s, int cost, const struct hint_bound *b);
+extern bool branch_hopeless(const struct trie_node *n, int skip, const symbol_t *suf, const struct trie_node *prev, int cost, const struct hint_bound *b);
+extern void unify_states(struct state_vector *ll, int mc);
+extern const wchar_t * get_text(struct state *s, const struct alphabet *alphabet, struct word_list *l);
+extern int compile_text(const wchar_t *text, struct alphabet *alphabet, symbol_t *out);
 extern int text_sorter(void *a, void *b);
+extern bool edit_costs_from_rules(struct hint_rule **rules, int max_cost, struct edit_costs *ec);
+
+/// Alfabet używany w testach.
+static struct alphabet *test_alphabet;
+
+/// Liczba buforów na zakodowane napisy.
+#define TEST_BUFFERS 32
+
+/// Bufory na zakodowane napisy.
+static symbol_t test_buffers[TEST_BUFFERS][64];
+
+/// Indeks następnego wolnego bufora.
+static int test_buffer_idx;
+
+/// Zwraca słowo zapisane w symbolach alfabetu testowego.
+static const symbol_t * S(const wchar_t *word)
+{
+    symbol_t *out = test_buffers[test_buffer_idx++ % TEST_BUFFERS];
+    alphabet_encode_add(test_alphabet, word, out);
+    return out;
+}
+
+/// Zwraca wzorzec reguły zapisany w symbolach alfabetu testowego.
+static const symbol_t * P(const wchar_t *pattern)
+{
+    symbol_t *out = test_buffers[test_buffer_idx++ % TEST_BUFFERS];
+    compile_text(pattern, test_alphabet, out);
+    return out;
+}
+
+/// Zwraca symbol litery w alfabecie testowym.
+static symbol_t C(wchar_t c)
+{
+    return alphabet_add(test_alphabet, c);
+}
+
+/// Tworzy regułę przetłumaczoną na symbole alfabetu testowego.
+static struct hint_rule * mkrule(const wchar_t *src, const wchar_t *dst, int cost, enum rule_flag flag)
+{
+    struct hint_rule *r = rule_make(src, dst, cost, flag);
+    if(r != NULL) rule_compile(r, test_alphabet);
+    return r;
+}
+
+/// Tworzy alfabet testowy.
+static int alphabet_setup(void **state)
+{
+    test_alphabet = alphabet_new();
+    return test_alphabet == NULL ? -1 : 0;
+}
+
+/// Niszczy alfabet testowy.
+static int alphabet_teardown(void **state)
+{
+    alphabet_done(test_alphabet);
+    return 0;
+}
 
 /// Sprawdza dopasowanie wzorca bez zmiennych.
 static void pattern_matches_no_vars_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
-    wchar_t memory[10];
-    assert_true(pattern_matches(L"okoń", L"okoń", memory));
-    assert_false(pattern_matches(L"figa", L"makiem", memory));
-    assert_true(pattern_matches(L"para", L"parapet", memory));
-    assert_false(pattern_matches(L"paragraf", L"parapet", memory));
+    symbol_t memory[10];
+    assert_true(pattern_matches(P(L"okoń"), S(L"okoń"), memory));
+    assert_false(pattern_matches(P(L"figa"), S(L"makiem"), memory));
+    assert_true(pattern_matches(P(L"para"), S(L"parapet"), memory));
+    assert_false(pattern_matches(P(L"paragraf"), S(L"parapet"), memory));
 }
 
 /// Sprawdza dopasowanie wzorca ze zmienną.
 static void pattern_matches_jocker_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
-    wchar_t memory[10];
-    assert_true(pattern_matches(L"0ocker", L"jocker", memory));
-    assert_true(pattern_matches(L"0ie1o23ik", L"niewolnik", memory));
-    assert_true(pattern_matches(L"w4lo83", L"waloyo", memory));
-    assert_true(pattern_matches(L"194ty", L"żółty", memory));
-    assert_true(pattern_matches(L"p6aw3a", L"prawda", memory));
-    assert_false(pattern_matches(L"p6aw3a", L"prawdę", memory));
+    symbol_t memory[10];
+    assert_true(pattern_matches(P(L"0ocker"), S(L"jocker"), memory));
+    assert_true(pattern_matches(P(L"0ie1o23ik"), S(L"niewolnik"), memory));
+    assert_true(pattern_matches(P(L"w4lo83"), S(L"waloyo"), memory));
+    assert_true(pattern_matches(P(L"194ty"), S(L"żółty"), memory));
+    assert_true(pattern_matches(P(L"p6aw3a"), S(L"prawda"), memory));
+    assert_false(pattern_matches(P(L"p6aw3a"), S(L"prawdę"), memory));
 }
 
 /// Sprawdza dopasowanie wzorca z ustaloną zmienną.
 static void pattern_matches_constrained_jocker_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
-    wchar_t memory[10];
-    assert_true(pattern_matches(L"0br0k0d0br0", L"abrakadabra", memory));
-    assert_true(pattern_matches(L"1471578zi78e9", L"prapradziadek", memory));
-    assert_true(pattern_matches(L"wsp0ni0ł0", L"wspaniała", memory));
-    assert_false(pattern_matches(L"wsp0ni0ł0", L"wspaniały", memory));
+    symbol_t memory[10];
+    assert_true(pattern_matches(P(L"0br0k0d0br0"), S(L"abrakadabra"), memory));
+    assert_true(pattern_matches(P(L"1471578zi78e9"), S(L"prapradziadek"), memory));
+    assert_true(pattern_matches(P(L"wsp0ni0ł0"), S(L"wspaniała"), memory));
+    assert_false(pattern_matches(P(L"wsp0ni0ł0"), S(L"wspaniały"), memory));
 }
 
 /// Sprawdza tłumaczenie liter dla litery.
 static void translate_letter_alpha_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
-    wchar_t memory[10] = {L'i',L'j',L'k',L'l',L'm',L'n',L'o',L'p',L'q',L'r'};
-    assert_int_equal(translate_letter(L'z', memory), L'z');
-    assert_int_equal(translate_letter(L'ł', memory), L'ł');
-    assert_int_equal(translate_letter(L'a', memory), L'a');
-    assert_int_equal(translate_letter(L'ć', memory), L'ć');
+    const symbol_t *m = S(L"ijklmnopqr");
+    symbol_t memory[10];
+    memcpy(memory, m, sizeof(memory));
+    assert_int_equal(translate_letter(C(L'z'), memory), C(L'z'));
+    assert_int_equal(translate_letter(C(L'ł'), memory), C(L'ł'));
+    assert_int_equal(translate_letter(C(L'a'), memory), C(L'a'));
+    assert_int_equal(translate_letter(C(L'ć'), memory), C(L'ć'));
     
 }
 /// Sprawdza tłumaczenie liter dla zmiennej.
 static void translate_letter_jocker_1_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
-    wchar_t memory[10] = {L'i',L'j',L'k',L'l',L'm',L'n',L'o',L'p',L'q',L'r'};
-    assert_int_equal(translate_letter(L'0', memory), L'i');
-    assert_int_equal(translate_letter(L'5', memory), L'n');
-    assert_int_equal(translate_letter(L'7', memory), L'p');
-    assert_int_equal(translate_letter(L'9', memory), L'r');
+    const symbol_t *m = S(L"ijklmnopqr");
+    symbol_t memory[10];
+    memcpy(memory, m, sizeof(memory));
+    assert_int_equal(translate_letter(P(L"0")[0], memory), C(L'i'));
+    assert_int_equal(translate_letter(P(L"5")[0], memory), C(L'n'));
+    assert_int_equal(translate_letter(P(L"7")[0], memory), C(L'p'));
+    assert_int_equal(translate_letter(P(L"9")[0], memory), C(L'r'));
 }
 /// Sprawdza tłumaczenie liter dla zmiennej.
 static void translate_letter_jocker_2_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
-    wchar_t memory[10] = {L'a',L'ą',L'b',L'c',L'ć',L'd',L'e',L'ę',L'f',L'g'};
-    assert_int_equal(translate_letter(L'0', memory), L'a');
-    assert_int_equal(translate_letter(L'1', memory), L'ą');
-    assert_int_equal(translate_letter(L'2', memory), L'b');
-    assert_int_equal(translate_letter(L'3', memory), L'c');
-    assert_int_equal(translate_letter(L'4', memory), L'ć');
-    assert_int_equal(translate_letter(L'5', memory), L'd');
-    assert_int_equal(translate_letter(L'6', memory), L'e');
-    assert_int_equal(translate_letter(L'7', memory), L'ę');
-    assert_int_equal(translate_letter(L'8', memory), L'f');
-    assert_int_equal(translate_letter(L'9', memory), L'g');
+    const symbol_t *m = S(L"aąbcćdeęfg");
+    symbol_t memory[10];
+    memcpy(memory, m, sizeof(memory));
+    assert_int_equal(translate_letter(P(L"0")[0], memory), C(L'a'));
+    assert_int_equal(translate_letter(P(L"1")[0], memory), C(L'ą'));
+    assert_int_equal(translate_letter(P(L"2")[0], memory), C(L'b'));
+    assert_int_equal(translate_letter(P(L"3")[0], memory), C(L'c'));
+    assert_int_equal(translate_letter(P(L"4")[0], memory), C(L'ć'));
+    assert_int_equal(translate_letter(P(L"5")[0], memory), C(L'd'));
+    assert_int_equal(translate_letter(P(L"6")[0], memory), C(L'e'));
+    assert_int_equal(translate_letter(P(L"7")[0], memory), C(L'ę'));
+    assert_int_equal(translate_letter(P(L"8")[0], memory), C(L'f'));
+    assert_int_equal(translate_letter(P(L"9")[0], memory), C(L'g'));
 }
-/// Sprawdza tłumaczenie liter dla syfu.
+/// Sprawdza tłumaczenie liter dla znaków niebędących literami (są zwykłymi symbolami).
 static void translate_letter_junk_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
-    wchar_t memory[10] = {L'i',L'j',L'k',L'l',L'm',L'n',L'o',L'p',L'q',L'r'};
-    assert_int_equal(translate_letter(L'#', memory), -1);
-    assert_int_equal(translate_letter(L'%', memory), -1);
-    assert_int_equal(translate_letter(L'&', memory), -1);
-    assert_int_equal(translate_letter(L'-', memory), -1);
+    const symbol_t *m = S(L"ijklmnopqr");
+    symbol_t memory[10];
+    memcpy(memory, m, sizeof(memory));
+    assert_int_equal(translate_letter(C(L'#'), memory), C(L'#'));
+    assert_int_equal(translate_letter(C(L'%'), memory), C(L'%'));
+    assert_int_equal(translate_letter(C(L'&'), memory), C(L'&'));
+    assert_int_equal(translate_letter(C(L'-'), memory), C(L'-'));
 }
 /// Sprawdza tłumaczenie liter dla nieustalonej zmiennej.
 static void translate_letter_unset_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
-    wchar_t memory[10] = {0,0,0,0,0,0,0,0,0,0};
-    assert_int_equal(translate_letter(L'0', memory), 0);
-    assert_int_equal(translate_letter(L'1', memory), 1);
-    assert_int_equal(translate_letter(L'2', memory), 2);
-    assert_int_equal(translate_letter(L'3', memory), 3);
-    assert_int_equal(translate_letter(L'4', memory), 4);
-    assert_int_equal(translate_letter(L'5', memory), 5);
-    assert_int_equal(translate_letter(L'6', memory), 6);
-    assert_int_equal(translate_letter(L'7', memory), 7);
-    assert_int_equal(translate_letter(L'8', memory), 8);
-    assert_int_equal(translate_letter(L'9', memory), 9);
+    symbol_t memory[10] = {0,0,0,0,0,0,0,0,0,0};
+    const symbol_t *v = P(L"0123456789");
+    for(int i = 0; i < 10; i++)
+        assert_int_equal(translate_letter(v[i], memory), i);
+}
+/// Sprawdza tłumaczenie reguły na symbole.
+static void rule_compile_test(void **state)
+{
+    setlocale(LC_ALL, "pl_PL.UTF8");
+    struct hint_rule *r = mkrule(L"0ą", L"ą01", 1, RULE_NORMAL);
+    assert_int_equal(r->ssrc[0], SYMBOL_VARIABLE_FIRST);
+    assert_int_equal(r->ssrc[1], C(L'ą'));
+    assert_int_equal(r->ssrc[2], 0);
+    assert_int_equal(r->sdst[0], C(L'ą'));
+    assert_int_equal(r->sdst[1], SYMBOL_VARIABLE_FIRST);
+    assert_int_equal(r->sdst[2], SYMBOL_VARIABLE_FIRST + 1);
+    assert_int_equal(r->sdst[3], 0);
+    rule_done(r);
 }
 /// Testuje tworzenie i usuwanie reguł.
 static void rule_make_done_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
-    struct hint_rule *r = rule_make(L"pa773rn", L"d357ina7ion", 7, RULE_SPLIT);
+    struct hint_rule *r = mkrule(L"pa773rn", L"d357ina7ion", 7, RULE_SPLIT);
     assert_string_equal(r->src, L"pa773rn");
     assert_string_equal(r->dst, L"d357ina7ion");
     assert_int_equal(r->cost, 7);
     assert_int_equal(r->flag, RULE_SPLIT);
     rule_done(r);
 }
+/// Testuje sprowadzanie reguły do postaci kanonicznej.
+static void rule_canonicalize_test(void **state)
+{
+    setlocale(LC_ALL, "pl_PL.UTF8");
+    struct hint_rule *r = mkrule(L"5ą3", L"37ą5", 1, RULE_NORMAL);
+    rule_canonicalize(r);
+    assert_true(wcscmp(r->src, L"0ą1") == 0);
+    assert_true(wcscmp(r->dst, L"12ą0") == 0);
+    assert_int_equal(r->ssrc[0], SYMBOL_VARIABLE_FIRST);
+    assert_int_equal(r->ssrc[1], C(L'ą'));
+    assert_int_equal(r->ssrc[2], SYMBOL_VARIABLE_FIRST + 1);
+    assert_int_equal(r->sdst[0], SYMBOL_VARIABLE_FIRST + 1);
+    assert_int_equal(r->sdst[1], SYMBOL_VARIABLE_FIRST + 2);
+    assert_int_equal(r->sdst[2], C(L'ą'));
+    assert_int_equal(r->sdst[3], SYMBOL_VARIABLE_FIRST);
+    rule_done(r);
+}
+/// Testuje usuwanie zbędnych reguł.
+static void rule_normalize_test(void **state)
+{
+    setlocale(LC_ALL, "pl_PL.UTF8");
+    const wchar_t *rules[][2] = {
+        { L"0", L"1" }, { L"ab", L"ab" }, { L"ą", L"a" }, { L"1", L"2" },
+        { L"ą", L"a" }, { L"", L"" }, { L"x", L"y" }, { L"x", L"y" }
+    };
+    int costs[] = { 2, 1, 3, 1, 3, 1, 1, 1 };
+    enum rule_flag flags[] = { RULE_NORMAL, RULE_NORMAL, RULE_BEGIN, RULE_NORMAL,
+        RULE_NORMAL, RULE_SPLIT, RULE_SPLIT, RULE_END };
+    struct list *l = list_init();
+    for(int i = 0; i < 8; i++)
+    {
+        struct hint_rule *r = mkrule(rules[i][0], rules[i][1], costs[i], flags[i]);
+        rule_canonicalize(r);
+        list_add(l, r);
+    }
+    struct word_list removed;
+    word_list_init(&removed);
+    assert_int_equal(rule_normalize(l, &removed), 3);
+    assert_int_equal(list_size(l), 5);
+    struct hint_rule **r = (struct hint_rule **)list_get(l);
+    // Tańsza reguła zajmuje miejsce droższej
+    assert_true(wcscmp(r[0]->src, L"0") == 0);
+    assert_int_equal(r[0]->cost, 1);
+    assert_true(wcscmp(r[1]->src, L"ą") == 0);
+    assert_int_equal(r[1]->flag, RULE_NORMAL);
+    assert_int_equal(r[2]->flag, RULE_SPLIT);
+    assert_true(wcscmp(r[2]->src, L"") == 0);
+    assert_int_equal(r[3]->flag, RULE_SPLIT);
+    assert_int_equal(r[4]->flag, RULE_END);
+    assert_true(r[5] == NULL);
+    assert_int_equal(word_list_size(&removed), 3);
+    assert_true(wcscmp(word_list_get(&removed)[0], L"ab -> ab : 1") == 0);
+    assert_true(wcscmp(word_list_get(&removed)[1], L"0 -> 1 : 2") == 0);
+    assert_true(wcscmp(word_list_get(&removed)[2], L"ą -> a : 3,b") == 0);
+    word_list_done(&removed);
+    for(int i = 0; i < 5; i++) rule_done(r[i]);
+    list_done(l);
+}
+/// Sprawdza dopasowanie wzorca reguły.
+static void rule_matches_test(void **state)
+{
+    setlocale(LC_ALL, "pl_PL.UTF8");
+    symbol_t memory[10];
+    struct hint_rule *r = mkrule(L"rzą", L"ż0", 1, RULE_NORMAL);
+    assert_int_equal(r->slen, 3);
+    assert_int_equal(r->vars, 0);
+    assert_true(rule_matches(r, S(L"rządek"), memory));
+    assert_int_equal(translate_letter(r->sdst[1], memory), 0);
+    assert_false(rule_matches(r, S(L"rzeka"), memory));
+    assert_false(rule_matches(r, S(L"rz"), memory));
+    rule_done(r);
+    r = mkrule(L"a10", L"01", 1, RULE_NORMAL);
+    rule_canonicalize(r);
+    assert_int_equal(r->vars, 3);
+    assert_true(rule_matches(r, S(L"abc"), memory));
+    assert_int_equal(translate_letter(r->sdst[0], memory), C(L'c'));
+    assert_int_equal(translate_letter(r->sdst[1], memory), C(L'b'));
+    assert_false(rule_matches(r, S(L"bbc"), memory));
+    rule_done(r);
+}
+/// Testuje preprocessing całego słowa (reguły wybierane po pierwszej literze).
+static void preprocess_test(void **state)
+{
+    setlocale(LC_ALL, "pl_PL.UTF8");
+    struct hint_rule *rules[] = {
+        mkrule(L"rz", L"ż", 1, RULE_NORMAL),
+        mkrule(L"0z", L"0ój", 2, RULE_NORMAL),
+        mkrule(L"p", L"b", 1, RULE_NORMAL),
+        mkrule(L"", L"0", 1, RULE_NORMAL),
+        mkrule(L"ep", L"x", 200, RULE_NORMAL),
+        NULL
+    };
+    struct rule_vector *pp = preprocess(rules, S(L"rzep"), 100);
+    assert_int_equal(pp[4].size, 3);
+    assert_true(pp[4].array[0] == rules[0] || pp[4].array[1] == rules[0]);
+    assert_true(pp[4].array[0] == rules[3] || pp[4].array[1] == rules[3]);
+    assert_true(pp[4].array[2] == rules[1]);
+    assert_int_equal(pp[3].size, 1);
+    assert_int_equal(pp[2].size, 1);
+    assert_int_equal(pp[1].size, 2);
+    assert_int_equal(pp[0].size, 1);
+    assert_true(pp[0].array[0] == rules[3]);
+    free_preprocessing_data(pp, 4);
+    for(int i = 0; rules[i] != NULL; i++) rule_done(rules[i]);
+}
 /// Testuje preprocessing (test bez reguł).
 static void preprocess_suffix_no_rule_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct hint_rule **rules = malloc(sizeof(struct hint_rule*));
     rules[0] = NULL;
-    struct list *output = preprocess_suffix(rules, 0, L"umlambo", false, 100);
-    assert_int_equal(list_size(output), 0);
-    free_preprocessing_data_for_suffix(output);
+    struct rule_vector output = preprocess_suffix(rules, 0, S(L"umlambo"), false, 100);
+    assert_int_equal(output.size, 0);
+    free_preprocessing_data_for_suffix(&output);
     free(rules);
 }
 /// Testuje preprocessing (test z niepasującą regułą).
@@ -180,11 +414,11 @@ static void preprocess_suffix_one_unmatching_rule_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct hint_rule **rules = malloc(2 * sizeof(struct hint_rule*));
-    rules[0] = rule_make(L"izolo", L"ngomso", 7, RULE_NORMAL);
+    rules[0] = mkrule(L"izolo", L"ngomso", 7, RULE_NORMAL);
     rules[1] = NULL;
-    struct list *output = preprocess_suffix(rules, 1, L"namhlanje", false, 100);
-    assert_int_equal(list_size(output), 0);
-    free_preprocessing_data_for_suffix(output);
+    struct rule_vector output = preprocess_suffix(rules, 1, S(L"namhlanje"), false, 100);
+    assert_int_equal(output.size, 0);
+    free_preprocessing_data_for_suffix(&output);
     rule_done(rules[0]);
     free(rules);
 }
@@ -194,13 +428,13 @@ static void preprocess_suffix_one_matching_rule_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct hint_rule **rules = malloc(2 * sizeof(struct hint_rule*));
-    rules[0] = rule_make(L"izolo", L"ngomso", 7, RULE_NORMAL);
+    rules[0] = mkrule(L"izolo", L"ngomso", 7, RULE_NORMAL);
     rules[1] = NULL;
-    struct list *output = preprocess_suffix(rules, 1, L"izolo", false, 100);
-    assert_int_equal(list_size(output), 1);
-    assert_true(list_get(output)[0] == rules[0]);
+    struct rule_vector output = preprocess_suffix(rules, 1, S(L"izolo"), false, 100);
+    assert_int_equal(output.size, 1);
+    assert_true(output.array[0] == rules[0]);
     
-    free_preprocessing_data_for_suffix(output);
+    free_preprocessing_data_for_suffix(&output);
     rule_done(rules[0]);
     free(rules);
 }
@@ -209,13 +443,13 @@ static void preprocess_suffix_some_samecost_rules_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct hint_rule **rules = malloc(4 * sizeof(struct hint_rule*));
-    rules[0] = rule_make(L"rz", L"ż", 1, RULE_NORMAL);
-    rules[1] = rule_make(L"rzep", L"cokolwiek", 1, RULE_NORMAL);
-    rules[2] = rule_make(L"0z", L"0ój", 1, RULE_NORMAL);
+    rules[0] = mkrule(L"rz", L"ż", 1, RULE_NORMAL);
+    rules[1] = mkrule(L"rzep", L"cokolwiek", 1, RULE_NORMAL);
+    rules[2] = mkrule(L"0z", L"0ój", 1, RULE_NORMAL);
     rules[3] = NULL;
-    struct list *output = preprocess_suffix(rules, 3, L"rzepiasty", false, 100);
-    assert_int_equal(list_size(output), 3);
-    struct hint_rule **out = (struct hint_rule**)list_get(output);
+    struct rule_vector output = preprocess_suffix(rules, 3, S(L"rzepiasty"), false, 100);
+    assert_int_equal(output.size, 3);
+    struct hint_rule **out = output.array;
     assert_true(out[0] == rules[0]
             ||  out[1] == rules[0]
             ||  out[2] == rules[0]);
@@ -225,7 +459,7 @@ static void preprocess_suffix_some_samecost_rules_test(void **state)
     assert_true(out[0] == rules[2]
             ||  out[1] == rules[2]
             ||  out[2] == rules[2]);
-    free_preprocessing_data_for_suffix(output);
+    free_preprocessing_data_for_suffix(&output);
     rule_done(rules[0]);
     rule_done(rules[1]);
     rule_done(rules[2]);
@@ -236,20 +470,20 @@ static void preprocess_suffix_some_multicost_rules_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct hint_rule **rules = malloc(5 * sizeof(struct hint_rule*));
-    rules[0] = rule_make(L"rz", L"ż", 1, RULE_NORMAL);
-    rules[1] = rule_make(L"rzep", L"cokolwiek", 1, RULE_NORMAL);
-    rules[2] = rule_make(L"0z", L"0ój", 2, RULE_NORMAL);
-    rules[3] = rule_make(L"01", L"10", 3, RULE_NORMAL);
+    rules[0] = mkrule(L"rz", L"ż", 1, RULE_NORMAL);
+    rules[1] = mkrule(L"rzep", L"cokolwiek", 1, RULE_NORMAL);
+    rules[2] = mkrule(L"0z", L"0ój", 2, RULE_NORMAL);
+    rules[3] = mkrule(L"01", L"10", 3, RULE_NORMAL);
     rules[4] = NULL;
-    struct list *output = preprocess_suffix(rules, 4, L"rzepiasty", false, 100);
-    assert_int_equal(list_size(output), 4);
-    struct hint_rule **out = (struct hint_rule**)list_get(output);
+    struct rule_vector output = preprocess_suffix(rules, 4, S(L"rzepiasty"), false, 100);
+    assert_int_equal(output.size, 4);
+    struct hint_rule **out = output.array;
     assert_true(out[0] == rules[0] || out[1] == rules[0]);
     assert_true(out[0] == rules[1] || out[1] == rules[1]);
     assert_true(out[2] == rules[2]);
     assert_true(out[3] == rules[3]);
     
-    free_preprocessing_data_for_suffix(output);
+    free_preprocessing_data_for_suffix(&output);
     rule_done(rules[0]);
     rule_done(rules[1]);
     rule_done(rules[2]);
@@ -261,11 +495,11 @@ static void preprocess_suffix_begin_flag_1_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct hint_rule **rules = malloc(2 * sizeof(struct hint_rule*));
-    rules[0] = rule_make(L"nie", L"tak", 1, RULE_BEGIN);
+    rules[0] = mkrule(L"nie", L"tak", 1, RULE_BEGIN);
     rules[1] = NULL;
-    struct list *output = preprocess_suffix(rules, 1, L"nieludzki", false, 100);
-    assert_int_equal(list_size(output), 0);
-    free_preprocessing_data_for_suffix(output);
+    struct rule_vector output = preprocess_suffix(rules, 1, S(L"nieludzki"), false, 100);
+    assert_int_equal(output.size, 0);
+    free_preprocessing_data_for_suffix(&output);
     rule_done(rules[0]);
     free(rules);
 }
@@ -274,13 +508,13 @@ static void preprocess_suffix_begin_flag_2_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct hint_rule **rules = malloc(2 * sizeof(struct hint_rule*));
-    rules[0] = rule_make(L"nie", L"tak", 1, RULE_BEGIN);
+    rules[0] = mkrule(L"nie", L"tak", 1, RULE_BEGIN);
     rules[1] = NULL;
-    struct list *output = preprocess_suffix(rules, 1, L"niewierzący", true, 100);
-    assert_int_equal(list_size(output), 1);
-    struct hint_rule **out = (struct hint_rule**)list_get(output);
+    struct rule_vector output = preprocess_suffix(rules, 1, S(L"niewierzący"), true, 100);
+    assert_int_equal(output.size, 1);
+    struct hint_rule **out = output.array;
     assert_true(out[0] == rules[0]);
-    free_preprocessing_data_for_suffix(output);
+    free_preprocessing_data_for_suffix(&output);
     rule_done(rules[0]);
     free(rules);
 }
@@ -289,11 +523,11 @@ static void preprocess_suffix_end_flag_1_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct hint_rule **rules = malloc(2 * sizeof(struct hint_rule*));
-    rules[0] = rule_make(L"nie", L"tak", 1, RULE_END);
+    rules[0] = mkrule(L"nie", L"tak", 1, RULE_END);
     rules[1] = NULL;
-    struct list *output = preprocess_suffix(rules, 1, L"niekończący", false, 100);
-    assert_int_equal(list_size(output), 0);
-    free_preprocessing_data_for_suffix(output);
+    struct rule_vector output = preprocess_suffix(rules, 1, S(L"niekończący"), false, 100);
+    assert_int_equal(output.size, 0);
+    free_preprocessing_data_for_suffix(&output);
     rule_done(rules[0]);
     free(rules);
 }
@@ -302,13 +536,13 @@ static void preprocess_suffix_end_flag_2_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct hint_rule **rules = malloc(2 * sizeof(struct hint_rule*));
-    rules[0] = rule_make(L"nie", L"tak", 1, RULE_END);
+    rules[0] = mkrule(L"nie", L"tak", 1, RULE_END);
     rules[1] = NULL;
-    struct list *output = preprocess_suffix(rules, 1, L"nie", false, 100);
-    assert_int_equal(list_size(output), 1);
-    struct hint_rule **out = (struct hint_rule**)list_get(output);
+    struct rule_vector output = preprocess_suffix(rules, 1, S(L"nie"), false, 100);
+    assert_int_equal(output.size, 1);
+    struct hint_rule **out = output.array;
     assert_true(out[0] == rules[0]);
-    free_preprocessing_data_for_suffix(output);
+    free_preprocessing_data_for_suffix(&output);
     rule_done(rules[0]);
     free(rules);
 }
@@ -317,22 +551,26 @@ static void extend_state_1_test(void **rubbish)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"abcde");
-    const struct trie_node *d1 = trie_get_child(d, L'a');
-    const struct trie_node *d2 = trie_get_child(d1, L'b');
-    const struct trie_node *d3 = trie_get_child(d2, L'c');
-    const struct trie_node *d4 = trie_get_child(d3, L'd');
+    trie_insert(d, S(L"abcde"));
+    const struct trie_node *d1 = trie_get_child(d, C(L'a'));
+    const struct trie_node *d2 = trie_get_child(d1, C(L'b'));
+    const struct trie_node *d3 = trie_get_child(d2, C(L'c'));
+    const struct trie_node *d4 = trie_get_child(d3, C(L'd'));
     
     struct state *s = malloc(sizeof(struct state));
-    const wchar_t *suf = L"abcd";
+    const symbol_t *suf = S(L"abcd");
     s->node = d;
     s->prev = NULL;
     s->prnt = NULL;
     s->rule = NULL;
     s->suf = suf;
-    struct list *l = extend_state(s);
-    struct state **ss = (struct state **)list_get(l);
-    assert_int_equal(list_size(l), 5);
+    struct state_pool pool;
+    state_pool_init(&pool);
+    struct state_vector l;
+    state_vector_init(&l);
+    extend_state(s, &pool, &l);
+    struct state **ss = l.array;
+    assert_int_equal(l.size, 5);
     assert_true(ss[0] == s);
     assert_true(ss[1]->suf == suf+1);
     assert_true(ss[1]->rule == NULL);
@@ -354,12 +592,9 @@ static void extend_state_1_test(void **rubbish)
     assert_true(ss[4]->node == d4);
     assert_true(ss[4]->prev == NULL);
     assert_true(ss[4]->prnt == ss[3]);
-    free(ss[0]);
-    free(ss[1]);
-    free(ss[2]);
-    free(ss[3]);
-    free(ss[4]);
-    list_done(l);
+    free(s);
+    state_vector_done(&l);
+    state_pool_done(&pool);
     trie_done(d);
 }
 
@@ -368,29 +603,33 @@ static void extend_state_2_test(void **rubbish)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"z");
-    trie_insert(d, L"mleka");
-    const struct trie_node *d1 = trie_get_child(d, L'z');
+    trie_insert(d, S(L"z"));
+    trie_insert(d, S(L"mleka"));
+    const struct trie_node *d1 = trie_get_child(d, C(L'z'));
     
     struct state *s = malloc(sizeof(struct state));
-    const wchar_t *suf = L"zmleka";
+    const symbol_t *suf = S(L"zmleka");
     s->node = d;
     s->prev = NULL;
     s->prnt = NULL;
     s->rule = NULL;
     s->suf = suf;
-    struct list *l = extend_state(s);
-    struct state **ss = (struct state **)list_get(l);
-    assert_int_equal(list_size(l), 2);
+    struct state_pool pool;
+    state_pool_init(&pool);
+    struct state_vector l;
+    state_vector_init(&l);
+    extend_state(s, &pool, &l);
+    struct state **ss = l.array;
+    assert_int_equal(l.size, 2);
     assert_true(ss[0] == s);
     assert_true(ss[1]->suf == suf+1);
     assert_true(ss[1]->rule == NULL);
     assert_true(ss[1]->node == d1);
     assert_true(ss[1]->prev == NULL);
     assert_true(ss[1]->prnt == s);
-    free(ss[0]);
-    free(ss[1]);
-    list_done(l);
+    free(s);
+    state_vector_done(&l);
+    state_pool_done(&pool);
     trie_done(d);
 }
 
@@ -401,24 +640,28 @@ static void explore_trie_noway_test(void **rubbish)
     struct trie_node *d = trie_init();
     
     struct state *s = malloc(sizeof(struct state));
-    const wchar_t *suf = L"b";
+    const symbol_t *suf = S(L"b");
     s->node = d;
     s->prev = NULL;
     s->prnt = NULL;
     s->rule = NULL;
     s->suf = suf;
     
-    struct hint_rule *r = rule_make(L"b", L"a", 1, RULE_NORMAL);
-    wchar_t memory[10];
+    struct hint_rule *r = mkrule(L"b", L"a", 1, RULE_NORMAL);
+    symbol_t memory[10];
     
-    struct list *l = list_init();
+    struct state_pool pool;
+    state_pool_init(&pool);
+    struct state_vector l;
+    state_vector_init(&l);
     
-    explore_trie(d, r->dst, memory, l, s, r, suf, d, 0);
+    explore_trie(d, r->sdst, memory, &pool, &l, s, r, suf, d, 0, NULL, 0);
     
-    assert_int_equal(list_size(l), 0);
+    assert_int_equal(l.size, 0);
     
     free(s);
-    list_done(l);
+    state_vector_done(&l);
+    state_pool_done(&pool);
     rule_done(r);
     trie_done(d);
 }
@@ -427,26 +670,29 @@ static void explore_trie_letter_test(void **rubbish)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"a");
-    const struct trie_node *d1 = trie_get_child(d, L'a');
+    trie_insert(d, S(L"a"));
+    const struct trie_node *d1 = trie_get_child(d, C(L'a'));
     
     struct state *s = malloc(sizeof(struct state));
-    const wchar_t *suf = L"b";
+    const symbol_t *suf = S(L"b");
     s->node = d;
     s->prev = NULL;
     s->prnt = NULL;
     s->rule = NULL;
     s->suf = suf;
     
-    struct hint_rule *r = rule_make(L"b", L"a", 1, RULE_NORMAL);
-    wchar_t memory[10];
+    struct hint_rule *r = mkrule(L"b", L"a", 1, RULE_NORMAL);
+    symbol_t memory[10];
     
-    struct list *l = list_init();
+    struct state_pool pool;
+    state_pool_init(&pool);
+    struct state_vector l;
+    state_vector_init(&l);
     
-    explore_trie(d, r->dst, memory, l, s, r, suf, d, 0);
+    explore_trie(d, r->sdst, memory, &pool, &l, s, r, suf, d, 0, NULL, 0);
     
-    assert_int_equal(list_size(l), 1);
-    struct state **ss = (struct state **)list_get(l);
+    assert_int_equal(l.size, 1);
+    struct state **ss = l.array;
     assert_true(ss[0]->node == d1);
     assert_true(ss[0]->prev == NULL);
     assert_true(ss[0]->prnt == s);
@@ -454,8 +700,8 @@ static void explore_trie_letter_test(void **rubbish)
     assert_int_equal(ss[0]->suf, suf);
     
     free(s);
-    free(ss[0]);
-    list_done(l);
+    state_vector_done(&l);
+    state_pool_done(&pool);
     rule_done(r);
     trie_done(d);
 }
@@ -464,27 +710,30 @@ static void explore_trie_constrained_jocker_test(void **rubbish)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"a");
-    const struct trie_node *d1 = trie_get_child(d, L'a');
+    trie_insert(d, S(L"a"));
+    const struct trie_node *d1 = trie_get_child(d, C(L'a'));
     
     struct state *s = malloc(sizeof(struct state));
-    const wchar_t *suf = L"b";
+    const symbol_t *suf = S(L"b");
     s->node = d;
     s->prev = NULL;
     s->prnt = NULL;
     s->rule = NULL;
     s->suf = suf;
     
-    struct hint_rule *r = rule_make(L"b", L"7", 1, RULE_NORMAL);
-    wchar_t memory[10];
-    memory[7] = L'a';
+    struct hint_rule *r = mkrule(L"b", L"7", 1, RULE_NORMAL);
+    symbol_t memory[10];
+    memory[7] = C(L'a');
     
-    struct list *l = list_init();
+    struct state_pool pool;
+    state_pool_init(&pool);
+    struct state_vector l;
+    state_vector_init(&l);
     
-    explore_trie(d, r->dst, memory, l, s, r, suf, d, 0);
+    explore_trie(d, r->sdst, memory, &pool, &l, s, r, suf, d, 0, NULL, 0);
     
-    assert_int_equal(list_size(l), 1);
-    struct state **ss = (struct state **)list_get(l);
+    assert_int_equal(l.size, 1);
+    struct state **ss = l.array;
     assert_true(ss[0]->node == d1);
     assert_true(ss[0]->prev == NULL);
     assert_true(ss[0]->prnt == s);
@@ -492,8 +741,8 @@ static void explore_trie_constrained_jocker_test(void **rubbish)
     assert_int_equal(ss[0]->suf, suf);
     
     free(s);
-    free(ss[0]);
-    list_done(l);
+    state_vector_done(&l);
+    state_pool_done(&pool);
     rule_done(r);
     trie_done(d);
 }
@@ -502,27 +751,30 @@ static void explore_trie_oneway_jocker_test(void **rubbish)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"a");
-    const struct trie_node *d1 = trie_get_child(d, L'a');
+    trie_insert(d, S(L"a"));
+    const struct trie_node *d1 = trie_get_child(d, C(L'a'));
     
     struct state *s = malloc(sizeof(struct state));
-    const wchar_t *suf = L"b";
+    const symbol_t *suf = S(L"b");
     s->node = d;
     s->prev = NULL;
     s->prnt = NULL;
     s->rule = NULL;
     s->suf = suf;
     
-    struct hint_rule *r = rule_make(L"b", L"7", 1, RULE_NORMAL);
-    wchar_t memory[10];
+    struct hint_rule *r = mkrule(L"b", L"7", 1, RULE_NORMAL);
+    symbol_t memory[10];
     memory[7] = 0;
     
-    struct list *l = list_init();
+    struct state_pool pool;
+    state_pool_init(&pool);
+    struct state_vector l;
+    state_vector_init(&l);
     
-    explore_trie(d, r->dst, memory, l, s, r, suf, d, 0);
+    explore_trie(d, r->sdst, memory, &pool, &l, s, r, suf, d, 0, NULL, 0);
     
-    assert_int_equal(list_size(l), 1);
-    struct state **ss = (struct state **)list_get(l);
+    assert_int_equal(l.size, 1);
+    struct state **ss = l.array;
     assert_true(ss[0]->node == d1);
     assert_true(ss[0]->prev == NULL);
     assert_true(ss[0]->prnt == s);
@@ -530,8 +782,8 @@ static void explore_trie_oneway_jocker_test(void **rubbish)
     assert_int_equal(ss[0]->suf, suf);
     
     free(s);
-    free(ss[0]);
-    list_done(l);
+    state_vector_done(&l);
+    state_pool_done(&pool);
     rule_done(r);
     trie_done(d);
 }
@@ -540,47 +792,49 @@ static void explore_trie_multiway_jocker_test(void **rubbish)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"a");
-    trie_insert(d, L"z");
-    const struct trie_node *d1 = trie_get_child(d, L'a');
-    const struct trie_node *d2 = trie_get_child(d, L'z');
+    trie_insert(d, S(L"a"));
+    trie_insert(d, S(L"z"));
+    const struct trie_node *d1 = trie_get_child(d, C(L'a'));
+    const struct trie_node *d2 = trie_get_child(d, C(L'z'));
     
     struct state *s = malloc(sizeof(struct state));
-    const wchar_t *suf = L"b";
+    const symbol_t *suf = S(L"b");
     s->node = d;
     s->prev = NULL;
     s->prnt = NULL;
     s->rule = NULL;
     s->suf = suf;
     
-    struct hint_rule *r = rule_make(L"b", L"7", 1, RULE_NORMAL);
-    wchar_t memory[10];
+    struct hint_rule *r = mkrule(L"b", L"7", 1, RULE_NORMAL);
+    symbol_t memory[10];
     memory[7] = 0;
     
-    struct list *l = list_init();
+    struct state_pool pool;
+    state_pool_init(&pool);
+    struct state_vector l;
+    state_vector_init(&l);
     
-    explore_trie(d, r->dst, memory, l, s, r, suf, d, 0);
+    explore_trie(d, r->sdst, memory, &pool, &l, s, r, suf, d, 0, NULL, 0);
     
-    assert_int_equal(list_size(l), 2);
-    struct state **ss = (struct state **)list_get(l);
+    assert_int_equal(l.size, 2);
+    struct state **ss = l.array;
     assert_true(ss[0]->node == d1);
     assert_true(ss[0]->prev == NULL);
     assert_true(ss[0]->prnt == s);
     assert_true(ss[0]->rule == r);
     assert_int_equal(ss[0]->suf, suf);
-    assert_int_equal(ss[0]->free_variable, L'a');
+    assert_int_equal(ss[0]->free_variable, C(L'a'));
     
     assert_true(ss[1]->node == d2);
     assert_true(ss[1]->prev == NULL);
     assert_true(ss[1]->prnt == s);
     assert_true(ss[1]->rule == r);
     assert_int_equal(ss[1]->suf, suf);
-    assert_int_equal(ss[1]->free_variable, L'z');
+    assert_int_equal(ss[1]->free_variable, C(L'z'));
     
     free(s);
-    free(ss[0]);
-    free(ss[1]);
-    list_done(l);
+    state_vector_done(&l);
+    state_pool_done(&pool);
     rule_done(r);
     trie_done(d);
 }
@@ -589,29 +843,32 @@ static void explore_trie_self_constraint_jocker_test(void **rubbish)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"aa");
-    trie_insert(d, L"az");
-    const struct trie_node *d1 = trie_get_child(d, L'a');
-    const struct trie_node *d2 = trie_get_child(d1, L'a');
+    trie_insert(d, S(L"aa"));
+    trie_insert(d, S(L"az"));
+    const struct trie_node *d1 = trie_get_child(d, C(L'a'));
+    const struct trie_node *d2 = trie_get_child(d1, C(L'a'));
     
     struct state *s = malloc(sizeof(struct state));
-    const wchar_t *suf = L"b";
+    const symbol_t *suf = S(L"b");
     s->node = d;
     s->prev = NULL;
     s->prnt = NULL;
     s->rule = NULL;
     s->suf = suf;
     
-    struct hint_rule *r = rule_make(L"b", L"77", 1, RULE_NORMAL);
-    wchar_t memory[10];
+    struct hint_rule *r = mkrule(L"b", L"77", 1, RULE_NORMAL);
+    symbol_t memory[10];
     memory[7] = 0;
     
-    struct list *l = list_init();
+    struct state_pool pool;
+    state_pool_init(&pool);
+    struct state_vector l;
+    state_vector_init(&l);
     
-    explore_trie(d, r->dst, memory, l, s, r, suf, d, 0);
+    explore_trie(d, r->sdst, memory, &pool, &l, s, r, suf, d, 0, NULL, 0);
     
-    assert_int_equal(list_size(l), 1);
-    struct state **ss = (struct state **)list_get(l);
+    assert_int_equal(l.size, 1);
+    struct state **ss = l.array;
     assert_true(ss[0]->node == d2);
     assert_true(ss[0]->prev == NULL);
     assert_true(ss[0]->prnt == s);
@@ -619,8 +876,8 @@ static void explore_trie_self_constraint_jocker_test(void **rubbish)
     assert_int_equal(ss[0]->suf, suf);
     
     free(s);
-    free(ss[0]);
-    list_done(l);
+    state_vector_done(&l);
+    state_pool_done(&pool);
     rule_done(r);
     trie_done(d);
 }
@@ -629,27 +886,31 @@ static void explore_trie_end_rule_1_test(void **rubbish)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"ac");
+    trie_insert(d, S(L"ac"));
     
     struct state *s = malloc(sizeof(struct state));
-    const wchar_t *suf = L"b";
+    const symbol_t *suf = S(L"b");
     s->node = d;
     s->prev = NULL;
     s->prnt = NULL;
     s->rule = NULL;
     s->suf = suf;
     
-    struct hint_rule *r = rule_make(L"b", L"a", 1, RULE_END);
-    wchar_t memory[10];
+    struct hint_rule *r = mkrule(L"b", L"a", 1, RULE_END);
+    symbol_t memory[10];
     
-    struct list *l = list_init();
+    struct state_pool pool;
+    state_pool_init(&pool);
+    struct state_vector l;
+    state_vector_init(&l);
     
-    explore_trie(d, r->dst, memory, l, s, r, suf, d, 0);
+    explore_trie(d, r->sdst, memory, &pool, &l, s, r, suf, d, 0, NULL, 0);
     
-    assert_int_equal(list_size(l), 0);
+    assert_int_equal(l.size, 0);
     
     free(s);
-    list_done(l);
+    state_vector_done(&l);
+    state_pool_done(&pool);
     rule_done(r);
     trie_done(d);
 }
@@ -658,27 +919,30 @@ static void explore_trie_end_rule_2_test(void **rubbish)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"ac");
-    trie_insert(d, L"a");
-    const struct trie_node *d1 = trie_get_child(d, L'a');
+    trie_insert(d, S(L"ac"));
+    trie_insert(d, S(L"a"));
+    const struct trie_node *d1 = trie_get_child(d, C(L'a'));
     
     struct state *s = malloc(sizeof(struct state));
-    const wchar_t *suf = L"b";
+    const symbol_t *suf = S(L"b");
     s->node = d;
     s->prev = NULL;
     s->prnt = NULL;
     s->rule = NULL;
     s->suf = suf;
     
-    struct hint_rule *r = rule_make(L"b", L"a", 1, RULE_END);
-    wchar_t memory[10];
+    struct hint_rule *r = mkrule(L"b", L"a", 1, RULE_END);
+    symbol_t memory[10];
     
-    struct list *l = list_init();
+    struct state_pool pool;
+    state_pool_init(&pool);
+    struct state_vector l;
+    state_vector_init(&l);
     
-    explore_trie(d, r->dst, memory, l, s, r, suf, d, 0);
+    explore_trie(d, r->sdst, memory, &pool, &l, s, r, suf, d, 0, NULL, 0);
     
-    assert_int_equal(list_size(l), 1);
-    struct state **ss = (struct state **)list_get(l);
+    assert_int_equal(l.size, 1);
+    struct state **ss = l.array;
     assert_true(ss[0]->node == d1);
     assert_true(ss[0]->prev == NULL);
     assert_true(ss[0]->prnt == s);
@@ -686,8 +950,8 @@ static void explore_trie_end_rule_2_test(void **rubbish)
     assert_int_equal(ss[0]->suf, suf);
     
     free(s);
-    free(ss[0]);
-    list_done(l);
+    state_vector_done(&l);
+    state_pool_done(&pool);
     rule_done(r);
     trie_done(d);
 }
@@ -696,27 +960,31 @@ static void explore_trie_split_rule_1_test(void **rubbish)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"ac");
+    trie_insert(d, S(L"ac"));
     
     struct state *s = malloc(sizeof(struct state));
-    const wchar_t *suf = L"b";
+    const symbol_t *suf = S(L"b");
     s->node = d;
     s->prev = NULL;
     s->prnt = NULL;
     s->rule = NULL;
     s->suf = suf;
     
-    struct hint_rule *r = rule_make(L"b", L"a", 1, RULE_SPLIT);
-    wchar_t memory[10];
+    struct hint_rule *r = mkrule(L"b", L"a", 1, RULE_SPLIT);
+    symbol_t memory[10];
     
-    struct list *l = list_init();
+    struct state_pool pool;
+    state_pool_init(&pool);
+    struct state_vector l;
+    state_vector_init(&l);
     
-    explore_trie(d, r->dst, memory, l, s, r, suf, d, 0);
+    explore_trie(d, r->sdst, memory, &pool, &l, s, r, suf, d, 0, NULL, 0);
     
-    assert_int_equal(list_size(l), 0);
+    assert_int_equal(l.size, 0);
     
     free(s);
-    list_done(l);
+    state_vector_done(&l);
+    state_pool_done(&pool);
     rule_done(r);
     trie_done(d);
 }
@@ -725,27 +993,30 @@ static void explore_trie_split_rule_2_test(void **rubbish)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"ac");
-    trie_insert(d, L"a");
-    const struct trie_node *d1 = trie_get_child(d, L'a');
+    trie_insert(d, S(L"ac"));
+    trie_insert(d, S(L"a"));
+    const struct trie_node *d1 = trie_get_child(d, C(L'a'));
     
     struct state *s = malloc(sizeof(struct state));
-    const wchar_t *suf = L"b";
+    const symbol_t *suf = S(L"b");
     s->node = d;
     s->prev = NULL;
     s->prnt = NULL;
     s->rule = NULL;
     s->suf = suf;
     
-    struct hint_rule *r = rule_make(L"b", L"a", 1, RULE_SPLIT);
-    wchar_t memory[10];
+    struct hint_rule *r = mkrule(L"b", L"a", 1, RULE_SPLIT);
+    symbol_t memory[10];
     
-    struct list *l = list_init();
+    struct state_pool pool;
+    state_pool_init(&pool);
+    struct state_vector l;
+    state_vector_init(&l);
     
-    explore_trie(d, r->dst, memory, l, s, r, suf, d, 0);
+    explore_trie(d, r->sdst, memory, &pool, &l, s, r, suf, d, 0, NULL, 0);
     
-    assert_int_equal(list_size(l), 1);
-    struct state **ss = (struct state **)list_get(l);
+    assert_int_equal(l.size, 1);
+    struct state **ss = l.array;
     assert_true(ss[0]->node == d);
     assert_true(ss[0]->prev == d1);
     assert_true(ss[0]->prnt == s);
@@ -753,8 +1024,8 @@ static void explore_trie_split_rule_2_test(void **rubbish)
     assert_int_equal(ss[0]->suf, suf);
     
     free(s);
-    free(ss[0]);
-    list_done(l);
+    state_vector_done(&l);
+    state_pool_done(&pool);
     rule_done(r);
     trie_done(d);
 }
@@ -763,25 +1034,29 @@ static void apply_rule_test(void **rubbish)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"aa");
-    trie_insert(d, L"az");
-    const struct trie_node *d1 = trie_get_child(d, L'a');
-    const struct trie_node *d2 = trie_get_child(d1, L'z');
+    trie_insert(d, S(L"aa"));
+    trie_insert(d, S(L"az"));
+    const struct trie_node *d1 = trie_get_child(d, C(L'a'));
+    const struct trie_node *d2 = trie_get_child(d1, C(L'z'));
     
     struct state *s = malloc(sizeof(struct state));
-    const wchar_t *suf = L"za";
+    const symbol_t *suf = S(L"za");
     s->node = d;
     s->prev = NULL;
     s->prnt = NULL;
     s->rule = NULL;
     s->suf = suf;
     
-    struct hint_rule *r = rule_make(L"01", L"10", 1, RULE_NORMAL);
+    struct hint_rule *r = mkrule(L"01", L"10", 1, RULE_NORMAL);
     
-    struct list *l = apply_rule(s, r, d);
+    struct state_pool pool;
+    state_pool_init(&pool);
+    struct state_vector l;
+    state_vector_init(&l);
+    assert_true(apply_rule(s, r, d, NULL, 0, &pool, &l));
     
-    assert_int_equal(list_size(l), 1);
-    struct state **ss = (struct state **)list_get(l);
+    assert_int_equal(l.size, 1);
+    struct state **ss = l.array;
     assert_true(ss[0]->node == d2);
     assert_true(ss[0]->prev == NULL);
     assert_true(ss[0]->prnt == s);
@@ -789,8 +1064,8 @@ static void apply_rule_test(void **rubbish)
     assert_int_equal(ss[0]->suf, suf + 2);
     
     free(s);
-    free(ss[0]);
-    list_done(l);
+    state_vector_done(&l);
+    state_pool_done(&pool);
     rule_done(r);
     trie_done(d);
 }
@@ -799,15 +1074,16 @@ static void apply_rules_to_states_test(void **rubbish)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"aa");
-    trie_insert(d, L"az");
-    const struct trie_node *d1 = trie_get_child(d, L'a');
-    const struct trie_node *d2 = trie_get_child(d1, L'z');
+    trie_insert(d, S(L"aa"));
+    trie_insert(d, S(L"az"));
+    const struct trie_node *d1 = trie_get_child(d, C(L'a'));
+    const struct trie_node *d2 = trie_get_child(d1, C(L'z'));
     
-    struct list * states = list_init();
+    struct state_vector states;
+    state_vector_init(&states);
     struct state *s1 = malloc(sizeof(struct state));
-    list_add(states, s1);
-    const wchar_t *suf = L"za";
+    state_vector_push(&states, s1);
+    const symbol_t *suf = S(L"za");
     s1->node = d;
     s1->prev = NULL;
     s1->prnt = NULL;
@@ -815,15 +1091,19 @@ static void apply_rules_to_states_test(void **rubbish)
     s1->suf = suf;
     
     struct hint_rule * rules[3];
-    struct hint_rule *r1 = rules[0] = rule_make(L"01", L"10", 1, RULE_NORMAL);
-    struct hint_rule *r2 = rules[1] = rule_make(L"z", L"", 1, RULE_BEGIN);
+    struct hint_rule *r1 = rules[0] = mkrule(L"01", L"10", 1, RULE_NORMAL);
+    struct hint_rule *r2 = rules[1] = mkrule(L"z", L"", 1, RULE_BEGIN);
     rules[2] = NULL;
     
-    struct list **pp = preprocess(rules, suf, 100);
-    struct list * l = apply_rules_to_states(states, 1, d, pp, s1);
+    struct rule_vector *pp = preprocess(rules, suf, 100);
+    struct state_pool pool;
+    state_pool_init(&pool);
+    struct state_vector l;
+    state_vector_init(&l);
+    apply_rules_to_states(states.array, states.size, 1, d, pp, s1, NULL, 1, &pool, &l);
     
-    assert_int_equal(list_size(l), 3);
-    struct state **ss = (struct state **)list_get(l);
+    assert_int_equal(l.size, 3);
+    struct state **ss = l.array;
     struct state *sa = NULL;
     struct state *sb = NULL;
     struct state *sc = NULL;
@@ -859,17 +1139,15 @@ static void apply_rules_to_states_test(void **rubbish)
     assert_true(sc->rule == NULL);
     assert_true(sc->suf == suf + 2);
     
-    free(sa);
-    free(sb);
-    free(sc);
-    list_done(l);
+    state_vector_done(&l);
+    state_pool_done(&pool);
     free_preprocessing_data(pp, 2);
     
     rule_done(r1);
     rule_done(r2);
     
     free(s1);
-    list_done(states);
+    state_vector_done(&states);
     trie_done(d);
 }
 
@@ -878,16 +1156,17 @@ static void apply_rules_to_states_closed_state_test(void **rubbish)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"aa");
-    trie_insert(d, L"az");
-    trie_insert(d, L"azy");
+    trie_insert(d, S(L"aa"));
+    trie_insert(d, S(L"az"));
+    trie_insert(d, S(L"azy"));
  
-    struct hint_rule *cr = rule_make(L"za", L"az", 1, RULE_END);
+    struct hint_rule *cr = mkrule(L"za", L"az", 1, RULE_END);
     
-    struct list * states = list_init();
+    struct state_vector states;
+    state_vector_init(&states);
     struct state *s1 = malloc(sizeof(struct state));
-    list_add(states, s1);
-    const wchar_t *suf = L"za";
+    state_vector_push(&states, s1);
+    const symbol_t *suf = S(L"za");
     s1->node = d;
     s1->prev = NULL;
     s1->prnt = NULL;
@@ -895,23 +1174,28 @@ static void apply_rules_to_states_closed_state_test(void **rubbish)
     s1->suf = suf;
     
     struct hint_rule * rules[3];
-    struct hint_rule *r1 = rules[0] = rule_make(L"", L"y", 1, RULE_NORMAL);
+    struct hint_rule *r1 = rules[0] = mkrule(L"", L"y", 1, RULE_NORMAL);
     rules[1] = cr;
     rules[2] = NULL;
     
-    struct list **pp = preprocess(rules, suf, 100);
-    struct list * l = apply_rules_to_states(states, 1, d, pp, NULL);
+    struct rule_vector *pp = preprocess(rules, suf, 100);
+    struct state_pool pool;
+    state_pool_init(&pool);
+    struct state_vector l;
+    state_vector_init(&l);
+    apply_rules_to_states(states.array, states.size, 1, d, pp, NULL, NULL, 1, &pool, &l);
     
-    assert_int_equal(list_size(l), 0);
+    assert_int_equal(l.size, 0);
     
-    list_done(l);
+    state_vector_done(&l);
+    state_pool_done(&pool);
     free_preprocessing_data(pp, 2);
     
     rule_done(r1);
     rule_done(cr);
     
     free(s1);
-    list_done(states);
+    state_vector_done(&states);
     trie_done(d);
 }
 
@@ -924,7 +1208,7 @@ static void apply_rules_to_states_closed_state_test(void **rubbish)
  * @param[in] suf Sufiks.
  * @return Wskaźnik na stan.
  */
-static struct state * mkstate(const struct trie_node *n, const struct trie_node *m, struct state *p, struct hint_rule *r, const wchar_t *suf)
+static struct state * mkstate(const struct trie_node *n, const struct trie_node *m, struct state *p, struct hint_rule *r, const symbol_t *suf)
 {
     struct state *s = malloc(sizeof(struct state));
     s->node = n;
@@ -935,33 +1219,116 @@ static struct state * mkstate(const struct trie_node *n, const struct trie_node
     return s;
 }
 
+/// Testuje dolne ograniczenie kosztu dokończenia podpowiedzi.
+static void state_hopeless_test(void **rubbish)
+{
+    struct trie_node *d = trie_init();
+    trie_insert(d, S(L"ab"));
+    trie_insert(d, S(L"abc"));
+    const symbol_t *word = S(L"abxyzw");
+    struct hint_rule *rules[3];
+    rules[0] = mkrule(L"0", L"", 1, RULE_NORMAL);
+    rules[1] = NULL;
+    rules[2] = NULL;
+    struct state s = { word, d, NULL, NULL, NULL, 0 };
+
+    // Trzeba usunąć co najmniej trzy litery
+    struct rule_vector *pp = preprocess(rules, word, 3);
+    struct hint_bound b;
+    assert_int_equal(hint_bound_init(&b, pp, word, 3), 0);
+    assert_false(state_hopeless(&s, 0, &b));
+    assert_true(state_hopeless(&s, 1, &b));
+    hint_bound_done(&b);
+    free_preprocessing_data(pp, 6);
+
+    // Po podziale słowa reszta może trafić do dłuższego słowa
+    rules[1] = mkrule(L"", L"", 1, RULE_SPLIT);
+    pp = preprocess(rules, word, 3);
+    assert_int_equal(hint_bound_init(&b, pp, word, 3), 0);
+    assert_false(state_hopeless(&s, 1, &b));
+    s.prev = d;
+    assert_true(state_hopeless(&s, 1, &b));
+    hint_bound_done(&b);
+    free_preprocessing_data(pp, 6);
+
+    // Żadna reguła nie wydłuża tekstu
+    s.prev = NULL;
+    s.suf = word + 5;
+    pp = preprocess(rules, word, 3);
+    assert_int_equal(hint_bound_init(&b, pp, word, 3), 0);
+    assert_true(state_hopeless(&s, 0, &b));
+    s.suf = word + 6;
+    s.node = trie_get_child(d, C(L'a'));
+    assert_true(state_hopeless(&s, 0, &b));
+    // Stan końcowy nie jest beznadziejny nawet bez budżetu
+    s.node = trie_get_child(s.node, C(L'b'));
+    assert_false(state_hopeless(&s, 3, &b));
+    hint_bound_done(&b);
+    free_preprocessing_data(pp, 6);
+
+    rule_done(rules[0]);
+    rule_done(rules[1]);
+    trie_done(d);
+}
+
+/// Testuje odcinanie poddrzew, w których nie da się dojść do podpowiedzi.
+static void branch_hopeless_test(void **rubbish)
+{
+    struct trie_node *d = trie_init();
+    trie_insert(d, S(L"kot"));
+    trie_insert(d, S(L"kos"));
+    trie_insert(d, S(L"lis"));
+    const symbol_t *word = S(L"xot");
+    struct hint_rule *rules[2];
+    rules[0] = mkrule(L"0", L"1", 1, RULE_NORMAL);
+    rules[1] = NULL;
+    struct rule_vector *pp = preprocess(rules, word, 1);
+    struct hint_bound b;
+    assert_int_equal(hint_bound_init(&b, pp, word, 1), 0);
+    const struct trie_node *k = trie_get_child(d, C(L'k'));
+    const struct trie_node *l = trie_get_child(d, C(L'l'));
+
+    // Po zamianie x na k sufiks "ot" da się przejść za darmo, a po zamianie na l nie
+    assert_false(branch_hopeless(k, 0, word + 1, NULL, 1, &b));
+    assert_true(branch_hopeless(l, 0, word + 1, NULL, 1, &b));
+    // Z budżetem na jeszcze jedną regułę żadne poddrzewo nie jest beznadziejne
+    assert_false(branch_hopeless(l, 0, word + 1, NULL, 0, &b));
+    // W poddrzewie nie ma węzłów tak głęboko
+    assert_true(branch_hopeless(k, 3, word + 1, NULL, 0, &b));
+    hint_bound_done(&b);
+    free_preprocessing_data(pp, 3);
+
+    rule_done(rules[0]);
+    trie_done(d);
+}
+
 /// Testuje usuwanie duplikatów stanów.
 static void unify_states_test(void **rubbish)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"c");
-    trie_insert(d, L"cd");
-    trie_insert(d, L"d");
-    const struct trie_node *d1 = trie_get_child(d, L'c');
-    const struct trie_node *d2 = trie_get_child(d1, L'd');
-    const struct trie_node *d3 = trie_get_child(d, L'd');
+    trie_insert(d, S(L"c"));
+    trie_insert(d, S(L"cd"));
+    trie_insert(d, S(L"d"));
+    const struct trie_node *d1 = trie_get_child(d, C(L'c'));
+    const struct trie_node *d2 = trie_get_child(d1, C(L'd'));
+    const struct trie_node *d3 = trie_get_child(d, C(L'd'));
     
     struct hint_rule *r[5];
-    r[0] = rule_make(L"ab", L"c", 1, RULE_END);
-    r[1] = rule_make(L"a", L"c", 1, RULE_NORMAL);
-    r[2] = rule_make(L"b", L"", 1, RULE_NORMAL);
-    r[3] = rule_make(L"", L"d", 1, RULE_NORMAL);
-    r[4] = rule_make(L"", L"", 1, RULE_SPLIT);
+    r[0] = mkrule(L"ab", L"c", 1, RULE_END);
+    r[1] = mkrule(L"a", L"c", 1, RULE_NORMAL);
+    r[2] = mkrule(L"b", L"", 1, RULE_NORMAL);
+    r[3] = mkrule(L"", L"d", 1, RULE_NORMAL);
+    r[4] = mkrule(L"", L"", 1, RULE_SPLIT);
     
-    struct list *l[5];
-    l[0] = list_init();
-    l[1] = list_init();
-    l[2] = list_init();
-    l[3] = list_init();
-    l[4] = list_init();
+    struct state_vector l[5];
+    state_vector_init(&l[0]);
+    state_vector_init(&l[1]);
+    state_vector_init(&l[2]);
+    state_vector_init(&l[3]);
+    state_vector_init(&l[4]);
     
-    const wchar_t *word = L"ab";
+    const symbol_t *word = S(L"ab");
     
     struct state *s00 = mkstate(d, NULL, NULL, NULL, word);
     struct state *s10 = mkstate(d1,NULL, s00, r[0], word + 2);
@@ -972,26 +1339,26 @@ static void unify_states_test(void **rubbish)
     struct state *s31 = mkstate(d, d1,   s21, r[2], word + 2);
     struct state *s32 = mkstate(d1,NULL, s11, r[4], word + 2);
     struct state *s40 = mkstate(d3,d1,   s31, r[3], word + 2);
-    list_add(l[0], s00);
-    list_add(l[1], s10); list_add(l[1], s11);
-    list_add(l[2], s20); list_add(l[2], s21);
-    list_add(l[3], s30); list_add(l[3], s31); list_add(l[3], s32);
-    list_add(l[4], s40);
+    state_vector_push(&l[0], s00);
+    state_vector_push(&l[1], s10); state_vector_push(&l[1], s11);
+    state_vector_push(&l[2], s20); state_vector_push(&l[2], s21);
+    state_vector_push(&l[3], s30); state_vector_push(&l[3], s31); state_vector_push(&l[3], s32);
+    state_vector_push(&l[4], s40);
     
     unify_states(l, 4);
-    assert_int_equal(list_size(l[0]), 1);
-    assert_int_equal(list_size(l[1]), 2);
-    assert_int_equal(list_size(l[2]), 2);
-    assert_int_equal(list_size(l[3]), 2);
-    assert_int_equal(list_size(l[4]), 1);
-    assert_true(list_get(l[0])[0] == s00);
-    assert_true(list_get(l[1])[0] == s10 || list_get(l[1])[1] == s10);
-    assert_true(list_get(l[1])[0] == s11 || list_get(l[1])[1] == s11);
-    assert_true(list_get(l[2])[0] == s20 || list_get(l[2])[1] == s20);
-    assert_true(list_get(l[2])[0] == s21 || list_get(l[2])[1] == s21);
-    assert_true(list_get(l[3])[0] == s30 || list_get(l[3])[1] == s30);
-    assert_true(list_get(l[3])[0] == s31 || list_get(l[3])[1] == s31);
-    assert_true(list_get(l[4])[0] == s40);
+    assert_int_equal(l[0].size, 1);
+    assert_int_equal(l[1].size, 2);
+    assert_int_equal(l[2].size, 2);
+    assert_int_equal(l[3].size, 2);
+    assert_int_equal(l[4].size, 1);
+    assert_true(l[0].array[0] == s00);
+    assert_true(l[1].array[0] == s10 || l[1].array[1] == s10);
+    assert_true(l[1].array[0] == s11 || l[1].array[1] == s11);
+    assert_true(l[2].array[0] == s20 || l[2].array[1] == s20);
+    assert_true(l[2].array[0] == s21 || l[2].array[1] == s21);
+    assert_true(l[3].array[0] == s30 || l[3].array[1] == s30);
+    assert_true(l[3].array[0] == s31 || l[3].array[1] == s31);
+    assert_true(l[4].array[0] == s40);
     
     free(s00);
     free(s10);
@@ -1000,14 +1367,14 @@ static void unify_states_test(void **rubbish)
     free(s21);
     free(s30);
     free(s31);
-    // State s32 was removed by unification
+    free(s32);
     free(s40);
     
-    list_done(l[0]);
-    list_done(l[1]);
-    list_done(l[2]);
-    list_done(l[3]);
-    list_done(l[4]);
+    state_vector_done(&l[0]);
+    state_vector_done(&l[1]);
+    state_vector_done(&l[2]);
+    state_vector_done(&l[3]);
+    state_vector_done(&l[4]);
     
     rule_done(r[0]);
     rule_done(r[1]);
@@ -1023,28 +1390,28 @@ static void get_text_test(void **rubbish)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"c");
-    trie_insert(d, L"cd");
-    trie_insert(d, L"d");
-    const struct trie_node *d1 = trie_get_child(d, L'c');
-    const struct trie_node *d2 = trie_get_child(d1, L'd');
-    const struct trie_node *d3 = trie_get_child(d, L'd');
+    trie_insert(d, S(L"c"));
+    trie_insert(d, S(L"cd"));
+    trie_insert(d, S(L"d"));
+    const struct trie_node *d1 = trie_get_child(d, C(L'c'));
+    const struct trie_node *d2 = trie_get_child(d1, C(L'd'));
+    const struct trie_node *d3 = trie_get_child(d, C(L'd'));
     
     struct hint_rule *r[5];
-    r[0] = rule_make(L"ab", L"c", 1, RULE_END);
-    r[1] = rule_make(L"a", L"c", 1, RULE_NORMAL);
-    r[2] = rule_make(L"b", L"", 1, RULE_NORMAL);
-    r[3] = rule_make(L"", L"d", 1, RULE_NORMAL);
-    r[4] = rule_make(L"", L"", 1, RULE_SPLIT);
+    r[0] = mkrule(L"ab", L"c", 1, RULE_END);
+    r[1] = mkrule(L"a", L"c", 1, RULE_NORMAL);
+    r[2] = mkrule(L"b", L"", 1, RULE_NORMAL);
+    r[3] = mkrule(L"", L"d", 1, RULE_NORMAL);
+    r[4] = mkrule(L"", L"", 1, RULE_SPLIT);
     
-    struct list *l[5];
-    l[0] = list_init();
-    l[1] = list_init();
-    l[2] = list_init();
-    l[3] = list_init();
-    l[4] = list_init();
+    struct state_vector l[5];
+    state_vector_init(&l[0]);
+    state_vector_init(&l[1]);
+    state_vector_init(&l[2]);
+    state_vector_init(&l[3]);
+    state_vector_init(&l[4]);
     
-    const wchar_t *word = L"ab";
+    const symbol_t *word = S(L"ab");
     
     struct state *s00 = mkstate(d, NULL, NULL, NULL, word);
     struct state *s10 = mkstate(d1,NULL, s00, r[0], word + 2);
@@ -1054,45 +1421,42 @@ static void get_text_test(void **rubbish)
     struct state *s30 = mkstate(d2,NULL, s20, r[3], word + 2);
     struct state *s31 = mkstate(d, d1,   s21, r[2], word + 2);
     struct state *s40 = mkstate(d3,d1,   s31, r[3], word + 2);
-    list_add(l[0], s00);
-    list_add(l[1], s10); list_add(l[1], s11);
-    list_add(l[2], s20); list_add(l[2], s21);
-    list_add(l[3], s30); list_add(l[3], s31);
-    list_add(l[4], s40);
+    state_vector_push(&l[0], s00);
+    state_vector_push(&l[1], s10); state_vector_push(&l[1], s11);
+    state_vector_push(&l[2], s20); state_vector_push(&l[2], s21);
+    state_vector_push(&l[3], s30); state_vector_push(&l[3], s31);
+    state_vector_push(&l[4], s40);
     
-    wchar_t *s;
+    struct word_list wl;
+    word_list_init(&wl);
+    const wchar_t *s;
     
-    s = get_text(s00);
+    s = get_text(s00, test_alphabet, &wl);
     assert_true(wcscmp(s, L"")==0);
-    free(s);
     
-    s = get_text(s10);
+    s = get_text(s10, test_alphabet, &wl);
     assert_true(wcscmp(s, L"c")==0);
-    free(s);
     
-    s = get_text(s11);
+    s = get_text(s11, test_alphabet, &wl);
     assert_true(wcscmp(s, L"c")==0);
-    free(s);
     
-    s = get_text(s20);
+    s = get_text(s20, test_alphabet, &wl);
     assert_true(wcscmp(s, L"c")==0);
-    free(s);
     
-    s = get_text(s21);
+    s = get_text(s21, test_alphabet, &wl);
     assert_true(wcscmp(s, L"c ")==0);
-    free(s);
     
-    s = get_text(s30);
+    s = get_text(s30, test_alphabet, &wl);
     assert_true(wcscmp(s, L"cd")==0);
-    free(s);
     
-    s = get_text(s31);
+    s = get_text(s31, test_alphabet, &wl);
     assert_true(wcscmp(s, L"c ")==0);
-    free(s);
     
-    s = get_text(s40);
+    s = get_text(s40, test_alphabet, &wl);
     assert_true(wcscmp(s, L"c d")==0);
-    free(s);
+    
+    assert_int_equal(word_list_size(&wl), 8);
+    word_list_done(&wl);
     
     free(s00);
     free(s10);
@@ -1101,14 +1465,13 @@ static void get_text_test(void **rubbish)
     free(s21);
     free(s30);
     free(s31);
-    // State s32 was removed by unification
     free(s40);
     
-    list_done(l[0]);
-    list_done(l[1]);
-    list_done(l[2]);
-    list_done(l[3]);
-    list_done(l[4]);
+    state_vector_done(&l[0]);
+    state_vector_done(&l[1]);
+    state_vector_done(&l[2]);
+    state_vector_done(&l[3]);
+    state_vector_done(&l[4]);
     
     rule_done(r[0]);
     rule_done(r[1]);
@@ -1132,22 +1495,24 @@ static void rule_generate_hints_1_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"c");
-    trie_insert(d, L"cd");
-    trie_insert(d, L"cdd");
-    trie_insert(d, L"dd");
+    trie_insert(d, S(L"c"));
+    trie_insert(d, S(L"cd"));
+    trie_insert(d, S(L"cdd"));
+    trie_insert(d, S(L"dd"));
     
     struct hint_rule *r[6];
-    r[0] = rule_make(L"ab", L"c", 1, RULE_END);
-    r[1] = rule_make(L"a", L"c", 1, RULE_NORMAL);
-    r[2] = rule_make(L"b", L"", 1, RULE_NORMAL);
-    r[3] = rule_make(L"", L"d", 1, RULE_NORMAL);
-    r[4] = rule_make(L"", L"", 1, RULE_SPLIT);
+    r[0] = mkrule(L"ab", L"c", 1, RULE_END);
+    r[1] = mkrule(L"a", L"c", 1, RULE_NORMAL);
+    r[2] = mkrule(L"b", L"", 1, RULE_NORMAL);
+    r[3] = mkrule(L"", L"d", 1, RULE_NORMAL);
+    r[4] = mkrule(L"", L"", 1, RULE_SPLIT);
     r[5] = NULL;
     
-    struct list *l = rule_generate_hints(r, 10, 100, d, L"ab");
-    assert_int_equal(list_size(l), 9);
-    wchar_t **ss = (wchar_t **)list_get(l);
+    struct word_list l;
+    word_list_init(&l);
+    rule_generate_hints(r, 10, 100, d, test_alphabet, S(L"ab"), &l, NULL, 1, NULL);
+    assert_int_equal(word_list_size(&l), 9);
+    const wchar_t * const *ss = word_list_get(&l);
     assert_true(wcscmp(ss[0], L"c")==0);
     assert_true(wcscmp(ss[1], L"cd")==0);
     assert_true(wcscmp(ss[2], L"cdd")==0);
@@ -1157,11 +1522,7 @@ static void rule_generate_hints_1_test(void **state)
     assert_true(wcscmp(ss[6], L"dd cd")==0);
     assert_true(wcscmp(ss[7], L"cdd dd")==0);
     assert_true(wcscmp(ss[8], L"dd cdd")==0);
-    for(int i = 0; i < list_size(l); i++)
-    {
-        free(ss[i]);
-    }
-    list_done(l);
+    word_list_done(&l);
     rule_done(r[0]);
     rule_done(r[1]);
     rule_done(r[2]);
@@ -1176,22 +1537,20 @@ static void rule_generate_hints_2_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"z");
-    trie_insert(d, L"mleka");
+    trie_insert(d, S(L"z"));
+    trie_insert(d, S(L"mleka"));
     
     struct hint_rule *r[2];
-    r[0] = rule_make(L"0", L"0", 1, RULE_SPLIT);
+    r[0] = mkrule(L"0", L"0", 1, RULE_SPLIT);
     r[1] = NULL;
     
-    struct list *l = rule_generate_hints(r, 10, 100, d, L"zmleka");
-    assert_int_equal(list_size(l), 1);
-    wchar_t **ss = (wchar_t **)list_get(l);
+    struct word_list l;
+    word_list_init(&l);
+    rule_generate_hints(r, 10, 100, d, test_alphabet, S(L"zmleka"), &l, NULL, 1, NULL);
+    assert_int_equal(word_list_size(&l), 1);
+    const wchar_t * const *ss = word_list_get(&l);
     assert_true(wcscmp(ss[0], L"z mleka")==0);
-    for(int i = 0; i < list_size(l); i++)
-    {
-        free(ss[i]);
-    }
-    list_done(l);
+    word_list_done(&l);
     rule_done(r[0]);
     
     trie_done(d);
@@ -1202,22 +1561,20 @@ static void rule_generate_hints_3_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"z");
-    trie_insert(d, L"mleka");
+    trie_insert(d, S(L"z"));
+    trie_insert(d, S(L"mleka"));
     
     struct hint_rule *r[2];
-    r[0] = rule_make(L"", L"", 1, RULE_SPLIT);
+    r[0] = mkrule(L"", L"", 1, RULE_SPLIT);
     r[1] = NULL;
     
-    struct list *l = rule_generate_hints(r, 10, 100, d, L"zmleka");
-    assert_int_equal(list_size(l), 1);
-    wchar_t **ss = (wchar_t **)list_get(l);
+    struct word_list l;
+    word_list_init(&l);
+    rule_generate_hints(r, 10, 100, d, test_alphabet, S(L"zmleka"), &l, NULL, 1, NULL);
+    assert_int_equal(word_list_size(&l), 1);
+    const wchar_t * const *ss = word_list_get(&l);
     assert_true(wcscmp(ss[0], L"z mleka")==0);
-    for(int i = 0; i < list_size(l); i++)
-    {
-        free(ss[i]);
-    }
-    list_done(l);
+    word_list_done(&l);
     rule_done(r[0]);
     
     trie_done(d);
@@ -1231,20 +1588,144 @@ static void rule_generate_hints_4_test(void **state)
 {
     setlocale(LC_ALL, "pl_PL.UTF8");
     struct trie_node *d = trie_init();
-    trie_insert(d, L"bba");
+    trie_insert(d, S(L"bba"));
     
     struct hint_rule *r[2];
-    r[0] = rule_make(L"", L"b", 1, RULE_BEGIN);
+    r[0] = mkrule(L"", L"b", 1, RULE_BEGIN);
     r[1] = NULL;
     
-    struct list *l = rule_generate_hints(r, 10, 100, d, L"a");
-    assert_int_equal(list_size(l), 0);
-    list_done(l);
+    struct word_list l;
+    word_list_init(&l);
+    rule_generate_hints(r, 10, 100, d, test_alphabet, S(L"a"), &l, NULL, 1, NULL);
+    assert_int_equal(word_list_size(&l), 0);
+    word_list_done(&l);
     rule_done(r[0]);
     
     trie_done(d);
 }
 
+/// Testuje rozpoznawanie reguł będących operacjami edycyjnymi.
+static void edit_costs_from_rules_test(void **state)
+{
+    struct hint_rule *r[7];
+    r[0] = mkrule(L"0", L"", 2, RULE_NORMAL);
+    r[1] = mkrule(L"", L"3", 1, RULE_NORMAL);
+    r[2] = mkrule(L"1", L"0", 3, RULE_NORMAL);
+    r[3] = mkrule(L"0", L"1", 2, RULE_NORMAL);
+    r[4] = mkrule(L"ab", L"", 9, RULE_NORMAL);
+    r[5] = NULL;
+    r[6] = NULL;
+    struct edit_costs ec;
+    assert_true(edit_costs_from_rules(r, 3, &ec));
+    assert_int_equal(ec.del, 2);
+    assert_int_equal(ec.ins, 1);
+    assert_int_equal(ec.sub, 2);
+    assert_int_equal(ec.swap, 4);
+    r[5] = mkrule(L"12", L"21", 1, RULE_NORMAL);
+    assert_true(edit_costs_from_rules(r, 3, &ec));
+    assert_int_equal(ec.swap, 1);
+    rule_done(r[4]);
+    r[4] = mkrule(L"0", L"", 1, RULE_END);
+    assert_false(edit_costs_from_rules(r, 3, &ec));
+    rule_done(r[4]);
+    r[4] = mkrule(L"0", L"0", 1, RULE_NORMAL);
+    assert_false(edit_costs_from_rules(r, 3, &ec));
+    rule_done(r[4]);
+    r[4] = mkrule(L"a", L"", 1, RULE_NORMAL);
+    assert_false(edit_costs_from_rules(r, 3, &ec));
+    for(int i = 0; i < 6; i++) rule_done(r[i]);
+}
+
+/**
+ * Testuje generowanie podpowiedzi dla reguł będących operacjami edycyjnymi.
+ * Reguła `0 -> 0` niczego nie zmienia, ale wyłącza przeszukiwanie
+ * z odległością edycyjną, więc obie listy muszą być takie same.
+ */
+static void rule_generate_hints_edit_test(void **state)
+{
+    setlocale(LC_ALL, "pl_PL.UTF8");
+    struct trie_node *d = trie_init();
+    const wchar_t *words[] = { L"kot", L"kto", L"kat", L"kita", L"ot", L"okno", L"kotek", L"k" };
+    for(size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++)
+        trie_insert(d, S(words[i]));
+    trie_set_frequency(d, S(L"kat"), 5);
+    trie_set_frequency(d, S(L"kita"), 5);
+
+    struct hint_rule *r[6];
+    r[0] = mkrule(L"0", L"", 1, RULE_NORMAL);
+    r[1] = mkrule(L"", L"0", 2, RULE_NORMAL);
+    r[2] = mkrule(L"0", L"1", 1, RULE_NORMAL);
+    r[3] = mkrule(L"01", L"10", 1, RULE_NORMAL);
+    r[4] = NULL;
+    r[5] = NULL;
+
+    struct word_list fast, slow;
+    int fast_costs[100], slow_costs[100];
+    word_list_init(&fast);
+    word_list_init(&slow);
+    rule_generate_hints(r, 3, 100, d, test_alphabet, S(L"kto"), &fast, fast_costs, 1, NULL);
+    r[4] = mkrule(L"0", L"0", 1, RULE_NORMAL);
+    rule_generate_hints(r, 3, 100, d, test_alphabet, S(L"kto"), &slow, slow_costs, 1, NULL);
+    assert_int_equal(word_list_size(&fast), 7);
+    assert_int_equal(word_list_size(&fast), word_list_size(&slow));
+    for(size_t i = 0; i < word_list_size(&fast); i++)
+    {
+        assert_true(wcscmp(word_list_get(&fast)[i], word_list_get(&slow)[i]) == 0);
+        assert_int_equal(fast_costs[i], slow_costs[i]);
+    }
+    assert_true(wcscmp(word_list_get(&fast)[0], L"kto") == 0);
+    assert_true(wcscmp(word_list_get(&fast)[1], L"kot") == 0);
+    assert_int_equal(fast_costs[1], 1);
+    word_list_done(&fast);
+    word_list_done(&slow);
+    for(int i = 0; i < 5; i++) rule_done(r[i]);
+
+    trie_done(d);
+}
+
+/**
+ * Testuje generowanie podpowiedzi w kilku wątkach.
+ * W testach warstwy są dzielone na części nawet wtedy, gdy są małe,
+ * więc wynik musi być taki sam jak w jednym wątku.
+ */
+static void rule_generate_hints_threads_test(void **state)
+{
+    setlocale(LC_ALL, "pl_PL.UTF8");
+    struct trie_node *d = trie_init();
+    const wchar_t *words[] = { L"kot", L"kto", L"kat", L"kita", L"ot", L"okno", L"kotek", L"k", L"ala", L"ma" };
+    for(size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++)
+        trie_insert(d, S(words[i]));
+    trie_set_frequency(d, S(L"kat"), 5);
+    trie_set_frequency(d, S(L"ot"), 2);
+
+    struct hint_rule *r[6];
+    r[0] = mkrule(L"0", L"", 1, RULE_NORMAL);
+    r[1] = mkrule(L"", L"0", 1, RULE_NORMAL);
+    r[2] = mkrule(L"0", L"1", 1, RULE_NORMAL);
+    r[3] = mkrule(L"", L"", 1, RULE_SPLIT);
+    r[4] = mkrule(L"k", L"ko", 1, RULE_BEGIN);
+    r[5] = NULL;
+
+    struct word_list serial, parallel;
+    int serial_costs[100], parallel_costs[100];
+    word_list_init(&serial);
+    word_list_init(&parallel);
+    rule_generate_hints(r, 3, 100, d, test_alphabet, S(L"ktoala"), &serial, serial_costs, 1, NULL);
+    rule_generate_hints(r, 3, 100, d, test_alphabet, S(L"ktoala"), &parallel, parallel_costs, 4, NULL);
+    assert_true(word_list_size(&serial) > 0);
+    assert_int_equal(word_list_size(&serial), word_list_size(&parallel));
+    for(size_t i = 0; i < word_list_size(&serial); i++)
+    {
+        assert_true(wcscmp(word_list_get(&serial)[i], word_list_get(&parallel)[i]) == 0);
+        assert_int_equal(serial_costs[i], parallel_costs[i]);
+    }
+    word_list_done(&serial);
+    word_list_done(&parallel);
+    for(int i = 0; i < 5; i++) rule_done(r[i]);
+
+    trie_done(d);
+}
+
 /// Uruchamia testy.
 int main(void) {
     const struct CMUnitTest tests[] = {
@@ -1256,7 +1737,10 @@ int main(void) {
         cmocka_unit_test(translate_letter_jocker_2_test),
         cmocka_unit_test(translate_letter_junk_test),
         cmocka_unit_test(translate_letter_unset_test),
+        cmocka_unit_test(rule_compile_test),
         cmocka_unit_test(rule_make_done_test),
+        cmocka_unit_test(rule_canonicalize_test),
+        cmocka_unit_test(rule_normalize_test),
         cmocka_unit_test(preprocess_suffix_no_rule_test),
         cmocka_unit_test(preprocess_suffix_one_unmatching_rule_test),
         cmocka_unit_test(preprocess_suffix_one_matching_rule_test),
@@ -1266,6 +1750,8 @@ int main(void) {
         cmocka_unit_test(preprocess_suffix_begin_flag_2_test),
         cmocka_unit_test(preprocess_suffix_end_flag_1_test),
         cmocka_unit_test(preprocess_suffix_end_flag_2_test),
+        cmocka_unit_test(rule_matches_test),
+        cmocka_unit_test(preprocess_test),
         cmocka_unit_test(extend_state_1_test),
         cmocka_unit_test(extend_state_2_test),
         cmocka_unit_test(explore_trie_noway_test),
@@ -1288,8 +1774,13 @@ int main(void) {
         cmocka_unit_test(rule_generate_hints_2_test),
         cmocka_unit_test(rule_generate_hints_3_test),
         cmocka_unit_test(rule_generate_hints_4_test),
+        cmocka_unit_test(edit_costs_from_rules_test),
+        cmocka_unit_test(rule_generate_hints_edit_test),
+        cmocka_unit_test(rule_generate_hints_threads_test),
+        cmocka_unit_test(state_hopeless_test),
+        cmocka_unit_test(branch_hopeless_test),
     };
 
-    return cmocka_run_group_tests(tests, NULL, NULL);
+    return cmocka_run_group_tests(tests, alphabet_setup, alphabet_teardown);
 }
 
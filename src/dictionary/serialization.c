@@ -14,6 +14,8 @@
 #include <stdio.h>
 #include <wchar.h>
 
+#include "../testable.h"
+
 int int32_serialize(int value, FILE *f)
 {
     if(fputwc(((value>>28)&0xF)+L'a', f)<0) return -1;
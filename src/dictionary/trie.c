@@ -12,28 +12,168 @@
 
 #include "list.h"
 #include "rule.h"
+#include "serialization.h"
+#include "vector.h"
 #include "word_list.h"
 
 #include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
 
-#include "../testable.h"
+/**
+ * Największa pojemność tablicy dzieci.
+ * Dzieci mają różne symbole liter, więc jest ich mniej niż ALPHABET_CAPACITY.
+ */
+#define TRIE_MAX_CHILDREN UCHAR_MAX
+
+/**
+ * Największa liczba dodatkowych właścicieli węzła.
+ * Węzeł, którego nie można już współdzielić, jest kopiowany.
+ */
+#define TRIE_MAX_SHARED 127
+
+/**
+ * Największa liczba wątków przy zagęszczaniu drzewa (zob. trie_compact()).
+ */
+#define TRIE_COMPACT_MAX_THREADS 64
 
 /**
  * Reprezentuje węzeł drzewa TRIE.
+ * 
+ * Pola są ułożone tak, żeby węzeł zajmował 24 bajty.
+ * 
+ * Podsumowanie poddrzewa (best, min_depth, max_depth, letters) jest
+ * przeliczane na ścieżce przy każdej zmianie i przy wczytywaniu drzewa.
+ * 
+ * Węzły mogą być współdzielone przez wiele drzew (zob. trie_share()).
+ * Przed zmianą węzła trzeba go skopiować, jeśli ma innych właścicieli,
+ * więc operacje modyfikujące kopiują tylko ścieżkę do zmienianego słowa.
  */
 struct trie_node
 {
     struct trie_node **chd;     ///< Lista dzieci
-    wchar_t val;                ///< Wartość węzła
-    unsigned int cap;           ///< Pojemność tablicy dzieci
-    unsigned int cnt;           ///< Ilość dzieci
-    unsigned int leaf;          ///< Czy tutaj kończy się słowo
+    unsigned short freq;        ///< Częstość słowa kończącego się tutaj
+    unsigned short best;        ///< Największa częstość słowa w poddrzewie
+    unsigned char min_depth;    ///< Najmniejsza liczba liter poniżej węzła do końca słowa (UCHAR_MAX jeśli brak słów)
+    unsigned char max_depth;    ///< Największa liczba liter poniżej węzła do końca słowa (nasycona w UCHAR_MAX)
+    uint32_t letters;           ///< Litery poniżej węzła (zob. trie_letter_bit())
+    unsigned char cap;          ///< Pojemność tablicy dzieci
+    unsigned char cnt;          ///< Ilość dzieci
+    symbol_t val;               ///< Wartość węzła (symbol alfabetu)
+    unsigned char leaf : 1;     ///< Czy tutaj kończy się słowo
+    unsigned char shared : 7;   ///< Liczba dodatkowych właścicieli węzła
+};
+
+/**
+ * Kandydat w wyszukiwaniu uzupełnień: poddrzewo albo słowo.
+ */
+struct complete_item
+{
+    const struct trie_node *node;   ///< Węzeł.
+    size_t parent;                  ///< Kandydat-rodzic (węzeł) lub SIZE_MAX dla węzła prefiksu.
+    unsigned int weight;            ///< Częstość słowa lub górne ograniczenie częstości w poddrzewie.
+    unsigned int depth;             ///< Głębokość węzła względem prefiksu.
+    bool word;                      ///< Czy kandydat jest słowem (a nie poddrzewem).
 };
 
+/// Wektor kandydatów w wyszukiwaniu uzupełnień.
+VECTOR_DEFINE(complete_item_vector, struct complete_item)
+/// Wektor indeksów kandydatów (kopiec lub lista znalezionych słów).
+VECTOR_DEFINE(index_vector, size_t)
+/// Wektor symboli.
+VECTOR_DEFINE(symbol_vector, symbol_t)
+
+/**
+ * Porządek alfabetyczny na w-stringach (według locale).
+ * 
+ * @param[in] a Wskaźnik na pierwszy tekst.
+ * @param[in] b Wskaźnik na drugi tekst.
+ * @return True jeśli pierwszy tekst jest wcześniej.
+ */
+static inline bool completion_less(const wchar_t * const *a, const wchar_t * const *b)
+{
+    return wcscoll(*a, *b) < 0;
+}
+
+/// Wektor wskaźników na uzupełnienia.
+VECTOR_DEFINE(completion_vector, const wchar_t *)
+VECTOR_DEFINE_SORT(completion_vector, const wchar_t *, completion_less)
+
+/**
+ * Pary dzieci dwóch węzłów o tym samym symbolu (w alfabecie wyniku)
+ * przeglądane po kolei przy łączeniu drzew.
+ */
+struct combine_pairs
+{
+    struct trie_node **a;       ///< Dzieci węzła pierwszego drzewa.
+    int acnt;                   ///< Liczba dzieci w a.
+    int i;                      ///< Następne dziecko z a.
+    struct trie_node **b;       ///< Dzieci węzła drugiego drzewa posortowane w alfabecie wyniku.
+    int bcnt;                   ///< Liczba dzieci w b.
+    int j;                      ///< Następne dziecko z b.
+    const symbol_t *map;        ///< Symbole drugiego drzewa w alfabecie wyniku lub NULL.
+    bool own;                   ///< Czy tablica b jest osobną kopią.
+};
+
+/**
+ * Zapis łączonego drzewa do strumienia.
+ * Węzły są zapisywane dopiero, gdy wiadomo, że w ich poddrzewie jest słowo.
+ */
+struct combine_writer
+{
+    FILE *file;                 ///< Strumień.
+    struct symbol_vector path;  ///< Symbole na ścieżce od korzenia.
+    size_t written;             ///< Liczba zapisanych już symboli ścieżki.
+};
+
+/**
+ * Węzeł na stosie przeglądania słów wraz z dziećmi w kolejności liter.
+ */
+struct iter_frame
+{
+    struct trie_node * const *chd;  ///< Dzieci węzła w kolejności kodów liter.
+    int cnt;                        ///< Liczba dzieci.
+    int next;                       ///< Następne dziecko do odwiedzenia.
+    const struct trie_node *node;   ///< Węzeł.
+};
+
+/// Stos przeglądania słów.
+VECTOR_DEFINE(iter_frame_vector, struct iter_frame)
+/// Tablice na posortowane dzieci, po jednej na każdy poziom drzewa.
+VECTOR_DEFINE(iter_scratch_vector, struct trie_node **)
+/// Wektor liter.
+VECTOR_DEFINE(letter_vector, wchar_t)
+
+/**
+ * Przeglądanie słów drzewa w kolejności kodów liter.
+ * Pamięć jest przydzielana tylko wtedy, gdy stos rośnie ponad
+ * największą dotąd głębokość, a nie dla każdego słowa.
+ */
+struct trie_iter
+{
+    const struct alphabet *alphabet;    ///< Alfabet drzewa.
+    bool ordered;                       ///< Czy kolejność symboli liter to kolejność ich kodów.
+    bool pending;                       ///< Czy węzeł na szczycie stosu jest słowem do zwrócenia.
+    bool finished;                      ///< Czy przeglądanie się skończyło.
+    struct iter_frame_vector stack;     ///< Stos węzłów od korzenia.
+    struct iter_scratch_vector scratch; ///< Tablice na posortowane dzieci.
+    struct letter_vector word;          ///< Bieżące słowo (litery węzłów na stosie poza korzeniem).
+    wchar_t *to;                        ///< Koniec zakresu (bez niego) lub NULL.
+};
+
+#include "../testable.h"
+
+#ifdef UNIT_TESTING
+// Przydzielanie pamięci w testach nie jest bezpieczne dla wątków, więc
+// testy zagęszczają wszystkie poddrzewa w jednym wątku.
+#define TRIE_COMPACT_INLINE
+#endif
+
 
 /** @name Funkcje pomocnicze
  * @{
@@ -42,6 +182,10 @@ struct trie_node
 /**
  * Sprawdza niektóre niezmienniki dla węzła.
  * 
+ * Sprawdzenie jest wywoływane przy każdym zejściu w drzewie, więc poza
+ * testami obejmuje tylko pola samego węzła. W testach sprawdza też, czy
+ * dzieci mają ściśle rosnące wartości (więc są różne).
+ * 
  * @param[in] node Węzeł do przetestowania.
  * 
  * @return 1 jeśli węzeł jest poprawny, 0 otherwise.
@@ -52,13 +196,12 @@ static int trie_node_integrity(const struct trie_node *node)
     if(node->cnt > node->cap) goto fail;
     if(node->cap > 0 && node->chd == NULL) goto fail;
     if(node->cap == 0 && node->chd != NULL) goto fail;
-    for(int i = 0; i < node->cnt; i++)
+#ifdef UNIT_TESTING
+    for(int i = 1; i < node->cnt; i++)
     {
-        for(int j = 0; j < node->cnt; j++)
-        {
-            if(i != j && node->chd[i] == node->chd[j]) goto fail;
-        }
+        if(node->chd[i - 1]->val >= node->chd[i]->val) goto fail;
     }
+#endif
     return 1;
 fail:
     return 0;
@@ -75,7 +218,7 @@ fail:
  * @return -1 jeśli trzeba utworzyć listę dzieci lub indeks, na którym powinien
  * być dany element (trzeba sprawdzić czy rzeczywiście tam jest)
  */
-static int trie_get_child_index(const struct trie_node *node, wchar_t value, int begin, int end)
+static int trie_get_child_index(const struct trie_node *node, symbol_t value, int begin, int end)
 {
     assert(trie_node_integrity(node));
     assert(0 <= begin && begin <= end && end <= node->cnt);
@@ -84,7 +227,7 @@ static int trie_get_child_index(const struct trie_node *node, wchar_t value, int
     while(end - begin > 2)
     {
         int middle = (begin + end)/2;
-        wchar_t midval = node->chd[middle]->val;
+        symbol_t midval = node->chd[middle]->val;
         if(midval == value)
             return middle;
         else if(midval > value)
@@ -99,15 +242,17 @@ static int trie_get_child_index(const struct trie_node *node, wchar_t value, int
     return end;
 }
 
+#ifdef UNIT_TESTING
 /**
  * Zwraca dziecko węzła o podanej wartości.
+ * Używane tylko w testach; reszta modułu korzysta z trie_get_child().
  * 
  * @param[in] node Węzeł, którego dzieci przeszukać.
  * @param[in] value Wartość, którą znaleźć.
  * 
  * @return Wskaźnik na znaleziony węzeł lub NULL jeśli nie znaleziono.
  */
-static struct trie_node * trie_get_child_priv(struct trie_node *node, wchar_t value)
+static struct trie_node * trie_get_child_priv(struct trie_node *node, symbol_t value)
 {
     assert(trie_node_integrity(node));
     int r = trie_get_child_index(node, value, 0, node->cnt);
@@ -116,6 +261,222 @@ static struct trie_node * trie_get_child_priv(struct trie_node *node, wchar_t va
     if(node->chd[r]->val != value) return NULL;
     return node->chd[r];
 }
+#endif
+
+/**
+ * Kopiuje węzeł; dzieci kopii są współdzielone z oryginałem.
+ * 
+ * @param[in] node Węzeł do skopiowania.
+ * 
+ * @return Kopia węzła bez innych właścicieli.
+ */
+static struct trie_node * trie_copy_node(const struct trie_node *node)
+{
+    struct trie_node *copy = malloc(sizeof(struct trie_node));
+    *copy = *node;
+    copy->shared = 0;
+    if(node->cap > 0)
+    {
+        copy->chd = malloc(node->cap * sizeof(struct trie_node *));
+        for(int i = 0; i < node->cnt; i++)
+            copy->chd[i] = trie_share(node->chd[i]);
+    }
+    return copy;
+}
+
+/**
+ * Oddaje węzeł: zmniejsza liczbę jego właścicieli, a gdy nie ma innych,
+ * usuwa go wraz z poddrzewami.
+ * 
+ * @param[in,out] node Węzeł do oddania.
+ */
+static void trie_release(struct trie_node *node)
+{
+    if(node->shared > 0)
+    {
+        node->shared--;
+        return;
+    }
+    for(int i = 0; i < node->cnt; i++)
+        trie_release(node->chd[i]);
+    free(node->chd);
+    free(node);
+}
+
+/**
+ * Zwalnia węzły drzewa, które nie są współdzielone.
+ * Współdzielone poddrzewa zostają bez zmiany liczby właścicieli, bo
+ * przechodzą do zagęszczonego drzewa (zob. trie_compact()).
+ * 
+ * @param[in,out] node Węzeł.
+ */
+static void trie_compact_free(struct trie_node *node)
+{
+    if(node->shared > 0) return;
+    for(int i = 0; i < node->cnt; i++)
+        trie_compact_free(node->chd[i]);
+    free(node->chd);
+    free(node);
+}
+
+/**
+ * Kopiuje poddrzewo do nowych węzłów z tablicami dzieci dokładnie
+ * na miarę, w kolejności przechodzenia w głąb (węzeł, jego tablica
+ * dzieci, potem kolejne poddrzewa), żeby węzły odwiedzane razem leżały
+ * w pamięci blisko siebie. Współdzielone poddrzewa nie są kopiowane.
+ * 
+ * @param[in] node Węzeł.
+ * @return Kopia węzła lub NULL, jeśli brakło pamięci.
+ */
+static struct trie_node * trie_compact_node(struct trie_node *node)
+{
+    if(node->shared > 0) return node;
+    struct trie_node *copy = malloc(sizeof(struct trie_node));
+    if(copy == NULL) return NULL;
+    *copy = *node;
+    copy->cap = node->cnt;
+    copy->chd = NULL;
+    if(node->cnt == 0) return copy;
+    copy->chd = malloc(node->cnt * sizeof(struct trie_node *));
+    if(copy->chd == NULL)
+    {
+        free(copy);
+        return NULL;
+    }
+    for(int i = 0; i < node->cnt; i++)
+    {
+        copy->chd[i] = trie_compact_node(node->chd[i]);
+        if(copy->chd[i] == NULL)
+        {
+            copy->cnt = i;
+            trie_compact_free(copy);
+            return NULL;
+        }
+    }
+    return copy;
+}
+
+/**
+ * Zagęszczanie poddrzew korzenia w kilku wątkach.
+ */
+struct compact_work
+{
+    struct trie_node **chd;     ///< Dzieci starego korzenia.
+    struct trie_node **out;     ///< Tablica na kopie dzieci.
+    int cnt;                    ///< Liczba dzieci.
+    int next;                   ///< Następne dziecko do skopiowania.
+};
+
+/**
+ * Kopiuje kolejne wolne poddrzewa korzenia (zob. trie_compact_node()).
+ * 
+ * @param[in,out] arg Zagęszczanie (struct compact_work).
+ * @return NULL.
+ */
+static void * compact_work_run(void *arg)
+{
+    struct compact_work *w = arg;
+    int i;
+    while((i = __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED)) < w->cnt)
+        w->out[i] = trie_compact_node(w->chd[i]);
+    return NULL;
+}
+
+/**
+ * Liczy miejsca w tablicach dzieci poddrzewa (zob. trie_child_slots()).
+ * 
+ * @param[in] node Węzeł.
+ * @param[in,out] used Licznik zajętych miejsc.
+ * @return Liczba wszystkich miejsc w poddrzewie.
+ */
+static size_t trie_node_slots(const struct trie_node *node, size_t *used)
+{
+    size_t slots = node->cap;
+    *used += node->cnt;
+    for(int i = 0; i < node->cnt; i++)
+        slots += trie_node_slots(node->chd[i], used);
+    return slots;
+}
+
+/**
+ * Dolicza sam węzeł (bez dzieci) do statystyk pamięci.
+ * 
+ * @param[in] node Węzeł.
+ * @param[in] depth Głębokość węzła.
+ * @param[in] shared Czy węzeł jest współdzielony (także przez przodka).
+ * @param[in,out] stats Statystyki.
+ */
+static void trie_count_node(const struct trie_node *node, size_t depth, bool shared, struct dictionary_memory_stats *stats)
+{
+    stats->nodes++;
+    stats->leaves += node->leaf;
+    if(shared) stats->shared_nodes++;
+    stats->node_bytes += sizeof(*node);
+    // Tablica dzieci rośnie dwukrotnie, więc część miejsc jest wolna
+    stats->child_bytes += node->cap * sizeof(struct trie_node *);
+    stats->child_wasted_bytes += (node->cap - node->cnt) * sizeof(struct trie_node *);
+    if(depth > stats->max_depth) stats->max_depth = depth;
+    if(node->cnt > stats->max_fanout) stats->max_fanout = node->cnt;
+    stats->depths[depth < DICTIONARY_MEMORY_DEPTHS ? depth : DICTIONARY_MEMORY_DEPTHS - 1]++;
+    stats->fanouts[node->cnt < DICTIONARY_MEMORY_FANOUTS ? node->cnt : DICTIONARY_MEMORY_FANOUTS - 1]++;
+}
+
+/**
+ * Dolicza poddrzewo węzła do statystyk pamięci (zob. trie_memory_stats()).
+ * 
+ * @param[in] node Węzeł.
+ * @param[in] depth Głębokość węzła.
+ * @param[in] shared Czy któryś z przodków węzła jest współdzielony.
+ * @param[in,out] stats Statystyki.
+ * @return Liczba słów w poddrzewie.
+ */
+static size_t trie_node_memory(const struct trie_node *node, size_t depth, bool shared, struct dictionary_memory_stats *stats)
+{
+    shared = shared || node->shared > 0;
+    trie_count_node(node, depth, shared, stats);
+    size_t words = node->leaf;
+    for(int i = 0; i < node->cnt; i++)
+        words += trie_node_memory(node->chd[i], depth + 1, shared, stats);
+    return words;
+}
+
+/**
+ * Zwraca dziecko o podanym indeksie, które można zmieniać.
+ * Współdzielone dziecko jest zastępowane swoją kopią.
+ * 
+ * @param[in,out] node Węzeł bez innych właścicieli.
+ * @param[in] i Indeks dziecka.
+ * 
+ * @return Dziecko bez innych właścicieli.
+ */
+static struct trie_node * trie_own_child(struct trie_node *node, int i)
+{
+    struct trie_node *child = node->chd[i];
+    if(child->shared > 0)
+    {
+        node->chd[i] = trie_copy_node(child);
+        child->shared--;
+    }
+    return node->chd[i];
+}
+
+/**
+ * Zwraca dziecko węzła o podanej wartości, które można zmieniać.
+ * 
+ * @param[in,out] node Węzeł bez innych właścicieli.
+ * @param[in] value Wartość, którą znaleźć.
+ * 
+ * @return Wskaźnik na znaleziony węzeł lub NULL jeśli nie znaleziono.
+ */
+static struct trie_node * trie_get_child_own(struct trie_node *node, symbol_t value)
+{
+    assert(trie_node_integrity(node));
+    int r = trie_get_child_index(node, value, 0, node->cnt);
+    if(r == -1) return NULL;
+    if(r == node->cnt) return NULL;
+    if(node->chd[r]->val != value) return NULL;
+    return trie_own_child(node, r);
+}
 
 /**
  * Zwraca dziecko węzła o podanej wartości lub tworzy takowe dziecko.
@@ -125,7 +486,7 @@ static struct trie_node * trie_get_child_priv(struct trie_node *node, wchar_t va
  * 
  * @return Wskaźnik na znaleziony lub utworzony węzeł.
  */
-static struct trie_node * trie_get_child_or_add_empty(struct trie_node *node, wchar_t value)
+static struct trie_node * trie_get_child_or_add_empty(struct trie_node *node, symbol_t value)
 {
     int r = trie_get_child_index(node, value, 0, node->cnt);
     if(r == -1)
@@ -140,7 +501,7 @@ static struct trie_node * trie_get_child_or_add_empty(struct trie_node *node, wc
     }
     else if(r < node->cnt && node->chd[r]->val == value)
     {
-        return node->chd[r];
+        return trie_own_child(node, r);
     }
     else
     {
@@ -153,7 +514,8 @@ static struct trie_node * trie_get_child_or_add_empty(struct trie_node *node, wc
         }
         else
         {
-            node->cap *= 2;
+            assert(node->cap < TRIE_MAX_CHILDREN);
+            node->cap = node->cap > TRIE_MAX_CHILDREN / 2 ? TRIE_MAX_CHILDREN : 2 * node->cap;
             struct trie_node ** table = malloc((node->cap) * sizeof(struct trie_node *));
             struct trie_node ** source = node->chd;
             for(int i = 0; i < r; i++)
@@ -175,6 +537,80 @@ static struct trie_node * trie_get_child_or_add_empty(struct trie_node *node, wc
 }
 
 
+/**
+ * Przelicza podsumowanie poddrzewa węzła (największą częstość słowa,
+ * długości słów i litery poniżej węzła) na podstawie dzieci.
+ * 
+ * @param[in,out] node Węzeł.
+ */
+static void trie_update_summary(struct trie_node *node)
+{
+    unsigned short best = node->leaf ? node->freq : 0;
+    int min_depth = node->leaf ? 0 : UCHAR_MAX;
+    int max_depth = 0;
+    uint32_t letters = 0;
+    for(int i = 0; i < node->cnt; i++)
+    {
+        const struct trie_node *child = node->chd[i];
+        if(child->best > best) best = child->best;
+        if(child->min_depth + 1 < min_depth) min_depth = child->min_depth + 1;
+        if(child->max_depth + 1 > max_depth) max_depth = child->max_depth + 1;
+        letters |= trie_letter_bit(child->val) | child->letters;
+    }
+    node->best = best;
+    node->min_depth = min_depth;
+    node->max_depth = max_depth < UCHAR_MAX ? max_depth : UCHAR_MAX;
+    node->letters = letters;
+}
+
+/**
+ * Wstawia sufiks słowa do poddrzewa i poszerza podsumowania na ścieżce.
+ * Nowe słowo nie zmienia największej częstości, bo ma częstość 0.
+ * 
+ * @param[in,out] node Poddrzewo.
+ * @param[in] word Sufiks słowa.
+ * @param[in] left Długość sufiksu.
+ * @return Litery sufiksu (zob. trie_letter_bit()).
+ */
+static uint32_t trie_insert_helper(struct trie_node *node, const symbol_t *word, size_t left)
+{
+    if(left < node->min_depth) node->min_depth = left;
+    if(left > node->max_depth) node->max_depth = left < UCHAR_MAX ? left : UCHAR_MAX;
+    if(left == 0)
+    {
+        node->leaf = 1;
+        return 0;
+    }
+    struct trie_node *child = trie_get_child_or_add_empty(node, word[0]);
+    uint32_t letters = trie_letter_bit(word[0]) | trie_insert_helper(child, word + 1, left - 1);
+    node->letters |= letters;
+    return letters;
+}
+
+/**
+ * Ustawia częstość słowa w poddrzewie i aktualizuje węzły na ścieżce.
+ * 
+ * @param[in,out] node Poddrzewo.
+ * @param[in] word Sufiks słowa.
+ * @param[in] freq Częstość (nie większa niż TRIE_MAX_FREQUENCY).
+ * @return 1 jeśli ustawiono częstość, 0 jeśli słowa nie ma w drzewie.
+ */
+static int trie_set_frequency_helper(struct trie_node *node, const symbol_t *word, unsigned short freq)
+{
+    if(*word == 0)
+    {
+        if(!node->leaf) return 0;
+        node->freq = freq;
+    }
+    else
+    {
+        struct trie_node *child = trie_get_child_own(node, *word);
+        if(child == NULL || trie_set_frequency_helper(child, word + 1, freq) == 0) return 0;
+    }
+    trie_update_summary(node);
+    return 1;
+}
+
 /**
  * Gdy można usuwa node i aktualizuje parenta.
  * 
@@ -237,7 +673,7 @@ static void trie_cleanup(struct trie_node *node, struct trie_node *parent)
  * 
  * @return Zwraca 1 jeśli podsłowo zostało usunięte, 0 jeśli nie istniało.
  */
-static int trie_delete_helper(struct trie_node *node, struct trie_node *parent, const wchar_t *word)
+static int trie_delete_helper(struct trie_node *node, struct trie_node *parent, const symbol_t *word)
 {
     assert(trie_node_integrity(node));
     if(word[0] == 0)
@@ -245,6 +681,8 @@ static int trie_delete_helper(struct trie_node *node, struct trie_node *parent,
         if(node->leaf)
         {
             node->leaf = 0;
+            node->freq = 0;
+            trie_update_summary(node);
             trie_cleanup(node, parent);
             assert(trie_node_integrity(parent));
             return 1;
@@ -254,7 +692,7 @@ static int trie_delete_helper(struct trie_node *node, struct trie_node *parent,
             return 0;
         }
     }
-    struct trie_node *child = trie_get_child_priv(node, word[0]);
+    struct trie_node *child = trie_get_child_own(node, word[0]);
     if(child == NULL)
     {
         return 0;
@@ -262,6 +700,7 @@ static int trie_delete_helper(struct trie_node *node, struct trie_node *parent,
     else
     {
         int r = trie_delete_helper(child, node, word + 1);
+        if(r) trie_update_summary(node);
         trie_cleanup(node, parent);
         assert(trie_node_integrity(parent));
         return r;
@@ -281,8 +720,11 @@ static int trie_serialize_formatU_helper(struct trie_node *node, FILE *file)
     assert(trie_node_integrity(node));
     
     if(fputwc(node->val, file)<0) return -1;
-    if(node->leaf)
+    // Słowa z częstością zapisujemy instrukcją 3, po której następuje częstość
+    if(node->leaf && node->freq == 0)
         if(fputwc(1, file)<0) return -1;
+    if(node->leaf && node->freq > 0)
+        if(fputwc(3, file)<0 || int32_serialize(node->freq, file)<0) return -1;
     for(int i = 0; i < node->cnt; i++)
         if(trie_serialize_formatU_helper(node->chd[i], file)<0) return -1;
     if(fputwc(2, file)<0) return -1;
@@ -305,15 +747,31 @@ static int trie_serialize_formatU(struct trie_node *root, FILE *file)
     return 0;
 }
 
+/**
+ * Zamienia etykietę węzła wczytaną z pliku na symbol.
+ * 
+ * @param[in] cmd Wczytana etykieta.
+ * @param[in,out] legacy Alfabet dla starego formatu (etykiety są literami) lub NULL.
+ * 
+ * @return Symbol lub 0 jeśli etykieta jest niepoprawna.
+ */
+static symbol_t trie_deserialize_label(wint_t cmd, struct alphabet *legacy)
+{
+    if(legacy != NULL) return alphabet_add(legacy, cmd);
+    if(cmd < SYMBOL_LETTER_FIRST || cmd > 255) return 0;
+    return cmd;
+}
+
 /**
  * Wczytuje poddrzewo z pliku.
  * 
  * @param[in,out] node Korzeń podderzewa do wczytania.
  * @param[in] file Strumień, z którego wczytać poddrzewo.
+ * @param[in,out] legacy Alfabet dla starego formatu lub NULL.
  * 
  * @return -1 jeśli błąd, 0 jeśli OK
  */
-static int trie_deserialize_formatU_helper(struct trie_node *node, FILE *file)
+static int trie_deserialize_formatU_helper(struct trie_node *node, FILE *file, struct alphabet *legacy)
 {
     assert(trie_node_integrity(node));
     while(1)
@@ -323,13 +781,24 @@ static int trie_deserialize_formatU_helper(struct trie_node *node, FILE *file)
         // Obsługa różnych rodzajów instrukcji
         if(cmd == 1) node->leaf = 1;
         else if(cmd == 2) break;
+        else if(cmd == 3)
+        {
+            int freq;
+            if(int32_deserialize(&freq, file)<0) return -1;
+            if(freq <= 0 || freq > TRIE_MAX_FREQUENCY) return -1;
+            node->leaf = 1;
+            node->freq = freq;
+        }
         else
         {
             // add letter
-            struct trie_node * child = trie_get_child_or_add_empty(node, cmd);
-            if(trie_deserialize_formatU_helper(child, file)<0) return -1;
+            symbol_t label = trie_deserialize_label(cmd, legacy);
+            if(label == 0) return -1;
+            struct trie_node * child = trie_get_child_or_add_empty(node, label);
+            if(trie_deserialize_formatU_helper(child, file, legacy)<0) return -1;
         }
     }
+    trie_update_summary(node);
     assert(trie_node_integrity(node));
     return 0;
 }
@@ -338,10 +807,11 @@ static int trie_deserialize_formatU_helper(struct trie_node *node, FILE *file)
  * Wczytuje drzewo z pliku.
  * 
  * @param[in] file Strumień, z którego wczytać poddrzewo.
+ * @param[in,out] legacy Alfabet dla starego formatu lub NULL.
  * 
  * @return Wczytane drzewo lub NULL jeśli błąd.
  */
-static struct trie_node * trie_deserialize_formatU(FILE *file)
+static struct trie_node * trie_deserialize_formatU(FILE *file, struct alphabet *legacy)
 {
     struct trie_node *root = trie_init();
     while(1)
@@ -356,18 +826,427 @@ static struct trie_node * trie_deserialize_formatU(FILE *file)
         else
         {
             // add letter
-            struct trie_node * child = trie_get_child_or_add_empty(root, cmd);
-            if(trie_deserialize_formatU_helper(child, file)<0)
+            symbol_t label = trie_deserialize_label(cmd, legacy);
+            struct trie_node * child = label == 0 ? NULL : trie_get_child_or_add_empty(root, label);
+            if(child == NULL || trie_deserialize_formatU_helper(child, file, legacy)<0)
             {
                 trie_done(root);
                 return NULL;
             }
         }
     }
+    trie_update_summary(root);
     assert(trie_node_integrity(root));
     return root;
 }
 
+/**
+ * Porządek kandydatów: większa częstość, potem mniejsza głębokość,
+ * a przy remisie kolejność utworzenia.
+ * 
+ * @param[in] items Kandydaci.
+ * @param[in] a Indeks pierwszego kandydata.
+ * @param[in] b Indeks drugiego kandydata.
+ * @return True jeśli pierwszy kandydat powinien być rozpatrzony wcześniej.
+ */
+static bool complete_before(const struct complete_item *items, size_t a, size_t b)
+{
+    if(items[a].weight != items[b].weight) return items[a].weight > items[b].weight;
+    if(items[a].depth != items[b].depth) return items[a].depth < items[b].depth;
+    return a < b;
+}
+
+/**
+ * Dodaje kandydata do kopca.
+ * 
+ * @param[in,out] heap Kopiec indeksów.
+ * @param[in] items Kandydaci.
+ * @param[in] i Indeks nowego kandydata.
+ * @return 0 jeśli się udało, -1 jeśli brakło pamięci.
+ */
+static int complete_heap_push(struct index_vector *heap, const struct complete_item *items, size_t i)
+{
+    if(!index_vector_push(heap, i)) return -1;
+    size_t c = heap->size - 1;
+    while(c > 0 && complete_before(items, heap->array[c], heap->array[(c - 1) / 2]))
+    {
+        size_t p = (c - 1) / 2;
+        size_t t = heap->array[c];
+        heap->array[c] = heap->array[p];
+        heap->array[p] = t;
+        c = p;
+    }
+    return 0;
+}
+
+/**
+ * Wyjmuje z kopca najlepszego kandydata.
+ * 
+ * @param[in,out] heap Niepusty kopiec indeksów.
+ * @param[in] items Kandydaci.
+ * @return Indeks najlepszego kandydata.
+ */
+static size_t complete_heap_pop(struct index_vector *heap, const struct complete_item *items)
+{
+    size_t top = heap->array[0];
+    heap->array[0] = heap->array[--heap->size];
+    size_t p = 0;
+    while(1)
+    {
+        size_t b = p, l = 2 * p + 1, r = 2 * p + 2;
+        if(l < heap->size && complete_before(items, heap->array[l], heap->array[b])) b = l;
+        if(r < heap->size && complete_before(items, heap->array[r], heap->array[b])) b = r;
+        if(b == p) break;
+        size_t t = heap->array[p];
+        heap->array[p] = heap->array[b];
+        heap->array[b] = t;
+        p = b;
+    }
+    return top;
+}
+
+/**
+ * Dopisuje do listy słowo wyznaczone przez kandydata.
+ * 
+ * @param[in] items Kandydaci.
+ * @param[in] i Indeks kandydata-słowa.
+ * @param[in] alphabet Alfabet drzewa.
+ * @param[in] prefix Prefiks w symbolach.
+ * @param[in] plen Długość prefiksu.
+ * @param[in,out] l Lista słów.
+ * @return 0 jeśli się udało, -1 jeśli brakło pamięci.
+ */
+static int complete_text(const struct complete_item *items, size_t i, const struct alphabet *alphabet,
+                         const symbol_t *prefix, size_t plen, struct word_list *l)
+{
+    wchar_t *text = word_list_add_empty(l, plen + items[i].depth);
+    if(text == NULL) return -1;
+    for(size_t j = 0; j < plen; j++)
+        text[j] = alphabet_letter(alphabet, prefix[j]);
+    // Kandydat-słowo ma tę samą głębokość co jego węzeł
+    for(size_t j = items[i].parent; items[j].parent != SIZE_MAX; j = items[j].parent)
+        text[plen + items[j].depth - 1] = alphabet_letter(alphabet, items[j].node->val);
+    return 0;
+}
+
+/**
+ * Zwraca symbol węzła drugiego łączonego drzewa w alfabecie wyniku.
+ * 
+ * @param[in] map Symbole drugiego drzewa w alfabecie wyniku lub NULL (te same).
+ * @param[in] s Symbol.
+ * @return Symbol w alfabecie wyniku.
+ */
+static symbol_t combine_symbol(const symbol_t *map, symbol_t s)
+{
+    return map != NULL ? map[s] : s;
+}
+
+/**
+ * Rozpoczyna przeglądanie par dzieci dwóch węzłów.
+ * Dzieci drugiego węzła są sortowane w alfabecie wyniku tylko wtedy,
+ * gdy tłumaczenie symboli zmienia ich kolejność.
+ * 
+ * @param[out] p Pary dzieci.
+ * @param[in] a Węzeł pierwszego drzewa lub NULL.
+ * @param[in] b Węzeł drugiego drzewa lub NULL.
+ * @param[in] map Symbole drugiego drzewa w alfabecie wyniku lub NULL.
+ */
+static void combine_pairs_init(struct combine_pairs *p, const struct trie_node *a,
+        const struct trie_node *b, const symbol_t *map)
+{
+    p->a = a != NULL ? a->chd : NULL;
+    p->acnt = a != NULL ? a->cnt : 0;
+    p->b = b != NULL ? b->chd : NULL;
+    p->bcnt = b != NULL ? b->cnt : 0;
+    p->i = p->j = 0;
+    p->map = map;
+    p->own = false;
+    bool sorted = true;
+    for(int j = 1; j < p->bcnt && sorted; j++)
+        sorted = combine_symbol(map, p->b[j - 1]->val) < combine_symbol(map, p->b[j]->val);
+    if(sorted) return;
+    struct trie_node **chd = malloc(p->bcnt * sizeof(struct trie_node *));
+    for(int j = 0; j < p->bcnt; j++)
+    {
+        int k = j;
+        for(; k > 0 && map[chd[k - 1]->val] > map[p->b[j]->val]; k--)
+            chd[k] = chd[k - 1];
+        chd[k] = p->b[j];
+    }
+    p->b = chd;
+    p->own = true;
+}
+
+/**
+ * Zwraca następną parę dzieci o tym samym symbolu.
+ * 
+ * @param[in,out] p Pary dzieci.
+ * @param[out] a Dziecko pierwszego węzła lub NULL, jeśli go nie ma.
+ * @param[out] b Dziecko drugiego węzła lub NULL, jeśli go nie ma.
+ * @return Czy była jeszcze jakaś para.
+ */
+static bool combine_pairs_next(struct combine_pairs *p, struct trie_node **a, struct trie_node **b)
+{
+    if(p->i == p->acnt && p->j == p->bcnt) return false;
+    *a = *b = NULL;
+    if(p->j == p->bcnt) *a = p->a[p->i++];
+    else if(p->i == p->acnt) *b = p->b[p->j++];
+    else
+    {
+        symbol_t sa = p->a[p->i]->val;
+        symbol_t sb = combine_symbol(p->map, p->b[p->j]->val);
+        if(sa <= sb) *a = p->a[p->i++];
+        if(sb <= sa) *b = p->b[p->j++];
+    }
+    return true;
+}
+
+/**
+ * Kończy przeglądanie par dzieci.
+ * 
+ * @param[in,out] p Pary dzieci.
+ */
+static void combine_pairs_done(struct combine_pairs *p)
+{
+    if(p->own) free(p->b);
+}
+
+/**
+ * Sprawdza, czy słowo kończące się w parze węzłów jest w wyniku łączenia.
+ * 
+ * @param[in] a Węzeł pierwszego drzewa lub NULL.
+ * @param[in] b Węzeł drugiego drzewa lub NULL.
+ * @param[in] keep Zachowywane słowa (suma flag enum trie_keep).
+ * @param[out] freq Częstość słowa w wyniku.
+ * @return Czy słowo jest w wyniku.
+ */
+static bool combine_leaf(const struct trie_node *a, const struct trie_node *b, int keep,
+        unsigned short *freq)
+{
+    bool la = a != NULL && a->leaf;
+    bool lb = b != NULL && b->leaf;
+    if(la && lb)
+    {
+        *freq = a->freq > b->freq ? a->freq : b->freq;
+        return keep & TRIE_KEEP_BOTH;
+    }
+    if(la) *freq = a->freq;
+    if(lb) *freq = b->freq;
+    return (la && (keep & TRIE_KEEP_ONLY_A)) || (lb && (keep & TRIE_KEEP_ONLY_B));
+}
+
+/**
+ * Dobiera pojemność tablicy dzieci tak, jak robi to wstawianie.
+ * 
+ * @param[in] cnt Liczba dzieci.
+ * @return Pojemność tablicy.
+ */
+static int combine_capacity(int cnt)
+{
+    int cap = 4;
+    while(cap < cnt && cap < TRIE_MAX_CHILDREN)
+        cap = cap > TRIE_MAX_CHILDREN / 2 ? TRIE_MAX_CHILDREN : 2 * cap;
+    return cap;
+}
+
+/**
+ * Łączy poddrzewa dwóch drzew.
+ * Poddrzewa, które w całości przechodzą do wyniku, są współdzielone.
+ * 
+ * @param[in,out] a Poddrzewo pierwszego drzewa lub NULL.
+ * @param[in,out] b Poddrzewo drugiego drzewa lub NULL.
+ * @param[in] map Symbole drugiego drzewa w alfabecie wyniku lub NULL.
+ * @param[in] keep Zachowywane słowa (suma flag enum trie_keep).
+ * @return Poddrzewo wyniku lub NULL, jeśli nie ma w nim słów.
+ */
+static struct trie_node * trie_combine_helper(struct trie_node *a, struct trie_node *b,
+        const symbol_t *map, int keep)
+{
+    if(b == NULL) return keep & TRIE_KEEP_ONLY_A ? trie_share(a) : NULL;
+    if(a == NULL && !(keep & TRIE_KEEP_ONLY_B)) return NULL;
+    if(a == NULL && map == NULL) return trie_share(b);
+    struct trie_node *node = trie_init();
+    node->val = a != NULL ? a->val : map[b->val];
+    unsigned short freq = 0;
+    if(combine_leaf(a, b, keep, &freq))
+    {
+        node->leaf = 1;
+        node->freq = freq;
+    }
+    int total = (a != NULL ? a->cnt : 0) + b->cnt;
+    if(total > 0)
+    {
+        node->cap = combine_capacity(total);
+        node->chd = malloc(node->cap * sizeof(struct trie_node *));
+    }
+    struct combine_pairs p;
+    struct trie_node *ca, *cb;
+    combine_pairs_init(&p, a, b, map);
+    while(combine_pairs_next(&p, &ca, &cb))
+    {
+        struct trie_node *child = trie_combine_helper(ca, cb, map, keep);
+        if(child != NULL) node->chd[node->cnt++] = child;
+    }
+    combine_pairs_done(&p);
+    if(node->cnt == 0)
+    {
+        free(node->chd);
+        node->chd = NULL;
+        node->cap = 0;
+    }
+    else if(combine_capacity(node->cnt) < node->cap)
+    {
+        node->cap = combine_capacity(node->cnt);
+        node->chd = realloc(node->chd, node->cap * sizeof(struct trie_node *));
+    }
+    if(!node->leaf && node->cnt == 0 && !trie_is_root(node))
+    {
+        free(node);
+        return NULL;
+    }
+    trie_update_summary(node);
+    assert(trie_node_integrity(node));
+    return node;
+}
+
+/**
+ * Zapisuje niezapisane jeszcze symbole ścieżki do bieżącego węzła.
+ * 
+ * @param[in,out] w Zapis łączonego drzewa.
+ * @return 0 jeśli się udało, -1 w p.p.
+ */
+static int combine_flush(struct combine_writer *w)
+{
+    for(; w->written < w->path.size; w->written++)
+        if(fputwc(w->path.array[w->written], w->file)<0) return -1;
+    return 0;
+}
+
+/**
+ * Zapisuje do strumienia wynik łączenia poddrzew dwóch drzew
+ * w tym samym formacie, co trie_serialize().
+ * 
+ * @param[in,out] w Zapis łączonego drzewa.
+ * @param[in] a Poddrzewo pierwszego drzewa lub NULL.
+ * @param[in] b Poddrzewo drugiego drzewa lub NULL.
+ * @param[in] map Symbole drugiego drzewa w alfabecie wyniku lub NULL.
+ * @param[in] keep Zachowywane słowa (suma flag enum trie_keep).
+ * @return 0 jeśli się udało, -1 w p.p.
+ */
+static int trie_combine_serialize_helper(struct combine_writer *w, const struct trie_node *a,
+        const struct trie_node *b, const symbol_t *map, int keep)
+{
+    if(b == NULL || (a == NULL && map == NULL))
+    {
+        // Poddrzewo tylko jednego drzewa jest zapisywane w całości albo wcale
+        if(!(keep & (b == NULL ? TRIE_KEEP_ONLY_A : TRIE_KEEP_ONLY_B))) return 0;
+        if(combine_flush(w)<0) return -1;
+        return trie_serialize_formatU_helper((struct trie_node *)(b == NULL ? a : b), w->file);
+    }
+    if(a == NULL && !(keep & TRIE_KEEP_ONLY_B)) return 0;
+    bool root = a != NULL && trie_is_root(a);
+    if(!root)
+    {
+        if(!symbol_vector_push(&w->path, a != NULL ? a->val : map[b->val])) return -1;
+        unsigned short freq = 0;
+        if(combine_leaf(a, b, keep, &freq))
+        {
+            if(combine_flush(w)<0) return -1;
+            if(freq == 0 && fputwc(1, w->file)<0) return -1;
+            if(freq > 0 && (fputwc(3, w->file)<0 || int32_serialize(freq, w->file)<0)) return -1;
+        }
+    }
+    struct combine_pairs p;
+    struct trie_node *ca, *cb;
+    int r = 0;
+    combine_pairs_init(&p, a, b, map);
+    while(r == 0 && combine_pairs_next(&p, &ca, &cb))
+        r = trie_combine_serialize_helper(w, ca, cb, map, keep);
+    combine_pairs_done(&p);
+    if(r < 0) return -1;
+    if(!root) w->path.size--;
+    // Węzeł zapisany razem z jakimś słowem trzeba zamknąć
+    if(root || w->written > w->path.size)
+    {
+        if(!root) w->written--;
+        if(fputwc(2, w->file)<0) return -1;
+    }
+    return 0;
+}
+
+/**
+ * Kładzie węzeł na stosie przeglądania słów.
+ * Jeśli symbole liter nie są w kolejności kodów, dzieci węzła są
+ * sortowane w tablicy przydzielonej raz dla danego poziomu drzewa.
+ * @param[in,out] it Przeglądanie.
+ * @param[in] node Węzeł.
+ * @return 0 jeśli się udało, -1 w p.p.
+ */
+static int iter_push(struct trie_iter *it, const struct trie_node *node)
+{
+    struct iter_frame f = { node->chd, node->cnt, 0, node };
+    size_t depth = it->stack.size;
+    if(!it->ordered && node->cnt > 1)
+    {
+        while(it->scratch.size <= depth)
+            if(!iter_scratch_vector_push(&it->scratch, NULL)) return -1;
+        struct trie_node **s = it->scratch.array[depth];
+        if(s == NULL)
+        {
+            s = malloc(TRIE_MAX_CHILDREN * sizeof(struct trie_node *));
+            if(s == NULL) return -1;
+            it->scratch.array[depth] = s;
+        }
+        // Sortowanie przez wstawianie: dzieci jest zwykle niewiele
+        for(int i = 0; i < node->cnt; i++)
+        {
+            struct trie_node *c = node->chd[i];
+            wchar_t l = alphabet_letter(it->alphabet, c->val);
+            int j = i;
+            for(; j > 0 && alphabet_letter(it->alphabet, s[j-1]->val) > l; j--)
+                s[j] = s[j-1];
+            s[j] = c;
+        }
+        f.chd = s;
+    }
+    // Miejsce na literę i kończące zero
+    if(!letter_vector_reserve(&it->word, depth + 1)) return -1;
+    if(!iter_frame_vector_push(&it->stack, f)) return -1;
+    if(depth > 0) it->word.array[it->word.size++] = alphabet_letter(it->alphabet, node->val);
+    return 0;
+}
+
+/**
+ * Zdejmuje węzeł ze stosu przeglądania słów.
+ * @param[in,out] it Przeglądanie.
+ */
+static void iter_pop(struct trie_iter *it)
+{
+    if(--it->stack.size > 0) it->word.size--;
+}
+
+/**
+ * Ustawia przeglądanie na pierwszym słowie nie mniejszym niż podane.
+ * @param[in,out] it Przeglądanie z samym korzeniem na stosie.
+ * @param[in] from Słowo.
+ * @return 0 jeśli się udało, -1 w p.p.
+ */
+static int iter_seek(struct trie_iter *it, const wchar_t *from)
+{
+    for(; *from != 0; from++)
+    {
+        struct iter_frame *f = &it->stack.array[it->stack.size - 1];
+        while(f->next < f->cnt && alphabet_letter(it->alphabet, f->chd[f->next]->val) < *from)
+            f->next++;
+        if(f->next == f->cnt || alphabet_letter(it->alphabet, f->chd[f->next]->val) != *from)
+            return 0;
+        // Słowa na ścieżce są prefiksami from, więc są od niego mniejsze
+        if(iter_push(it, f->chd[f->next++]) < 0) return -1;
+    }
+    it->pending = it->stack.size > 1 && it->stack.array[it->stack.size - 1].node->leaf;
+    return 0;
+}
+
 /**
  * @}
  */
@@ -382,8 +1261,14 @@ struct trie_node * trie_init()
     root->val = 0;
     root->cnt = 0;
     root->leaf = 0;
+    root->freq = 0;
+    root->best = 0;
+    root->min_depth = UCHAR_MAX;
+    root->max_depth = 0;
+    root->letters = 0;
     root->cap = 0;
     root->chd = NULL;
+    root->shared = 0;
     assert(trie_node_integrity(root));
     return root;
 }
@@ -391,50 +1276,64 @@ struct trie_node * trie_init()
 void trie_done(struct trie_node *root)
 {
     assert(trie_node_integrity(root));
-    trie_clear(root);
-    free(root);
+    trie_release(root);
 }
 
 
 void trie_clear(struct trie_node *node)
 {
     assert(trie_node_integrity(node));
+    assert(node->shared == 0);
     if(node->chd == NULL) return;
     for(int i = 0; i < node->cnt; i++)
-    {
-        trie_clear(node->chd[i]);
-        free(node->chd[i]);
-    }
+        trie_release(node->chd[i]);
     free(node->chd);
     node->chd = NULL;
     node->cap = 0;
     node->cnt = 0;
+    trie_update_summary(node);
     assert(trie_node_integrity(node));
 }
 
-int trie_insert(struct trie_node* root, const wchar_t* word)
+struct trie_node * trie_share(struct trie_node *root)
+{
+    assert(trie_node_integrity(root));
+    if(root->shared >= TRIE_MAX_SHARED) return trie_copy_node(root);
+    root->shared++;
+    return root;
+}
+
+struct trie_node * trie_unshare(struct trie_node *root)
 {
     assert(trie_node_integrity(root));
+    if(root->shared == 0) return root;
+    struct trie_node *copy = trie_copy_node(root);
+    root->shared--;
+    return copy;
+}
+
+int trie_insert(struct trie_node* root, const symbol_t* word)
+{
+    assert(trie_node_integrity(root));
+    assert(root->shared == 0);
     assert(word[0] != 0);
-    struct trie_node *child = trie_get_child_or_add_empty(root, word[0]);
-    if(word[1] == 0)
-    {
-        // Trzeba sprawdzić, czy słowo przypadkiem już nie istnieje!
-        if(child->leaf) return 0;
-        child->leaf = 1;
-        assert(trie_node_integrity(root));
-        return 1;
-    }
-    else
-    {
-        // Zwyczajnie dodajemy
-        int r = trie_insert(child, word + 1);
-        assert(trie_node_integrity(root));
-        return r;
-    }
+    // Wstawienie istniejącego słowa nie powinno kopiować współdzielonej ścieżki
+    if(trie_find(root, word)) return 0;
+    trie_insert_helper(root, word, symbol_len(word));
+    assert(trie_node_integrity(root));
+    return 1;
+}
+
+int trie_set_frequency(struct trie_node *root, const symbol_t *word, unsigned int freq)
+{
+    assert(trie_node_integrity(root));
+    assert(root->shared == 0);
+    if(freq > TRIE_MAX_FREQUENCY) freq = TRIE_MAX_FREQUENCY;
+    if(!trie_find(root, word)) return 0;
+    return trie_set_frequency_helper(root, word, freq);
 }
 
-int trie_find(const struct trie_node* root, const wchar_t* word)
+int trie_find(const struct trie_node* root, const symbol_t* word)
 {
     assert(trie_node_integrity(root));
     if(word[0] == 0) return root->leaf;
@@ -443,11 +1342,13 @@ int trie_find(const struct trie_node* root, const wchar_t* word)
     return trie_find(child, word + 1);
 }
 
-int trie_delete(struct trie_node* root, const wchar_t* word)
+int trie_delete(struct trie_node* root, const symbol_t* word)
 {
     assert(trie_node_integrity(root));
+    assert(root->shared == 0);
     assert(word[0] != 0);
-    struct trie_node *child = trie_get_child_priv(root, word[0]);
+    if(!trie_find(root, word)) return 0;
+    struct trie_node *child = trie_get_child_own(root, word[0]);
     if(child == NULL)
     {
         return 0;
@@ -455,6 +1356,7 @@ int trie_delete(struct trie_node* root, const wchar_t* word)
     else
     {
         int r = trie_delete_helper(child, root, word + 1);
+        if(r) trie_update_summary(root);
         assert(trie_node_integrity(root));
         return r;
     }
@@ -467,14 +1369,14 @@ int trie_serialize(struct trie_node *root, FILE *file)
 }
 
 
-struct trie_node * trie_deserialize(FILE *file)
+struct trie_node * trie_deserialize(FILE *file, struct alphabet *legacy)
 {
-    struct trie_node *ret = trie_deserialize_formatU(file);
-    assert(trie_node_integrity(ret));
+    struct trie_node *ret = trie_deserialize_formatU(file, legacy);
+    assert(ret == NULL || trie_node_integrity(ret));
     return ret;
 }
 
-const struct trie_node * trie_get_child(const struct trie_node *node, wchar_t value)
+const struct trie_node * trie_get_child(const struct trie_node *node, symbol_t value)
 {
     assert(trie_node_integrity(node));
     int r = trie_get_child_index(node, value, 0, node->cnt);
@@ -490,12 +1392,12 @@ int trie_get_children(const struct trie_node *node, const struct trie_node *** c
     return node->cnt;
 }
 
-wchar_t trie_get_value(const struct trie_node *node)
+symbol_t trie_get_value(const struct trie_node *node)
 {
     return node->val;
 }
 
-const wchar_t * trie_get_value_ptr(const struct trie_node *node)
+const symbol_t * trie_get_value_ptr(const struct trie_node *node)
 {
     return &(node->val);
 }
@@ -505,24 +1407,282 @@ bool trie_is_leaf(const struct trie_node *node)
     return node->leaf;
 }
 
+unsigned int trie_get_frequency(const struct trie_node *node)
+{
+    return node->freq;
+}
+
+unsigned int trie_get_min_depth(const struct trie_node *node)
+{
+    return node->min_depth;
+}
+
+unsigned int trie_get_max_depth(const struct trie_node *node)
+{
+    return node->max_depth;
+}
+
+uint32_t trie_get_letters(const struct trie_node *node)
+{
+    return node->letters;
+}
+
 bool trie_is_root(const struct trie_node* node)
 {
     return node->val == 0;
 }
 
-void trie_hints(struct trie_node *root, const wchar_t *word, struct word_list *list, struct list *rules, int max_cost, int max_hints_no)
+int trie_complete(const struct trie_node *root, const struct alphabet *alphabet, const symbol_t *prefix, size_t k, struct word_list *list)
+{
+    assert(trie_node_integrity(root));
+    const struct trie_node *node = root;
+    size_t plen = 0;
+    for(; prefix[plen] != 0 && node != NULL; plen++)
+        node = trie_get_child(node, prefix[plen]);
+    if(node == NULL || k == 0) return 0;
+    struct complete_item_vector items;
+    struct index_vector heap, found;
+    struct word_list words;
+    struct completion_vector run;
+    complete_item_vector_init(&items);
+    index_vector_init(&heap);
+    index_vector_init(&found);
+    word_list_init(&words);
+    completion_vector_init(&run);
+    int r = -1;
+    struct complete_item start = { node, SIZE_MAX, node->best, 0, false };
+    if(!complete_item_vector_push(&items, start) || complete_heap_push(&heap, items.array, 0) < 0)
+        goto done;
+    // Przeglądamy poddrzewa od największego ograniczenia częstości, więc
+    // poddrzewa bez odpowiednio częstych słów nie są w ogóle odwiedzane.
+    // Po znalezieniu k słów dobieramy jeszcze słowa o tej samej częstości
+    // i długości co ostatnie, żeby wybrać spośród nich pierwsze alfabetycznie.
+    while(heap.size > 0)
+    {
+        size_t top = heap.array[0];
+        if(found.size >= k)
+        {
+            const struct complete_item *last = &items.array[found.array[found.size - 1]];
+            if(items.array[top].weight != last->weight || items.array[top].depth != last->depth)
+                break;
+        }
+        complete_heap_pop(&heap, items.array);
+        struct complete_item it = items.array[top];
+        if(it.word)
+        {
+            if(!index_vector_push(&found, top)) goto done;
+            continue;
+        }
+        if(it.node->leaf)
+        {
+            struct complete_item w = { it.node, top, it.node->freq, it.depth, true };
+            if(!complete_item_vector_push(&items, w)
+               || complete_heap_push(&heap, items.array, items.size - 1) < 0) goto done;
+        }
+        for(int i = 0; i < it.node->cnt; i++)
+        {
+            const struct trie_node *ch = it.node->chd[i];
+            struct complete_item c = { ch, top, ch->best, it.depth + 1, false };
+            if(!complete_item_vector_push(&items, c)
+               || complete_heap_push(&heap, items.array, items.size - 1) < 0) goto done;
+        }
+    }
+    for(size_t i = 0; i < found.size; i++)
+        if(complete_text(items.array, found.array[i], alphabet, prefix, plen, &words) < 0) goto done;
+    // Słowa o tej samej częstości i długości porządkujemy alfabetycznie
+    const wchar_t * const *texts = word_list_get(&words);
+    size_t added = 0;
+    for(size_t b = 0; b < found.size && added < k; )
+    {
+        const struct complete_item *first = &items.array[found.array[b]];
+        size_t e = b;
+        completion_vector_clear(&run);
+        for(; e < found.size && items.array[found.array[e]].weight == first->weight
+                             && items.array[found.array[e]].depth == first->depth; e++)
+            if(!completion_vector_push(&run, texts[e])) goto done;
+        completion_vector_sort(&run);
+        for(size_t j = 0; j < run.size && added < k; j++, added++)
+            if(!word_list_add(list, run.array[j])) goto done;
+        b = e;
+    }
+    r = added;
+done:
+    complete_item_vector_done(&items);
+    index_vector_done(&heap);
+    index_vector_done(&found);
+    word_list_done(&words);
+    completion_vector_done(&run);
+    return r;
+}
+
+void trie_hints(struct trie_node *root, const struct alphabet *alphabet, const symbol_t *word, struct word_list *list, struct list *rules, const struct deletion_index *index, int max_cost, int max_hints_no, int *costs, int threads, struct hint_stats *stats)
+{
+    assert(trie_node_integrity(root));
+    rule_generate_hints_indexed(index, (struct hint_rule**)list_get(rules), max_cost, max_hints_no, root, alphabet, word, list, costs, threads, stats);
+}
+
+
+struct trie_node * trie_combine(struct trie_node *a, struct trie_node *b, const symbol_t *map, int keep)
+{
+    assert(trie_node_integrity(a) && trie_node_integrity(b));
+    return trie_combine_helper(a, b, map, keep);
+}
+
+int trie_combine_serialize(const struct trie_node *a, const struct trie_node *b, const symbol_t *map, int keep, FILE *file)
+{
+    assert(trie_node_integrity(a) && trie_node_integrity(b));
+    struct combine_writer w = { file, { NULL, 0, 0 }, 0 };
+    int r = trie_combine_serialize_helper(&w, a, b, map, keep);
+    symbol_vector_done(&w.path);
+    return r;
+}
+
+
+struct trie_iter * trie_iter_new(const struct trie_node *root, const struct alphabet *alphabet,
+        const wchar_t *from, const wchar_t *to)
+{
+    assert(trie_node_integrity(root));
+    struct trie_iter *it = malloc(sizeof(struct trie_iter));
+    if(it == NULL) return NULL;
+    it->alphabet = alphabet;
+    it->ordered = true;
+    for(int i = 1; i < alphabet_size(alphabet); i++)
+        if(alphabet_letter(alphabet, SYMBOL_LETTER_FIRST + i - 1)
+           > alphabet_letter(alphabet, SYMBOL_LETTER_FIRST + i))
+            it->ordered = false;
+    it->pending = false;
+    it->finished = false;
+    iter_frame_vector_init(&it->stack);
+    iter_scratch_vector_init(&it->scratch);
+    letter_vector_init(&it->word);
+    it->to = NULL;
+    if(to != NULL)
+    {
+        size_t len = wcslen(to);
+        it->to = malloc((len + 1) * sizeof(wchar_t));
+        if(it->to != NULL) memcpy(it->to, to, (len + 1) * sizeof(wchar_t));
+    }
+    if((to != NULL && it->to == NULL) || iter_push(it, root) < 0
+       || (from != NULL && iter_seek(it, from) < 0))
+    {
+        trie_iter_done(it);
+        return NULL;
+    }
+    return it;
+}
+
+int trie_iter_next(struct trie_iter *it, const wchar_t **word, const struct trie_node **node)
+{
+    while(!it->finished && !it->pending)
+    {
+        struct iter_frame *f = &it->stack.array[it->stack.size - 1];
+        if(f->next < f->cnt)
+        {
+            if(iter_push(it, f->chd[f->next++]) < 0) return -1;
+            it->pending = it->stack.array[it->stack.size - 1].node->leaf;
+        }
+        else if(it->stack.size > 1) iter_pop(it);
+        else it->finished = true;
+    }
+    if(it->finished) return 0;
+    it->pending = false;
+    it->word.array[it->word.size] = 0;
+    // Słowa są rosnące, więc po pierwszym spoza zakresu nie ma już innych
+    if(it->to != NULL && wcscmp(it->word.array, it->to) >= 0)
+    {
+        it->finished = true;
+        return 0;
+    }
+    *word = it->word.array;
+    if(node != NULL) *node = it->stack.array[it->stack.size - 1].node;
+    return 1;
+}
+
+void trie_iter_done(struct trie_iter *it)
+{
+    for(size_t i = 0; i < it->scratch.size; i++)
+        free(it->scratch.array[i]);
+    iter_scratch_vector_done(&it->scratch);
+    iter_frame_vector_done(&it->stack);
+    letter_vector_done(&it->word);
+    free(it->to);
+    free(it);
+}
+
+void trie_memory_stats(const struct trie_node *root, const struct alphabet *alphabet, struct dictionary_memory_stats *stats)
 {
     assert(trie_node_integrity(root));
-    list_terminate(rules);
-    struct list *output = rule_generate_hints((struct hint_rule**)list_get(rules), max_cost, max_hints_no, root, word);
-    for(int i = 0; i < list_size(output); i++)
+    bool shared = root->shared > 0;
+    trie_count_node(root, 0, shared, stats);
+    // Dzieci korzenia to pierwsze litery słów
+    for(int i = 0; i < root->cnt; i++)
     {
-        word_list_add(list, list_get(output)[i]);
-        free(list_get(output)[i]);
+        size_t words = trie_node_memory(root->chd[i], 1, shared, stats);
+        if(stats->letters_no < DICTIONARY_MEMORY_LETTERS)
+        {
+            stats->letters[stats->letters_no] = alphabet_letter(alphabet, root->chd[i]->val);
+            stats->letter_words[stats->letters_no++] = words;
+        }
     }
-    list_done(output);
 }
 
+size_t trie_child_slots(const struct trie_node *root, size_t *used)
+{
+    *used = 0;
+    return trie_node_slots(root, used);
+}
+
+struct trie_node * trie_compact(struct trie_node *root, int threads)
+{
+    assert(trie_node_integrity(root));
+    if(root->shared > 0) return root;
+    struct trie_node *copy = malloc(sizeof(struct trie_node));
+    if(copy == NULL) return NULL;
+    *copy = *root;
+    copy->cap = root->cnt;
+    copy->chd = NULL;
+    if(root->cnt > 0)
+    {
+        copy->chd = malloc(root->cnt * sizeof(struct trie_node *));
+        if(copy->chd == NULL)
+        {
+            free(copy);
+            return NULL;
+        }
+        for(int i = 0; i < root->cnt; i++)
+            copy->chd[i] = NULL;
+        // Poddrzewa korzenia są od siebie niezależne
+        struct compact_work w = { root->chd, copy->chd, root->cnt, 0 };
+        pthread_t workers[TRIE_COMPACT_MAX_THREADS];
+        int started = 0;
+#ifndef TRIE_COMPACT_INLINE
+        if(threads > root->cnt) threads = root->cnt;
+        if(threads > TRIE_COMPACT_MAX_THREADS + 1) threads = TRIE_COMPACT_MAX_THREADS + 1;
+        for(; started < threads - 1; started++)
+            if(pthread_create(&workers[started], NULL, compact_work_run, &w) != 0)
+                break;
+#else
+        (void)threads;
+#endif
+        compact_work_run(&w);
+        for(int i = 0; i < started; i++)
+            pthread_join(workers[i], NULL);
+        bool failed = false;
+        for(int i = 0; i < root->cnt; i++)
+            failed = failed || copy->chd[i] == NULL;
+        if(failed)
+        {
+            for(int i = 0; i < root->cnt; i++)
+                if(copy->chd[i] != NULL) trie_compact_free(copy->chd[i]);
+            free(copy->chd);
+            free(copy);
+            return NULL;
+        }
+    }
+    trie_compact_free(root);
+    assert(trie_node_integrity(copy));
+    return copy;
+}
 
 /**@}*/
 
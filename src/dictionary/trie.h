@@ -20,13 +20,27 @@ struct trie_node;
 /*
  * Includes.
  */
+#include "alphabet.h"
 #include "list.h"
 #include "rule.h"
 #include "word_list.h"
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+/**
+ * Największa częstość słowa, jaką można zapisać w drzewie.
+ */
+#define TRIE_MAX_FREQUENCY 65535
+
+/**
+ * Bit litery w zbiorze liter poddrzewa (zob. trie_get_letters()).
+ * Zbiór ma 32 bity, więc litery, których symbole różnią się o wielokrotność 32,
+ * dzielą bit.
+ */
+#define trie_letter_bit(s) ((uint32_t)1 << ((unsigned int)(s) % 32))
+
 /**
  * Tworzy nowy węzeł drzewa TRIE
  * 
@@ -36,11 +50,37 @@ struct trie_node * trie_init();
 
 /**
  * Destrukcja węzła drzewa TRIE wraz z poddrzewami.
+ * Współdzielone drzewo traci tylko jednego właściciela.
  * 
  * @param[in] root Drzewo do usunięcia.
  */
 void trie_done(struct trie_node *root);
 
+/**
+ * Dodaje drzewu właściciela, który może je później zmieniać niezależnie
+ * od pozostałych (kopia przy zapisie).
+ * 
+ * Operacje modyfikujące kopiują tylko węzły na ścieżce do zmienianego słowa,
+ * a reszta drzewa pozostaje współdzielona. Każdy właściciel zwalnia drzewo
+ * przez trie_done(). Liczniki właścicieli nie są chronione przed
+ * wyścigami, więc drzewa nie wolno współdzielić, gdy inne wątki go używają.
+ * 
+ * @param[in,out] root Drzewo.
+ * @return Drzewo nowego właściciela (zwykle to samo drzewo).
+ */
+struct trie_node * trie_share(struct trie_node *root);
+
+/**
+ * Przygotowuje drzewo do zmian: współdzielony korzeń jest zastępowany
+ * kopią, a pozostali właściciele zachowują stary korzeń.
+ * 
+ * Funkcje zmieniające drzewo wymagają korzenia bez innych właścicieli.
+ * 
+ * @param[in,out] root Drzewo.
+ * @return Drzewo, które można zmieniać.
+ */
+struct trie_node * trie_unshare(struct trie_node *root);
+
 /**
  * Usuwa wszystkie wyrazy z drzewa.
  * 
@@ -55,7 +95,18 @@ void trie_clear(struct trie_node *root);
  * @param[in] word Słowo do wstawienia.
  * @return 1 jeśli wstawiono słowo, 0 jeśli istniało wcześniej.
  */
-int trie_insert(struct trie_node *root, const wchar_t *word);
+int trie_insert(struct trie_node *root, const symbol_t *word);
+
+/**
+ * Ustawia częstość słowa w drzewie.
+ * Częstości większe niż TRIE_MAX_FREQUENCY są obcinane.
+ * 
+ * @param[in,out] root Drzewo.
+ * @param[in] word Słowo.
+ * @param[in] freq Częstość słowa.
+ * @return 1 jeśli ustawiono częstość, 0 jeśli słowa nie ma w drzewie.
+ */
+int trie_set_frequency(struct trie_node *root, const symbol_t *word, unsigned int freq);
 
 /**
  * Sprawdza, czy słowo istnieje w drzewie.
@@ -64,7 +115,7 @@ int trie_insert(struct trie_node *root, const wchar_t *word);
  * @param[in] word Słowo do znalezienia.
  * @return 0 jeśli nie znaleziono słowa, 1 gdy znaleziono.
  */
-int trie_find(const struct trie_node *root, const wchar_t *word);
+int trie_find(const struct trie_node *root, const symbol_t *word);
 
 /**
  * Usuwa słowo z drzewa.
@@ -73,7 +124,7 @@ int trie_find(const struct trie_node *root, const wchar_t *word);
  * @param[in] word Słowo do usunięcia.
  * @return 1 jeśli usunięto słowo, 0 jeśli takowe słowo nie ustniało.
  */
-int trie_delete(struct trie_node *root, const wchar_t *word);
+int trie_delete(struct trie_node *root, const symbol_t *word);
 
 /**
  * Zapisuje drzewo do strumienia.
@@ -86,10 +137,55 @@ int trie_serialize(struct trie_node *root, FILE *file);
 /**
  * Ładuje drzewo ze strumienia.
  * 
+ * Jeśli podano alfabet, drzewo jest w starym formacie, w którym etykietami
+ * węzłów są litery, a nie symbole; litery są wtedy dodawane do alfabetu.
+ * 
  * @param[in] file Strumień, z którego wczytać drzewo.
+ * @param[in,out] legacy Alfabet dla starego formatu lub NULL.
  * @return Wczytane drzewo.
  */
-struct trie_node * trie_deserialize(FILE *file);
+struct trie_node * trie_deserialize(FILE *file, struct alphabet *legacy);
+
+/**
+ * Słowa zachowywane przy łączeniu drzew przez trie_combine().
+ */
+enum trie_keep
+{
+    TRIE_KEEP_ONLY_A = 1,   ///< Słowa tylko z pierwszego drzewa.
+    TRIE_KEEP_ONLY_B = 2,   ///< Słowa tylko z drugiego drzewa.
+    TRIE_KEEP_BOTH = 4      ///< Słowa z obu drzew.
+};
+
+/**
+ * Łączy dwa drzewa w jednym przejściu po obu naraz (suma, różnica,
+ * przecięcie lub różnica symetryczna zbiorów słów, zależnie od `keep`).
+ * 
+ * Słowo z obu drzew dostaje większą z częstości. Poddrzewa, które w całości
+ * przechodzą do wyniku, są współdzielone z drzewami wejściowymi
+ * (zob. trie_share()); dotyczy to drugiego drzewa tylko wtedy, gdy
+ * jego symbole nie są tłumaczone.
+ * 
+ * @param[in,out] a Pierwsze drzewo.
+ * @param[in,out] b Drugie drzewo.
+ * @param[in] map Symbole liter drugiego drzewa w alfabecie pierwszego
+ * (tablica indeksowana symbolami) lub NULL, jeśli są takie same.
+ * @param[in] keep Zachowywane słowa (suma flag enum trie_keep).
+ * @return Nowe drzewo.
+ */
+struct trie_node * trie_combine(struct trie_node *a, struct trie_node *b, const symbol_t *map, int keep);
+
+/**
+ * Zapisuje do strumienia wynik trie_combine() bez budowania go w pamięci.
+ * Zapis ma ten sam format, co trie_serialize().
+ * 
+ * @param[in] a Pierwsze drzewo.
+ * @param[in] b Drugie drzewo.
+ * @param[in] map Symbole liter drugiego drzewa w alfabecie pierwszego lub NULL.
+ * @param[in] keep Zachowywane słowa (suma flag enum trie_keep).
+ * @param[in] file Strumień.
+ * @return 0 jeśli się udało, -1 w p.p.
+ */
+int trie_combine_serialize(const struct trie_node *a, const struct trie_node *b, const symbol_t *map, int keep, FILE *file);
 
 /**
  * Zwraca dziecko o podanej wartości.
@@ -98,7 +194,7 @@ struct trie_node * trie_deserialize(FILE *file);
  * @param[in] value Wartość dziecka.
  * @return Węzeł reprezentujący dziecko lub NULL jeśli takowe nie istnieje.
  */
-const struct trie_node * trie_get_child(const struct trie_node *node, wchar_t value);
+const struct trie_node * trie_get_child(const struct trie_node *node, symbol_t value);
 
 /**
  * Zwraca dzieci danego węzła.
@@ -114,14 +210,14 @@ int trie_get_children(const struct trie_node *node, const struct trie_node *** c
  * @param[in] node Węzeł, którego wartość zwrócić.
  * @return Wartość węzła.
  */
-wchar_t trie_get_value(const struct trie_node *node);
+symbol_t trie_get_value(const struct trie_node *node);
 
 /**
  * Zwraca wskaźnik na wartość przechowywaną w danym węźle.
  * @param[in] node Węzeł.
  * @return Wskaźnik na Wartość węzła.
  */
-const wchar_t * trie_get_value_ptr(const struct trie_node *node);
+const symbol_t * trie_get_value_ptr(const struct trie_node *node);
 
 /**
  * Sprawdza, czy węzeł jest liściem.
@@ -130,6 +226,37 @@ const wchar_t * trie_get_value_ptr(const struct trie_node *node);
  */
 bool trie_is_leaf(const struct trie_node *node);
 
+/**
+ * Zwraca częstość słowa kończącego się w węźle.
+ * @param[in] node Węzeł.
+ * @return Częstość słowa (0 dla nieznanej częstości lub węzła, który nie jest liściem).
+ */
+unsigned int trie_get_frequency(const struct trie_node *node);
+
+/**
+ * Zwraca najmniejszą liczbę liter, które trzeba dopisać od węzła,
+ * żeby dojść do końca słowa z drzewa.
+ * @param[in] node Węzeł.
+ * @return Liczba liter (UCHAR_MAX, jeśli w poddrzewie nie ma słów).
+ */
+unsigned int trie_get_min_depth(const struct trie_node *node);
+
+/**
+ * Zwraca największą liczbę liter, które można dopisać od węzła,
+ * żeby dojść do końca słowa z drzewa.
+ * @param[in] node Węzeł.
+ * @return Liczba liter (UCHAR_MAX oznacza UCHAR_MAX lub więcej).
+ */
+unsigned int trie_get_max_depth(const struct trie_node *node);
+
+/**
+ * Zwraca zbiór liter, które występują w słowach poniżej węzła.
+ * Jeśli bitu litery nie ma w zbiorze, litera na pewno nie występuje poniżej węzła.
+ * @param[in] node Węzeł.
+ * @return Zbiór liter jako suma bitów trie_letter_bit().
+ */
+uint32_t trie_get_letters(const struct trie_node *node);
+
 /**
  * Sprawdza, czy węzeł jest korzeniem.
  * @param[in] node Węzeł.
@@ -137,16 +264,111 @@ bool trie_is_leaf(const struct trie_node *node);
  */
 bool trie_is_root(const struct trie_node *node);
 
+/**
+ * Przeglądanie słów drzewa (zob. trie_iter_new()).
+ */
+struct trie_iter;
+
+/**
+ * Zaczyna przeglądanie słów drzewa w kolejności kodów liter (jak wcscmp()).
+ * Przeglądanie nie używa rekursji ani nie przydziela pamięci dla
+ * każdego słowa. Drzewa nie można zmieniać, dopóki jest przeglądane.
+ * @param[in] root Drzewo.
+ * @param[in] alphabet Alfabet, w którym zapisano drzewo.
+ * @param[in] from Najmniejsze słowo zakresu lub NULL.
+ * @param[in] to Pierwsze słowo za zakresem lub NULL.
+ * @return Przeglądanie lub NULL, jeśli brakło pamięci.
+ */
+struct trie_iter * trie_iter_new(const struct trie_node *root, const struct alphabet *alphabet,
+        const wchar_t *from, const wchar_t *to);
+
+/**
+ * Przechodzi do następnego słowa.
+ * @param[in,out] it Przeglądanie.
+ * @param[out] word Słowo, ważne do następnego wywołania.
+ * @param[out] node Węzeł, w którym kończy się słowo, lub NULL.
+ * @return 1 jeśli jest następne słowo, 0 na końcu, -1 jeśli brakło pamięci.
+ */
+int trie_iter_next(struct trie_iter *it, const wchar_t **word, const struct trie_node **node);
+
+/**
+ * Kończy przeglądanie słów.
+ * @param[in] it Przeglądanie.
+ */
+void trie_iter_done(struct trie_iter *it);
+
+/**
+ * Znajduje najczęstsze słowa zaczynające się od podanego prefiksu.
+ * 
+ * Każdy węzeł pamięta największą częstość słowa w swoim poddrzewie,
+ * więc poddrzewa bez odpowiednio częstych słów nie są przeglądane.
+ * Słowa są uporządkowane nierosnąco po częstości, przy równej częstości
+ * od najkrótszych, a przy równej długości alfabetycznie.
+ * 
+ * @param[in] root Drzewo do przeszukania.
+ * @param[in] alphabet Alfabet, w którym zapisano drzewo.
+ * @param[in] prefix Prefiks (w symbolach).
+ * @param[in] k Największa liczba słów.
+ * @param[in,out] list Lista, do której dopisać słowa.
+ * @return Liczba dopisanych słów lub -1, jeśli brakło pamięci.
+ */
+int trie_complete(const struct trie_node *root, const struct alphabet *alphabet, const symbol_t *prefix, size_t k, struct word_list *list);
+
 /**
  * Znajduje wyrazy podobne do podanego w drzewie.
  * 
  * @param[in] root Drzewo do przeszukania.
- * @param[in] word Słowo wzorcowe, do którego znaleźć podobne.
+ * @param[in] alphabet Alfabet, w którym zapisano drzewo.
+ * @param[in] word Słowo wzorcowe (w symbolach), do którego znaleźć podobne.
  * @param[out] list Lista słów podobnych.
- * @param[in] rules Lista reguł, które można zastosować.
+ * @param[in] rules Lista reguł, które można zastosować, zakończona
+ * wywołaniem list_terminate(). Lista nie jest modyfikowana, więc można
+ * szukać podpowiedzi w wielu wątkach naraz.
+ * @param[in] index Indeks usunięć zbudowany ze słów drzewa albo NULL.
  * @param[in] max_cost Maksymalny możliwy koszt podpowiedzi.
  * @param[in] max_hints_no Maksymalna liczba podpowiedzi.
+ * @param[out] costs Tablica (co najmniej `max_hints_no` elementów) na koszty
+ * kolejnych podpowiedzi albo NULL.
+ * @param[in] threads Liczba wątków, w których można generować podpowiedzi.
+ * @param[in,out] stats Statystyki generowania podpowiedzi albo NULL
+ * (zob. rule_generate_hints()).
+ */
+void trie_hints(struct trie_node *root, const struct alphabet *alphabet, const symbol_t *word, struct word_list *list, struct list *rules, const struct deletion_index *index, int max_cost, int max_hints_no, int *costs, int threads, struct hint_stats *stats);
+
+/**
+ * Dolicza do statystyk pamięć i kształt drzewa: węzły, liście, tablice
+ * dzieci, histogramy głębokości i liczby dzieci oraz liczby słów
+ * zaczynających się od kolejnych liter (zob. dictionary_memory_stats()).
+ * 
+ * @param[in] root Korzeń drzewa.
+ * @param[in] alphabet Alfabet, w którym zapisano drzewo.
+ * @param[in,out] stats Statystyki.
+ */
+void trie_memory_stats(const struct trie_node *root, const struct alphabet *alphabet, struct dictionary_memory_stats *stats);
+
+/**
+ * Liczy miejsca w tablicach dzieci drzewa. W przeciwieństwie do
+ * trie_memory_stats() nie zbiera nic więcej, więc nadaje się do szybkiego
+ * sprawdzenia, czy warto zagęścić drzewo (zob. trie_compact()).
+ * 
+ * @param[in] root Korzeń drzewa.
+ * @param[out] used Liczba zajętych miejsc.
+ * @return Liczba wszystkich miejsc.
+ */
+size_t trie_child_slots(const struct trie_node *root, size_t *used);
+
+/**
+ * Zagęszcza drzewo: kopiuje je do nowych węzłów z tablicami dzieci
+ * dokładnie na miarę, w kolejności przechodzenia w głąb, i zwalnia stare
+ * węzły. Poddrzewa współdzielone z innymi drzewami (zob. trie_share())
+ * zostają bez zmian, a współdzielone drzewo nie jest w ogóle kopiowane.
+ * 
+ * @param[in,out] root Korzeń drzewa.
+ * @param[in] threads Liczba wątków kopiujących poddrzewa korzenia.
+ * @return Korzeń zagęszczonego drzewa (drzewo `root` przestaje wtedy
+ * istnieć, chyba że to ten sam korzeń) lub NULL, jeśli brakło pamięci
+ * (drzewo `root` się wtedy nie zmienia).
  */
-void trie_hints(struct trie_node *root, const wchar_t *word, struct word_list *list, struct list *rules, int max_cost, int max_hints_no);
+struct trie_node * trie_compact(struct trie_node *root, int threads);
 
 #endif /* __TRIE_H__ */
\ No newline at end of file
@@ -8,6 +8,7 @@
   @date 2015-06-03
  */
 
+#include <limits.h>
 #include <stdlib.h>
 #include <locale.h>
 #include <string.h>
@@ -26,21 +27,27 @@
 struct trie_node
 {
     struct trie_node **chd;     ///< Lista dzieci
-    wchar_t val;                ///< Wartość węzła
-    unsigned int cap;           ///< Pojemność tablicy dzieci
-    unsigned int cnt;           ///< Ilość dzieci
-    unsigned int leaf;          ///< Czy tutaj kończy się słowo
+    unsigned short freq;        ///< Częstość słowa kończącego się tutaj
+    unsigned short best;        ///< Największa częstość słowa w poddrzewie
+    unsigned char min_depth;    ///< Najmniejsza liczba liter poniżej węzła do końca słowa
+    unsigned char max_depth;    ///< Największa liczba liter poniżej węzła do końca słowa
+    uint32_t letters;           ///< Litery poniżej węzła
+    unsigned char cap;          ///< Pojemność tablicy dzieci
+    unsigned char cnt;          ///< Ilość dzieci
+    symbol_t val;               ///< Wartość węzła
+    unsigned char leaf : 1;     ///< Czy tutaj kończy się słowo
+    unsigned char shared : 7;   ///< Liczba dodatkowych właścicieli węzła
 };
 
-extern int trie_get_child_index(struct trie_node *node, wchar_t value, int begin, int end);
-extern struct trie_node * trie_get_child_priv(struct trie_node *node, wchar_t value);
-extern struct trie_node * trie_get_child_or_add_empty(struct trie_node *node, wchar_t value);
+extern int trie_get_child_index(struct trie_node *node, symbol_t value, int begin, int end);
+extern struct trie_node * trie_get_child_priv(struct trie_node *node, symbol_t value);
+extern struct trie_node * trie_get_child_or_add_empty(struct trie_node *node, symbol_t value);
 extern void trie_cleanup(struct trie_node *node, struct trie_node *parent);
-extern int trie_delete_helper(struct trie_node *node, struct trie_node *parent, const wchar_t *word);
+extern int trie_delete_helper(struct trie_node *node, struct trie_node *parent, const symbol_t *word);
 extern int trie_serialize_formatU_helper(struct trie_node *node, FILE *file);
 extern int trie_serialize_formatU(struct trie_node *node, FILE *file);
-extern int trie_deserialize_formatU_helper(struct trie_node *node, FILE *file);
-extern struct trie_node * trie_deserialize_formatU(FILE *file);
+extern int trie_deserialize_formatU_helper(struct trie_node *node, FILE *file, struct alphabet *legacy);
+extern struct trie_node * trie_deserialize_formatU(FILE *file, struct alphabet *legacy);
 extern void trie_hints_helper(struct trie_node *node, const wchar_t *word,
                        wchar_t **created, int length, int *capacity,
                        int points, struct word_list *list);
@@ -83,6 +90,7 @@ static int node_1_setup(void **state)
         child->cap = 0;
         child->cnt = 0;
         child->chd = NULL;
+        child->shared = 0;
         node->chd[i] = child;
     }
     node->chd[0]->val = 'c';
@@ -106,6 +114,7 @@ static int node_2_setup(void **state)
         child->cap = 0;
         child->cnt = 0;
         child->chd = NULL;
+        child->shared = 0;
         node->chd[i] = child;
     }
     node->chd[0]->val = 'd';
@@ -130,6 +139,7 @@ static int node_4_setup(void **state)
         child->cap = 0;
         child->cnt = 0;
         child->chd = NULL;
+        child->shared = 0;
         node->chd[i] = child;
     }
     node->chd[0]->val = 'd';
@@ -792,7 +802,7 @@ static void trie_delete_helper_1_noleaf_test(void **state)
 {
     struct trie_node *node = trie_init();
     struct trie_node *chd = trie_get_child_or_add_empty(node, L'h');
-    assert_int_equal(trie_delete_helper(chd, node, L""), 0);
+    assert_int_equal(trie_delete_helper(chd, node, (const symbol_t *)""), 0);
     assert_true(node->cnt == 1);
     assert_true(node->chd[0] == chd);
     trie_done(node);
@@ -809,7 +819,7 @@ static void trie_delete_helper_11_leaf_test(void **state)
     struct trie_node *chd = trie_get_child_or_add_empty(node, L'h');
     struct trie_node *gch = trie_get_child_or_add_empty(chd, L'w');
     chd->leaf = 1;
-    assert_int_equal(trie_delete_helper(chd, node, L""), 1);
+    assert_int_equal(trie_delete_helper(chd, node, (const symbol_t *)""), 1);
     assert_true(chd->leaf == 0);
     assert_true(node->cnt == 1);
     assert_true(node->chd[0] == chd);
@@ -827,7 +837,7 @@ static void trie_delete_helper_1_nochild_test(void **state)
 {
     struct trie_node *node = trie_init();
     struct trie_node *chd = trie_get_child_or_add_empty(node, L'h');
-    assert_int_equal(trie_delete_helper(chd, node, L"x"), 0);
+    assert_int_equal(trie_delete_helper(chd, node, (const symbol_t *)"x"), 0);
     assert_true(node->cnt == 1);
     assert_true(node->chd[0] == chd);
     trie_done(node);
@@ -844,7 +854,7 @@ static void trie_delete_helper_11_leaf_A_test(void **state)
     struct trie_node *chd = trie_get_child_or_add_empty(node, L'h');
     struct trie_node *gch = trie_get_child_or_add_empty(chd, L'w');
     gch->leaf = 1;
-    assert_int_equal(trie_delete_helper(chd, node, L"w"), 1);
+    assert_int_equal(trie_delete_helper(chd, node, (const symbol_t *)"w"), 1);
     assert_true(node->cnt == 0);
     trie_done(node);
 }
@@ -960,7 +970,7 @@ static void trie_deserialize_formatU_helper_1_test(void **state)
     wbuff[3] = 2;
     wreadp = 0;
     wfilelen = 4;
-    assert_int_equal(trie_deserialize_formatU_helper(node, NULL), 0);
+    assert_int_equal(trie_deserialize_formatU_helper(node, NULL, NULL), 0);
     assert_int_equal(node->cnt, 1);
     assert_int_equal(node->leaf, 0);
     assert_true(node->chd[0]->val == L't');
@@ -984,7 +994,7 @@ static void trie_deserialize_formatU_helper_2_test(void **state)
     wbuff[6] = 2;
     wreadp = 0;
     wfilelen = 7;
-    assert_int_equal(trie_deserialize_formatU_helper(node, NULL), 0);
+    assert_int_equal(trie_deserialize_formatU_helper(node, NULL, NULL), 0);
     assert_int_equal(node->cnt, 1);
     assert_int_equal(node->leaf, 0);
     assert_true(node->chd[0]->val == L't');
@@ -1014,7 +1024,7 @@ static void trie_deserialize_formatU_helper_3_test(void **state)
     wbuff[9] = 2;
     wreadp = 0;
     wfilelen = 10;
-    assert_int_equal(trie_deserialize_formatU_helper(node, NULL), 0);
+    assert_int_equal(trie_deserialize_formatU_helper(node, NULL, NULL), 0);
     assert_int_equal(node->cnt, 1);
     assert_int_equal(node->leaf, 0);
     assert_true(node->chd[0]->val == L't');
@@ -1046,7 +1056,7 @@ static void trie_deserialize_fromatU_test(void **state)
     wbuff[6] = 2;
     wreadp = 0;
     wfilelen = 7;
-    struct trie_node *node = trie_deserialize_formatU(NULL);
+    struct trie_node *node = trie_deserialize_formatU(NULL, NULL);
     assert_int_equal(node->cnt, 2);
     assert_int_equal(node->leaf, 0);
     assert_int_equal(node->chd[0]->cnt, 0);
@@ -1091,7 +1101,7 @@ static void trie_clear_2_test(void **state)
 static void trie_insert_1_test(void **state)
 {
     struct trie_node *node = trie_init();
-    assert_int_equal(trie_insert(node, L"x"), 1);
+    assert_int_equal(trie_insert(node, (const symbol_t *)"x"), 1);
     assert_int_equal(node->cnt, 1);
     assert_int_equal(node->chd[0]->val, L'x');
     assert_int_equal(node->chd[0]->cnt, 0);
@@ -1107,7 +1117,7 @@ static void trie_insert_2_test(void **state)
 {
     struct trie_node *node = trie_init();
     trie_get_child_or_add_empty(node, L'f');
-    assert_int_equal(trie_insert(node, L"f"),1);
+    assert_int_equal(trie_insert(node, (const symbol_t *)"f"),1);
     assert_int_equal(node->cnt, 1);
     assert_int_equal(node->chd[0]->val, L'f');
     assert_int_equal(node->chd[0]->cnt, 0);
@@ -1124,7 +1134,7 @@ static void trie_insert_3_test(void **state)
     struct trie_node *node = trie_init();
     struct trie_node *child = trie_get_child_or_add_empty(node, L'f');
     child->leaf = 1;
-    assert_int_equal(trie_insert(node, L"f"),0);
+    assert_int_equal(trie_insert(node, (const symbol_t *)"f"),0);
     assert_int_equal(node->cnt, 1);
     assert_int_equal(node->chd[0]->val, L'f');
     assert_int_equal(node->chd[0]->cnt, 0);
@@ -1139,7 +1149,7 @@ static void trie_insert_4_test(void **state)
 {
     struct trie_node *node = trie_init();
     trie_get_child_or_add_empty(node, L'f');
-    assert_int_equal(trie_insert(node, L"fl"),1);
+    assert_int_equal(trie_insert(node, (const symbol_t *)"fl"),1);
     assert_int_equal(node->cnt, 1);
     assert_int_equal(node->chd[0]->val, L'f');
     assert_int_equal(node->chd[0]->cnt, 1);
@@ -1156,7 +1166,7 @@ static void trie_insert_4_test(void **state)
 static void trie_find_1_test(void **state)
 {
     struct trie_node *node = trie_init();
-    assert_int_equal(trie_find(node, L""),0);
+    assert_int_equal(trie_find(node, (const symbol_t *)""),0);
     trie_done(node);
 }
 
@@ -1167,7 +1177,7 @@ static void trie_find_2_test(void **state)
 {
     struct trie_node *node = trie_init();
     node->leaf = 1;
-    assert_int_equal(trie_find(node, L""),1);
+    assert_int_equal(trie_find(node, (const symbol_t *)""),1);
     trie_done(node);
 }
 
@@ -1177,7 +1187,7 @@ static void trie_find_2_test(void **state)
 static void trie_find_3_test(void **state)
 {
     struct trie_node *node = trie_init();
-    assert_int_equal(trie_find(node, L"n"),0);
+    assert_int_equal(trie_find(node, (const symbol_t *)"n"),0);
     trie_done(node);
 }
 
@@ -1188,7 +1198,7 @@ static void trie_find_4_test(void **state)
 {
     struct trie_node *node = trie_init();
     trie_get_child_or_add_empty(node, L'f');
-    assert_int_equal(trie_find(node, L"f"),0);
+    assert_int_equal(trie_find(node, (const symbol_t *)"f"),0);
     trie_done(node);
 }
 
@@ -1200,7 +1210,7 @@ static void trie_find_5_test(void **state)
     struct trie_node *node = trie_init();
     struct trie_node *child = trie_get_child_or_add_empty(node, L'f');
     child->leaf = 1;
-    assert_int_equal(trie_find(node, L"f"),1);
+    assert_int_equal(trie_find(node, (const symbol_t *)"f"),1);
     trie_done(node);
 }
 
@@ -1210,7 +1220,7 @@ static void trie_find_5_test(void **state)
 static void trie_delete_1_test(void **state)
 {
     struct trie_node *node = trie_init();
-    assert_int_equal(trie_delete(node, L"e"), 0);
+    assert_int_equal(trie_delete(node, (const symbol_t *)"e"), 0);
     trie_done(node);
 }
 
@@ -1221,7 +1231,7 @@ static void trie_delete_2_test(void **state)
 {
     struct trie_node *node = trie_init();
     trie_get_child_or_add_empty(node, L'f');
-    assert_int_equal(trie_delete(node, L"f"), 0);
+    assert_int_equal(trie_delete(node, (const symbol_t *)"f"), 0);
     trie_done(node);
 }
 
@@ -1233,7 +1243,7 @@ static void trie_delete_3_test(void **state)
     struct trie_node *node = trie_init();
     struct trie_node *child = trie_get_child_or_add_empty(node, L'f');
     child->leaf = 1;
-    assert_int_equal(trie_delete(node, L"f"), 1);
+    assert_int_equal(trie_delete(node, (const symbol_t *)"f"), 1);
     trie_done(node);
 }
 
@@ -1243,9 +1253,9 @@ static void trie_delete_3_test(void **state)
 static void trie_serialize_test(void **state)
 {
     struct trie_node *node = trie_init();
-    trie_insert(node, L"p");
-    trie_insert(node, L"gl");
-    trie_insert(node, L"gr");
+    trie_insert(node, (const symbol_t *)"p");
+    trie_insert(node, (const symbol_t *)"gl");
+    trie_insert(node, (const symbol_t *)"gr");
     wchar_t *output = L"gl\x01\x02r\x01\x02\x02p\x01\x02\x02";
     wwritep = 0;
     trie_serialize(node, NULL);
@@ -1298,7 +1308,7 @@ static void trie_deserialize_test(void **state)
     memcpy(wbuff, output, 12*sizeof(wchar_t));
     wreadp = 0;
     wfilelen = 12;
-    struct trie_node * node = trie_deserialize(NULL);
+    struct trie_node * node = trie_deserialize(NULL, NULL);
     assert_int_equal(node->cnt, 2);
     assert_int_equal(node->chd[0]->val, L'g');
     assert_int_equal(node->chd[0]->cnt, 2);
@@ -1313,10 +1323,347 @@ static void trie_deserialize_test(void **state)
     assert_int_equal(node->chd[0]->chd[1]->val, L'r');
     assert_int_equal(node->chd[0]->chd[1]->cnt, 0);
     assert_true(node->chd[0]->chd[1]->leaf);
+
+    // Podsumowania poddrzew są przeliczane przy wczytywaniu
+    assert_int_equal(trie_get_min_depth(node), 1);
+    assert_int_equal(trie_get_max_depth(node), 2);
+    assert_int_equal(trie_get_letters(node), trie_letter_bit(L'g') | trie_letter_bit(L'l')
+                     | trie_letter_bit(L'r') | trie_letter_bit(L'p'));
+    assert_int_equal(trie_get_letters(node->chd[0]), trie_letter_bit(L'l') | trie_letter_bit(L'r'));
+    assert_int_equal(trie_get_letters(node->chd[1]), 0);
     
     trie_done(node);
 }
 
+/**
+ * Testuje ustawianie częstości słów.
+ */
+static void trie_set_frequency_test(void **state)
+{
+    struct trie_node *node = trie_init();
+    trie_insert(node, (const symbol_t *)"gl");
+    trie_insert(node, (const symbol_t *)"glr");
+    assert_int_equal(trie_set_frequency(node, (const symbol_t *)"gl", 7), 1);
+    assert_int_equal(trie_set_frequency(node, (const symbol_t *)"g", 7), 0);
+    assert_int_equal(trie_set_frequency(node, (const symbol_t *)"gp", 7), 0);
+    assert_int_equal(trie_set_frequency(node, (const symbol_t *)"glr", 100000), 1);
+    assert_int_equal(trie_get_frequency(node->chd[0]->chd[0]), 7);
+    assert_int_equal(trie_get_frequency(node->chd[0]->chd[0]->chd[0]), TRIE_MAX_FREQUENCY);
+    assert_int_equal(trie_get_frequency(node->chd[0]), 0);
+    trie_delete(node, (const symbol_t *)"gl");
+    trie_insert(node, (const symbol_t *)"gl");
+    assert_int_equal(trie_get_frequency(node->chd[0]->chd[0]), 0);
+    trie_done(node);
+}
+
+/**
+ * Testuje zapisywanie i wczytywanie drzewa z częstościami słów.
+ */
+static void trie_serialize_frequency_test(void **state)
+{
+    struct trie_node *node = trie_init();
+    trie_insert(node, (const symbol_t *)"p");
+    trie_insert(node, (const symbol_t *)"gl");
+    trie_set_frequency(node, (const symbol_t *)"gl", 0x12);
+    wchar_t *output = L"gl\x03" L"aaaaaabc\x02\x02p\x01\x02\x02";
+    wwritep = 0;
+    trie_serialize(node, NULL);
+    assert_int_equal(wwritep, 17);
+    assert_memory_equal(wbuff, output, 17*sizeof(wchar_t));
+    trie_done(node);
+    wreadp = 0;
+    wfilelen = 17;
+    node = trie_deserialize(NULL, NULL);
+    assert_true(node != NULL);
+    assert_true(node->chd[0]->chd[0]->leaf);
+    assert_int_equal(node->chd[0]->chd[0]->freq, 0x12);
+    assert_true(node->chd[1]->leaf);
+    assert_int_equal(node->chd[1]->freq, 0);
+    assert_int_equal(node->best, 0x12);
+    trie_done(node);
+}
+
+/**
+ * Testuje aktualizację największych częstości w poddrzewach.
+ */
+static void trie_best_test(void **state)
+{
+    struct trie_node *node = trie_init();
+    trie_insert(node, (const symbol_t *)"gl");
+    trie_insert(node, (const symbol_t *)"glr");
+    trie_insert(node, (const symbol_t *)"p");
+    trie_set_frequency(node, (const symbol_t *)"glr", 9);
+    trie_set_frequency(node, (const symbol_t *)"gl", 4);
+    trie_set_frequency(node, (const symbol_t *)"p", 6);
+    assert_int_equal(node->best, 9);
+    assert_int_equal(node->chd[0]->best, 9);
+    assert_int_equal(node->chd[1]->best, 6);
+    trie_set_frequency(node, (const symbol_t *)"glr", 1);
+    assert_int_equal(node->best, 6);
+    assert_int_equal(node->chd[0]->best, 4);
+    trie_delete(node, (const symbol_t *)"gl");
+    assert_int_equal(node->chd[0]->best, 1);
+    trie_delete(node, (const symbol_t *)"p");
+    assert_int_equal(node->best, 1);
+    trie_done(node);
+}
+
+/**
+ * Testuje podsumowania poddrzew (długości słów i litery) po wstawianiu i usuwaniu.
+ */
+static void trie_summary_test(void **state)
+{
+    struct trie_node *node = trie_init();
+    assert_true(trie_get_max_depth(node) < trie_get_min_depth(node));
+    trie_insert(node, (const symbol_t *)"abcd");
+    trie_insert(node, (const symbol_t *)"ab");
+    trie_insert(node, (const symbol_t *)"x");
+    assert_int_equal(trie_get_min_depth(node), 1);
+    assert_int_equal(trie_get_max_depth(node), 4);
+    const struct trie_node *a = trie_get_child(node, 'a');
+    assert_int_equal(trie_get_min_depth(a), 1);
+    assert_int_equal(trie_get_max_depth(a), 3);
+    assert_int_equal(trie_get_min_depth(trie_get_child(a, 'b')), 0);
+    assert_int_equal(trie_get_letters(node), trie_letter_bit('a') | trie_letter_bit('b')
+                     | trie_letter_bit('c') | trie_letter_bit('d') | trie_letter_bit('x'));
+    assert_int_equal(trie_get_letters(a), trie_letter_bit('b') | trie_letter_bit('c')
+                     | trie_letter_bit('d'));
+
+    trie_delete(node, (const symbol_t *)"abcd");
+    trie_delete(node, (const symbol_t *)"x");
+    assert_int_equal(trie_get_min_depth(node), 2);
+    assert_int_equal(trie_get_max_depth(node), 2);
+    assert_int_equal(trie_get_letters(node), trie_letter_bit('a') | trie_letter_bit('b'));
+    assert_int_equal(trie_get_letters(trie_get_child(node, 'a')), trie_letter_bit('b'));
+
+    // Długość jest nasycana, więc bardzo długie słowa nie przepełniają licznika
+    symbol_t word[300];
+    memset(word, 'a', 299);
+    word[299] = 0;
+    trie_insert(node, word);
+    assert_int_equal(trie_get_min_depth(node), 2);
+    assert_int_equal(trie_get_max_depth(node), UCHAR_MAX);
+    trie_done(node);
+}
+
+/**
+ * Testuje współdzielenie drzewa i kopiowanie ścieżek przy zmianach.
+ */
+static void trie_share_test(void **state)
+{
+    struct trie_node *node = trie_init();
+    trie_insert(node, (const symbol_t *)"gl");
+    trie_insert(node, (const symbol_t *)"p");
+    struct trie_node *copy = trie_share(node);
+    assert_true(copy == node);
+    copy = trie_unshare(copy);
+    assert_true(copy != node);
+    assert_true(copy->chd[0] == node->chd[0]);
+    assert_true(copy->chd[1] == node->chd[1]);
+
+    // Zmieniana jest tylko ścieżka do słowa, reszta pozostaje wspólna
+    assert_int_equal(trie_insert(copy, (const symbol_t *)"gr"), 1);
+    assert_int_equal(trie_insert(copy, (const symbol_t *)"p"), 0);
+    assert_true(copy->chd[0] != node->chd[0]);
+    assert_true(copy->chd[1] == node->chd[1]);
+    assert_int_equal(trie_set_frequency(copy, (const symbol_t *)"p", 5), 1);
+    assert_int_equal(trie_delete(copy, (const symbol_t *)"gl"), 1);
+    assert_true(trie_find(copy, (const symbol_t *)"gr"));
+    assert_false(trie_find(copy, (const symbol_t *)"gl"));
+    assert_false(trie_find(node, (const symbol_t *)"gr"));
+    assert_true(trie_find(node, (const symbol_t *)"gl"));
+    assert_int_equal(trie_get_frequency(trie_get_child(node, 'p')), 0);
+    assert_int_equal(copy->best, 5);
+    assert_int_equal(node->best, 0);
+    trie_done(copy);
+
+    // Węzeł o zbyt wielu właścicielach jest kopiowany
+    struct trie_node *owners[200];
+    for(int i = 0; i < 200; i++)
+        owners[i] = trie_share(node);
+    assert_true(owners[0] == node);
+    assert_true(owners[199] != node);
+    for(int i = 0; i < 200; i++)
+        trie_done(owners[i]);
+    trie_done(node);
+}
+
+/**
+ * Testuje zagęszczanie drzewa.
+ */
+static void trie_compact_test(void **state)
+{
+    struct trie_node *node = trie_init();
+    trie_insert(node, (const symbol_t *)"gl");
+    trie_insert(node, (const symbol_t *)"gr");
+    trie_insert(node, (const symbol_t *)"p");
+    trie_set_frequency(node, (const symbol_t *)"gr", 3);
+    assert_int_equal(node->cap, 4);
+    size_t used;
+    assert_int_equal(trie_child_slots(node, &used), 8);
+    assert_int_equal(used, 4);
+    node = trie_compact(node, 2);
+    assert_int_equal(trie_child_slots(node, &used), 4);
+    assert_int_equal(used, 4);
+    assert_int_equal(node->cap, 2);
+    assert_int_equal(node->chd[0]->cap, 2);
+    assert_int_equal(node->chd[1]->cap, 0);
+    assert_true(node->chd[1]->chd == NULL);
+    assert_true(trie_find(node, (const symbol_t *)"gl"));
+    assert_true(trie_find(node, (const symbol_t *)"gr"));
+    assert_true(trie_find(node, (const symbol_t *)"p"));
+    assert_int_equal(node->best, 3);
+    // Zagęszczone drzewo można dalej zmieniać
+    assert_int_equal(trie_insert(node, (const symbol_t *)"ga"), 1);
+    assert_int_equal(trie_insert(node, (const symbol_t *)"a"), 1);
+    assert_int_equal(trie_delete(node, (const symbol_t *)"p"), 1);
+    assert_true(trie_find(node, (const symbol_t *)"ga"));
+    assert_true(trie_find(node, (const symbol_t *)"a"));
+
+    // Współdzielone drzewo i poddrzewa zostają bez zmian
+    struct trie_node *copy = trie_share(node);
+    assert_true(trie_compact(copy, 1) == node);
+    copy = trie_unshare(copy);
+    struct trie_node *shared = copy->chd[1];
+    assert_int_equal(trie_insert(copy, (const symbol_t *)"ab"), 1);
+    copy = trie_compact(copy, 1);
+    assert_true(copy->chd[1] == shared);
+    assert_true(copy->chd[1]->shared == 1);
+    assert_true(trie_find(copy, (const symbol_t *)"ab"));
+    assert_true(trie_find(copy, (const symbol_t *)"gr"));
+    assert_false(trie_find(node, (const symbol_t *)"ab"));
+    trie_done(copy);
+    assert_true(trie_find(node, (const symbol_t *)"gr"));
+    trie_done(node);
+}
+
+/**
+ * Testuje łączenie drzew.
+ */
+static void trie_combine_test(void **state)
+{
+    struct trie_node *a = trie_init();
+    trie_insert(a, (const symbol_t *)"gl");
+    trie_insert(a, (const symbol_t *)"gr");
+    trie_insert(a, (const symbol_t *)"p");
+    trie_set_frequency(a, (const symbol_t *)"gl", 2);
+    struct trie_node *b = trie_init();
+    trie_insert(b, (const symbol_t *)"gl");
+    trie_insert(b, (const symbol_t *)"gx");
+    trie_insert(b, (const symbol_t *)"z");
+    trie_set_frequency(b, (const symbol_t *)"gl", 7);
+
+    // Suma: poddrzewa tylko z jednego drzewa są współdzielone
+    struct trie_node *sum = trie_combine(a, b, NULL, TRIE_KEEP_ONLY_A | TRIE_KEEP_ONLY_B | TRIE_KEEP_BOTH);
+    assert_true(trie_find(sum, (const symbol_t *)"gl"));
+    assert_true(trie_find(sum, (const symbol_t *)"gr"));
+    assert_true(trie_find(sum, (const symbol_t *)"gx"));
+    assert_true(trie_find(sum, (const symbol_t *)"p"));
+    assert_true(trie_find(sum, (const symbol_t *)"z"));
+    assert_int_equal(sum->cnt, 3);
+    assert_true(sum->chd[1] == a->chd[1]);
+    assert_true(sum->chd[2] == b->chd[1]);
+    assert_int_equal(sum->best, 7);
+    sum = trie_unshare(sum);
+    trie_delete(sum, (const symbol_t *)"p");
+    assert_true(trie_find(a, (const symbol_t *)"p"));
+    trie_done(sum);
+
+    // Różnica i przecięcie
+    struct trie_node *sub = trie_combine(a, b, NULL, TRIE_KEEP_ONLY_A);
+    assert_false(trie_find(sub, (const symbol_t *)"gl"));
+    assert_true(trie_find(sub, (const symbol_t *)"gr"));
+    assert_true(trie_find(sub, (const symbol_t *)"p"));
+    assert_false(trie_find(sub, (const symbol_t *)"z"));
+    trie_done(sub);
+    struct trie_node *both = trie_combine(a, b, NULL, TRIE_KEEP_BOTH);
+    wwritep = 0;
+    trie_serialize(both, NULL);
+    size_t len = wwritep;
+    wchar_t output[32];
+    memcpy(output, wbuff, len * sizeof(wchar_t));
+    assert_int_equal(output[0], L'g');
+    assert_int_equal(output[1], L'l');
+    assert_int_equal(output[2], 3);
+    assert_int_equal(both->cnt, 1);
+    assert_int_equal(both->chd[0]->cnt, 1);
+    trie_done(both);
+    // Zapis bez budowania drzewa jest taki sam
+    wwritep = 0;
+    assert_int_equal(trie_combine_serialize(a, b, NULL, TRIE_KEEP_BOTH, NULL), 0);
+    assert_int_equal(wwritep, len);
+    assert_memory_equal(wbuff, output, len * sizeof(wchar_t));
+
+    // Tłumaczenie symboli drugiego drzewa zmienia kolejność dzieci
+    symbol_t map[256];
+    for(int i = 0; i < 256; i++)
+        map[i] = i;
+    map['x'] = 'a';
+    struct trie_node *mapped = trie_combine(a, b, map, TRIE_KEEP_ONLY_A | TRIE_KEEP_ONLY_B | TRIE_KEEP_BOTH);
+    assert_true(trie_find(mapped, (const symbol_t *)"ga"));
+    assert_false(trie_find(mapped, (const symbol_t *)"gx"));
+    assert_int_equal(mapped->chd[0]->chd[0]->val, 'a');
+    wwritep = 0;
+    trie_serialize(mapped, NULL);
+    len = wwritep;
+    memcpy(output, wbuff, len * sizeof(wchar_t));
+    wwritep = 0;
+    assert_int_equal(trie_combine_serialize(a, b, map, TRIE_KEEP_ONLY_A | TRIE_KEEP_ONLY_B | TRIE_KEEP_BOTH, NULL), 0);
+    assert_int_equal(wwritep, len);
+    assert_memory_equal(wbuff, output, len * sizeof(wchar_t));
+    trie_done(mapped);
+
+    trie_done(a);
+    trie_done(b);
+}
+
+/**
+ * Testuje odrzucanie niepoprawnych częstości przy wczytywaniu.
+ */
+static void trie_deserialize_bad_frequency_test(void **state)
+{
+    wchar_t *output = L"p\x03" L"aaaaaaaa\x02\x02";
+    memcpy(wbuff, output, 12*sizeof(wchar_t));
+    wreadp = 0;
+    wfilelen = 12;
+    assert_true(trie_deserialize(NULL, NULL) == NULL);
+}
+
+/**
+ * Testuje wczytywanie drzewa {ął, ż} w starym formacie,
+ * w którym etykietami węzłów są litery.
+ */
+static void trie_deserialize_legacy_test(void **state)
+{
+    wchar_t *output = L"ął\x01\x02\x02ż\x01\x02\x02";
+    memcpy(wbuff, output, 9*sizeof(wchar_t));
+    wreadp = 0;
+    wfilelen = 9;
+    struct alphabet *alphabet = alphabet_new();
+    struct trie_node * node = trie_deserialize(NULL, alphabet);
+    assert_int_equal(alphabet_size(alphabet), 3);
+    assert_int_equal(node->cnt, 2);
+    assert_int_equal(alphabet_letter(alphabet, node->chd[0]->val), L'ą');
+    assert_int_equal(alphabet_letter(alphabet, node->chd[0]->chd[0]->val), L'ł');
+    assert_true(node->chd[0]->chd[0]->leaf);
+    assert_int_equal(alphabet_letter(alphabet, node->chd[1]->val), L'ż');
+    assert_true(node->chd[1]->leaf);
+    trie_done(node);
+    alphabet_done(alphabet);
+}
+
+/**
+ * Testuje odrzucanie etykiet, które nie są symbolami liter.
+ */
+static void trie_deserialize_bad_label_test(void **state)
+{
+    wchar_t *output = L"\x05\x01\x02\x02";
+    memcpy(wbuff, output, 4*sizeof(wchar_t));
+    wreadp = 0;
+    wfilelen = 4;
+    assert_true(trie_deserialize(NULL, NULL) == NULL);
+}
+
 int main(void) {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(trie_init_done_test),
@@ -1373,6 +1720,16 @@ int main(void) {
         cmocka_unit_test(trie_delete_3_test),
         cmocka_unit_test(trie_serialize_test),
         cmocka_unit_test(trie_deserialize_test),
+        cmocka_unit_test(trie_deserialize_legacy_test),
+        cmocka_unit_test(trie_deserialize_bad_label_test),
+        cmocka_unit_test(trie_set_frequency_test),
+        cmocka_unit_test(trie_serialize_frequency_test),
+        cmocka_unit_test(trie_deserialize_bad_frequency_test),
+        cmocka_unit_test(trie_best_test),
+        cmocka_unit_test(trie_summary_test),
+        cmocka_unit_test(trie_share_test),
+        cmocka_unit_test(trie_compact_test),
+        cmocka_unit_test(trie_combine_test),
         cmocka_unit_test_setup_teardown(trie_get_child_empty_test, node_0_setup, node_0_teardown),
         cmocka_unit_test_setup_teardown(trie_get_child_1_test, node_1_setup, node_1_teardown),
         cmocka_unit_test_setup_teardown(trie_get_child_2_test, node_2_setup, node_2_teardown),
@@ -0,0 +1,91 @@
+/** @file
+    Implementacja kodowania i dekodowania UTF-8.
+
+    @ingroup dictionary
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+    @copyright Uniwerstet Warszawski
+    @date 2015-06-22
+ */
+
+#include "utf8.h"
+
+#include "../testable.h"
+
+/** @name Elementy interfejsu
+ * @{
+ */
+
+size_t utf8_decode(const char *s, size_t len, wchar_t *c)
+{
+    const unsigned char *u = (const unsigned char *)s;
+    if(u[0] < 0x80)
+    {
+        *c = u[0];
+        return 1;
+    }
+    size_t n;
+    wchar_t v, min;
+    if((u[0] & 0xE0) == 0xC0) { n = 2; v = u[0] & 0x1F; min = 0x80; }
+    else if((u[0] & 0xF0) == 0xE0) { n = 3; v = u[0] & 0x0F; min = 0x800; }
+    else if((u[0] & 0xF8) == 0xF0) { n = 4; v = u[0] & 0x07; min = 0x10000; }
+    else return 0;
+    if(len < n) return 0;
+    for(size_t i = 1; i < n; i++)
+    {
+        if((u[i] & 0xC0) != 0x80) return 0;
+        v = (v << 6) | (u[i] & 0x3F);
+    }
+    if(v < min || v > 0x10FFFF) return 0;
+    if(v >= 0xD800 && v <= 0xDFFF) return 0;
+    *c = v;
+    return n;
+}
+
+size_t utf8_encode(wchar_t c, char *out)
+{
+    unsigned char *u = (unsigned char *)out;
+    if(c < 0) return 0;
+    if(c < 0x80)
+    {
+        u[0] = c;
+        return 1;
+    }
+    if(c < 0x800)
+    {
+        u[0] = 0xC0 | (c >> 6);
+        u[1] = 0x80 | (c & 0x3F);
+        return 2;
+    }
+    if(c >= 0xD800 && c <= 0xDFFF) return 0;
+    if(c < 0x10000)
+    {
+        u[0] = 0xE0 | (c >> 12);
+        u[1] = 0x80 | ((c >> 6) & 0x3F);
+        u[2] = 0x80 | (c & 0x3F);
+        return 3;
+    }
+    if(c > 0x10FFFF) return 0;
+    u[0] = 0xF0 | (c >> 18);
+    u[1] = 0x80 | ((c >> 12) & 0x3F);
+    u[2] = 0x80 | ((c >> 6) & 0x3F);
+    u[3] = 0x80 | (c & 0x3F);
+    return 4;
+}
+
+size_t utf8_length(const wchar_t *word)
+{
+    size_t len = 0;
+    char buf[UTF8_MAX_LENGTH];
+    for(; *word != 0; word++)
+    {
+        size_t n = utf8_encode(*word, buf);
+        if(n == 0) return (size_t)-1;
+        len += n;
+    }
+    return len;
+}
+
+/**
+ * @}
+ */
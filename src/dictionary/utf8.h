@@ -0,0 +1,53 @@
+/** @file
+    Interfejs kodowania i dekodowania UTF-8.
+
+    Funkcje nie zależą od ustawionego locale i nie alokują pamięci,
+    więc można ich używać bezpośrednio na buforach klientów.
+
+    @ingroup dictionary
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+    @copyright Uniwerstet Warszawski
+    @date 2015-06-22
+ */
+
+#ifndef DICTIONARY_UTF8_H
+#define DICTIONARY_UTF8_H
+
+#include <stddef.h>
+#include <wchar.h>
+
+/// Maksymalna liczba bajtów jednego znaku w UTF-8.
+#define UTF8_MAX_LENGTH 4
+
+/**
+ * Dekoduje pierwszy znak z bufora.
+ *
+ * Odrzuca sekwencje nadmiarowe (overlong), surogaty i kody większe niż U+10FFFF.
+ *
+ * @param[in] s Bufor.
+ * @param[in] len Długość bufora w bajtach (większa od 0).
+ * @param[out] c Zdekodowany znak.
+ * @return Liczba bajtów znaku lub 0, jeśli bufor nie zaczyna się poprawnym znakiem.
+ */
+size_t utf8_decode(const char *s, size_t len, wchar_t *c);
+
+/**
+ * Koduje znak.
+ *
+ * @param[in] c Znak.
+ * @param[out] out Bufor na co najmniej UTF8_MAX_LENGTH bajtów.
+ * @return Liczba zapisanych bajtów lub 0, jeśli znak nie jest poprawnym kodem.
+ */
+size_t utf8_encode(wchar_t c, char *out);
+
+/**
+ * Zwraca długość zakodowanego słowa.
+ *
+ * @param[in] word Słowo.
+ * @return Liczba bajtów (bez kończącego zera) lub (size_t)-1, jeśli słowo
+ * zawiera niepoprawny znak.
+ */
+size_t utf8_length(const wchar_t *word);
+
+#endif /* DICTIONARY_UTF8_H */
@@ -0,0 +1,94 @@
+/** @file
+  Test kodowania i dekodowania UTF-8.
+
+  @ingroup dictionary
+  @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+  @copyright Uniwerstet Warszawski
+  @date 2015-06-22
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmocka.h>
+#include "utf8.h"
+
+/**
+ * Testuje dekodowanie poprawnych znaków.
+ */
+static void utf8_decode_test(void **state)
+{
+    wchar_t c;
+    assert_int_equal(utf8_decode("a", 1, &c), 1);
+    assert_int_equal(c, L'a');
+    assert_int_equal(utf8_decode("\xc5\x82x", 3, &c), 2);
+    assert_int_equal(c, L'ł');
+    assert_int_equal(utf8_decode("\xe2\x82\xac", 3, &c), 3);
+    assert_int_equal(c, 0x20AC);
+    assert_int_equal(utf8_decode("\xf0\x9f\x98\x80", 4, &c), 4);
+    assert_int_equal(c, 0x1F600);
+}
+
+/**
+ * Testuje odrzucanie niepoprawnych sekwencji.
+ */
+static void utf8_decode_invalid_test(void **state)
+{
+    wchar_t c;
+    // ucięty znak
+    assert_int_equal(utf8_decode("\xc5\x82", 1, &c), 0);
+    // bajt kontynuacji na początku
+    assert_int_equal(utf8_decode("\x82", 1, &c), 0);
+    // zły bajt kontynuacji
+    assert_int_equal(utf8_decode("\xc5z", 2, &c), 0);
+    // sekwencja nadmiarowa
+    assert_int_equal(utf8_decode("\xc0\xaf", 2, &c), 0);
+    // surogat
+    assert_int_equal(utf8_decode("\xed\xa0\x80", 3, &c), 0);
+    // poza zakresem
+    assert_int_equal(utf8_decode("\xf4\x90\x80\x80", 4, &c), 0);
+}
+
+/**
+ * Testuje kodowanie znaków.
+ */
+static void utf8_encode_test(void **state)
+{
+    char buf[UTF8_MAX_LENGTH];
+    assert_int_equal(utf8_encode(L'a', buf), 1);
+    assert_memory_equal(buf, "a", 1);
+    assert_int_equal(utf8_encode(L'ł', buf), 2);
+    assert_memory_equal(buf, "\xc5\x82", 2);
+    assert_int_equal(utf8_encode(0x20AC, buf), 3);
+    assert_memory_equal(buf, "\xe2\x82\xac", 3);
+    assert_int_equal(utf8_encode(0x1F600, buf), 4);
+    assert_memory_equal(buf, "\xf0\x9f\x98\x80", 4);
+    assert_int_equal(utf8_encode(0xD800, buf), 0);
+    assert_int_equal(utf8_encode(0x110000, buf), 0);
+}
+
+/**
+ * Testuje liczenie długości słowa.
+ */
+static void utf8_length_test(void **state)
+{
+    assert_int_equal(utf8_length(L""), 0);
+    assert_int_equal(utf8_length(L"żółw"), 7);
+}
+
+/**
+ * Uruchamia testy.
+ */
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(utf8_decode_test),
+        cmocka_unit_test(utf8_decode_invalid_test),
+        cmocka_unit_test(utf8_encode_test),
+        cmocka_unit_test(utf8_length_test),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,34 @@
+/** @file
+    Alokacja pamięci dla wektorów generowanych przez vector.h.
+
+    @ingroup dictionary
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+            
+    @copyright Uniwerstet Warszawski
+    @date 2015-06-20
+ */
+
+#include "vector.h"
+
+#include <stdlib.h>
+
+#include "../testable.h"
+
+/**
+ * @name Elementy interfejsu
+ * @{
+ */
+
+void * vector_realloc(void *ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void vector_free(void *ptr)
+{
+    free(ptr);
+}
+
+/**
+ * @}
+ */
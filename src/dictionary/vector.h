@@ -0,0 +1,267 @@
+/** @file
+    Makra generujące wektory, czyli dynamiczne tablice o ustalonym typie elementów.
+
+    W odróżnieniu od struct list elementy są trzymane bezpośrednio w tablicy
+    (a nie jako `void*`), tablica rośnie za pomocą realloc(), a sortowanie
+    i usuwanie duplikatów korzysta z porównań, które kompilator może rozwinąć
+    w miejscu wywołania.
+
+    Przykład użycia:
+
+        VECTOR_DEFINE(int_vector, int)
+        VECTOR_DEFINE_SORT(int_vector, int, int_less)
+
+    definiuje `struct int_vector` oraz funkcje `int_vector_init()`,
+    `int_vector_push()`, ..., `int_vector_sort()`.
+
+    Wszystkie generowane funkcje są statyczne, więc makra należy rozwijać
+    przed dołączeniem testable.h (który na potrzeby testów usuwa słowo
+    kluczowe `static`). Pamięć jest przydzielana przez vector_realloc()
+    i vector_free() z vector.c, więc w testach trafia do tego samego
+    alokatora co reszta modułu.
+
+    @ingroup dictionary
+    @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+
+    @copyright Uniwerstet Warszawski
+    @date 2015-06-20
+ */
+
+#ifndef DICTIONARY_VECTOR_H
+#define DICTIONARY_VECTOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Zmienia rozmiar bloku pamięci wektora (jak realloc()).
+ * @param[in] ptr Blok pamięci lub NULL.
+ * @param[in] size Nowy rozmiar w bajtach.
+ * @return Nowy blok lub NULL jeśli alokacja się nie powiodła.
+ */
+void * vector_realloc(void *ptr, size_t size);
+
+/**
+ * Zwalnia blok pamięci wektora (jak free()).
+ * @param[in] ptr Blok pamięci lub NULL.
+ */
+void vector_free(void *ptr);
+
+/**
+ * Definiuje strukturę wektora `struct name` o elementach typu `type`
+ * oraz podstawowe operacje na nim.
+ *
+ * @param name Nazwa struktury i przedrostek nazw funkcji.
+ * @param type Typ elementów.
+ */
+#define VECTOR_DEFINE(name, type)                                             \
+    /** Wektor elementów typu type. */                                       \
+    struct name                                                               \
+    {                                                                         \
+        type *array;        /**< Tablica elementów. */                        \
+        size_t size;        /**< Liczba elementów. */                         \
+        size_t capacity;    /**< Pojemność tablicy. */                        \
+    };                                                                        \
+                                                                              \
+    /** Inicjuje pusty wektor (bez alokacji). */                             \
+    static inline void name##_init(struct name *v)                            \
+    {                                                                         \
+        v->array = NULL;                                                      \
+        v->size = 0;                                                          \
+        v->capacity = 0;                                                      \
+    }                                                                         \
+                                                                              \
+    /** Zwalnia pamięć wektora. */                                           \
+    static inline void name##_done(struct name *v)                            \
+    {                                                                         \
+        vector_free(v->array);                                                \
+        v->array = NULL;                                                      \
+        v->size = v->capacity = 0;                                            \
+    }                                                                         \
+                                                                              \
+    /** Zapewnia pojemność co najmniej c; zwraca false przy braku pamięci. */ \
+    static inline bool name##_reserve(struct name *v, size_t c)               \
+    {                                                                         \
+        if(c <= v->capacity) return true;                                     \
+        type *na = vector_realloc(v->array, c * sizeof(type));                \
+        if(na == NULL) return false;                                          \
+        v->array = na;                                                        \
+        v->capacity = c;                                                      \
+        return true;                                                          \
+    }                                                                         \
+                                                                              \
+    /** Zapewnia miejsce na n kolejnych elementów (wzrost geometryczny). */  \
+    static inline bool name##_grow(struct name *v, size_t n)                  \
+    {                                                                         \
+        if(v->size + n <= v->capacity) return true;                           \
+        size_t c = v->capacity < 8 ? 8 : v->capacity * 2;                     \
+        while(c < v->size + n) c *= 2;                                        \
+        return name##_reserve(v, c);                                          \
+    }                                                                         \
+                                                                              \
+    /** Dodaje element na koniec wektora. */                                 \
+    static inline bool name##_push(struct name *v, type e)                    \
+    {                                                                         \
+        if(v->size >= v->capacity && !name##_grow(v, 1)) return false;        \
+        v->array[v->size++] = e;                                              \
+        return true;                                                          \
+    }                                                                         \
+                                                                              \
+    /** Dodaje n elementów z tablicy a na koniec wektora. */                 \
+    static inline bool name##_append(struct name *v, type const *a, size_t n) \
+    {                                                                         \
+        if(!name##_grow(v, n)) return false;                                  \
+        if(n > 0) memcpy(v->array + v->size, a, n * sizeof(type));            \
+        v->size += n;                                                         \
+        return true;                                                          \
+    }                                                                         \
+                                                                              \
+    /** Usuwa wszystkie elementy, zachowując zaalokowaną pamięć. */          \
+    static inline void name##_clear(struct name *v)                           \
+    {                                                                         \
+        v->size = 0;                                                          \
+    }
+
+/**
+ * Definiuje funkcję `name_sort()` sortującą wektor `struct name`.
+ *
+ * Sortowanie jest nierekurencyjnym quicksortem (mediana z trzech,
+ * sortowanie przez wstawianie dla krótkich przedziałów). Gdy podział
+ * okazuje się zbyt głęboki, przedział jest dosortowywany przez kopcowanie,
+ * więc pesymistyczny czas to O(n log n).
+ *
+ * @param name Nazwa wektora zdefiniowanego przez VECTOR_DEFINE.
+ * @param type Typ elementów.
+ * @param less Funkcja lub makro `bool less(const type *a, const type *b)`.
+ */
+#define VECTOR_DEFINE_SORT(name, type, less)                                  \
+    /** Przesiewa element kopca w dół (porządek według less). */            \
+    static inline void name##_sift_down(type *a, size_t i, size_t n)          \
+    {                                                                         \
+        type e = a[i];                                                        \
+        while(2 * i + 1 < n)                                                  \
+        {                                                                     \
+            size_t c = 2 * i + 1;                                             \
+            if(c + 1 < n && less(&a[c], &a[c + 1])) c++;                      \
+            if(!less(&e, &a[c])) break;                                       \
+            a[i] = a[c];                                                      \
+            i = c;                                                            \
+        }                                                                     \
+        a[i] = e;                                                             \
+    }                                                                         \
+                                                                              \
+    /** Sortuje tablicę przez kopcowanie. */                                 \
+    static inline void name##_heap_sort(type *a, size_t n)                    \
+    {                                                                         \
+        for(size_t i = n / 2; i-- > 0; ) name##_sift_down(a, i, n);           \
+        while(n > 1)                                                          \
+        {                                                                     \
+            type t = a[0]; a[0] = a[n - 1]; a[n - 1] = t;                     \
+            name##_sift_down(a, 0, --n);                                      \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    /** Sortuje tablicę przez wstawianie. */                                 \
+    static inline void name##_insertion_sort(type *a, size_t n)               \
+    {                                                                         \
+        for(size_t i = 1; i < n; i++)                                         \
+        {                                                                     \
+            type e = a[i];                                                    \
+            size_t j = i;                                                     \
+            while(j > 0 && less(&e, &a[j - 1]))                               \
+            {                                                                 \
+                a[j] = a[j - 1];                                              \
+                j--;                                                          \
+            }                                                                 \
+            a[j] = e;                                                         \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    /** Sortuje wektor. */                                                   \
+    static inline void name##_sort(struct name *v)                            \
+    {                                                                         \
+        size_t lo_stack[64], hi_stack[64];                                    \
+        int depth_stack[64];                                                  \
+        int top = 0;                                                          \
+        int depth = 0;                                                        \
+        for(size_t n = v->size; n > 1; n >>= 1) depth += 2;                   \
+        lo_stack[0] = 0; hi_stack[0] = v->size; depth_stack[0] = depth;       \
+        top = 1;                                                              \
+        while(top > 0)                                                        \
+        {                                                                     \
+            top--;                                                            \
+            size_t lo = lo_stack[top], hi = hi_stack[top];                    \
+            depth = depth_stack[top];                                         \
+            while(hi - lo > 16)                                               \
+            {                                                                 \
+                type *a = v->array;                                           \
+                if(depth-- == 0)                                              \
+                {                                                             \
+                    name##_heap_sort(a + lo, hi - lo);                        \
+                    break;                                                    \
+                }                                                             \
+                size_t mid = lo + (hi - lo) / 2;                              \
+                type t;                                                       \
+                if(less(&a[mid], &a[lo]))                                     \
+                    { t = a[mid]; a[mid] = a[lo]; a[lo] = t; }                \
+                if(less(&a[hi - 1], &a[mid]))                                 \
+                    { t = a[hi - 1]; a[hi - 1] = a[mid]; a[mid] = t; }        \
+                if(less(&a[mid], &a[lo]))                                     \
+                    { t = a[mid]; a[mid] = a[lo]; a[lo] = t; }                \
+                type pivot = a[mid];                                          \
+                size_t i = lo, j = hi - 1;                                    \
+                while(1)                                                      \
+                {                                                             \
+                    while(less(&a[i], &pivot)) i++;                           \
+                    while(less(&pivot, &a[j])) j--;                           \
+                    if(i >= j) break;                                         \
+                    t = a[i]; a[i] = a[j]; a[j] = t;                          \
+                    i++; j--;                                                 \
+                }                                                             \
+                /* [lo, j] i [j+1, hi); mniejszy przedział najpierw */        \
+                size_t split = j + 1;                                         \
+                if(split - lo < hi - split)                                   \
+                {                                                             \
+                    lo_stack[top] = split; hi_stack[top] = hi;                \
+                    depth_stack[top++] = depth;                               \
+                    hi = split;                                               \
+                }                                                             \
+                else                                                          \
+                {                                                             \
+                    lo_stack[top] = lo; hi_stack[top] = split;                \
+                    depth_stack[top++] = depth;                               \
+                    lo = split;                                               \
+                }                                                             \
+            }                                                                 \
+            if(hi - lo <= 16)                                                 \
+                name##_insertion_sort(v->array + lo, hi - lo);                \
+        }                                                                     \
+    }
+
+/**
+ * Definiuje funkcję `name_unique()`, która w posortowanym wektorze zostawia
+ * tylko pierwszy element z każdej grupy równych sobie elementów.
+ * Działa w miejscu, bez dodatkowych alokacji.
+ *
+ * @param name Nazwa wektora zdefiniowanego przez VECTOR_DEFINE.
+ * @param type Typ elementów.
+ * @param equal Funkcja lub makro `bool equal(const type *a, const type *b)`.
+ */
+#define VECTOR_DEFINE_UNIQUE(name, type, equal)                               \
+    /** Usuwa kolejne duplikaty; jeśli dups != NULL, dopisuje je tam. */      \
+    static inline void name##_unique(struct name *v, struct name *dups)       \
+    {                                                                         \
+        if(v->size <= 1) return;                                              \
+        size_t w = 1;                                                         \
+        for(size_t r = 1; r < v->size; r++)                                   \
+        {                                                                     \
+            if(!equal(&v->array[w - 1], &v->array[r]))                        \
+                v->array[w++] = v->array[r];                                  \
+            else if(dups != NULL)                                             \
+                name##_push(dups, v->array[r]);                               \
+        }                                                                     \
+        v->size = w;                                                          \
+    }
+
+#endif /* DICTIONARY_VECTOR_H */
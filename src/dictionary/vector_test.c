@@ -0,0 +1,117 @@
+/** @file
+  Test makr generujących wektory.
+  
+  @ingroup dictionary
+  @author Wojciech Kordalski <wojtek.kordalski@gmail.com>
+          
+  @copyright Uniwerstet Warszawski
+  @date 2015-06-20
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <cmocka.h>
+#include "vector.h"
+
+/// Porządek na liczbach całkowitych.
+#define int_less(a, b) (*(a) < *(b))
+/// Równość liczb całkowitych.
+#define int_equal(a, b) (*(a) == *(b))
+
+VECTOR_DEFINE(int_vector, int)
+VECTOR_DEFINE_SORT(int_vector, int, int_less)
+VECTOR_DEFINE_UNIQUE(int_vector, int, int_equal)
+
+/// Testuje dodawanie elementów do wektora.
+static void vector_push_test(void **state)
+{
+    struct int_vector v;
+    int_vector_init(&v);
+    assert_int_equal(v.size, 0);
+    for(int i = 0; i < 1000; i++)
+        assert_true(int_vector_push(&v, i));
+    assert_int_equal(v.size, 1000);
+    assert_true(v.capacity >= 1000);
+    for(int i = 0; i < 1000; i++)
+        assert_int_equal(v.array[i], i);
+    int_vector_clear(&v);
+    assert_int_equal(v.size, 0);
+    int_vector_done(&v);
+}
+
+/// Testuje dopisywanie tablicy na koniec wektora.
+static void vector_append_test(void **state)
+{
+    int a[] = {3, 1, 4, 1, 5};
+    struct int_vector v;
+    int_vector_init(&v);
+    assert_true(int_vector_append(&v, a, 5));
+    assert_true(int_vector_append(&v, a, 5));
+    assert_int_equal(v.size, 10);
+    assert_int_equal(v.array[7], 4);
+    int_vector_done(&v);
+}
+
+/// Testuje sortowanie dużego wektora.
+static void vector_sort_test(void **state)
+{
+    struct int_vector v;
+    int_vector_init(&v);
+    unsigned x = 12345;
+    for(int i = 0; i < 10000; i++)
+    {
+        x = x * 1103515245 + 12345;
+        int_vector_push(&v, (x >> 16) % 100);
+    }
+    int_vector_sort(&v);
+    for(size_t i = 1; i < v.size; i++)
+        assert_true(v.array[i-1] <= v.array[i]);
+    int_vector_done(&v);
+}
+
+/// Testuje sortowanie wektora posortowanego malejąco.
+static void vector_sort_reversed_test(void **state)
+{
+    struct int_vector v;
+    int_vector_init(&v);
+    for(int i = 5000; i > 0; i--)
+        int_vector_push(&v, i);
+    int_vector_sort(&v);
+    for(size_t i = 0; i < v.size; i++)
+        assert_int_equal(v.array[i], i + 1);
+    int_vector_done(&v);
+}
+
+/// Testuje usuwanie duplikatów.
+static void vector_unique_test(void **state)
+{
+    int a[] = {5, 1, 3, 1, 5, 5, 2};
+    struct int_vector v, dups;
+    int_vector_init(&v);
+    int_vector_init(&dups);
+    int_vector_append(&v, a, 7);
+    int_vector_sort(&v);
+    int_vector_unique(&v, &dups);
+    assert_int_equal(v.size, 4);
+    assert_int_equal(v.array[0], 1);
+    assert_int_equal(v.array[1], 2);
+    assert_int_equal(v.array[2], 3);
+    assert_int_equal(v.array[3], 5);
+    assert_int_equal(dups.size, 3);
+    int_vector_done(&v);
+    int_vector_done(&dups);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(vector_push_test),
+        cmocka_unit_test(vector_append_test),
+        cmocka_unit_test(vector_sort_test),
+        cmocka_unit_test(vector_sort_reversed_test),
+        cmocka_unit_test(vector_unique_test),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -18,6 +18,47 @@
 #include "../testable.h"
 
 
+/** @name Funkcje pomocnicze
+   @{
+ */
+
+/**
+ * Zapewnia miejsce na kolejne słowo o podanej długości.
+ * Po przeniesieniu bufora znaków odtwarza wskaźniki na słowa.
+ *
+ * @param[in,out] list Lista słów.
+ * @param[in] len Długość dodawanego słowa.
+ * @return 1 jeśli się udało, 0 w p.p.
+ */
+static int word_list_grow(struct word_list *list, size_t len)
+{
+    if(list->size >= list->capacity)
+    {
+        size_t cap = list->capacity < 16 ? 16 : list->capacity * 2;
+        const wchar_t **na = realloc(list->array, sizeof(wchar_t*)*cap);
+        if(na == NULL) return 0;
+        list->array = na;
+        size_t *no = realloc(list->offsets, sizeof(size_t)*cap);
+        if(no == NULL) return 0;
+        list->offsets = no;
+        list->capacity = cap;
+    }
+    if(list->buffer_size + len + 1 > list->buffer_capacity)
+    {
+        size_t cap = list->buffer_capacity < 256 ? 256 : list->buffer_capacity;
+        while(list->buffer_size + len + 1 > cap) cap *= 2;
+        wchar_t *nb = realloc(list->buffer, sizeof(wchar_t)*cap);
+        if(nb == NULL) return 0;
+        list->buffer = nb;
+        list->buffer_capacity = cap;
+        for(size_t i = 0; i < list->size; i++)
+            list->array[i] = nb + list->offsets[i];
+    }
+    return 1;
+}
+
+/**@}*/
+
 /** @name Elementy interfejsu 
    @{
  */
@@ -25,39 +66,48 @@
 void word_list_init(struct word_list *list)
 {
     list->size = 0;
-    list->capacity = 16;
-    list->array = malloc(sizeof(wchar_t*)*(list->capacity));
+    list->capacity = 0;
+    list->array = NULL;
+    list->offsets = NULL;
+    list->buffer = NULL;
+    list->buffer_size = 0;
+    list->buffer_capacity = 0;
 }
 
 void word_list_done(struct word_list *list)
 {
-    for(int i = 0; i < list->size; i++)
-    {
-        free((void*)(list->array[i]));
-    }
     free(list->array);
+    free(list->offsets);
+    free(list->buffer);
+}
+
+wchar_t * word_list_add_empty(struct word_list *list, size_t len)
+{
+    if(!word_list_grow(list, len)) return NULL;
+    wchar_t *word = list->buffer + list->buffer_size;
+    word[len] = 0;
+    list->offsets[list->size] = list->buffer_size;
+    list->array[list->size] = word;
+    list->buffer_size += len + 1;
+    list->size++;
+    return word;
 }
 
 int word_list_add(struct word_list *list, const wchar_t *word)
 {
-    if(list->size >= list->capacity)
-    {
-        // Enlarge the list
-        list->capacity *= 2;
-        const wchar_t ** na = malloc(sizeof(wchar_t*)*(list->capacity));
-        if(na == NULL) return 0;
-        for(int i = 0; i < list->size; i++)
-            na[i] = list->array[i];
-        free(list->array);
-        list->array = na;
-    }
-    int len = wcslen(word) + 1;
-    wchar_t *copy = malloc(sizeof(wchar_t)*len);
+    size_t len = wcslen(word);
+    wchar_t *copy = word_list_add_empty(list, len);
+    if(copy == NULL) return 0;
     memcpy(copy, word, sizeof(wchar_t)*len);
-    list->array[list->size++] = copy;
     return 1;
 }
 
+void word_list_clear(struct word_list *list)
+{
+    list->size = 0;
+    list->buffer_size = 0;
+}
+
 size_t word_list_size(const struct word_list *list)
 {
     return list->size;
@@ -19,15 +19,27 @@
   Struktura przechowująca listę słów.
   Należy używać funkcji operujących na strukturze,
   gdyż jej implementacja może się zmienić.
+
+  Wszystkie słowa są przechowywane jedno za drugim we wspólnym buforze
+  znaków, a lista pamięta jedynie przesunięcia ich początków.
+  Dzięki temu dodanie słowa nie wymaga osobnej alokacji.
   */
 struct word_list
 {
     /// Liczba słów.
     size_t size;
-    /// Pojemność tablicy
+    /// Pojemność tablic słów i przesunięć.
     size_t capacity;
-    /// Tablica słów.
+    /// Tablica słów (wskaźniki do wspólnego bufora).
     const wchar_t **array;
+    /// Przesunięcia początków słów we wspólnym buforze.
+    size_t *offsets;
+    /// Wspólny bufor ze słowami zakończonymi znakiem '\0'.
+    wchar_t *buffer;
+    /// Liczba zajętych znaków bufora.
+    size_t buffer_size;
+    /// Pojemność bufora.
+    size_t buffer_capacity;
 };
 
 /**
@@ -50,6 +62,22 @@ void word_list_done(struct word_list *list);
   */
 int word_list_add(struct word_list *list, const wchar_t *word);
 
+/**
+  Dodaje do listy słowo o zadanej długości i nieokreślonej treści.
+  Zwrócony bufor należy wypełnić `len` znakami; kończący znak '\0'
+  jest już wstawiony. Wskaźnik jest ważny do następnej modyfikacji listy.
+  @param[in,out] list Lista słów.
+  @param[in] len Długość dodawanego słowa.
+  @return Wskaźnik na miejsce na słowo lub NULL, jeśli się nie udało.
+  */
+wchar_t * word_list_add_empty(struct word_list *list, size_t len);
+
+/**
+  Usuwa wszystkie słowa z listy, nie zwalniając pamięci.
+  @param[in,out] list Lista słów.
+  */
+void word_list_clear(struct word_list *list);
+
 /**
   Zwraca liczę słów w liście.
   @param[in] list Lista słów.
@@ -43,6 +43,38 @@ static void word_list_add_test(void** state) {
     word_list_done(&l);
 }
 
+/**
+ * Testuje dodawanie wielu słów, wymuszające powiększenie bufora.
+ */
+static void word_list_grow_test(void** state) {
+    struct word_list l;
+    word_list_init(&l);
+    for(int i = 0; i < 100; i++)
+        word_list_add(&l, (i % 2) ? first : second);
+    assert_int_equal(word_list_size(&l), 100);
+    for(int i = 0; i < 100; i++)
+        assert_true(wcscmp((i % 2) ? first : second, word_list_get(&l)[i]) == 0);
+    word_list_done(&l);
+}
+
+/**
+ * Testuje dodawanie słowa wypełnianego na miejscu oraz czyszczenie listy.
+ */
+static void word_list_add_empty_test(void** state) {
+    struct word_list l;
+    word_list_init(&l);
+    word_list_add(&l, first);
+    wchar_t *w = word_list_add_empty(&l, 3);
+    w[0] = L'a'; w[1] = L'b'; w[2] = L'c';
+    assert_int_equal(word_list_size(&l), 2);
+    assert_true(wcscmp(L"abc", word_list_get(&l)[1]) == 0);
+    word_list_clear(&l);
+    assert_int_equal(word_list_size(&l), 0);
+    word_list_add(&l, third);
+    assert_true(wcscmp(third, word_list_get(&l)[0]) == 0);
+    word_list_done(&l);
+}
+
 /**
  * Tworzy przykładowe środowisko.
  */
@@ -92,6 +124,8 @@ int main(void) {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(word_list_init_test),
         cmocka_unit_test(word_list_add_test),
+        cmocka_unit_test(word_list_grow_test),
+        cmocka_unit_test(word_list_add_empty_test),
         cmocka_unit_test_setup_teardown(word_list_get_test, word_list_setup, word_list_teardown),
         cmocka_unit_test_setup_teardown(word_list_repeat_test, word_list_setup, word_list_teardown),
     };
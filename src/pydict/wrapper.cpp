@@ -44,14 +44,43 @@ public:
     }
     /**
      * Kopiuje obiekt słownika.
-     * Właściwie, to powinno być przenoszenie,
-     * ale to jest dopiero od C++11,
-     * a w dodatku nie wiem, czy Boost.Python to wspiera.
-     * Choć pewnie tak...
+     * Kopia jest klonem, który współdzieli słowa z oryginałem
+     * aż do pierwszej zmiany, więc kopiowanie jest tanie.
+     * @param[in] orig Kopiowany słownik.
      */
     dict(const dict &orig)
     {
-        d = orig.d;
+        d = orig.d != NULL ? dictionary_clone(orig.d) : NULL;
+    }
+    /**
+     * Przypisuje słownikowi klon innego słownika.
+     * @param[in] orig Kopiowany słownik.
+     * @return Ten słownik.
+     */
+    dict & operator=(const dict &orig)
+    {
+        if(this != &orig)
+        {
+            struct dictionary *copy = orig.d != NULL ? dictionary_clone(orig.d) : NULL;
+            if(d != NULL) dictionary_done(d);
+            d = copy;
+        }
+        return *this;
+    }
+    /**
+     * Niszczy słownik, jeśli nie zrobiono tego przez done().
+     */
+    ~dict()
+    {
+        if(d != NULL) dictionary_done(d);
+    }
+    /**
+     * Tworzy niezależną kopię słownika.
+     * @return Klon słownika.
+     */
+    dict clone()
+    {
+        return dict(*this);
     }
 
     /**
@@ -226,6 +255,7 @@ BOOST_PYTHON_MODULE(libpyippdict)
 {
     class_< ::dict>("dict")
         .def("done", &::dict::done)
+        .def("clone", &::dict::clone)
         .def("insert", &::dict::insert)
         .def("remove", &::dict::remove)
         .def("find", &::dict::find)
@@ -35,6 +35,12 @@ void mock_assert(const int result, const char* expression, const char *file,
 #define malloc(size) _test_malloc(size, __FILE__, __LINE__)
 void * _test_malloc(const size_t size, const char* file, const int line);
 
+#ifdef realloc
+#undef realloc
+#endif /* realloc */
+#define realloc(ptr, size) _test_realloc(ptr, size, __FILE__, __LINE__)
+void * _test_realloc(void * const ptr, const size_t size, const char* file, const int line);
+
 #ifdef free
 #undef free
 #endif /* free */